@@ -1,17 +1,26 @@
 #ifndef __APP_HPP__
 #define __APP_HPP__
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <random>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <sstream>
+#include <utility>
 
 #include <SDL.h>
 #include <SDL_ttf.h>
 
-#include "game-of-life.hpp"
+#include "engines.hpp"
+#include "painter.hpp"
+#include "pattern-io.hpp"
+#include "profiler.hpp"
+#include "recorder.hpp"
+#include "simulation.hpp"
+#include "snapshot.hpp"
 #include "ui/ui.hpp"
 
 class app
@@ -19,20 +28,132 @@ class app
     static constexpr int DEFAULT_WIDTH = 640;
     static constexpr int DEFAULT_HEIGHT = 480;
     static constexpr int DEFAULT_SCALE = 3;
+    // iterations Shift+Left goes back
+    static constexpr uint64_t LONG_REWIND = 100;
+    // seconds of events the HUD summarizes
+    static constexpr double HUD_WINDOW = 2;
 
 public:
-    app()
-        : width(DEFAULT_WIDTH), height(DEFAULT_HEIGHT), scale(DEFAULT_SCALE)
+    /// A world of `world_width` x `world_height` cells, 0 for as many as the window shows.
+    app(games::settings const &settings, int world_width, int world_height)
+        : width(DEFAULT_WIDTH), height(DEFAULT_HEIGHT), scale(DEFAULT_SCALE), settings(settings)
+        , colors(DEFAULT_WIDTH / DEFAULT_SCALE, DEFAULT_HEIGHT / DEFAULT_SCALE)
     {
         ready_ = setup_ui();
-        game = std::make_unique<games::game_of_life>(
-            width / scale,
-            height / scale,
-            reinterpret_cast<uint32_t *>(surface->pixels));
+        if (!ready_)
+        {
+            return;
+        }
+        int const view_width = width / scale;
+        int const view_height = height / scale;
+        sim = std::make_unique<simulation>(settings, world_width > 0 ? world_width : view_width,
+                                           world_height > 0 ? world_height : view_height, view_width, view_height);
+        if (!sim->is_ready())
+        {
+            // make_game() reports its own errors starting worker processes
+            std::string const problem = games::check(settings);
+            if (!problem.empty())
+            {
+                std::cerr << "\u001b[31;1mInvalid settings:\u001b[0m " << problem << std::endl;
+            }
+            ready_ = false;
+        }
+    }
+
+    /// Replaces the board with the pattern file at `path`, top left corner at the origin.
+    void load_pattern(std::string const &path)
+    {
+        int const w = sim->width();
+        int const h = sim->height();
+        sim->post([path, w, h](::game &g)
+                  {
+                      g.clear();
+                      patterns::info header;
+                      std::string error;
+                      if (!patterns::load(path, g, w, h, 0, 0, header, error))
+                      {
+                          std::cerr << "\u001b[31;1mError reading pattern:\u001b[0m " << error << std::endl;
+                      } });
+    }
+
+    /// Replaces the board with a snapshot of the same size.
+    void restore_snapshot(std::string const &path)
+    {
+        int const w = sim->width();
+        int const h = sim->height();
+        sim->post([path, w, h](::game &g)
+                  {
+                      snapshots::reader snapshot;
+                      if (!snapshot.open(path))
+                      {
+                          std::cerr << "\u001b[31;1mError reading snapshot:\u001b[0m " << snapshot.error() << std::endl;
+                          return;
+                      }
+                      if (snapshot.header().width != w || snapshot.header().height != h)
+                      {
+                          std::cerr << "\u001b[31;1mError reading snapshot:\u001b[0m " << path << " is "
+                                    << snapshot.header().width << "x" << snapshot.header().height
+                                    << ", the board " << w << "x" << h << std::endl;
+                          return;
+                      }
+                      if (!snapshot.restore(g))
+                      {
+                          std::cerr << "\u001b[31;1mError reading snapshot:\u001b[0m " << snapshot.error() << std::endl;
+                      } });
+    }
+
+    /// Settings of the recordings start_recording() and Ctrl+R make.
+    void set_recording(recording::options const &o)
+    {
+        record_options = o;
+    }
+
+    /// Streams what the window shows to `path` in the format of the recording settings.
+    void start_recording(std::string const &path)
+    {
+        recording::options o = record_options;
+        o.path = path;
+        auto r = std::make_shared<recording::recorder>(o, sim->view_width(), sim->view_height());
+        if (!r->error().empty())
+        {
+            std::cerr << "\u001b[31;1mError recording:\u001b[0m " << r->error() << std::endl;
+            return;
+        }
+        std::cout << "Recording to " << path << " ..." << std::endl;
+        recorder = r;
+        sim->set_recorder(recorder);
+    }
+
+    /// Writes what is still queued and closes the recording.
+    void stop_recording()
+    {
+        if (!recorder)
+        {
+            return;
+        }
+        sim->set_recorder(nullptr);
+        recorder->finish();
+        std::cout << "Recorded " << recorder->written() << " frames to " << recorder->settings().path;
+        if (recorder->dropped() > 0)
+        {
+            std::cout << ", dropped " << recorder->dropped() << " the disk could not keep up with";
+        }
+        std::cout << std::endl;
+        if (!recorder->error().empty())
+        {
+            std::cerr << "\u001b[31;1mError recording:\u001b[0m " << recorder->error() << std::endl;
+        }
+        recorder.reset();
     }
 
     virtual ~app()
     {
+        // the simulation thread must be gone before SDL shuts down
+        sim.reset();
+        // and the glyph atlas before its renderer
+        fps_label = ui::label{};
+        hud.clear();
+        ctx.reset();
         SDL_FreeSurface(surface);
         SDL_DestroyTexture(texture);
         SDL_DestroyRenderer(renderer);
@@ -44,27 +165,49 @@ public:
     {
         auto t0 = SDL_GetPerformanceCounter();
         long long num_frames = 0;
+        uint64_t iterations0 = 0;
         const float freq = static_cast<float>(SDL_GetPerformanceFrequency());
+        profiling::name_thread("display");
+        sim->start();
         while (!do_close)
         {
-            if (!paused)
             {
-                render();
-                if (++num_frames % 10 == 0)
+                profiling::scope timer(profiling::EVENTS);
+                handle_events();
+            }
+            render();
+            if (++num_frames % 10 == 0)
+            {
+                auto t1 = SDL_GetPerformanceCounter();
+                float seconds_elapsed = (t1 - t0) / freq;
+                t0 = t1;
+                uint64_t const iterations1 = sim->iterations();
+                std::stringstream ss;
+                // a rewind can take the count back
+                uint64_t const iterations = iterations1 > iterations0 ? iterations1 - iterations0 : 0;
+                ss << std::setprecision(4) << (10.f / seconds_elapsed) << " fps, "
+                   << (static_cast<float>(iterations) / seconds_elapsed) << " gens/s";
+                if (view.level > 0)
+                {
+                    ss << ", 1:" << (uint64_t{1} << view.level);
+                }
+                iterations0 = iterations1;
+                fps_label.set_text(ss.str());
+                if (hud_visible)
                 {
-                    auto t1 = SDL_GetPerformanceCounter();
-                    float seconds_elapsed = (t1 - t0) / freq;
-                    t0 = t1;
-                    std::stringstream ss;
-                    ss << std::setprecision(4) << (10.f / seconds_elapsed) << " fps";
-                    fps_label.set_text(ss.str());
+                    update_hud();
                 }
-                fps_label.render();
-                SDL_RenderPresent(renderer);
-                iterate();
             }
-            handle_events();
+            profiling::scope timer(profiling::PRESENT);
+            fps_label.render();
+            for (std::size_t i = 0; hud_visible && i < hud.size(); ++i)
+            {
+                hud[i].render();
+            }
+            SDL_RenderPresent(renderer);
         }
+        sim->stop();
+        stop_recording();
     }
 
     bool is_ready() const
@@ -75,11 +218,57 @@ public:
 private:
     void render()
     {
-        SDL_UpdateTexture(texture, nullptr, surface->pixels, surface->pitch);
+        // only frames that are shown get colored, and only the rows that changed are uploaded
+        if (sim->update_frame())
+        {
+            simulation::frame const &f = sim->latest_frame();
+            if (f.shown != shown)
+            {
+                // other cells than before, so no trails
+                colors.reset();
+                shown = f.shown;
+            }
+            std::vector<painter::rows> const *changed;
+            {
+                profiling::scope timer(profiling::COLOR);
+                if (f.shown.level > 0)
+                {
+                    changed = &colors.update_density(f.counts, f.shown.level);
+                }
+                else if (!f.states.empty())
+                {
+                    changed = &colors.update_states(f.states, f.state_count);
+                }
+                else
+                {
+                    changed = &colors.update(f.cells, f.versions, simulation::BAND_ROWS);
+                }
+            }
+            profiling::scope timer(profiling::UPLOAD);
+            for (painter::rows const &r : *changed)
+            {
+                upload(r.begin, r.end);
+            }
+        }
         SDL_RenderClear(renderer);
         SDL_RenderCopy(renderer, texture, nullptr, nullptr);
     }
 
+    // Paints rows [begin, end) straight into the streaming texture.
+    void upload(int begin, int end)
+    {
+        SDL_Rect const rect{0, begin, colors.width(), end - begin};
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(texture, &rect, &pixels, &pitch) != 0)
+        {
+            std::cerr << "\u001b[31;1mError locking texture:\u001b[0m " << SDL_GetError() << std::endl;
+            return;
+        }
+        colors.paint(begin, end, pixels, pitch);
+        SDL_UnlockTexture(texture);
+    }
+
     bool setup_ui()
     {
         if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_TIMER) != 0)
@@ -114,13 +303,17 @@ private:
             std::cerr << "\u001b[31;1mError initializing surface:\u001b[0m " << SDL_GetError() << std::endl;
             return false;
         }
-        texture = SDL_CreateTextureFromSurface(renderer, surface);
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width / scale, height / scale);
         if (texture == nullptr)
         {
             std::cerr << "\u001b[31;1mError initializing texture:\u001b[0m " << SDL_GetError() << std::endl;
             return false;
         }
+        // the fading trails are drawn over the background
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
         SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+        // a streaming texture starts out with undefined pixels
+        upload(0, height / scale);
         SDL_RenderSetVSync(renderer, 1);
         if (TTF_Init() < 0)
         {
@@ -136,13 +329,125 @@ private:
 
         ctx = std::make_shared<ui::context>(renderer, font);
         fps_label = ui::label(ctx, {8, 8, 0, 0}, {255, 255, 255, 200}, "? fps");
+        // a line per phase and one for the counters
+        for (int i = 0; i <= profiling::PHASES; ++i)
+        {
+            hud.emplace_back(ctx, SDL_Rect{8, 40 + 24 * i, 0, 0}, SDL_Color{255, 255, 160, 220}, "");
+        }
 
         return true;
     }
 
-    inline void iterate()
+    // Writes the frame on screen to a BMP file.
+    void save_frame(std::string const &filename)
+    {
+        colors.paint(0, colors.height(), surface->pixels, surface->pitch);
+        SDL_SaveBMP(surface, filename.c_str());
+    }
+
+    // Percentiles of the phases over the last HUD_WINDOW seconds, and the latest counters.
+    void update_hud()
+    {
+        profiling::summarize(HUD_WINDOW, stats, scratch);
+        for (int p = 0; p < profiling::PHASES; ++p)
+        {
+            profiling::percentiles const &t = stats.phases[static_cast<std::size_t>(p)];
+            std::stringstream ss;
+            ss << std::left << std::setw(8) << profiling::name(static_cast<profiling::phase>(p)) << std::right
+               << std::fixed << std::setprecision(2) << "p50 " << t.p50 << "  p90 " << t.p90 << "  p99 " << t.p99
+               << "  max " << t.max << " ms  " << std::setprecision(0) << (static_cast<double>(t.count) / HUD_WINDOW) << "/s";
+            hud[static_cast<std::size_t>(p)].set_text(ss.str());
+        }
+        std::stringstream ss;
+        ss << profiling::name(profiling::POPULATION) << " " << stats.counters[profiling::POPULATION] << ", "
+           << stats.counters[profiling::CELL_UPDATES] << " cell updates/gen";
+        if (recorder)
+        {
+            ss << ", " << recorder->written() << " frames recorded, " << recorder->dropped() << " dropped";
+        }
+        hud.back().set_text(ss.str());
+    }
+
+    static char const *extension(recording::format f)
+    {
+        switch (f)
+        {
+        case recording::format::PNG:
+            return ".png";
+        case recording::format::GIF:
+            return ".gif";
+        default:
+            return ".y4m";
+        }
+    }
+
+    // Writes the recent events of all threads as a Chrome trace.
+    void save_trace(std::string const &filename)
+    {
+        std::string error;
+        if (!profiling::write_trace(filename, error))
+        {
+            std::cerr << "\u001b[31;1mError writing trace:\u001b[0m " << error << std::endl;
+        }
+    }
+
+    // Writes the cells to a snapshot from the simulation thread, between two generations.
+    void save_snapshot(std::string const &filename)
+    {
+        games::settings saved = settings;
+        saved.snapshots = true;
+        std::string const problem = games::check(saved);
+        if (!problem.empty())
+        {
+            std::cerr << "\u001b[31;1mError writing snapshot:\u001b[0m " << problem << std::endl;
+            return;
+        }
+        snapshots::info header;
+        header.width = sim->width();
+        header.height = sim->height();
+        header.rule = settings.rule;
+        header.ltl = settings.ltl;
+        header.seed = settings.seed;
+        uint64_t const per_iteration = games::generations_per_iteration(settings);
+        simulation const *s = sim.get();
+        sim->post([filename, header, per_iteration, s](::game &g) mutable
+                  {
+                      header.generation = s->iterations() * per_iteration;
+                      std::string error;
+                      if (!snapshots::save(filename, g, header, error))
+                      {
+                          std::cerr << "\u001b[31;1mError writing snapshot:\u001b[0m " << error << std::endl;
+                      } });
+    }
+
+    // The world cell under pixel (x, y) of the window.
+    std::pair<int64_t, int64_t> to_world(int x, int y) const
+    {
+        return {view.x + (int64_t{x / scale} << view.level), view.y + (int64_t{y / scale} << view.level)};
+    }
+
+    // Zooms out `steps` levels, in for negative ones, keeping the cells under pixel (x, y) in place.
+    void zoom(int steps, int x, int y)
+    {
+        int const level = std::clamp(view.level + steps, 0, max_level());
+        auto const [wx, wy] = to_world(x, y);
+        // the corner must stay a multiple of the square size
+        view.x = ((wx - (int64_t{x / scale} << level)) >> level) << level;
+        view.y = ((wy - (int64_t{y / scale} << level)) >> level) << level;
+        view.level = level;
+        sim->set_view(view);
+    }
+
+    // Zoomed out this far, the whole world fits in the window.
+    int max_level() const
     {
-        game->iterate();
+        int level = 0;
+        while (level < ::game::MAX_DENSITY_LEVEL &&
+               ((int64_t{sim->view_width()} << level) < sim->width() || (int64_t{sim->view_height()} << level) < sim->height()))
+        {
+            ++level;
+        }
+        return level;
     }
 
     void handle_events()
@@ -157,45 +462,118 @@ private:
                 {
                     mouse_down = true;
                 }
+                else if (event.button.button == SDL_BUTTON_RIGHT)
+                {
+                    panning = true;
+                    pan_x = event.button.x;
+                    pan_y = event.button.y;
+                    pan_from = view;
+                }
                 break;
             case SDL_MOUSEBUTTONUP:
                 if (event.button.button == 1)
                 {
                     if (!mouse_moved)
                     {
-                        int const x = event.motion.x / scale;
-                        int const y = event.motion.y / scale;
-                        game->emplace(x, y, games::game_of_life::TWOENGINESHIP);
+                        auto const [x, y] = to_world(event.button.x, event.button.y);
+                        sim->post([x, y](::game &g)
+                                  { g.emplace(static_cast<int>(x), static_cast<int>(y), games::game_of_life::TWO_ENGINE_CORDERSHIP); });
                     }
                     mouse_moved = false;
                     mouse_down = false;
                 }
+                else if (event.button.button == SDL_BUTTON_RIGHT)
+                {
+                    panning = false;
+                }
                 break;
             case SDL_MOUSEMOTION:
             {
-                if (mouse_down)
+                if (panning)
                 {
-                    int const x = event.motion.x / scale;
-                    int const y = event.motion.y / scale;
-                    game->irritate(x, y);
+                    // a square per pixel moved
+                    view.x = pan_from.x - (int64_t{(event.motion.x - pan_x) / scale} << view.level);
+                    view.y = pan_from.y - (int64_t{(event.motion.y - pan_y) / scale} << view.level);
+                    if (view != shown)
+                    {
+                        sim->set_view(view);
+                    }
+                }
+                else if (mouse_down)
+                {
+                    auto const [x, y] = to_world(event.motion.x, event.motion.y);
+                    sim->post([x, y](::game &g)
+                              { g.irritate(static_cast<int>(x), static_cast<int>(y)); });
                     mouse_moved = true;
                 }
             }
             break;
+            case SDL_MOUSEWHEEL:
+                if (event.wheel.y != 0 && !panning)
+                {
+                    int x;
+                    int y;
+                    SDL_GetMouseState(&x, &y);
+                    // rolled away from the user, it zooms in
+                    zoom(event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? event.wheel.y : -event.wheel.y, x, y);
+                }
+                break;
             case SDL_QUIT:
                 do_close = true;
                 break;
+            case SDL_KEYDOWN:
+                // held down, it keeps going back
+                if (event.key.keysym.sym == SDLK_LEFT)
+                {
+                    sim->rewind((event.key.keysym.mod & KMOD_SHIFT) != 0 ? LONG_REWIND : 1);
+                }
+                break;
             case SDL_KEYUP:
                 switch (event.key.keysym.sym)
                 {
                 case SDLK_ESCAPE:
-                    game->populate();
+                    sim->post([density = settings.density](::game &g)
+                              { g.populate(density); });
                     break;
                 case SDLK_SPACE:
-                    paused = !paused;
+                    sim->set_paused(!sim->paused());
                     break;
                 case SDLK_c:
-                    game->clear();
+                    sim->post([](::game &g)
+                              { g.clear(); });
+                    break;
+                case SDLK_F3:
+                    hud_visible = !hud_visible;
+                    sim->track_population(hud_visible);
+                    if (hud_visible)
+                    {
+                        update_hud();
+                    }
+                    break;
+                case SDLK_t:
+                    if (event.key.keysym.mod == KMOD_LCTRL)
+                    {
+                        std::string const filename = "trace-" + util::iso_datetime_now() + ".json";
+                        std::cout << "Saving trace to " << filename << " ..." << std::endl;
+                        save_trace(filename);
+                    }
+                    break;
+                case SDLK_r:
+                    if (event.key.keysym.mod == KMOD_LCTRL)
+                    {
+                        if (recorder)
+                        {
+                            stop_recording();
+                        }
+                        else
+                        {
+                            start_recording("recording-" + util::iso_datetime_now() + extension(record_options.fmt));
+                        }
+                    }
+                    break;
+                case SDLK_HOME:
+                    view = {};
+                    sim->set_view(view);
                     break;
                 case SDLK_q:
                     do_close = true;
@@ -204,9 +582,11 @@ private:
                 {
                     if (event.key.keysym.mod == KMOD_LCTRL)
                     {
-                        std::string filename = "screenshot-" + util::iso_datetime_now() + ".bmp";
-                        std::cout << "Saving screenshot to " << filename << " ..." << std::endl;
-                        SDL_SaveBMP(surface, filename.c_str());
+                        std::string const now = util::iso_datetime_now();
+                        std::string filename = "screenshot-" + now + ".bmp";
+                        std::cout << "Saving screenshot to " << filename << " and snapshot-" << now << ".snap ..." << std::endl;
+                        save_frame(filename);
+                        save_snapshot("snapshot-" + now + ".snap");
                     }
                 }
                 break;
@@ -224,20 +604,38 @@ private:
     int height;
     int scale;
     bool ready_{false};
-    std::unique_ptr<games::game_of_life> game;
+    games::settings settings;
+    std::unique_ptr<simulation> sim;
+    painter colors;
 
     std::shared_ptr<ui::context> ctx;
     ui::label fps_label{};
+    // F3 shows where the time goes
+    std::vector<ui::label> hud;
+    bool hud_visible{false};
+    profiling::summary stats;
+    std::vector<uint64_t> scratch;
+    // Ctrl+R starts and stops a recording with these settings
+    recording::options record_options;
+    std::shared_ptr<recording::recorder> recorder;
 
     SDL_Window *win;
     SDL_Renderer *renderer;
     SDL_Surface *surface;
     SDL_Texture *texture;
     TTF_Font *font;
-    bool paused{false};
     bool do_close{false};
     bool mouse_down{false};
     bool mouse_moved{false};
+
+    // what the window is to show, and what the last frame showed
+    simulation::view view;
+    simulation::view shown;
+    // the right button drags the view from where it was pressed
+    bool panning{false};
+    int pan_x{0};
+    int pan_y{0};
+    simulation::view pan_from;
 };
 
 #endif // __APP_HPP__
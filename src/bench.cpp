@@ -0,0 +1,426 @@
+// Throughput benchmarks of the engines over board sizes from L1-resident
+// to far beyond the last-level cache, with dense and sparse boards.
+// Results are written as JSON or CSV and can be compared against an
+// earlier run, failing when throughput regressed past a threshold.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engines.hpp"
+#include "kernels/life.hpp"
+#include "rule.hpp"
+
+namespace
+{
+    constexpr char const *GLIDER = ".O.\n..O\nOOO";
+    // one glider per GLIDER_SPACING x GLIDER_SPACING cells
+    constexpr int GLIDER_SPACING = 64;
+
+    struct result
+    {
+        std::string engine;
+        std::string rule;
+        std::string op;
+        int size;
+        std::string density;
+        unsigned int threads;
+        /// worker processes of the domain engine, 0 for the others
+        unsigned int workers;
+        uint64_t iterations;
+        double seconds;
+
+        std::string name() const
+        {
+            std::string n = engine + (workers > 0 ? ":" + std::to_string(workers) : "") + "/" + op + "/" + std::to_string(size) + "x" +
+                            std::to_string(size) + "/" + density;
+            // Conway runs keep their names from before rules were selectable
+            return rule == rules::to_string(rules::CONWAY) ? n : n + "/" + rule;
+        }
+        double per_second() const
+        {
+            return static_cast<double>(iterations) / seconds;
+        }
+        double cells_per_second() const
+        {
+            return per_second() * static_cast<double>(size) * static_cast<double>(size);
+        }
+    };
+
+    struct options
+    {
+        std::vector<std::string> engines{"classic", "packed", "sparse", "hashlife", "generations", "ltl",
+#ifdef AUTOMATA_DOMAIN_LIFE
+                                         "domain",
+#endif
+        };
+        /// worker processes the domain engine is run with
+        std::vector<unsigned int> workers{1, 2, 4};
+        std::vector<int> sizes{128, 1024, 4096, 16384};
+        std::vector<std::string> densities{"soup", "gliders"};
+        std::vector<rules::rule> rules{rules::CONWAY};
+        unsigned int threads{1};
+        double min_seconds{0.25};
+        std::string format{"json"};
+        std::string output;
+        std::string baseline;
+        double threshold{0.1};
+    };
+
+    // Largest board each engine is benchmarked on; beyond it a run takes minutes.
+    int max_size(std::string const &engine)
+    {
+        if (engine == "classic" || engine == "domain")
+        {
+            return 1024;
+        }
+        if (engine == "hashlife")
+        {
+            return 2048;
+        }
+        if (engine == "ltl")
+        {
+            return 4096;
+        }
+        return 1 << 16;
+    }
+
+    void usage(char const *argv0)
+    {
+        std::cerr << "Usage: " << argv0
+                  << " [--engines a,b] [--sizes N,M] [--densities soup,gliders] [--rules a,b] [--threads N] [--workers N,M] [--min-time SECONDS]"
+                     " [--format json|csv] [--output FILE] [--baseline FILE] [--threshold FRACTION]"
+                  << std::endl;
+    }
+
+    std::vector<std::string> split(std::string const &s)
+    {
+        std::vector<std::string> parts;
+        std::stringstream ss(s);
+        std::string part;
+        while (std::getline(ss, part, ','))
+        {
+            if (!part.empty())
+            {
+                parts.push_back(part);
+            }
+        }
+        return parts;
+    }
+
+    void fill(game &g, int size, std::string const &density)
+    {
+        if (density == "soup")
+        {
+            g.populate(0.5);
+            return;
+        }
+        for (int y = 0; y + 3 <= size; y += GLIDER_SPACING)
+        {
+            for (int x = 0; x + 3 <= size; x += GLIDER_SPACING)
+            {
+                g.emplace(x, y, GLIDER);
+            }
+        }
+    }
+
+    // Calls `f` until at least `min_seconds` have passed, after one untimed warm-up call.
+    std::pair<uint64_t, double> measure(double min_seconds, std::function<void()> const &f)
+    {
+        f();
+        uint64_t n = 0;
+        auto const t0 = std::chrono::steady_clock::now();
+        double seconds = 0;
+        do
+        {
+            f();
+            ++n;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        } while (seconds < min_seconds);
+        return {n, seconds};
+    }
+
+    std::vector<result> run(options const &opt)
+    {
+        std::vector<result> results;
+        for (std::string const &engine : opt.engines)
+        {
+            // "domain" is the classic engine split among worker processes
+            std::vector<unsigned int> const workers = engine == "domain" ? opt.workers : std::vector<unsigned int>{0};
+            for (rules::rule const &rule : opt.rules)
+            {
+                for (unsigned int w : workers)
+                {
+                    games::settings s;
+                    s.engine = engine == "domain" ? "classic" : engine;
+                    s.threads = opt.threads;
+                    s.workers = w;
+                    s.seed = 1;
+                    s.rule = rule;
+                    std::string const problem = games::check(s);
+                    if (!problem.empty())
+                    {
+                        std::cerr << "\u001b[31;1mSkipping:\u001b[0m " << problem << std::endl;
+                        continue;
+                    }
+                    std::string const rule_name = rules::to_string(rule);
+                    for (int size : opt.sizes)
+                    {
+                        if (size > max_size(engine))
+                        {
+                            continue;
+                        }
+                        for (std::string const &density : opt.densities)
+                        {
+                            std::unique_ptr<game> g = games::make_game(s, size, size);
+                            if (!g)
+                            {
+                                // make_game() reports why its worker processes did not start
+                                continue;
+                            }
+                            auto const [fills, fill_seconds] = measure(opt.min_seconds, [&]
+                                                                       { fill(*g, size, density); });
+                            results.push_back({engine, rule_name, density == "soup" ? "populate" : "emplace", size, density,
+                                               opt.threads, w, fills, fill_seconds});
+                            g->clear();
+                            fill(*g, size, density);
+                            auto const [gens, gen_seconds] = measure(opt.min_seconds, [&]
+                                                                     { g->iterate(); });
+                            if (std::string const failure = g->failure(); !failure.empty())
+                            {
+                                std::cerr << "\u001b[31;1mThe engine stopped:\u001b[0m " << failure << std::endl;
+                                results.pop_back();
+                                continue;
+                            }
+                            results.push_back({engine, rule_name, "iterate", size, density, opt.threads, w, gens, gen_seconds});
+                            std::cerr << std::left << std::setw(40) << results.back().name()
+                                      << std::right << std::scientific << std::setprecision(3)
+                                      << results.back().cells_per_second() << " cells/s" << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+        return results;
+    }
+
+    void write_json(std::ostream &out, std::vector<result> const &results)
+    {
+        out << "{\"kernel\": \"" << kernels::active().name << "\", \"results\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            result const &r = results[i];
+            out << "  {\"name\": \"" << r.name() << "\", \"engine\": \"" << r.engine << "\", \"rule\": \"" << r.rule << "\", \"op\": \"" << r.op
+                << "\", \"size\": " << r.size << ", \"density\": \"" << r.density << "\", \"threads\": " << r.threads << ", \"workers\": " << r.workers
+                << ", \"iterations\": " << r.iterations << ", \"seconds\": " << r.seconds
+                << ", \"per_s\": " << r.per_second() << ", \"cells_per_s\": " << r.cells_per_second() << "}"
+                << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        out << "]}\n";
+    }
+
+    void write_csv(std::ostream &out, std::vector<result> const &results)
+    {
+        out << "name,engine,rule,op,size,density,threads,workers,iterations,seconds,per_s,cells_per_s\n";
+        for (result const &r : results)
+        {
+            out << r.name() << "," << r.engine << "," << r.rule << "," << r.op << "," << r.size << "," << r.density << ","
+                << r.threads << "," << r.workers << "," << r.iterations << "," << r.seconds << ","
+                << r.per_second() << "," << r.cells_per_second() << "\n";
+        }
+    }
+
+    /**
+     * Reads cells/s by benchmark name from the JSON or CSV output of an
+     * earlier run. Only the formats written above are understood.
+     */
+    bool read_baseline(std::string const &path, std::map<std::string, double> &baseline)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::size_t const name = line.find("\"name\": \"");
+            if (name != std::string::npos)
+            {
+                std::size_t const begin = name + std::strlen("\"name\": \"");
+                std::size_t const rate = line.find("\"cells_per_s\": ");
+                if (rate != std::string::npos)
+                {
+                    baseline[line.substr(begin, line.find('"', begin) - begin)] =
+                        std::strtod(line.c_str() + rate + std::strlen("\"cells_per_s\": "), nullptr);
+                }
+            }
+            else if (line.find(',') != std::string::npos && line.rfind("name,", 0) != 0)
+            {
+                baseline[line.substr(0, line.find(','))] = std::strtod(line.c_str() + line.rfind(',') + 1, nullptr);
+            }
+        }
+        return true;
+    }
+
+    // Prints the change against the baseline. Returns false if anything regressed past `threshold`.
+    bool compare(std::vector<result> const &results, std::map<std::string, double> const &baseline, double threshold)
+    {
+        bool ok = true;
+        for (result const &r : results)
+        {
+            auto const it = baseline.find(r.name());
+            if (it == baseline.end() || it->second <= 0)
+            {
+                continue;
+            }
+            double const change = r.cells_per_second() / it->second - 1;
+            bool const regressed = change < -threshold;
+            ok &= !regressed;
+            std::cerr << std::left << std::setw(40) << r.name()
+                      << std::right << std::fixed << std::setprecision(1) << std::showpos
+                      << std::setw(8) << change * 100 << "%" << std::noshowpos
+                      << (regressed ? "  \u001b[31;1mREGRESSION\u001b[0m" : "") << std::endl;
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--engines") == 0 && i + 1 < argc)
+        {
+            opt.engines = split(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc)
+        {
+            opt.sizes.clear();
+            for (std::string const &size : split(argv[++i]))
+            {
+                opt.sizes.push_back(std::atoi(size.c_str()));
+            }
+        }
+        else if (std::strcmp(argv[i], "--densities") == 0 && i + 1 < argc)
+        {
+            opt.densities = split(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--rules") == 0 && i + 1 < argc)
+        {
+            opt.rules.clear();
+            for (std::string const &name : split(argv[++i]))
+            {
+                rules::rule r{};
+                if (!rules::from_name(name, r))
+                {
+                    std::cerr << "\u001b[31;1mInvalid rule:\u001b[0m " << name << std::endl;
+                    return EXIT_FAILURE;
+                }
+                opt.rules.push_back(r);
+            }
+        }
+        else if ((std::strcmp(argv[i], "--threads") == 0 || std::strcmp(argv[i], "-t") == 0) && i + 1 < argc)
+        {
+            opt.threads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            opt.workers.clear();
+            for (std::string const &n : split(argv[++i]))
+            {
+                opt.workers.push_back(static_cast<unsigned int>(std::strtoul(n.c_str(), nullptr, 10)));
+            }
+        }
+        else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+        {
+            opt.min_seconds = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            opt.format = argv[++i];
+        }
+        else if ((std::strcmp(argv[i], "--output") == 0 || std::strcmp(argv[i], "-o") == 0) && i + 1 < argc)
+        {
+            opt.output = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            opt.baseline = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            opt.threshold = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            if (!kernels::select(argv[++i]))
+            {
+                std::cerr << "\u001b[31;1mKernel not supported on this CPU:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((opt.format != "json" && opt.format != "csv") || std::find(opt.workers.begin(), opt.workers.end(), 0u) != opt.workers.end())
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!opt.baseline.empty() && !read_baseline(opt.baseline, baseline))
+    {
+        std::cerr << "\u001b[31;1mError reading baseline:\u001b[0m " << opt.baseline << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<result> const results = run(opt);
+    if (results.empty())
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream file;
+    if (!opt.output.empty())
+    {
+        file.open(opt.output);
+        if (!file)
+        {
+            std::cerr << "\u001b[31;1mError writing:\u001b[0m " << opt.output << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream &out = opt.output.empty() ? std::cout : file;
+    out << std::setprecision(6);
+    if (opt.format == "json")
+    {
+        write_json(out, results);
+    }
+    else
+    {
+        write_csv(out, results);
+    }
+
+    if (!baseline.empty() && !compare(results, baseline, opt.threshold))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
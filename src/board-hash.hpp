@@ -0,0 +1,79 @@
+#ifndef __BOARD_HASH_HPP__
+#define __BOARD_HASH_HPP__
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace games
+{
+    /**
+     * Hashes of bit-packed boards that can be kept up to date one tile at a
+     * time: the hash of a board is EMPTY_BOARD_HASH XORed with the
+     * tile_hash() of each of its tiles, so a changed tile is swapped in by
+     * XORing out its old hash and XORing in its new one. Tiles without
+     * live cells hash to 0 and need not be visited at all.
+     */
+    constexpr uint64_t EMPTY_BOARD_HASH = 0x6a09e667f3bcc908ull;
+
+    /**
+     * Tiles of bounded boards: the packed engine's tiles, so that it can
+     * hash a tile right after stepping it. Other bounded engines hash the
+     * same tiles and get the same hash for the same board.
+     */
+    constexpr int HASH_TILE_ROWS = 32;
+    constexpr std::size_t HASH_TILE_WORDS = 8;
+
+    inline uint64_t mix64(uint64_t h)
+    {
+        // the splitmix64 finalizer
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        return h;
+    }
+
+    /// Salt of the tile at tile coordinates (x, y) for tile_hash().
+    inline uint64_t tile_salt(int64_t x, int64_t y)
+    {
+        return mix64(static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ull + static_cast<uint64_t>(y) * 0xc2b2ae3d27d4eb4full + 0x165667b19e3779f9ull);
+    }
+
+    /**
+     * Hash of `rows` rows of `words` <= HASH_TILE_WORDS words, `stride`
+     * words apart, of the tile identified by `salt`. 0 if the tile has no
+     * live cells.
+     */
+    inline uint64_t tile_hash(uint64_t const *cells, std::size_t stride, int rows, std::size_t words, uint64_t salt)
+    {
+        // every word is mixed with a key of its own by a 32 x 32 bit
+        // multiplication and the products of each column are only added up,
+        // so nothing waits on the previous row
+        uint64_t lanes[HASH_TILE_WORDS] = {};
+        uint64_t any = 0;
+        uint64_t key = salt;
+        for (int y = 0; y < rows; ++y, cells += stride, key += 0x9e3779b97f4a7c15ull)
+        {
+            for (std::size_t w = 0; w < words; ++w)
+            {
+                uint64_t const x = cells[w] ^ (key + w * 0xc2b2ae3d27d4eb4full);
+                lanes[w] += (x & 0xffffffffu) * (x >> 32) + cells[w];
+                any |= cells[w];
+            }
+        }
+        if (any == 0)
+        {
+            return 0;
+        }
+        uint64_t h = salt;
+        for (std::size_t w = 0; w < HASH_TILE_WORDS; ++w)
+        {
+            h ^= std::rotl(lanes[w], static_cast<int>(w * 8));
+        }
+        return mix64(h);
+    }
+}
+
+#endif // __BOARD_HASH_HPP__
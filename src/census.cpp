@@ -0,0 +1,652 @@
+#include "census.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <utility>
+
+#include "board-hash.hpp"
+#include "kernels/life.hpp"
+
+namespace games
+{
+    namespace
+    {
+        // shapes whose objects are remembered
+        constexpr std::size_t MAX_CACHED = 1 << 16;
+        // groups of cells are flooded, and objects run, in WINDOW x WINDOW boxes that wrap around
+        constexpr int WINDOW = 64;
+        using box = std::array<uint64_t, WINDOW>;
+
+        // A group of cells moved to the top left corner of a box.
+        struct shape
+        {
+            int width{0};
+            int height{0};
+            box rows{};
+
+            bool operator==(shape const &other) const = default;
+        };
+
+        struct classification
+        {
+            std::string code;
+            // generations until it repeats, 0 if it did not
+            std::size_t period;
+        };
+
+        inline int mod(int a, int b)
+        {
+            int const m = a % b;
+            return m < 0 ? m + b : m;
+        }
+
+        inline uint64_t spread(uint64_t r)
+        {
+            return r | (r << 1) | (r >> 1);
+        }
+
+        inline uint64_t low_bits(int n)
+        {
+            return n >= 64 ? ~uint64_t{0} : (uint64_t{1} << n) - 1;
+        }
+
+        // Cells [x0, x0 + n) of a row `width` cells wide that wraps around.
+        uint64_t read(uint64_t const *row, int width, int x0, int n)
+        {
+            x0 = mod(x0, width);
+            std::size_t const words = (static_cast<std::size_t>(width) + 63) / 64;
+            std::size_t const w = static_cast<std::size_t>(x0 / 64);
+            int const s = x0 % 64;
+            if (width % 64 == 0 || x0 + n <= width)
+            {
+                uint64_t v = row[w] >> s;
+                if (s != 0 && (width % 64 == 0 || w + 1 < words))
+                {
+                    v |= row[(w + 1) % words] << (64 - s);
+                }
+                return v & low_bits(n);
+            }
+            uint64_t v = 0;
+            for (int x = 0; x < n; ++x)
+            {
+                int const c = (x0 + x) % width;
+                v |= ((row[c / 64] >> (c % 64)) & 1) << x;
+            }
+            return v;
+        }
+
+        // Clears the cells of `mask`, shifted to column x0, in a row like the one of read().
+        void erase(uint64_t *row, int width, int x0, int n, uint64_t mask)
+        {
+            x0 = mod(x0, width);
+            std::size_t const words = (static_cast<std::size_t>(width) + 63) / 64;
+            std::size_t const w = static_cast<std::size_t>(x0 / 64);
+            int const s = x0 % 64;
+            if (width % 64 == 0 || x0 + n <= width)
+            {
+                row[w] &= ~(mask << s);
+                if (s != 0 && (width % 64 == 0 || w + 1 < words))
+                {
+                    row[(w + 1) % words] &= ~(mask >> (64 - s));
+                }
+                return;
+            }
+            for (uint64_t m = mask; m != 0; m &= m - 1)
+            {
+                int const c = (x0 + std::countr_zero(m)) % width;
+                row[c / 64] &= ~(uint64_t{1} << (c % 64));
+            }
+        }
+
+        // cells up to two columns to either side
+        inline uint64_t spread2(uint64_t r)
+        {
+            return spread(r) | (r << 2) | (r >> 2);
+        }
+
+        /**
+         * Grows `group` to all cells of `cells` it reaches a row of 64 cells
+         * at a time, going from cell to cell only orthogonally with `reach`
+         * 0, to any of the eight neighbors with 1, and across one dead cell
+         * with 2.
+         */
+        void flood(box &group, box const &cells, int reach)
+        {
+            for (bool grew = true; grew;)
+            {
+                grew = false;
+                for (int y = 0; y < WINDOW; ++y)
+                {
+                    auto const at = [&](int r)
+                    {
+                        return r >= 0 && r < WINDOW ? group[static_cast<std::size_t>(r)] : 0;
+                    };
+                    uint64_t g = spread(at(y));
+                    if (reach == 0)
+                    {
+                        g |= at(y - 1) | at(y + 1);
+                    }
+                    else if (reach == 1)
+                    {
+                        g |= spread(at(y - 1)) | spread(at(y + 1));
+                    }
+                    else
+                    {
+                        g = spread2(at(y - 2)) | spread2(at(y - 1)) | spread2(at(y)) | spread2(at(y + 1)) | spread2(at(y + 2));
+                    }
+                    g &= cells[static_cast<std::size_t>(y)];
+                    if (g != group[static_cast<std::size_t>(y)])
+                    {
+                        group[static_cast<std::size_t>(y)] = g;
+                        grew = true;
+                    }
+                }
+            }
+        }
+
+        bool empty(box const &b)
+        {
+            uint64_t any = 0;
+            for (uint64_t r : b)
+            {
+                any |= r;
+            }
+            return any == 0;
+        }
+
+        // Moves the cells of `b` into `s` and returns where they were, or false if there are none.
+        bool normalize(box const &b, shape &s, int &x0, int &y0)
+        {
+            uint64_t any = 0;
+            y0 = WINDOW;
+            int y1 = -1;
+            for (int y = 0; y < WINDOW; ++y)
+            {
+                if (b[y] != 0)
+                {
+                    any |= b[y];
+                    y0 = std::min(y0, y);
+                    y1 = y;
+                }
+            }
+            if (any == 0)
+            {
+                return false;
+            }
+            x0 = std::countr_zero(any);
+            s.width = 64 - std::countl_zero(any) - x0;
+            s.height = y1 - y0 + 1;
+            s.rows.fill(0);
+            for (int y = 0; y < s.height; ++y)
+            {
+                s.rows[static_cast<std::size_t>(y)] = b[static_cast<std::size_t>(y0 + y)] >> x0;
+            }
+            return true;
+        }
+
+        box place(shape const &s, int x, int y)
+        {
+            box b{};
+            for (int r = 0; r < s.height; ++r)
+            {
+                b[static_cast<std::size_t>(y + r)] = s.rows[static_cast<std::size_t>(r)] << x;
+            }
+            return b;
+        }
+
+        // Places `s` in the middle of a box, which leaves room to grow on every side.
+        box center(shape const &s, int &x, int &y)
+        {
+            x = (WINDOW - s.width) / 2;
+            y = (WINDOW - s.height) / 2;
+            return place(s, x, y);
+        }
+
+        void step(rules::rule const &r, box &b)
+        {
+            kernels::life_kernel const &k = kernels::active();
+            box next;
+            // all rows but the first and the last in one call
+            k.step_wrapped(r, b.data(), b.data() + 1, b.data() + 2, next.data() + 1, WINDOW - 2);
+            k.step_wrapped(r, b.data() + WINDOW - 1, b.data(), b.data() + 1, next.data(), 1);
+            k.step_wrapped(r, b.data() + WINDOW - 2, b.data() + WINDOW - 1, b.data(), next.data() + WINDOW - 1, 1);
+            b = next;
+        }
+
+        /**
+         * `s` mirrored horizontally (bit 0 of `t`), vertically (bit 1) and
+         * transposed first (bit 2).
+         */
+        shape transform(shape const &s, int t)
+        {
+            shape out;
+            out.width = (t & 4) != 0 ? s.height : s.width;
+            out.height = (t & 4) != 0 ? s.width : s.height;
+            for (int y = 0; y < s.height; ++y)
+            {
+                for (uint64_t m = s.rows[static_cast<std::size_t>(y)]; m != 0; m &= m - 1)
+                {
+                    int tx = std::countr_zero(m);
+                    int ty = y;
+                    if ((t & 4) != 0)
+                    {
+                        std::swap(tx, ty);
+                    }
+                    tx = (t & 1) != 0 ? out.width - 1 - tx : tx;
+                    ty = (t & 2) != 0 ? out.height - 1 - ty : ty;
+                    out.rows[static_cast<std::size_t>(ty)] |= uint64_t{1} << tx;
+                }
+            }
+            return out;
+        }
+
+        /**
+         * Extended Wechsler code of `s`: strips of five rows separated by
+         * "z", each a digit per column with the top row in the lowest bit,
+         * with runs of empty columns shortened to "w" (2), "x" (3) and "y"
+         * and a digit (4 to 39) and left out at the end of a strip.
+         */
+        std::string wechsler(shape const &s)
+        {
+            static constexpr char DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+            std::string code;
+            for (int y0 = 0; y0 < s.height; y0 += 5)
+            {
+                if (y0 > 0)
+                {
+                    code += 'z';
+                }
+                int zeros = 0;
+                for (int x = 0; x < s.width; ++x)
+                {
+                    unsigned int v = 0;
+                    for (int r = 0; r < 5 && y0 + r < s.height; ++r)
+                    {
+                        v |= static_cast<unsigned int>((s.rows[static_cast<std::size_t>(y0 + r)] >> x) & 1) << r;
+                    }
+                    if (v == 0)
+                    {
+                        ++zeros;
+                        continue;
+                    }
+                    while (zeros > 0)
+                    {
+                        if (zeros >= 4)
+                        {
+                            int const run = std::min(zeros, 39);
+                            code += 'y';
+                            code += DIGITS[run - 4];
+                            zeros -= run;
+                        }
+                        else
+                        {
+                            code += zeros == 3 ? 'x' : zeros == 2 ? 'w' : '0';
+                            zeros = 0;
+                        }
+                    }
+                    code += DIGITS[v];
+                }
+            }
+            return code;
+        }
+
+        int population(shape const &s)
+        {
+            int n = 0;
+            for (uint64_t r : s.rows)
+            {
+                n += std::popcount(r);
+            }
+            return n;
+        }
+
+        // Runs `s` on its own until it repeats and names it.
+        classification classify(rules::rule const &rule, std::size_t max_period, shape const &s)
+        {
+            if (s.width > census::MAX_OBJECT || s.height > census::MAX_OBJECT)
+            {
+                return {"ov_" + std::to_string(population(s)), 0};
+            }
+            std::vector<shape> phases{s};
+            int dx = 0;
+            int dy = 0;
+            for (std::size_t period = 1; period <= max_period; ++period)
+            {
+                int ox;
+                int oy;
+                box b = center(phases.back(), ox, oy);
+                step(rule, b);
+                shape next;
+                int nx;
+                int ny;
+                if (!normalize(b, next, nx, ny) || next.width > census::MAX_OBJECT || next.height > census::MAX_OBJECT)
+                {
+                    break;
+                }
+                dx += nx - ox;
+                dy += ny - oy;
+                if (next == s)
+                {
+                    std::string best;
+                    for (shape const &phase : phases)
+                    {
+                        for (int t = 0; t < 8; ++t)
+                        {
+                            std::string const code = wechsler(transform(phase, t));
+                            if (best.empty() || code.size() < best.size() || (code.size() == best.size() && code < best))
+                            {
+                                best = code;
+                            }
+                        }
+                    }
+                    std::string const prefix = period == 1 ? "xs" + std::to_string(population(s))
+                                               : dx == 0 && dy == 0 ? "xp" + std::to_string(period)
+                                                                    : "xq" + std::to_string(period);
+                    return {prefix + "_" + best, period};
+                }
+                phases.push_back(next);
+            }
+            return {"zz_UNKNOWN", 0};
+        }
+
+        // Whether `b` has its shape again, wherever it moved, after `generations` on its own.
+        bool returns(rules::rule const &rule, box const &b, std::size_t generations)
+        {
+            box c = b;
+            for (std::size_t g = 0; g < generations; ++g)
+            {
+                step(rule, c);
+            }
+            shape before;
+            shape after;
+            int x;
+            int y;
+            return normalize(b, before, x, y) && normalize(c, after, x, y) && before == after;
+        }
+
+        /**
+         * Splits the periodic group `whole` into periodic pieces that evolve
+         * for a full period apart exactly as they do together; a spark that
+         * just dies off is no piece of its own. Starts from the pieces
+         * connected through neighbors and merges a piece that does not
+         * keep its shape on its own with one at most two cells away until
+         * that holds.
+         */
+        std::vector<box> split(rules::rule const &rule, box const &whole, std::size_t period)
+        {
+            std::vector<box> groups;
+            box rest = whole;
+            while (!empty(rest))
+            {
+                box piece{};
+                for (std::size_t y = 0; y < rest.size(); ++y)
+                {
+                    if (rest[y] != 0)
+                    {
+                        piece[y] = rest[y] & (~rest[y] + 1);
+                        break;
+                    }
+                }
+                flood(piece, rest, 1);
+                for (std::size_t y = 0; y < rest.size(); ++y)
+                {
+                    rest[y] &= ~piece[y];
+                }
+                groups.push_back(piece);
+            }
+
+            while (groups.size() > 1)
+            {
+                std::vector<box> apart = groups;
+                box together = whole;
+                bool same = true;
+                for (std::size_t g = 0; g < period && same; ++g)
+                {
+                    step(rule, together);
+                    box merged{};
+                    for (box &a : apart)
+                    {
+                        step(rule, a);
+                        for (std::size_t y = 0; y < merged.size(); ++y)
+                        {
+                            merged[y] |= a[y];
+                        }
+                    }
+                    same = merged == together;
+                }
+                if (same && std::all_of(groups.begin(), groups.end(), [&](box const &g)
+                                        { return returns(rule, g, period); }))
+                {
+                    break;
+                }
+
+                std::size_t i = 0;
+                while (i < groups.size() && returns(rule, groups[i], period))
+                {
+                    ++i;
+                }
+                std::size_t j = 0;
+                for (; i < groups.size() && j < groups.size(); ++j)
+                {
+                    bool touches = false;
+                    for (std::size_t y = 0; y < WINDOW && j != i; ++y)
+                    {
+                        uint64_t near = 0;
+                        for (std::size_t r = y < 2 ? 0 : y - 2; r <= y + 2 && r < WINDOW; ++r)
+                        {
+                            near |= spread2(groups[i][r]);
+                        }
+                        touches = touches || (near & groups[j][y]) != 0;
+                    }
+                    if (touches)
+                    {
+                        break;
+                    }
+                }
+                if (i == groups.size() || j == groups.size())
+                {
+                    // every piece keeps its shape, yet they interact: one object
+                    return {whole};
+                }
+                for (std::size_t y = 0; y < WINDOW; ++y)
+                {
+                    groups[i][y] |= groups[j][y];
+                }
+                groups.erase(groups.begin() + static_cast<std::ptrdiff_t>(j));
+            }
+            return groups;
+        }
+
+        uint64_t hash_code(std::string const &code)
+        {
+            uint64_t h = 0xcbf29ce484222325ull;
+            for (char c : code)
+            {
+                h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+            }
+            return mix64(h);
+        }
+
+        uint64_t hash_shape(shape const &s)
+        {
+            uint64_t h = mix64(static_cast<uint64_t>(s.width) << 32 | static_cast<uint64_t>(s.height));
+            for (int y = 0; y < s.height; ++y)
+            {
+                h = mix64(h ^ s.rows[static_cast<std::size_t>(y)]) + static_cast<uint64_t>(y);
+            }
+            return h;
+        }
+    }
+
+    census::census(rules::rule const &rule, std::size_t max_period)
+        : rule(rule), max_period(std::max<std::size_t>(max_period, 1))
+    {
+    }
+
+    void census::add(uint64_t const *rows, std::size_t stride, int width, int height)
+    {
+        std::size_t const words = (static_cast<std::size_t>(width) + 63) / 64;
+        board.resize(words * static_cast<std::size_t>(height));
+        for (int y = 0; y < height; ++y)
+        {
+            std::copy_n(rows + static_cast<std::size_t>(y) * stride, words, board.begin() + static_cast<std::ptrdiff_t>(static_cast<std::size_t>(y) * words));
+        }
+        int const window_width = std::min(WINDOW, width);
+        int const window_height = std::min(WINDOW, height);
+        auto const row = [&](int y)
+        {
+            return board.data() + static_cast<std::size_t>(mod(y, height)) * words;
+        };
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (std::size_t w = 0; w < words; ++w)
+            {
+                while (row(y)[w] != 0)
+                {
+                    // the group of the first live cell left, flooded in a window around it
+                    int const x0 = static_cast<int>(w) * 64 + std::countr_zero(row(y)[w]) - window_width / 2;
+                    int const y0 = y - window_height / 2;
+                    box cells{};
+                    for (int r = 0; r < window_height; ++r)
+                    {
+                        cells[static_cast<std::size_t>(r)] = read(row(y0 + r), width, x0, window_width);
+                    }
+                    box group{};
+                    group[static_cast<std::size_t>(window_height / 2)] = uint64_t{1} << (window_width / 2);
+                    flood(group, cells, 2);
+                    bool cut = false;
+                    for (int r = 0; r < window_height; ++r)
+                    {
+                        uint64_t const g = group[static_cast<std::size_t>(r)];
+                        erase(row(y0 + r), width, x0, window_width, g);
+                        cut = cut || ((r == 0 || r == window_height - 1) && g != 0) || (g & (1 | uint64_t{1} << (window_width - 1))) != 0;
+                    }
+
+                    shape s;
+                    int sx;
+                    int sy;
+                    normalize(group, s, sx, sy);
+                    if (cut)
+                    {
+                        // larger than the window, at least
+                        ++kinds[intern("ov_" + std::to_string(population(s)))].count;
+                        ++total_;
+                        continue;
+                    }
+                    for (uint64_t code : components(hash_shape(s), group.data(), window_height))
+                    {
+                        ++kinds[code].count;
+                        ++total_;
+                    }
+                }
+            }
+        }
+    }
+
+    // The codes of the objects a group of cells is made of, classified on the first sight of its shape.
+    std::vector<uint64_t> const &census::components(uint64_t shape_key, uint64_t const *window, int window_height)
+    {
+        auto const cached = cache.find(shape_key);
+        if (cached != cache.end())
+        {
+            return cached->second;
+        }
+        if (cache.size() >= MAX_CACHED)
+        {
+            // rare shapes that will hardly be seen again
+            cache.clear();
+        }
+        box group{};
+        std::copy_n(window, window_height, group.begin());
+        shape whole;
+        int x;
+        int y;
+        normalize(group, whole, x, y);
+        classification const kind = classify(rule, max_period, whole);
+        std::vector<uint64_t> codes;
+        if (kind.period == 0)
+        {
+            codes.push_back(intern(kind.code));
+        }
+        else
+        {
+            std::vector<box> const pieces = split(rule, center(whole, x, y), kind.period);
+            for (box const &piece : pieces)
+            {
+                shape s;
+                normalize(piece, s, x, y);
+                codes.push_back(intern(pieces.size() == 1 ? kind.code : classify(rule, max_period, s).code));
+            }
+        }
+        return cache.emplace(shape_key, std::move(codes)).first->second;
+    }
+
+    uint64_t census::intern(std::string const &code)
+    {
+        uint64_t const key = hash_code(code);
+        kinds.try_emplace(key, kind{code, 0});
+        return key;
+    }
+
+    void census::merge(census const &other)
+    {
+        for (auto const &[key, k] : other.kinds)
+        {
+            kinds.try_emplace(key, kind{k.code, 0}).first->second.count += k.count;
+        }
+        total_ += other.total_;
+    }
+
+    void census::clear()
+    {
+        kinds.clear();
+        total_ = 0;
+    }
+
+    std::vector<census::object> census::objects() const
+    {
+        std::vector<object> result;
+        for (auto const &[key, k] : kinds)
+        {
+            if (k.count > 0)
+            {
+                result.push_back({k.code, name(k.code), k.count});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](object const &a, object const &b)
+                  { return a.count != b.count ? a.count > b.count : a.code < b.code; });
+        return result;
+    }
+
+    std::string census::name(std::string const &code)
+    {
+        static std::pair<char const *, char const *> const NAMES[] = {
+            {"xs4_33", "block"},
+            {"xs4_252", "tub"},
+            {"xs5_253", "boat"},
+            {"xs6_356", "ship"},
+            {"xs6_696", "beehive"},
+            {"xs6_25a4", "barge"},
+            {"xs7_2596", "loaf"},
+            {"xs7_25ac", "long boat"},
+            {"xs8_6996", "pond"},
+            {"xp2_7", "blinker"},
+            {"xp2_7e", "toad"},
+            {"xp2_318c", "beacon"},
+            {"xq4_153", "glider"},
+            {"xq4_6frc", "lightweight spaceship"},
+            {"xq4_27dee6", "middleweight spaceship"},
+            {"xq4_27deee6", "heavyweight spaceship"},
+        };
+        for (auto const &[c, n] : NAMES)
+        {
+            if (code == c)
+            {
+                return n;
+            }
+        }
+        return "";
+    }
+}
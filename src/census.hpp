@@ -0,0 +1,100 @@
+#ifndef __CENSUS_HPP__
+#define __CENSUS_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cycle-detector.hpp"
+#include "rule.hpp"
+
+namespace games
+{
+    /**
+     * Counts the objects on settled boards: still lifes, oscillators and
+     * spaceships, by kind.
+     *
+     * A board is taken apart into groups of live cells that are connected
+     * through neighbors, diagonal ones included, or across a single dead
+     * cell, which keeps objects like the lightweight spaceship in one piece.
+     * A group made of pieces that evolve the same way apart as together,
+     * such as two blocks side by side or other pseudo still lifes, is split
+     * into those pieces. Each object is then run on its
+     * own until it repeats, up to `max_period` generations, and named by
+     * its apgcode: "xs" and the population for still lifes, "xp" and the
+     * period for oscillators, "xq" and the period for spaceships, then
+     * "_" and the extended Wechsler code of the phase and orientation with
+     * the shortest, then lexicographically first, code. Objects that do not
+     * repeat in time are "zz_UNKNOWN", those larger than MAX_OBJECT cells
+     * across are "ov_" and their population.
+     *
+     * The board is read word by word in the bit-packed layout of the
+     * engines' planes; groups are flooded 64 cells wide at a time. What a
+     * group of cells turned out to be is cached by its shape, so the
+     * blocks and blinkers that make up most of a soup are recognized with
+     * one hash table lookup.
+     */
+    class census
+    {
+    public:
+        /// Largest object, in cells across, that is classified.
+        static constexpr int MAX_OBJECT = 40;
+
+        struct object
+        {
+            std::string code;
+            /// common name, or an empty string
+            std::string name;
+            uint64_t count;
+        };
+
+        explicit census(rules::rule const &rule = rules::CONWAY, std::size_t max_period = cycle_detector::DEFAULT_MAX_PERIOD);
+
+        /**
+         * Counts the objects of a board of `width` x `height` cells that
+         * wraps around, with row y at rows + y * stride in the layout of
+         * game::get_rows().
+         */
+        void add(uint64_t const *rows, std::size_t stride, int width, int height);
+
+        /// Adds the counts of `other`, which must use the same rule.
+        void merge(census const &other);
+
+        void clear();
+
+        /// All objects counted so far, most common first.
+        std::vector<object> objects() const;
+
+        /// Number of objects counted so far.
+        inline uint64_t total() const
+        {
+            return total_;
+        }
+
+        /// Common name of the object with apgcode `code`, or an empty string.
+        static std::string name(std::string const &code);
+
+    private:
+        struct kind
+        {
+            std::string code;
+            uint64_t count;
+        };
+
+        std::vector<uint64_t> const &components(uint64_t shape_key, uint64_t const *window, int window_height);
+        uint64_t intern(std::string const &code);
+
+        rules::rule rule;
+        std::size_t max_period;
+        // by the hash of the code
+        std::unordered_map<uint64_t, kind> kinds;
+        // by the hash of a group of cells: the codes of the objects it is made of
+        std::unordered_map<uint64_t, std::vector<uint64_t>> cache;
+        std::vector<uint64_t> board;
+        uint64_t total_{0};
+    };
+}
+
+#endif // __CENSUS_HPP__
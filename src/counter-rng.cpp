@@ -0,0 +1,112 @@
+#include "counter-rng.hpp"
+
+#include <algorithm>
+
+namespace util
+{
+    namespace
+    {
+        // pairs of words whose Philox blocks are computed side by side
+        constexpr std::size_t LANES = 16;
+
+        /**
+         * Block k of pairs [pair, pair + LANES) of a fill, as the first and
+         * the second word of each pair: philox() with the lanes as the
+         * inner loop, so the multiplications of all lanes are in flight at
+         * once.
+         */
+        void philox_lanes(uint64_t key, uint32_t fill, uint64_t pair, uint32_t k, uint64_t (&first)[LANES], uint64_t (&second)[LANES])
+        {
+            uint32_t c0[LANES];
+            uint32_t c1[LANES];
+            uint32_t c2[LANES];
+            uint32_t c3[LANES];
+            for (std::size_t i = 0; i < LANES; ++i)
+            {
+                c0[i] = static_cast<uint32_t>(pair + i);
+                c1[i] = static_cast<uint32_t>((pair + i) >> 32);
+                c2[i] = fill;
+                c3[i] = k;
+            }
+            uint32_t k0 = static_cast<uint32_t>(key);
+            uint32_t k1 = static_cast<uint32_t>(key >> 32);
+            for (int round = 0; round < 10; ++round)
+            {
+                for (std::size_t i = 0; i < LANES; ++i)
+                {
+                    uint64_t const p0 = uint64_t{0xd2511f53} * c0[i];
+                    uint64_t const p1 = uint64_t{0xcd9e8d57} * c2[i];
+                    uint32_t const n0 = static_cast<uint32_t>(p1 >> 32) ^ c1[i] ^ k0;
+                    uint32_t const n2 = static_cast<uint32_t>(p0 >> 32) ^ c3[i] ^ k1;
+                    c0[i] = n0;
+                    c1[i] = static_cast<uint32_t>(p1);
+                    c2[i] = n2;
+                    c3[i] = static_cast<uint32_t>(p0);
+                }
+                k0 += 0x9e3779b9;
+                k1 += 0xbb67ae85;
+            }
+            for (std::size_t i = 0; i < LANES; ++i)
+            {
+                first[i] = (uint64_t{c0[i]} << 32) | c1[i];
+                second[i] = (uint64_t{c2[i]} << 32) | c3[i];
+            }
+        }
+    }
+
+    void random_words(uint64_t key, uint32_t fill, uint64_t first, std::size_t count, uint32_t density, uint64_t *out)
+    {
+        if (density == 0 || density >= uint32_t{1} << DENSITY_BITS)
+        {
+            std::fill_n(out, count, density == 0 ? 0 : ~uint64_t{0});
+            return;
+        }
+        int lowest = 0;
+        while (((density >> lowest) & 1) == 0)
+        {
+            ++lowest;
+        }
+        uint64_t const end = first + count;
+        for (uint64_t pair = first / 2; pair * 2 < end; pair += LANES)
+        {
+            uint64_t even[LANES] = {};
+            uint64_t odd[LANES] = {};
+            uint64_t r0[LANES];
+            uint64_t r1[LANES];
+            uint32_t k = 0;
+            for (int bit = lowest; bit < DENSITY_BITS; ++bit, ++k)
+            {
+                philox_lanes(key, fill, pair, k, r0, r1);
+                if (((density >> bit) & 1) != 0)
+                {
+                    for (std::size_t i = 0; i < LANES; ++i)
+                    {
+                        even[i] |= r0[i];
+                        odd[i] |= r1[i];
+                    }
+                }
+                else
+                {
+                    for (std::size_t i = 0; i < LANES; ++i)
+                    {
+                        even[i] &= r0[i];
+                        odd[i] &= r1[i];
+                    }
+                }
+            }
+            // only the words of the range; the first pair may start before it, the last end after it
+            for (std::size_t i = 0; i < LANES; ++i)
+            {
+                uint64_t const w = (pair + i) * 2;
+                if (w >= first && w < end)
+                {
+                    out[w - first] = even[i];
+                }
+                if (w + 1 >= first && w + 1 < end)
+                {
+                    out[w + 1 - first] = odd[i];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,186 @@
+#ifndef __COUNTER_RNG_HPP__
+#define __COUNTER_RNG_HPP__
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace util
+{
+    /// Random 64-bit words come in blocks of this many.
+    using philox_block = std::array<uint32_t, 4>;
+
+    /**
+     * Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+     * 1, 2, 3"): 128 random bits that are a function of a 128-bit counter
+     * and a 64-bit key alone, so any block can be computed on its own, in
+     * any order and on any thread.
+     */
+    constexpr philox_block philox(philox_block counter, uint64_t key)
+    {
+        uint32_t k0 = static_cast<uint32_t>(key);
+        uint32_t k1 = static_cast<uint32_t>(key >> 32);
+        for (int round = 0; round < 10; ++round)
+        {
+            uint64_t const p0 = uint64_t{0xd2511f53} * counter[0];
+            uint64_t const p1 = uint64_t{0xcd9e8d57} * counter[2];
+            counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ k0, static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ k1, static_cast<uint32_t>(p0)};
+            k0 += 0x9e3779b9;
+            k1 += 0xbb67ae85;
+        }
+        return counter;
+    }
+
+    static_assert(philox({0, 0, 0, 0}, 0) == philox_block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+
+    /// Bits of the fixed point densities random_cells() takes, alive with probability density / 2^DENSITY_BITS.
+    constexpr int DENSITY_BITS = 16;
+    constexpr uint32_t HALF_DENSITY = uint32_t{1} << (DENSITY_BITS - 1);
+
+    /// `density` in [0, 1] as a fixed point density, rounded to the nearest.
+    inline uint32_t fixed_density(double density)
+    {
+        double const clamped = std::isnan(density) ? 0.5 : std::fmin(1.0, std::fmax(0.0, density));
+        return static_cast<uint32_t>(std::lround(clamped * (uint32_t{1} << DENSITY_BITS)));
+    }
+
+    /**
+     * Words 2 `pair` and 2 `pair` + 1 of random fill number `fill` under
+     * `key`: 64 cells each, every one alive with probability
+     * density / 2^DENSITY_BITS, independently.
+     *
+     * A cell is alive with probability 0.b1 b2 ... b16 in binary if it is
+     * taken from a fresh random word r_k per bit, from the lowest set bit
+     * up, as x = b_k ? x | r_k : x & r_k. So density 1/2 costs one Philox
+     * block per two words and no density more than 16; block k of a pair
+     * has the counter (pair, fill, k).
+     */
+    constexpr std::array<uint64_t, 2> random_cell_pair(uint64_t key, uint32_t fill, uint64_t pair, uint32_t density)
+    {
+        if (density == 0)
+        {
+            return {0, 0};
+        }
+        if (density >= uint32_t{1} << DENSITY_BITS)
+        {
+            return {~uint64_t{0}, ~uint64_t{0}};
+        }
+        int bit = 0;
+        while (((density >> bit) & 1) == 0)
+        {
+            ++bit;
+        }
+        std::array<uint64_t, 2> cells{0, 0};
+        for (uint32_t k = 0; bit < DENSITY_BITS; ++bit, ++k)
+        {
+            philox_block const b = philox({static_cast<uint32_t>(pair), static_cast<uint32_t>(pair >> 32), fill, k}, key);
+            bool const one = ((density >> bit) & 1) != 0;
+            for (std::size_t i = 0; i < 2; ++i)
+            {
+                uint64_t const r = (uint64_t{b[2 * i]} << 32) | b[2 * i + 1];
+                cells[i] = one ? cells[i] | r : cells[i] & r;
+            }
+        }
+        return cells;
+    }
+
+    /// Word `index` of a random fill, see random_cell_pair().
+    constexpr uint64_t random_cells(uint64_t key, uint32_t fill, uint64_t index, uint32_t density)
+    {
+        return random_cell_pair(key, fill, index / 2, density)[index % 2];
+    }
+
+    /**
+     * Words [first, first + count) of a random fill, the same as
+     * random_cells() gives one at a time. Computes the Philox blocks of
+     * several pairs side by side, so that their rounds overlap.
+     */
+    void random_words(uint64_t key, uint32_t fill, uint64_t first, std::size_t count, uint32_t density, uint64_t *out);
+
+    /**
+     * The random numbers of an engine: random fills of the board, and a
+     * stream of 32-bit numbers for everything else, like irritate().
+     *
+     * Fill words depend on the key, the number of the fill since seed()
+     * and the position of the word on the board only, so the same seed
+     * gives the same boards whatever the layout, tiling and thread count
+     * of the engine. The stream is a UniformRandomBitGenerator, drawn from
+     * Philox blocks of its own, and needs no warming up.
+     */
+    class counter_rng
+    {
+    public:
+        using result_type = uint32_t;
+
+        /// counter word of stream blocks, apart from every fill's
+        static constexpr uint32_t STREAM = 0xffffffff;
+
+        explicit counter_rng(uint64_t key = 0)
+            : key_(key)
+        {
+        }
+
+        inline void seed(uint64_t key)
+        {
+            key_ = key;
+            fills = 0;
+            drawn = 0;
+        }
+
+        inline uint64_t key() const
+        {
+            return key_;
+        }
+
+        /// Number of the next fill of the board; each one differs.
+        inline uint32_t next_fill()
+        {
+            return fills++;
+        }
+
+        /**
+         * Fills `count` rows of a board `width` cells wide, starting at row
+         * y, in the layout of game::get_rows(), as fill number `fill`.
+         * Cells past the width are dead.
+         */
+        void fill_rows(uint32_t fill, uint32_t density, int width, int y, int count, uint64_t *words) const
+        {
+            std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+            uint64_t const last_mask = (width % 64) == 0 ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1;
+            random_words(key_, fill, static_cast<uint64_t>(y) * per_row, static_cast<std::size_t>(count) * per_row, density, words);
+            for (std::size_t r = 0; r < static_cast<std::size_t>(count); ++r)
+            {
+                words[r * per_row + per_row - 1] &= last_mask;
+            }
+        }
+
+        inline uint32_t operator()()
+        {
+            if (drawn % 4 == 0)
+            {
+                block = philox({static_cast<uint32_t>(drawn / 4), static_cast<uint32_t>(drawn / 4 >> 32), STREAM, 0}, key_);
+            }
+            return block[drawn++ % 4];
+        }
+
+        static constexpr result_type min()
+        {
+            return 0;
+        }
+        static constexpr result_type max()
+        {
+            return std::numeric_limits<result_type>::max();
+        }
+
+    private:
+        uint64_t key_;
+        uint32_t fills{0};
+        uint64_t drawn{0};
+        philox_block block{};
+    };
+}
+
+#endif // __COUNTER_RNG_HPP__
@@ -0,0 +1,97 @@
+#ifndef __CYCLE_DETECTOR_HPP__
+#define __CYCLE_DETECTOR_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace games
+{
+    /**
+     * Notices when a board starts repeating itself, from the game::hash() of
+     * every generation.
+     *
+     * The hashes of the last `max_period` generations are kept in a ring.
+     * The first generation whose hash is already in there closes a cycle:
+     * the board has been periodic since the generation that hash belongs to,
+     * and the distance between the two is the period. Still lifes and
+     * vanished boards come out as period 1. Cycles longer than `max_period`
+     * go unnoticed.
+     */
+    class cycle_detector
+    {
+    public:
+        static constexpr std::size_t DEFAULT_MAX_PERIOD = 64;
+
+        explicit cycle_detector(std::size_t max_period = DEFAULT_MAX_PERIOD)
+            : recent(max_period == 0 ? 1 : max_period)
+        {
+        }
+
+        /**
+         * Takes the hash of generation `generation`, which must come after
+         * the previous one. Returns true once a cycle has been found.
+         */
+        bool add(uint64_t hash, uint64_t generation)
+        {
+            if (found_)
+            {
+                return true;
+            }
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (recent[i].hash == hash)
+                {
+                    found_ = true;
+                    start_ = recent[i].generation;
+                    period_ = generation - start_;
+                    return true;
+                }
+            }
+            recent[next] = {hash, generation};
+            next = (next + 1) % recent.size();
+            count = count < recent.size() ? count + 1 : count;
+            return false;
+        }
+
+        void clear()
+        {
+            count = 0;
+            next = 0;
+            found_ = false;
+            start_ = 0;
+            period_ = 0;
+        }
+
+        inline bool found() const
+        {
+            return found_;
+        }
+        /// First generation of the cycle; only meaningful if found().
+        inline uint64_t start() const
+        {
+            return start_;
+        }
+        /// Generations the cycle takes; only meaningful if found().
+        inline uint64_t period() const
+        {
+            return period_;
+        }
+
+    private:
+        struct seen
+        {
+            uint64_t hash;
+            uint64_t generation;
+        };
+
+        std::vector<seen> recent;
+        std::size_t count{0};
+        std::size_t next{0};
+        bool found_{false};
+        uint64_t start_{0};
+        uint64_t period_{0};
+    };
+}
+
+#endif // __CYCLE_DETECTOR_HPP__
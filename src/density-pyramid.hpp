@@ -0,0 +1,186 @@
+#ifndef __DENSITY_PYRAMID_HPP__
+#define __DENSITY_PYRAMID_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "index-map.hpp"
+
+namespace games
+{
+    /**
+     * Live cells of a column of words, one add() per word, kept per 16-bit
+     * quarter of the words. Without a popcount instruction std::popcount
+     * is a library call per word, and this a dozen instructions. Counts
+     * are 16 bits wide, so a column may be at most 1023 words long.
+     */
+    class column_count
+    {
+    public:
+        inline void add(uint64_t word)
+        {
+            // cells per pair, per nibble, then per byte
+            word -= (word >> 1) & 0x5555555555555555ull;
+            word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+            bytes += (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            // 8 per byte and word at most, so bytes hold 16 words without overflowing
+            if (++words == 16)
+            {
+                flush();
+            }
+        }
+
+        /// Cells in bits [0, 16), [16, 32), [32, 48) and [48, 64) of the words, in the same bits.
+        inline uint64_t quarters()
+        {
+            flush();
+            return lanes;
+        }
+
+        inline uint64_t total()
+        {
+            return (quarters() * 0x0001000100010001ull) >> 48;
+        }
+
+    private:
+        inline void flush()
+        {
+            lanes += (bytes & 0x00ff00ff00ff00ffull) + ((bytes >> 8) & 0x00ff00ff00ff00ffull);
+            bytes = 0;
+            words = 0;
+        }
+
+        uint64_t bytes{0};
+        uint64_t lanes{0};
+        int words{0};
+    };
+
+    /**
+     * Live cell counts of the squares of a plane at every scale, for
+     * drawing it zoomed out.
+     *
+     * Level 0 holds the smallest squares an engine counts, and every level
+     * above squares twice as large across, made of four of the level
+     * below. Engines set() the level 0 squares whose cells changed, and
+     * update() recomputes only the squares above those, once for all
+     * changes since the last call. The squares of a level are kept in a
+     * hash map by their coordinates, and empty ones not at all, so the
+     * plane may be unbounded and a lookup costs the same for any size.
+     */
+    class density_pyramid
+    {
+    public:
+        explicit density_pyramid(int levels)
+            : levels(static_cast<std::size_t>(levels))
+        {
+        }
+
+        inline int level_count() const
+        {
+            return static_cast<int>(levels.size());
+        }
+
+        /// Cells in square (x, y) of `level`, 0 for squares never set.
+        inline uint64_t at(int level, int64_t x, int64_t y) const
+        {
+            layer const &l = levels[static_cast<std::size_t>(level)];
+            uint32_t const i = l.index.find(key(x, y));
+            return i == util::index_map::NONE ? 0 : l.counts[i];
+        }
+
+        /// Sets the count of square (x, y) of level 0; the levels above follow with update().
+        void set(int64_t x, int64_t y, uint64_t count)
+        {
+            store(levels[0], key(x, y), count);
+            if (levels.size() > 1)
+            {
+                levels[1].pending.push_back(key(x >> 1, y >> 1));
+            }
+        }
+
+        /// Recomputes the squares above those set since the last call.
+        void update()
+        {
+            for (std::size_t l = 1; l < levels.size(); ++l)
+            {
+                std::vector<uint64_t> &pending = levels[l].pending;
+                std::sort(pending.begin(), pending.end());
+                pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+                for (uint64_t k : pending)
+                {
+                    int64_t const x = static_cast<int32_t>(k >> 32);
+                    int64_t const y = static_cast<int32_t>(k);
+                    int const below = static_cast<int>(l) - 1;
+                    store(levels[l], k, at(below, 2 * x, 2 * y) + at(below, 2 * x + 1, 2 * y) + at(below, 2 * x, 2 * y + 1) + at(below, 2 * x + 1, 2 * y + 1));
+                    if (l + 1 < levels.size())
+                    {
+                        levels[l + 1].pending.push_back(key(x >> 1, y >> 1));
+                    }
+                }
+                pending.clear();
+            }
+        }
+
+        void clear()
+        {
+            for (layer &l : levels)
+            {
+                l.index.clear();
+                l.counts.clear();
+                l.free.clear();
+                l.pending.clear();
+            }
+        }
+
+    private:
+        struct layer
+        {
+            // key() of a square to its slot in `counts`
+            util::index_map index;
+            std::vector<uint64_t> counts;
+            std::vector<uint32_t> free;
+            // squares to recompute on update()
+            std::vector<uint64_t> pending;
+        };
+
+        static inline uint64_t key(int64_t x, int64_t y)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+        }
+
+        static void store(layer &l, uint64_t k, uint64_t count)
+        {
+            uint32_t i = l.index.find(k);
+            if (count == 0)
+            {
+                if (i != util::index_map::NONE)
+                {
+                    l.index.erase(k);
+                    l.free.push_back(i);
+                }
+                return;
+            }
+            if (i == util::index_map::NONE)
+            {
+                if (l.free.empty())
+                {
+                    i = static_cast<uint32_t>(l.counts.size());
+                    l.counts.push_back(0);
+                }
+                else
+                {
+                    i = l.free.back();
+                    l.free.pop_back();
+                }
+                l.index.insert(k, i);
+            }
+            l.counts[i] = count;
+        }
+
+        std::vector<layer> levels;
+    };
+}
+
+#endif // __DENSITY_PYRAMID_HPP__
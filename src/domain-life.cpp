@@ -0,0 +1,731 @@
+#include "domain-life.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "board-hash.hpp"
+#include "game-of-life.hpp"
+#include "util.hpp"
+
+namespace games
+{
+    namespace
+    {
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+                      "futexes need plain 32-bit atomics");
+
+        // loads of a futex word before a wait sleeps in the kernel
+        constexpr int SPINS = 256;
+
+        // how long iterate() waits for the workers before it checks they are still there
+        constexpr timespec WORKER_CHECK{0, 100'000'000};
+
+        enum command : uint32_t
+        {
+            STEP,
+            QUIT,
+        };
+
+        long futex(std::atomic<uint32_t> &word, int op, uint32_t value, timespec const *timeout)
+        {
+            // shared between processes, so not FUTEX_PRIVATE_FLAG
+            return syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), op, value, timeout, nullptr, 0);
+        }
+
+        /// `value` counts up to `target` or past it, allowing for wrapping around.
+        inline bool reached(uint32_t value, uint32_t target)
+        {
+            return static_cast<int32_t>(value - target) >= 0;
+        }
+
+        /// Waits until `word` reaches `target`; false if `timeout` passed first.
+        bool wait_for(std::atomic<uint32_t> &word, uint32_t target, timespec const *timeout)
+        {
+            for (int i = 0; i < SPINS; ++i)
+            {
+                if (reached(word.load(std::memory_order_acquire), target))
+                {
+                    return true;
+                }
+            }
+            for (;;)
+            {
+                uint32_t const seen = word.load(std::memory_order_acquire);
+                if (reached(seen, target))
+                {
+                    return true;
+                }
+                if (futex(word, FUTEX_WAIT, seen, timeout) == -1 && errno == ETIMEDOUT)
+                {
+                    return reached(word.load(std::memory_order_acquire), target);
+                }
+            }
+        }
+
+        void store_and_wake(std::atomic<uint32_t> &word, uint32_t value)
+        {
+            word.store(value, std::memory_order_release);
+            futex(word, FUTEX_WAKE, INT_MAX, nullptr);
+        }
+
+        /// Cells of the edge on side `s` of a subdomain `w` x `h` cells large.
+        inline std::size_t edge_length(side s, int w, int h)
+        {
+            return s == NORTH || s == SOUTH ? static_cast<std::size_t>(w) : s == WEST || s == EAST ? static_cast<std::size_t>(h) : 1;
+        }
+
+        inline std::size_t round_up(std::size_t n, std::size_t to)
+        {
+            return (n + to - 1) / to * to;
+        }
+
+        /**
+         * `size` bytes of a fresh POSIX shared memory object, zeroed. The
+         * name is unlinked at once: the mapping outlives it, is inherited
+         * by fork() and goes away with the last process that maps it, so
+         * nothing is left behind in /dev/shm even after a crash.
+         */
+        void *map_shared(std::size_t size, std::string &error)
+        {
+            static std::atomic<unsigned int> segments{0};
+            std::string const name = "/automata-" + std::to_string(getpid()) + "-" + std::to_string(segments++);
+            int const fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+            if (fd == -1)
+            {
+                error = "Cannot create shared memory " + name + ": " + std::strerror(errno);
+                return nullptr;
+            }
+            shm_unlink(name.c_str());
+            void *memory = MAP_FAILED;
+            if (ftruncate(fd, static_cast<off_t>(size)) == 0)
+            {
+                memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            if (memory == MAP_FAILED)
+            {
+                error = "Cannot map " + std::to_string(size) + " bytes of shared memory: " + std::strerror(errno);
+                close(fd);
+                return nullptr;
+            }
+            close(fd);
+            return memory;
+        }
+
+        /**
+         * Halos through shared memory: two buffers per side and generation
+         * parity, and a futex word per side that counts the generations
+         * published, which the neighbor waits on.
+         */
+        class shared_memory_transport final : public halo_transport
+        {
+        public:
+            struct link
+            {
+                /// our two buffers of the side, one after the other
+                uint8_t *out;
+                std::atomic<uint32_t> *published;
+                /// the neighbor's two buffers of the opposite side
+                uint8_t const *in;
+                std::atomic<uint32_t> *arrived;
+                std::size_t length;
+            };
+
+            explicit shared_memory_transport(std::array<link, SIDES> const &links)
+                : links(links)
+            {
+            }
+
+            uint8_t *outgoing(side s, uint64_t generation) override
+            {
+                return links[s].out + (generation % 2) * links[s].length;
+            }
+
+            void publish(side s, uint64_t generation) override
+            {
+                store_and_wake(*links[s].published, static_cast<uint32_t>(generation + 1));
+            }
+
+            uint8_t const *incoming(side s, uint64_t generation) override
+            {
+                wait_for(*links[s].arrived, static_cast<uint32_t>(generation + 1), nullptr);
+                return links[s].in + (generation % 2) * links[s].length;
+            }
+
+        private:
+            const std::array<link, SIDES> links;
+        };
+
+        /**
+         * Steps the cells [x_begin, x_end) of rows [y_begin, y_end) from
+         * `src` to `dst`, which are `stride` bytes per row with a border of
+         * one cell around them, by `next_state[9 * alive + live neighbors]`.
+         */
+        void step_cells(uint8_t const *src, uint8_t *dst, std::size_t stride, int y_begin, int y_end, int x_begin, int x_end,
+                        uint8_t const *next_state)
+        {
+            for (int y = y_begin; y < y_end; ++y)
+            {
+                uint8_t const *above = src + static_cast<std::size_t>(y - 1) * stride;
+                uint8_t const *row = above + stride;
+                uint8_t const *below = row + stride;
+                uint8_t *out = dst + static_cast<std::size_t>(y) * stride;
+                for (int x = x_begin; x < x_end; ++x)
+                {
+                    unsigned int const n = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+                    out[x] = next_state[9 * row[x] + n];
+                }
+            }
+        }
+    }
+
+    /// Written by this process only, before it bumps `command`.
+    struct domain_life::control
+    {
+        /// counts the commands sent; the workers wait on it
+        alignas(64) std::atomic<uint32_t> command{0};
+        uint32_t op{STEP};
+        /// the generation STEP computes the next one of
+        uint64_t generation{0};
+        std::array<uint8_t, 18> next_state{};
+    };
+
+    /// Futex words of a subdomain, each counting generations.
+    struct domain_life::signals
+    {
+        /// the last generation the worker computed, plus one
+        alignas(64) std::atomic<uint32_t> done{0};
+        /// the last generation whose edge on each side is in the halo buffers, plus one
+        alignas(64) std::array<std::atomic<uint32_t>, SIDES> published{};
+    };
+
+    struct domain_life::tile
+    {
+        int x0;
+        int y0;
+        int w;
+        int h;
+        /// bytes per row, with a border cell on either side
+        std::size_t stride;
+        /// bytes per plane, with a border row above and below
+        std::size_t plane;
+        /// both planes, in a shared segment of their own
+        uint8_t *cells{nullptr};
+        signals *flags{nullptr};
+        /// two buffers for the edge on each side, in the shared segment
+        std::array<uint8_t *, SIDES> halo{};
+        std::array<std::size_t, SIDES> neighbor{};
+    };
+
+    domain_life::domain_life(int width, int height, unsigned int workers)
+        : width(width), height(height), parent(getpid())
+    {
+        // the grid with the shortest cuts, whose halos are the least to send
+        long best = -1;
+        for (unsigned int n = std::max(1u, workers); best < 0; --n)
+        {
+            for (unsigned int px = 1; px <= n; ++px)
+            {
+                unsigned int const py = n / px;
+                if (px * py != n || px > static_cast<unsigned int>(width) || py > static_cast<unsigned int>(height))
+                {
+                    continue;
+                }
+                long const cut = static_cast<long>(px) * height + static_cast<long>(py) * width;
+                if (best < 0 || cut < best)
+                {
+                    best = cut;
+                    columns = static_cast<int>(px);
+                    rows = static_cast<int>(py);
+                }
+            }
+        }
+        for (int i = 0; i <= columns; ++i)
+        {
+            xs.push_back(static_cast<int>(static_cast<int64_t>(width) * i / columns));
+        }
+        for (int i = 0; i <= rows; ++i)
+        {
+            ys.push_back(static_cast<int>(static_cast<int64_t>(height) * i / rows));
+        }
+        column_of.resize(static_cast<std::size_t>(width));
+        row_of.resize(static_cast<std::size_t>(height));
+        for (int c = 0; c < columns; ++c)
+        {
+            std::fill(column_of.begin() + xs[c], column_of.begin() + xs[c + 1], c);
+        }
+        for (int r = 0; r < rows; ++r)
+        {
+            std::fill(row_of.begin() + ys[r], row_of.begin() + ys[r + 1], r);
+        }
+        for (int r = 0; r < rows; ++r)
+        {
+            for (int c = 0; c < columns; ++c)
+            {
+                tile t;
+                t.x0 = xs[c];
+                t.y0 = ys[r];
+                t.w = xs[c + 1] - xs[c];
+                t.h = ys[r + 1] - ys[r];
+                t.stride = static_cast<std::size_t>(t.w) + 2;
+                t.plane = t.stride * (static_cast<std::size_t>(t.h) + 2);
+                auto const at = [this](int dc, int dr, int c, int r)
+                {
+                    return static_cast<std::size_t>((r + dr + rows) % rows) * static_cast<std::size_t>(columns) +
+                           static_cast<std::size_t>((c + dc + columns) % columns);
+                };
+                t.neighbor = {at(0, -1, c, r), at(0, 1, c, r), at(-1, 0, c, r), at(1, 0, c, r),
+                              at(-1, -1, c, r), at(1, -1, c, r), at(-1, 1, c, r), at(1, 1, c, r)};
+                tiles.push_back(t);
+            }
+        }
+        seed(util::make_seed());
+        ready = map_segments() && start_workers();
+        if (ready)
+        {
+            set_rule(rules::CONWAY);
+        }
+    }
+
+    domain_life::~domain_life()
+    {
+        stop_workers();
+        for (tile const &t : tiles)
+        {
+            if (t.cells != nullptr)
+            {
+                munmap(t.cells, 2 * t.plane);
+            }
+        }
+        if (shared != nullptr)
+        {
+            munmap(shared, shared_size);
+        }
+    }
+
+    bool domain_life::map_segments()
+    {
+        std::size_t const signals_at = round_up(sizeof(control), 64);
+        std::size_t halos_at = signals_at + tiles.size() * sizeof(signals);
+        std::vector<std::size_t> halo_at;
+        for (tile const &t : tiles)
+        {
+            halo_at.push_back(halos_at);
+            std::size_t n = 0;
+            for (int s = 0; s < SIDES; ++s)
+            {
+                n += 2 * edge_length(static_cast<side>(s), t.w, t.h);
+            }
+            halos_at = round_up(halos_at + n, 64);
+        }
+        shared_size = halos_at;
+        void *memory = map_shared(shared_size, error_);
+        if (memory == nullptr)
+        {
+            return false;
+        }
+        auto *bytes = static_cast<uint8_t *>(memory);
+        shared = new (bytes) control;
+        for (std::size_t i = 0; i < tiles.size(); ++i)
+        {
+            tile &t = tiles[i];
+            t.flags = new (bytes + signals_at + i * sizeof(signals)) signals;
+            uint8_t *halo = bytes + halo_at[i];
+            for (int s = 0; s < SIDES; ++s)
+            {
+                t.halo[s] = halo;
+                halo += 2 * edge_length(static_cast<side>(s), t.w, t.h);
+            }
+            t.cells = static_cast<uint8_t *>(map_shared(2 * t.plane, error_));
+            if (t.cells == nullptr)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool domain_life::start_workers()
+    {
+        // nothing may be allocated between the fork and the worker's loop
+        pids.reserve(tiles.size());
+        // a worker may only get to run after the first command is sent, so it cannot read this itself
+        uint32_t const commands = shared->command.load(std::memory_order_relaxed);
+        for (std::size_t t = 0; t < tiles.size(); ++t)
+        {
+            pid_t const pid = fork();
+            if (pid == 0)
+            {
+                work(t, commands);
+            }
+            if (pid == -1)
+            {
+                error_ = std::string("Cannot start a worker process: ") + std::strerror(errno);
+                stop_workers();
+                return false;
+            }
+            pids.push_back(pid);
+        }
+        return true;
+    }
+
+    void domain_life::stop_workers()
+    {
+        if (pids.empty())
+        {
+            return;
+        }
+        shared->op = QUIT;
+        store_and_wake(shared->command, shared->command.load(std::memory_order_relaxed) + 1);
+        for (pid_t pid : pids)
+        {
+            waitpid(pid, nullptr, 0);
+        }
+        pids.clear();
+    }
+
+    void domain_life::work(std::size_t t, uint32_t commands)
+    {
+        // dies with the thread that forked it; that is the one that runs the engine, and it lives as long
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent)
+        {
+            _exit(EXIT_FAILURE);
+        }
+        for (std::size_t u = 0; u < tiles.size(); ++u)
+        {
+            if (u != t)
+            {
+                munmap(tiles[u].cells, 2 * tiles[u].plane);
+            }
+        }
+        tile const &me = tiles[t];
+        std::array<shared_memory_transport::link, SIDES> links;
+        for (int s = 0; s < SIDES; ++s)
+        {
+            tile const &other = tiles[me.neighbor[s]];
+            side const o = opposite(static_cast<side>(s));
+            links[s] = {me.halo[s], &me.flags->published[s], other.halo[o], &other.flags->published[o],
+                        edge_length(static_cast<side>(s), me.w, me.h)};
+        }
+        shared_memory_transport transport(links);
+        halo_transport &halos = transport;
+
+        int const w = me.w;
+        int const h = me.h;
+        std::size_t const stride = me.stride;
+        auto const copy_column = [h](uint8_t const *from, std::size_t from_step, uint8_t *to, std::size_t to_step)
+        {
+            for (int y = 0; y < h; ++y)
+            {
+                to[static_cast<std::size_t>(y) * to_step] = from[static_cast<std::size_t>(y) * from_step];
+            }
+        };
+        for (;;)
+        {
+            wait_for(shared->command, ++commands, nullptr);
+            if (shared->op == QUIT)
+            {
+                _exit(EXIT_SUCCESS);
+            }
+            uint64_t const g = shared->generation;
+            uint8_t *src = me.cells + (g % 2) * me.plane;
+            uint8_t *dst = me.cells + ((g + 1) % 2) * me.plane;
+            uint8_t const *next_state = shared->next_state.data();
+            uint8_t *first = src + stride + 1;
+            uint8_t *last = src + static_cast<std::size_t>(h) * stride + 1;
+
+            // send the edges first, so that they travel while the interior is computed
+            std::memcpy(halos.outgoing(NORTH, g), first, static_cast<std::size_t>(w));
+            halos.publish(NORTH, g);
+            std::memcpy(halos.outgoing(SOUTH, g), last, static_cast<std::size_t>(w));
+            halos.publish(SOUTH, g);
+            copy_column(first, stride, halos.outgoing(WEST, g), 1);
+            halos.publish(WEST, g);
+            copy_column(first + w - 1, stride, halos.outgoing(EAST, g), 1);
+            halos.publish(EAST, g);
+            *halos.outgoing(NORTH_WEST, g) = first[0];
+            halos.publish(NORTH_WEST, g);
+            *halos.outgoing(NORTH_EAST, g) = first[w - 1];
+            halos.publish(NORTH_EAST, g);
+            *halos.outgoing(SOUTH_WEST, g) = last[0];
+            halos.publish(SOUTH_WEST, g);
+            *halos.outgoing(SOUTH_EAST, g) = last[w - 1];
+            halos.publish(SOUTH_EAST, g);
+
+            // every cell whose neighbors are all ours
+            step_cells(src, dst, stride, 2, h, 2, w, next_state);
+
+            // the border around ours from the neighbors' edges, then the outer ring of ours
+            std::memcpy(first - stride, halos.incoming(NORTH, g), static_cast<std::size_t>(w));
+            std::memcpy(last + stride, halos.incoming(SOUTH, g), static_cast<std::size_t>(w));
+            copy_column(halos.incoming(WEST, g), 1, first - 1, stride);
+            copy_column(halos.incoming(EAST, g), 1, first + w, stride);
+            first[-1 - static_cast<std::ptrdiff_t>(stride)] = *halos.incoming(NORTH_WEST, g);
+            first[w - static_cast<std::ptrdiff_t>(stride)] = *halos.incoming(NORTH_EAST, g);
+            last[-1 + static_cast<std::ptrdiff_t>(stride)] = *halos.incoming(SOUTH_WEST, g);
+            last[w + static_cast<std::ptrdiff_t>(stride)] = *halos.incoming(SOUTH_EAST, g);
+            step_cells(src, dst, stride, 1, 2, 1, w + 1, next_state);
+            if (h > 1)
+            {
+                step_cells(src, dst, stride, h, h + 1, 1, w + 1, next_state);
+            }
+            step_cells(src, dst, stride, 2, h, 1, 2, next_state);
+            if (w > 1)
+            {
+                step_cells(src, dst, stride, 2, h, w, w + 1, next_state);
+            }
+            store_and_wake(me.flags->done, static_cast<uint32_t>(g + 1));
+        }
+    }
+
+    bool domain_life::check_workers()
+    {
+        for (std::size_t i = 0; i < pids.size(); ++i)
+        {
+            int status = 0;
+            if (waitpid(pids[i], &status, WNOHANG) == pids[i])
+            {
+                error_ = "Worker process " + std::to_string(i) + " (pid " + std::to_string(pids[i]) + ") died: " +
+                         (WIFSIGNALED(status) ? std::string("signal ") + strsignal(WTERMSIG(status))
+                                              : "exit status " + std::to_string(WEXITSTATUS(status)));
+                ready = false;
+                // the others would wait for its halos forever; the cells stay mapped, at the last generation completed
+                pids.erase(pids.begin() + static_cast<std::ptrdiff_t>(i));
+                for (pid_t pid : pids)
+                {
+                    kill(pid, SIGKILL);
+                    waitpid(pid, nullptr, 0);
+                }
+                pids.clear();
+                munmap(shared, shared_size);
+                shared = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void domain_life::iterate()
+    {
+        if (!ready)
+        {
+            return;
+        }
+        shared->op = STEP;
+        shared->generation = generation;
+        store_and_wake(shared->command, shared->command.load(std::memory_order_relaxed) + 1);
+        uint32_t const target = static_cast<uint32_t>(generation + 1);
+        for (tile const &t : tiles)
+        {
+            while (!wait_for(t.flags->done, target, &WORKER_CHECK))
+            {
+                if (!check_workers())
+                {
+                    return;
+                }
+            }
+        }
+        ++generation;
+    }
+
+    void domain_life::set_rule(rules::rule const &r)
+    {
+        if (!ready)
+        {
+            return;
+        }
+        for (int n = 0; n <= 8; ++n)
+        {
+            shared->next_state[static_cast<std::size_t>(n)] = r.next(false, n) ? 1 : 0;
+            shared->next_state[static_cast<std::size_t>(9 + n)] = r.next(true, n) ? 1 : 0;
+        }
+    }
+
+    void domain_life::seed(unsigned long s)
+    {
+        rng.seed(s);
+    }
+
+    uint8_t *domain_life::row_cells(int c, int y) const
+    {
+        tile const &t = tiles[static_cast<std::size_t>(row_of[static_cast<std::size_t>(y)]) * static_cast<std::size_t>(columns) +
+                              static_cast<std::size_t>(c)];
+        return t.cells + (generation % 2) * t.plane + static_cast<std::size_t>(y - t.y0 + 1) * t.stride + 1;
+    }
+
+    uint8_t &domain_life::cell(int x, int y) const
+    {
+        unsigned int const cx = mod(x, width);
+        unsigned int const cy = mod(y, height);
+        int const c = column_of[cx];
+        return row_cells(c, static_cast<int>(cy))[static_cast<int>(cx) - xs[static_cast<std::size_t>(c)]];
+    }
+
+    template <typename F>
+    void domain_life::for_each_run(int y, int x_begin, int x_end, F f) const
+    {
+        int c = x_begin < x_end ? column_of[static_cast<std::size_t>(x_begin)] : 0;
+        for (int x = x_begin; x < x_end; ++c)
+        {
+            int const end = std::min(x_end, xs[static_cast<std::size_t>(c) + 1]);
+            f(row_cells(c, y) + (x - xs[static_cast<std::size_t>(c)]), x, end - x);
+            x = end;
+        }
+    }
+
+    void domain_life::populate(double density)
+    {
+        uint32_t const fill = rng.next_fill();
+        uint32_t const p = util::fixed_density(density);
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        std::vector<uint64_t> words(per_row);
+        for (int y = 0; y < height; ++y)
+        {
+            rng.fill_rows(fill, p, width, y, 1, words.data());
+            set_rows(y, 1, width, words.data());
+        }
+    }
+
+    void domain_life::clear()
+    {
+        for (tile const &t : tiles)
+        {
+            std::memset(t.cells, 0, 2 * t.plane);
+        }
+    }
+
+    void domain_life::irritate(int const x, int const y)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                set(x + dx, y + dy, (rng() & 1) != 0);
+            }
+        }
+    }
+
+    void domain_life::set(int x, int y, bool alive)
+    {
+        cell(x, y) = alive ? 1 : 0;
+    }
+
+    bool domain_life::get(int x, int y) const
+    {
+        return cell(x, y) != 0;
+    }
+
+    void domain_life::set_span(int x, int y, int length, bool alive)
+    {
+        length = std::min(length, width);
+        int const row = static_cast<int>(mod(y, height));
+        int cx = static_cast<int>(mod(x, width));
+        while (length > 0)
+        {
+            int const n = std::min(length, width - cx);
+            for_each_run(row, cx, cx + n, [alive](uint8_t *cells, int, int count)
+                         { std::memset(cells, alive ? 1 : 0, static_cast<std::size_t>(count)); });
+            length -= n;
+            cx = 0;
+        }
+    }
+
+    void domain_life::get_rows(int y, int count, int w, uint64_t *words) const
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::get_rows(y, count, w, words);
+            return;
+        }
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (int row = 0; row < count; ++row)
+        {
+            uint64_t *out = words + static_cast<std::size_t>(row) * per_row;
+            std::fill_n(out, per_row, 0);
+            for_each_run(y + row, 0, width, [out](uint8_t const *cells, int x, int n)
+                         {
+                             for (int i = 0; i < n; ++i)
+                             {
+                                 std::size_t const b = static_cast<std::size_t>(x + i);
+                                 out[b / 64] |= static_cast<uint64_t>(cells[i]) << (b % 64);
+                             } });
+        }
+    }
+
+    void domain_life::set_rows(int y, int count, int w, uint64_t const *words)
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::set_rows(y, count, w, words);
+            return;
+        }
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (int row = 0; row < count; ++row)
+        {
+            uint64_t const *in = words + static_cast<std::size_t>(row) * per_row;
+            for_each_run(y + row, 0, width, [in](uint8_t *cells, int x, int n)
+                         {
+                             for (int i = 0; i < n; ++i)
+                             {
+                                 std::size_t const b = static_cast<std::size_t>(x + i);
+                                 cells[i] = static_cast<uint8_t>((in[b / 64] >> (b % 64)) & 1);
+                             } });
+        }
+    }
+
+    /// Rehashes the whole board; same hash as the packed engine for the same cells.
+    uint64_t domain_life::hash() const
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        std::vector<uint64_t> band(per_row * HASH_TILE_ROWS);
+        uint64_t h = EMPTY_BOARD_HASH;
+        for (int y = 0; y < height; y += HASH_TILE_ROWS)
+        {
+            int const count = std::min(HASH_TILE_ROWS, height - y);
+            get_rows(y, count, width, band.data());
+            for (std::size_t w = 0; w < per_row; w += HASH_TILE_WORDS)
+            {
+                h ^= tile_hash(band.data() + w, per_row, count, std::min(HASH_TILE_WORDS, per_row - w),
+                               tile_salt(static_cast<int64_t>(w / HASH_TILE_WORDS), y / HASH_TILE_ROWS));
+            }
+        }
+        return h;
+    }
+
+    void domain_life::get_density(int64_t x, int64_t y, int level, int count_columns, int count_rows, uint64_t *counts) const
+    {
+        count_density(width, height, x, y, level, count_columns, count_rows, counts, [this](int cy, int x0, int x1)
+                      {
+                          uint64_t n = 0;
+                          for_each_run(cy, x0, x1, [&n](uint8_t const *cells, int, int length)
+                                       { n += static_cast<uint64_t>(std::count(cells, cells + length, uint8_t{1})); });
+                          return n; });
+    }
+
+    uint64_t domain_life::population() const
+    {
+        uint64_t n = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            for_each_run(y, 0, width, [&n](uint8_t const *cells, int, int length)
+                         { n += static_cast<uint64_t>(std::count(cells, cells + length, uint8_t{1})); });
+        }
+        return n;
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef __DOMAIN_LIFE_HPP__
+#define __DOMAIN_LIFE_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "counter-rng.hpp"
+#include "game.hpp"
+#include "rule.hpp"
+
+namespace games
+{
+    /// The neighbors of a subdomain on the torus, which its halo comes from.
+    enum side : uint8_t
+    {
+        NORTH,
+        SOUTH,
+        WEST,
+        EAST,
+        NORTH_WEST,
+        NORTH_EAST,
+        SOUTH_WEST,
+        SOUTH_EAST,
+        SIDES
+    };
+
+    /// The side a neighbor sees us on.
+    constexpr side opposite(side s)
+    {
+        constexpr std::array<side, SIDES> OPPOSITE = {SOUTH, NORTH, EAST, WEST, SOUTH_EAST, SOUTH_WEST, NORTH_EAST, NORTH_WEST};
+        return OPPOSITE[s];
+    }
+
+    /**
+     * Carries the edges of one subdomain to its eight neighbors and theirs
+     * back, a generation at a time: the row or column of cells along each
+     * side, and the corner cells for the diagonal neighbors.
+     *
+     * A worker fills outgoing() and publish()es it as soon as its edges are
+     * known, steps the cells that need no halo, and only then asks for
+     * incoming(), which waits until the neighbor has published. A neighbor
+     * can be at most one generation ahead, since it waits for our edges in
+     * turn, so two buffers per side are enough. Nothing here allocates,
+     * which keeps it safe to use in a forked process.
+     */
+    class halo_transport
+    {
+    public:
+        virtual ~halo_transport() = default;
+
+        /// Where to put the edge on side `s` of `generation`: the tile's width of cells, its height, or one for a corner.
+        virtual uint8_t *outgoing(side s, uint64_t generation) = 0;
+        /// Hands the edge on side `s` to the neighbor there.
+        virtual void publish(side s, uint64_t generation) = 0;
+        /// The edge of the neighbor on side `s` that faces us, once it has been published; valid until the next generation.
+        virtual uint8_t const *incoming(side s, uint64_t generation) = 0;
+    };
+
+    /**
+     * Conway's Game of Life and other Life-like rules on a torus, like
+     * game_of_life and with the same results, split into a grid of
+     * subdomains that each live in a worker process of their own.
+     *
+     * The grid is chosen to cut as few cells as it can. The cells of a
+     * subdomain, with a border of one cell for its halo, are in a POSIX
+     * shared memory segment of its own: each worker unmaps those of the
+     * others after the fork, while this process keeps all of them mapped
+     * to read and edit cells between generations. The halos go through a
+     * halo_transport; the one here copies them through another shared
+     * segment and signals with futexes.
+     *
+     * A generation publishes the edges, steps the interior while they
+     * travel, then fills the border from the neighbors' halos and steps
+     * the outer ring of cells. iterate() wakes all workers at once and
+     * waits for them, so everything else sees a board that only changes
+     * inside iterate(). Linux only.
+     */
+    class domain_life final : public game
+    {
+    public:
+        domain_life() = delete;
+        /**
+         * Splits the board among `workers` processes, or the most below that
+         * whose grid of subdomains still has a cell in each.
+         */
+        domain_life(int width, int height, unsigned int workers);
+        ~domain_life() override;
+
+        domain_life(domain_life const &) = delete;
+        domain_life &operator=(domain_life const &) = delete;
+
+        /// False if the shared memory or the workers could not be set up, or a worker died since; error() tells why.
+        inline bool is_ready() const
+        {
+            return ready;
+        }
+        inline std::string const &error() const
+        {
+            return error_;
+        }
+        inline std::string failure() const override
+        {
+            return ready ? std::string() : error_;
+        }
+
+        void populate(double density) override;
+        void clear() override;
+        void irritate(int x, int y) override;
+        void iterate() override;
+        void set_span(int x, int y, int length, bool alive) override;
+        void get_rows(int y, int count, int width, uint64_t *words) const override;
+        void set_rows(int y, int count, int width, uint64_t const *words) override;
+        uint64_t hash() const override;
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override;
+        uint64_t population() const override;
+        inline uint64_t cells_updated() const override
+        {
+            return static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+        }
+        bool get(int x, int y) const override;
+        void seed(unsigned long s) override;
+
+        void set(int x, int y, bool alive);
+        void set_rule(rules::rule const &r);
+
+        /// Subdomains across and down, as many as there are worker processes.
+        inline std::pair<int, int> grid() const
+        {
+            return {columns, rows};
+        }
+
+    private:
+        struct control;
+        struct signals;
+        struct tile;
+
+        bool map_segments();
+        bool start_workers();
+        void stop_workers();
+        // the loop of the worker of tile t, which waits for the command after `commands`
+        [[noreturn]] void work(std::size_t t, uint32_t commands);
+        // false, with the workers stopped, if one of them died
+        bool check_workers();
+        // row y of subdomain column c in the current generation, from its first cell
+        uint8_t *row_cells(int c, int y) const;
+        uint8_t &cell(int x, int y) const;
+        // calls f(cells, x, n) for the runs of cells [x_begin, x_end) of row y that each lie in one subdomain
+        template <typename F>
+        void for_each_run(int y, int x_begin, int x_end, F f) const;
+
+        const int width;
+        const int height;
+        int columns{1};
+        int rows{1};
+        // first column of each column of subdomains and the width after the last; the same for rows
+        std::vector<int> xs;
+        std::vector<int> ys;
+        // the column of subdomains of every column of cells; the same for rows
+        std::vector<int> column_of;
+        std::vector<int> row_of;
+        std::vector<tile> tiles;
+        // the control block, the signals of every subdomain and their halos
+        control *shared{nullptr};
+        std::size_t shared_size{0};
+        pid_t parent{0};
+        std::vector<pid_t> pids;
+        uint64_t generation{0};
+        bool ready{false};
+        std::string error_;
+        util::counter_rng rng;
+    };
+}
+
+#endif // __DOMAIN_LIFE_HPP__
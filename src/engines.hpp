@@ -0,0 +1,202 @@
+#ifndef __ENGINES_HPP__
+#define __ENGINES_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <string>
+
+#include "game.hpp"
+#include "game-of-life.hpp"
+#ifdef AUTOMATA_DOMAIN_LIFE
+#include "domain-life.hpp"
+#endif
+#include "generations-life.hpp"
+#include "hash-life.hpp"
+#include "larger-than-life.hpp"
+#include "packed-life.hpp"
+#include "sparse-life.hpp"
+#include "rule.hpp"
+
+namespace games
+{
+    /// Startup choices for the simulation engine.
+    struct settings
+    {
+        /// "classic", "packed", "sparse", "hashlife", "generations" or "ltl"
+        std::string engine{"packed"};
+        /// worker threads of engines that support them, 0 = one per hardware thread
+        unsigned int threads{0};
+        /// worker processes the classic engine splits the board among, 0 = none, all in this process
+        unsigned int workers{0};
+        /// hashlife advances 2^step generations per iteration
+        unsigned int step{0};
+        /// target generations per second, 0 = as fast as possible
+        double rate{0};
+        /// seed of the random number generator, 0 = a different one every run
+        unsigned long seed{0};
+        /// share of live cells in a random fill
+        double density{0.5};
+        /// bytes kept for rewinding past generations, 0 = none
+        std::size_t history{0};
+        /// the board is written to or read from snapshots
+        bool snapshots{false};
+        rules::rule rule{rules::CONWAY};
+        /// rule of the ltl engine
+        rules::ltl_rule ltl{};
+    };
+
+    /// Why the engine described by `s` cannot be created, or an empty string if it can.
+    inline std::string check(settings const &s)
+    {
+        if (s.engine != "classic" && s.engine != "packed" && s.engine != "sparse" && s.engine != "hashlife" &&
+            s.engine != "generations" && s.engine != "ltl")
+        {
+            return "Unknown engine: " + s.engine;
+        }
+        if (s.engine != "generations" && s.rule.states > 2)
+        {
+            return "Only the generations engine can run rules with more than two states: " + rules::to_string(s.rule);
+        }
+        if (s.rule.states > 2 && (s.history > 0 || s.snapshots))
+        {
+            return "Snapshots and the history keep only the live cells, not the dying ones of " + rules::to_string(s.rule);
+        }
+        if ((s.engine == "sparse" || s.engine == "hashlife") && s.snapshots)
+        {
+            return "Snapshots keep only the window, not the unbounded plane of the " + s.engine + " engine";
+        }
+        if (s.engine != "ltl" && s.ltl != rules::ltl_rule{})
+        {
+            return "Only the ltl engine can run Larger-than-Life rules: " + rules::to_string(s.ltl);
+        }
+        if (s.engine == "hashlife" && s.rule.births(0))
+        {
+            return "HashLife cannot run rules with B0: " + rules::to_string(s.rule);
+        }
+        if (s.engine == "sparse" && s.rule.births(0))
+        {
+            return "The sparse engine cannot run rules with B0: " + rules::to_string(s.rule);
+        }
+        if (s.workers > 0 && s.engine != "classic")
+        {
+            return "Only the classic engine can run in worker processes, not " + s.engine;
+        }
+#ifndef AUTOMATA_DOMAIN_LIFE
+        if (s.workers > 0)
+        {
+            return "Worker processes need Linux";
+        }
+#endif
+        return "";
+    }
+
+    /**
+     * Creates the engine described by `s`. Returns nullptr if check()
+     * finds a problem with `s`, or if its worker processes cannot be
+     * started, which is reported on std::cerr.
+     */
+    inline std::unique_ptr<game> make_game(settings const &s, int width, int height)
+    {
+        if (!check(s).empty())
+        {
+            return nullptr;
+        }
+        std::unique_ptr<game> g;
+#ifdef AUTOMATA_DOMAIN_LIFE
+        if (s.engine == "classic" && s.workers > 0)
+        {
+            auto d = std::make_unique<domain_life>(width, height, s.workers);
+            if (!d->is_ready())
+            {
+                std::cerr << "\u001b[31;1mError starting workers:\u001b[0m " << d->error() << std::endl;
+                return nullptr;
+            }
+            d->set_rule(s.rule);
+            g = std::move(d);
+        }
+        else
+#endif
+        if (s.engine == "classic")
+        {
+            auto c = std::make_unique<game_of_life>(width, height);
+            c->set_rule(s.rule);
+            g = std::move(c);
+        }
+        else if (s.engine == "packed")
+        {
+            auto p = std::make_unique<packed_life>(width, height, s.threads);
+            p->set_rule(s.rule);
+            g = std::move(p);
+        }
+        else if (s.engine == "sparse")
+        {
+            auto p = std::make_unique<sparse_life>(width, height, s.threads);
+            p->set_rule(s.rule);
+            g = std::move(p);
+        }
+        else if (s.engine == "hashlife")
+        {
+            auto h = std::make_unique<hash_life>(width, height);
+            h->set_step(s.step);
+            h->set_rule(s.rule);
+            g = std::move(h);
+        }
+        else if (s.engine == "generations")
+        {
+            auto p = std::make_unique<generations_life>(width, height, s.threads);
+            p->set_rule(s.rule);
+            g = std::move(p);
+        }
+        else if (s.engine == "ltl")
+        {
+            auto l = std::make_unique<larger_than_life>(width, height, s.threads);
+            l->set_rule(s.ltl);
+            g = std::move(l);
+        }
+        if (g && s.seed != 0)
+        {
+            g->seed(s.seed);
+        }
+        return g;
+    }
+
+    /**
+     * The built-in pattern called `name` in the format emplace() takes, or
+     * nullptr.
+     */
+    inline std::string const *find_pattern(std::string const &name)
+    {
+        if (name == "beacon")
+        {
+            return &game_of_life::BEACON1;
+        }
+        if (name == "two-gun")
+        {
+            return &game_of_life::TWO_GUN;
+        }
+        if (name == "gosper-gun")
+        {
+            return &game_of_life::GOSPER_GUN;
+        }
+        if (name == "schick256")
+        {
+            return &game_of_life::SCHICK256;
+        }
+        if (name == "cordership")
+        {
+            return &game_of_life::TWO_ENGINE_CORDERSHIP;
+        }
+        return nullptr;
+    }
+
+    /// Generations one iterate() call of the engine described by `s` advances.
+    inline uint64_t generations_per_iteration(settings const &s)
+    {
+        return s.engine == "hashlife" ? uint64_t{1} << s.step : 1;
+    }
+}
+
+#endif // __ENGINES_HPP__
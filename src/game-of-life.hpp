@@ -1,15 +1,18 @@
 #ifndef __GAME_OF_LIFE_HPP__
 #define __GAME_OF_LIFE_HPP__
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <memory>
-#include <random>
 #include <vector>
 #include <utility>
 #include <sstream>
 
+#include "board-hash.hpp"
+#include "counter-rng.hpp"
 #include "game.hpp"
+#include "rule.hpp"
 #include "util.hpp"
 
 namespace games
@@ -24,9 +27,6 @@ namespace games
 
     class game_of_life final : public game
     {
-        static constexpr uint32_t ALIVE_COLOR = 0xfff01020;
-        static constexpr uint32_t DEAD_COLOR = 0xffcc8000;
-
     public:
         static const std::string BEACON1;
         static const std::string TWO_GUN;
@@ -42,54 +42,53 @@ namespace games
 
         game_of_life() = delete;
 
-        game_of_life(int width, int height, uint32_t *pixels)
-            : width(width), height(height), pixels(pixels)
+        game_of_life(int width, int height)
+            : width(width), height(height)
         {
             plane_a = std::make_unique<std::vector<cell_state>>(width * height, DEAD);
             plane_b = std::make_unique<std::vector<cell_state>>(width * height, DEAD);
-            neighbors = {-1 - width, -width, 1 - width, 1, 1 + width, width, width - 1, -1};
-            rng.seed(static_cast<uint32_t>(util::make_seed()));
-            // warmup RNG
-            for (int i = 0; i < 10'000; ++i)
-            {
-                (void)rng();
-            }
+            seed(util::make_seed());
+            set_rule(rules::CONWAY);
         }
 
-        void populate()
+        void set_rule(rules::rule const &r)
         {
-            for (unsigned int i = 0; i < static_cast<unsigned int>(width * height); ++i)
+            for (int n = 0; n <= 8; ++n)
             {
-                (*plane_a)[i] = ((rng() & 1) == 0) ? DEAD : ALIVE;
+                next_state[n] = r.next(false, n);
+                next_state[9 + n] = r.next(true, n);
             }
         }
 
-        void clear()
+        void seed(unsigned long s) override
         {
-            std::fill(plane_a->begin(), plane_a->end(), DEAD);
-            std::fill(plane_b->begin(), plane_b->end(), DEAD);
+            rng.seed(s);
         }
 
-        void emplace(int const x, int const y, std::string const &obj)
+        void populate(double density) override
         {
-            int j = 0;
-            int i = 0;
-            for (char const &c : obj)
+            uint32_t const fill = rng.next_fill();
+            uint32_t const p = util::fixed_density(density);
+            std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+            std::vector<uint64_t> words(per_row);
+            for (int y = 0; y < height; ++y)
             {
-                if (c == '\n')
-                {
-                    i = 0;
-                    ++j;
-                }
-                else
+                rng.fill_rows(fill, p, width, y, 1, words.data());
+                cell_state *r = plane_a->data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width);
+                for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
                 {
-                    set(x + i, y + j, c == '.' ? DEAD : ALIVE);
-                    ++i;
+                    r[x] = ((words[x / 64] >> (x % 64)) & 1) == 0 ? DEAD : ALIVE;
                 }
             }
         }
 
-        void irritate(int const x, int const y)
+        void clear() override
+        {
+            std::fill(plane_a->begin(), plane_a->end(), DEAD);
+            std::fill(plane_b->begin(), plane_b->end(), DEAD);
+        }
+
+        void irritate(int const x, int const y) override
         {
             for (int dy = -1; dy <= 1; ++dy)
             {
@@ -105,44 +104,139 @@ namespace games
             (*plane_a)[mod(y, height) * static_cast<unsigned int>(width) + mod(x, width)] = state;
         }
 
-        void iterate()
+        void set_span(int x, int y, int length, bool alive) override
         {
-            for (int y = 0; y < height; ++y)
+            length = std::min(length, width);
+            unsigned int const row = mod(y, height) * static_cast<unsigned int>(width);
+            int cx = static_cast<int>(mod(x, width));
+            while (length > 0)
             {
-                for (int x = 0; x < width; ++x)
+                int const n = std::min(length, width - cx);
+                auto const first = plane_a->begin() + row + cx;
+                std::fill(first, first + n, alive ? ALIVE : DEAD);
+                length -= n;
+                cx = 0;
+            }
+        }
+
+        void get_rows(int y, int count, int w, uint64_t *words) const override
+        {
+            if (w != width || y < 0 || y + count > height)
+            {
+                game::get_rows(y, count, w, words);
+                return;
+            }
+            std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+            cell_state const *cells = plane_a->data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width);
+            for (int row = 0; row < count; ++row, cells += width)
+            {
+                uint64_t *out = words + static_cast<std::size_t>(row) * per_row;
+                for (std::size_t i = 0; i < per_row; ++i)
                 {
-                    unsigned int const current_idx = static_cast<unsigned int>(y * width + x);
-                    int num_alive = 0;
-                    for (auto neighbor_idx : neighbors)
+                    uint64_t word = 0;
+                    std::size_t const n = std::min<std::size_t>(64, static_cast<std::size_t>(width) - i * 64);
+                    for (std::size_t b = 0; b < n; ++b)
                     {
-                        num_alive += plane_a->at(mod(static_cast<int>(current_idx) + neighbor_idx, width * height));
+                        word |= static_cast<uint64_t>(cells[i * 64 + b] == ALIVE) << b;
                     }
-                    if (plane_a->at(current_idx) == ALIVE)
+                    out[i] = word;
+                }
+            }
+        }
+
+        void set_rows(int y, int count, int w, uint64_t const *words) override
+        {
+            if (w != width || y < 0 || y + count > height)
+            {
+                game::set_rows(y, count, w, words);
+                return;
+            }
+            std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+            cell_state *cells = plane_a->data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width);
+            for (int row = 0; row < count; ++row, cells += width)
+            {
+                uint64_t const *in = words + static_cast<std::size_t>(row) * per_row;
+                for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
+                {
+                    cells[x] = ((in[x / 64] >> (x % 64)) & 1) != 0 ? ALIVE : DEAD;
+                }
+            }
+        }
+
+        /// Rehashes the whole board; same hash as the packed engine for the same cells.
+        uint64_t hash() const override
+        {
+            std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+            std::vector<uint64_t> band(per_row * HASH_TILE_ROWS);
+            uint64_t h = EMPTY_BOARD_HASH;
+            for (int y = 0; y < height; y += HASH_TILE_ROWS)
+            {
+                int const rows = std::min(HASH_TILE_ROWS, height - y);
+                get_rows(y, rows, width, band.data());
+                for (std::size_t w = 0; w < per_row; w += HASH_TILE_WORDS)
+                {
+                    h ^= tile_hash(band.data() + w, per_row, rows, std::min(HASH_TILE_WORDS, per_row - w),
+                                   tile_salt(static_cast<int64_t>(w / HASH_TILE_WORDS), y / HASH_TILE_ROWS));
+                }
+            }
+            return h;
+        }
+
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override
+        {
+            int64_t const size = int64_t{1} << std::min(level, MAX_DENSITY_LEVEL);
+            for (int r = 0; r < rows; ++r)
+            {
+                int64_t const y0 = std::max<int64_t>(0, y + r * size);
+                int64_t const y1 = std::min<int64_t>(height, y + (r + 1) * size);
+                for (int c = 0; c < columns; ++c)
+                {
+                    int64_t const x0 = std::max<int64_t>(0, x + c * size);
+                    int64_t const x1 = std::min<int64_t>(width, x + (c + 1) * size);
+                    uint64_t n = 0;
+                    for (int64_t cy = y0; cy < y1; ++cy)
                     {
-                        if (num_alive == 2 || num_alive == 3)
-                        {
-                            (*plane_b)[current_idx] = ALIVE;
-                            pixels[current_idx] = ALIVE_COLOR;
-                        }
-                        else
+                        cell_state const *cells = plane_a->data() + cy * width;
+                        for (int64_t cx = x0; cx < x1; ++cx)
                         {
-                            (*plane_b)[current_idx] = DEAD;
-                            pixels[current_idx] = DEAD_COLOR;
+                            n += cells[cx] == ALIVE ? 1 : 0;
                         }
                     }
-                    else
+                    counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(c)] = n;
+                }
+            }
+        }
+
+        uint64_t population() const override
+        {
+            return static_cast<uint64_t>(std::count(plane_a->begin(), plane_a->end(), ALIVE));
+        }
+
+        /// every cell, every generation
+        uint64_t cells_updated() const override
+        {
+            return static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+        }
+
+        bool get(int x, int y) const override
+        {
+            return (*plane_a)[mod(y, height) * static_cast<unsigned int>(width) + mod(x, width)] == ALIVE;
+        }
+
+        void iterate() override
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    unsigned int const current_idx = static_cast<unsigned int>(y * width + x);
+                    int num_alive = 0;
+                    for (auto const &[dx, dy] : neighbors)
                     {
-                        if (num_alive == 3)
-                        {
-                            (*plane_b)[current_idx] = ALIVE;
-                            pixels[current_idx] = ALIVE_COLOR;
-                        }
-                        else
-                        {
-                            (*plane_b)[current_idx] = DEAD;
-                            pixels[current_idx] = ((pixels[current_idx] >> 1) & 0xff000000) | (pixels[current_idx] & 0x00ffffff);
-                        }
+                        num_alive += plane_a->at(mod(y + dy, height) * static_cast<unsigned int>(width) + mod(x + dx, width));
                     }
+                    bool const was_alive = plane_a->at(current_idx) == ALIVE;
+                    (*plane_b)[current_idx] = next_state[(was_alive ? 9 : 0) + num_alive] ? ALIVE : DEAD;
                 }
             }
             std::swap(plane_a, plane_b);
@@ -151,11 +245,13 @@ namespace games
     private:
         const int width;
         const int height;
-        uint32_t *pixels{nullptr};
         std::unique_ptr<std::vector<cell_state>> plane_a;
         std::unique_ptr<std::vector<cell_state>> plane_b;
-        std::array<int, 8> neighbors;
-        std::mt19937 rng;
+        static constexpr std::array<std::pair<int, int>, 8> neighbors{{
+            {-1, -1}, {0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}}};
+        // indexed by 9 * alive + live neighbors
+        std::array<bool, 18> next_state{};
+        util::counter_rng rng;
     };
 }
 
@@ -1,11 +1,242 @@
 #ifndef __GAME_HPP__
 #define __GAME_HPP__
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
 class game
 {
 public:
+    virtual ~game() = default;
     virtual void iterate() = 0;
     virtual void clear() = 0;
+    /**
+     * Fills the board with random cells, each alive with probability
+     * `density`. The same seed() and board size give the same cells in
+     * every engine, for any number of threads; every further fill differs.
+     */
+    virtual void populate(double density) = 0;
+
+    /**
+     * Copies `obj` to the board with its top-left corner at (x, y). Rows
+     * are separated by '\n', '.' is a dead cell and anything else a live
+     * one.
+     */
+    virtual void emplace(int x, int y, std::string const &obj)
+    {
+        int row = 0;
+        for (std::size_t begin = 0; begin <= obj.size(); ++row)
+        {
+            std::size_t end = obj.find('\n', begin);
+            if (end == std::string::npos)
+            {
+                end = obj.size();
+            }
+            for (std::size_t i = begin; i < end;)
+            {
+                bool const alive = obj[i] != '.';
+                std::size_t run = i + 1;
+                while (run < end && (obj[run] != '.') == alive)
+                {
+                    ++run;
+                }
+                set_span(x + static_cast<int>(i - begin), y + row, static_cast<int>(run - i), alive);
+                i = run;
+            }
+            begin = end + 1;
+        }
+    }
+
+    /// Sets `length` cells of row y, starting at column x, to `alive`.
+    virtual void set_span(int x, int y, int length, bool alive) = 0;
+
+    /**
+     * Packs `count` rows starting at row y into `words`, (width + 63) / 64
+     * words per row with cell x in bit x % 64 of word x / 64. Bits past
+     * `width` in the last word of a row are zero.
+     */
+    virtual void get_rows(int y, int count, int width, uint64_t *words) const
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (int row = 0; row < count; ++row)
+        {
+            uint64_t *out = words + static_cast<std::size_t>(row) * per_row;
+            for (std::size_t w = 0; w < per_row; ++w)
+            {
+                out[w] = 0;
+            }
+            for (int x = 0; x < width; ++x)
+            {
+                if (get(x, y + row))
+                {
+                    out[x / 64] |= uint64_t{1} << (x % 64);
+                }
+            }
+        }
+    }
+
+    /// Overwrites `count` rows starting at row y with the layout of get_rows().
+    virtual void set_rows(int y, int count, int width, uint64_t const *words)
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (int row = 0; row < count; ++row)
+        {
+            uint64_t const *in = words + static_cast<std::size_t>(row) * per_row;
+            auto const bit = [in](int x)
+            {
+                return ((in[x / 64] >> (x % 64)) & 1) != 0;
+            };
+            for (int x = 0; x < width;)
+            {
+                bool const alive = bit(x);
+                int run = x + 1;
+                while (run < width && bit(run) == alive)
+                {
+                    ++run;
+                }
+                set_span(x, y + row, run - x, alive);
+                x = run;
+            }
+        }
+    }
+
+    /// States a cell can be in: 2 for Life-like rules, more for Generations rules.
+    virtual int states() const
+    {
+        return 2;
+    }
+
+    /**
+     * Writes the state of every cell of `count` rows starting at row y to
+     * `cells`, `width` bytes per row: 0 for dead, 1 for alive and from 2 up
+     * for dying cells. get_rows() packs only the live ones.
+     */
+    virtual void get_states(int y, int count, int width, uint8_t *cells) const
+    {
+        for (int row = 0; row < count; ++row)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                cells[static_cast<std::size_t>(row) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)] = get(x, y + row) ? 1 : 0;
+            }
+        }
+    }
+
+    /**
+     * A stamp that moves on whenever a cell in rows [y, y + count) may have
+     * changed, so that callers who keep a copy of the board can skip rows
+     * that did not. 0 means the engine does not track it and the rows must
+     * be assumed to have changed.
+     */
+    virtual uint64_t rows_version(int /* y */, int /* count */) const
+    {
+        return 0;
+    }
+
+    /// Like rows_version(), for the cells [x, x + count_x) of those rows only; engines that track no finer areas give rows_version().
+    virtual uint64_t area_version(int /* x */, int y, int /* count_x */, int count) const
+    {
+        return rows_version(y, count);
+    }
+
+    /**
+     * 64-bit hash of the board, equal for equal boards, or 0 if the engine
+     * does not compute one. The packed and sparse engines hash only what
+     * changed since the last call, so calling it every generation is cheap.
+     */
+    virtual uint64_t hash() const
+    {
+        return 0;
+    }
+
+    /// Live cells on the board.
+    virtual uint64_t population() const = 0;
+
+    /// Cells the last iterate() computed, or 0 if the engine does not tell.
+    virtual uint64_t cells_updated() const
+    {
+        return 0;
+    }
+
+    /**
+     * Why the engine can no longer step, such as a worker process that
+     * died, or an empty string. From then on iterate() does nothing and
+     * the board stays at the last generation completed.
+     */
+    virtual std::string failure() const
+    {
+        return {};
+    }
+
+    /// Largest `level` get_density() supports.
+    static constexpr int MAX_DENSITY_LEVEL = 30;
+
+    /**
+     * Counts the live cells in squares of 2^level x 2^level cells, for
+     * drawing the board zoomed out: `columns` x `rows` squares into
+     * `counts`, left to right and top to bottom, the first with its top
+     * left corner at cell (x, y), which must be a multiple of 2^level.
+     * Engines on a board that wraps around count cells on the board only.
+     * The default asks get() for every cell; the engines keep their counts
+     * up to date as cells change, so the cost follows the number of
+     * squares rather than the number of cells in them.
+     */
+    virtual void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const
+    {
+        int64_t const size = int64_t{1} << level;
+        for (int r = 0; r < rows; ++r)
+        {
+            for (int c = 0; c < columns; ++c)
+            {
+                uint64_t n = 0;
+                for (int64_t cy = y + r * size; cy < y + (r + 1) * size; ++cy)
+                {
+                    for (int64_t cx = x + c * size; cx < x + (c + 1) * size; ++cx)
+                    {
+                        n += get(static_cast<int>(cx), static_cast<int>(cy)) ? 1 : 0;
+                    }
+                }
+                counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(c)] = n;
+            }
+        }
+    }
+
+    virtual void irritate(int x, int y) = 0;
+    virtual bool get(int x, int y) const = 0;
+    /// Restarts the random number generator behind populate() and irritate().
+    virtual void seed(unsigned long s) = 0;
+
+protected:
+    /**
+     * get_density() for engines whose boards are no larger than the
+     * window, so that counting the cells themselves is cheap enough:
+     * squares are clipped to the board [0, width) x [0, height) and
+     * `count(y, x0, x1)` gives the live cells [x0, x1) of row y.
+     */
+    template <typename Count>
+    static void count_density(int width, int height, int64_t x, int64_t y, int level, int columns, int rows,
+                              uint64_t *counts, Count const &count)
+    {
+        int64_t const size = int64_t{1} << std::min(level, MAX_DENSITY_LEVEL);
+        for (int r = 0; r < rows; ++r)
+        {
+            int64_t const y0 = std::max<int64_t>(0, y + r * size);
+            int64_t const y1 = std::min<int64_t>(height, y + (r + 1) * size);
+            for (int c = 0; c < columns; ++c)
+            {
+                int64_t const x0 = std::max<int64_t>(0, x + c * size);
+                int64_t const x1 = std::min<int64_t>(width, x + (c + 1) * size);
+                uint64_t n = 0;
+                for (int64_t cy = y0; cy < y1 && x0 < x1; ++cy)
+                {
+                    n += count(static_cast<int>(cy), static_cast<int>(x0), static_cast<int>(x1));
+                }
+                counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(c)] = n;
+            }
+        }
+    }
 };
 
 #endif // __GAME_HPP__
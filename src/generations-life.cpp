@@ -0,0 +1,343 @@
+#include "generations-life.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "density-pyramid.hpp"
+#include "game-of-life.hpp"
+#include "kernels/life-impl.hpp"
+
+namespace games
+{
+    generations_life::generations_life(int width, int height, unsigned int threads)
+        : width(width), height(height)
+        , words_per_row((static_cast<std::size_t>(width) + 63) / 64)
+        , last_word_mask((width % 64) == 0 ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1)
+        , kernel(&kernels::active())
+    {
+        live_a.assign(words_per_row * static_cast<std::size_t>(height), 0);
+        live_b.assign(words_per_row * static_cast<std::size_t>(height), 0);
+        std::size_t const bands = (static_cast<std::size_t>(height) + BAND_ROWS - 1) / BAND_ROWS;
+        band_rows.assign(bands * 2 * words_per_row, 0);
+        band_chunks.assign(bands * ((words_per_row + kernels::CHUNK_WORDS - 1) / kernels::CHUNK_WORDS), 0);
+        set_threads(threads);
+        seed(util::make_seed());
+    }
+
+    void generations_life::seed(unsigned long s)
+    {
+        rng.seed(s);
+    }
+
+    void generations_life::set_rule(rules::rule const &r)
+    {
+        rule_ = r;
+        std::size_t const bits = r.states > 2 ? static_cast<std::size_t>(std::bit_width(static_cast<unsigned int>(r.states - 1))) : 0;
+        if (bits != age_bits)
+        {
+            age_bits = bits;
+            ages_a.assign(age_bits * words_per_row * static_cast<std::size_t>(height), 0);
+            ages_b.assign(age_bits * words_per_row * static_cast<std::size_t>(height), 0);
+        }
+        else
+        {
+            // ages past the new last state would never end
+            std::fill(ages_a.begin(), ages_a.end(), 0);
+        }
+    }
+
+    void generations_life::set_kernel(kernels::life_kernel const &k)
+    {
+        kernel = &k;
+    }
+
+    void generations_life::set_threads(unsigned int threads)
+    {
+        pool.reset();
+        if (threads != 1)
+        {
+            pool = std::make_unique<util::thread_pool>(threads);
+        }
+    }
+
+    void generations_life::populate(double density)
+    {
+        uint32_t const fill = rng.next_fill();
+        uint32_t const p = util::fixed_density(density);
+        std::size_t const bands = (static_cast<std::size_t>(height) + BAND_ROWS - 1) / BAND_ROWS;
+        auto band = [&](std::size_t b)
+        {
+            int const y = static_cast<int>(b) * BAND_ROWS;
+            rng.fill_rows(fill, p, width, y, std::min(BAND_ROWS, height - y), row(live_a, y));
+        };
+        if (pool)
+        {
+            pool->parallel_for(bands, band);
+        }
+        else
+        {
+            for (std::size_t b = 0; b < bands; ++b)
+            {
+                band(b);
+            }
+        }
+        std::fill(ages_a.begin(), ages_a.end(), 0);
+    }
+
+    void generations_life::clear()
+    {
+        std::fill(live_a.begin(), live_a.end(), 0);
+        std::fill(ages_a.begin(), ages_a.end(), 0);
+    }
+
+    void generations_life::irritate(int const x, int const y)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                set(x + dx, y + dy, (rng() & 1) != 0);
+            }
+        }
+    }
+
+    void generations_life::set(int x, int y, bool alive)
+    {
+        set_cell(static_cast<int>(mod(x, width)), static_cast<int>(mod(y, height)), alive);
+    }
+
+    void generations_life::set_cell(int x, int y, bool alive)
+    {
+        std::size_t const w = static_cast<std::size_t>(x) / 64;
+        uint64_t const bit = uint64_t{1} << (x % 64);
+        uint64_t &word = row(live_a, y)[w];
+        word = alive ? (word | bit) : (word & ~bit);
+        uint64_t *a = ages(ages_a, y);
+        for (std::size_t i = 0; i < age_bits; ++i)
+        {
+            a[i * words_per_row + w] &= ~bit;
+        }
+    }
+
+    void generations_life::set_span(int x, int y, int length, bool alive)
+    {
+        length = std::min(length, width);
+        int const cy = static_cast<int>(mod(y, height));
+        int const cx = static_cast<int>(mod(x, width));
+        for (int i = 0; i < length; ++i)
+        {
+            set_cell((cx + i) % width, cy, alive);
+        }
+    }
+
+    bool generations_life::get(int x, int y) const
+    {
+        unsigned int const cx = mod(x, width);
+        return ((row(live_a, static_cast<int>(mod(y, height)))[cx / 64] >> (cx % 64)) & 1) != 0;
+    }
+
+    void generations_life::get_rows(int y, int count, int w, uint64_t *words) const
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::get_rows(y, count, w, words);
+            return;
+        }
+        std::memcpy(words, row(live_a, y), static_cast<std::size_t>(count) * words_per_row * sizeof(uint64_t));
+    }
+
+    void generations_life::set_rows(int y, int count, int w, uint64_t const *words)
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::set_rows(y, count, w, words);
+            return;
+        }
+        std::memcpy(row(live_a, y), words, static_cast<std::size_t>(count) * words_per_row * sizeof(uint64_t));
+        for (int r = y; r < y + count; ++r)
+        {
+            row(live_a, r)[words_per_row - 1] &= last_word_mask;
+            std::fill_n(ages(ages_a, r), age_bits * words_per_row, 0);
+        }
+    }
+
+    void generations_life::get_states(int y, int count, int w, uint8_t *cells) const
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::get_states(y, count, w, cells);
+            return;
+        }
+        for (int r = 0; r < count; ++r)
+        {
+            uint64_t const *live = row(live_a, y + r);
+            uint64_t const *a = ages(ages_a, y + r);
+            uint8_t *out = cells + static_cast<std::size_t>(r) * static_cast<std::size_t>(width);
+            for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
+            {
+                std::size_t const word = x / 64;
+                unsigned int const bit = x % 64;
+                unsigned int age = 0;
+                for (std::size_t i = 0; i < age_bits; ++i)
+                {
+                    age |= static_cast<unsigned int>((a[i * words_per_row + word] >> bit) & 1) << i;
+                }
+                // a dying cell of age n is in state n + 1
+                out[x] = static_cast<uint8_t>(((live[word] >> bit) & 1) != 0 ? 1 : age == 0 ? 0 : age + 1);
+            }
+        }
+    }
+
+    void generations_life::get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const
+    {
+        // the live plane only, dying cells do not count
+        count_density(width, height, x, y, level, columns, rows, counts, [this](int cy, int x0, int x1)
+                      {
+                          uint64_t const *live = row(live_a, cy);
+                          uint64_t n = 0;
+                          for (int cx = x0; cx < x1; ++cx)
+                          {
+                              n += (live[cx / 64] >> (cx % 64)) & 1;
+                          }
+                          return n; });
+    }
+
+    uint64_t generations_life::population() const
+    {
+        constexpr std::size_t BLOCK = 512;
+        uint64_t n = 0;
+        for (std::size_t i = 0; i < live_a.size(); i += BLOCK)
+        {
+            column_count count;
+            for (std::size_t j = i; j < std::min(live_a.size(), i + BLOCK); ++j)
+            {
+                count.add(live_a[j]);
+            }
+            n += count.total();
+        }
+        return n;
+    }
+
+    // Steps the live cells of a whole row under the Life-like part of the rule, as packed_life::step_span() does.
+    void generations_life::step_live(uint64_t const *above, uint64_t const *current, uint64_t const *below, uint64_t *out,
+                                     uint8_t *changed) const
+    {
+        std::size_t const n = words_per_row;
+        unsigned int const last_bit = static_cast<unsigned int>(width - 1) % 64;
+        // neighbor to the west (x - 1) shifted into position x, wrapping at x = 0
+        auto west = [&](uint64_t const *r, std::size_t w)
+        {
+            uint64_t const carry = w > 0 ? r[w - 1] >> 63 : (r[n - 1] >> last_bit) & 1;
+            return (r[w] << 1) | carry;
+        };
+        // neighbor to the east (x + 1) shifted into position x, wrapping at x = width - 1
+        auto east = [&](uint64_t const *r, std::size_t w)
+        {
+            uint64_t const carry = w + 1 < n ? r[w + 1] << 63 : (r[0] & 1) << last_bit;
+            return (r[w] >> 1) | carry;
+        };
+        auto edge = [&](std::size_t w)
+        {
+            return kernels::any_rule{rule_}.apply<kernels::scalar_traits>(
+                west(above, w), above[w], east(above, w),
+                west(current, w), current[w], east(current, w),
+                west(below, w), below[w], east(below, w));
+        };
+        out[0] = edge(0);
+        if (n > 2)
+        {
+            kernel->step(rule_, above, current, below, out, 1, n - 1, changed);
+        }
+        if (n > 1)
+        {
+            out[n - 1] = edge(n - 1);
+        }
+        out[n - 1] &= last_word_mask;
+    }
+
+    void generations_life::step_band(std::size_t band)
+    {
+        std::size_t const n = words_per_row;
+        // per row: dying cells, then the carry of the increment, then the ages that ended
+        uint64_t *const dying = band_rows.data() + band * 2 * n;
+        uint64_t *const carry = dying + n;
+        std::size_t const chunks = (n + kernels::CHUNK_WORDS - 1) / kernels::CHUNK_WORDS;
+        uint8_t *const changed = band_chunks.data() + band * chunks;
+        // the age of the state after the last one, which is dead again
+        unsigned int const end_age = rule_.states > 2 ? static_cast<unsigned int>(rule_.states) - 1 : 0;
+        int const y0 = static_cast<int>(band) * BAND_ROWS;
+        int const y1 = std::min(height, y0 + BAND_ROWS);
+        for (int y = y0; y < y1; ++y)
+        {
+            uint64_t const *current = row(live_a, y);
+            uint64_t *out = row(live_b, y);
+            step_live(row(live_a, y == 0 ? height - 1 : y - 1), current, row(live_a, y == height - 1 ? 0 : y + 1), out, changed);
+            if (age_bits == 0)
+            {
+                continue;
+            }
+            uint64_t const *age = ages(ages_a, y);
+            uint64_t *next_age = ages(ages_b, y);
+            std::fill_n(dying, n, 0);
+            for (std::size_t i = 0; i < age_bits; ++i)
+            {
+                for (std::size_t w = 0; w < n; ++w)
+                {
+                    dying[w] |= age[i * n + w];
+                }
+            }
+            // dying cells cannot be born; live ones that did not survive start dying at age 1 below
+            for (std::size_t w = 0; w < n; ++w)
+            {
+                out[w] &= ~dying[w];
+                carry[w] = dying[w];
+            }
+            // age + 1 on dying cells, and `dying` narrowed to the cells whose new age is end_age
+            for (std::size_t i = 0; i < age_bits; ++i)
+            {
+                uint64_t const *a = age + i * n;
+                uint64_t *b = next_age + i * n;
+                uint64_t const want = ((end_age >> i) & 1) != 0 ? ~uint64_t{0} : 0;
+                for (std::size_t w = 0; w < n; ++w)
+                {
+                    uint64_t const sum = a[w] ^ carry[w];
+                    carry[w] &= a[w];
+                    b[w] = sum;
+                    dying[w] &= ~(sum ^ want);
+                }
+            }
+            for (std::size_t i = 0; i < age_bits; ++i)
+            {
+                uint64_t *b = next_age + i * n;
+                for (std::size_t w = 0; w < n; ++w)
+                {
+                    b[w] &= ~dying[w];
+                }
+            }
+            for (std::size_t w = 0; w < n; ++w)
+            {
+                next_age[w] |= current[w] & ~out[w];
+            }
+        }
+    }
+
+    void generations_life::iterate()
+    {
+        std::size_t const bands = (static_cast<std::size_t>(height) + BAND_ROWS - 1) / BAND_ROWS;
+        if (pool)
+        {
+            pool->parallel_for(bands, [this](std::size_t b)
+                               { step_band(b); });
+        }
+        else
+        {
+            for (std::size_t b = 0; b < bands; ++b)
+            {
+                step_band(b);
+            }
+        }
+        std::swap(live_a, live_b);
+        std::swap(ages_a, ages_b);
+    }
+}
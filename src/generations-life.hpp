@@ -0,0 +1,121 @@
+#ifndef __GENERATIONS_LIFE_HPP__
+#define __GENERATIONS_LIFE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "counter-rng.hpp"
+#include "game.hpp"
+#include "kernels/life.hpp"
+#include "rule.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+
+namespace games
+{
+    /**
+     * Generations rules, like Brian's Brain (/2/3) or Star Wars (345/2/4),
+     * on a torus, in bit planes.
+     *
+     * The live cells are one plane in the layout of packed_life, stepped
+     * by the same SIMD kernel, which sees dying cells as dead. Dying cells
+     * keep their age, 1 for the state after alive, in `age_bits` more
+     * planes, bit i of the age in plane i. After the kernel, a few passes
+     * of whole-word operations per row take births on dying cells back,
+     * start the cells that did not survive dying, add one to every age
+     * with a bit-sliced increment and clear the ages that reached the last
+     * state. With two states there are no age planes and this is the
+     * packed engine without skipping quiet tiles.
+     *
+     * get_rows() and set_rows() see the live cells only, so snapshots and
+     * the history keep those and drop the dying ones; get_states() has all.
+     */
+    class generations_life final : public game
+    {
+    public:
+        /// rows per task of a generation
+        static constexpr int BAND_ROWS = 32;
+
+        generations_life() = delete;
+        /// `threads` == 0 uses one thread per hardware thread.
+        generations_life(int width, int height, unsigned int threads = 1);
+
+        void populate(double density) override;
+        void clear() override;
+        void irritate(int x, int y) override;
+        void iterate() override;
+        void set_span(int x, int y, int length, bool alive) override;
+        void get_rows(int y, int count, int width, uint64_t *words) const override;
+        void set_rows(int y, int count, int width, uint64_t const *words) override;
+        void get_states(int y, int count, int width, uint8_t *cells) const override;
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override;
+        uint64_t population() const override;
+        inline uint64_t cells_updated() const override
+        {
+            return static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+        }
+        inline int states() const override
+        {
+            return rule_.states;
+        }
+        bool get(int x, int y) const override;
+        void seed(unsigned long s) override;
+
+        void set(int x, int y, bool alive);
+        /// Any Life-like or Generations rule. Dying cells are dropped when the number of states changes.
+        void set_rule(rules::rule const &r);
+        inline rules::rule const &rule() const
+        {
+            return rule_;
+        }
+
+        void set_kernel(kernels::life_kernel const &k);
+        void set_threads(unsigned int threads);
+
+    private:
+        inline uint64_t *row(std::vector<uint64_t> &plane, int y)
+        {
+            return plane.data() + static_cast<std::size_t>(y) * words_per_row;
+        }
+        inline uint64_t const *row(std::vector<uint64_t> const &plane, int y) const
+        {
+            return plane.data() + static_cast<std::size_t>(y) * words_per_row;
+        }
+        // plane i of the ages of row y is `words_per_row` words after plane i - 1
+        inline uint64_t *ages(std::vector<uint64_t> &planes, int y)
+        {
+            return planes.data() + static_cast<std::size_t>(y) * age_bits * words_per_row;
+        }
+        inline uint64_t const *ages(std::vector<uint64_t> const &planes, int y) const
+        {
+            return planes.data() + static_cast<std::size_t>(y) * age_bits * words_per_row;
+        }
+
+        void step_band(std::size_t band);
+        void step_live(uint64_t const *above, uint64_t const *current, uint64_t const *below, uint64_t *out, uint8_t *changed) const;
+        // Makes a cell dead or alive, no longer dying.
+        void set_cell(int x, int y, bool alive);
+
+        const int width;
+        const int height;
+        const std::size_t words_per_row;
+        const uint64_t last_word_mask;
+        kernels::life_kernel const *kernel;
+        rules::rule rule_{rules::CONWAY};
+        // planes of the ages, enough bits for states - 1
+        std::size_t age_bits{0};
+        std::vector<uint64_t> live_a;
+        std::vector<uint64_t> live_b;
+        std::vector<uint64_t> ages_a;
+        std::vector<uint64_t> ages_b;
+        // per band of rows: two rows of words step_band() works in, then a flag per chunk of a row for the kernel
+        std::vector<uint64_t> band_rows;
+        std::vector<uint8_t> band_chunks;
+        std::unique_ptr<util::thread_pool> pool;
+        util::counter_rng rng;
+    };
+}
+
+#endif // __GENERATIONS_LIFE_HPP__
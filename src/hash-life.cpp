@@ -0,0 +1,635 @@
+#include "hash-life.hpp"
+
+#include <algorithm>
+
+namespace games
+{
+    namespace
+    {
+        inline std::size_t node_hash(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+        {
+            uint64_t h = (static_cast<uint64_t>(nw) << 32 | ne) * 0x9e3779b97f4a7c15ull;
+            h ^= (static_cast<uint64_t>(sw) << 32 | se) + 0x632be59bd9b4e019ull + (h << 6) + (h >> 2);
+            h ^= h >> 29;
+            h *= 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 32;
+            return static_cast<std::size_t>(h);
+        }
+    }
+
+    hash_life::hash_life(int width, int height, std::size_t max_nodes)
+        : width(width), height(height), max_nodes(max_nodes)
+    {
+        // slot 0 is unused so that NONE can double as "no node"
+        nodes.push_back(node{NONE, NONE, NONE, NONE, NONE, 0, 0});
+        nodes.push_back(node{NONE, NONE, NONE, NONE, NONE, 0, 0});
+        nodes.push_back(node{NONE, NONE, NONE, NONE, NONE, 0, 1});
+        empties.push_back(DEAD_CELL);
+        table.assign(1 << 16, NONE);
+        root = empty(3);
+        seed(util::make_seed());
+    }
+
+    void hash_life::seed(unsigned long s)
+    {
+        rng.seed(s);
+    }
+
+    hash_life::node_id hash_life::join(node_id nw, node_id ne, node_id sw, node_id se)
+    {
+        std::size_t const mask = table.size() - 1;
+        std::size_t slot = node_hash(nw, ne, sw, se) & mask;
+        while (table[slot] != NONE)
+        {
+            node const &n = nodes[table[slot]];
+            if (n.nw == nw && n.ne == ne && n.sw == sw && n.se == se)
+            {
+                return table[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        node const fresh{
+            nw, ne, sw, se, NONE,
+            nodes[nw].level + 1,
+            nodes[nw].population + nodes[ne].population + nodes[sw].population + nodes[se].population};
+        node_id id;
+        if (free_ids.empty())
+        {
+            id = static_cast<node_id>(nodes.size());
+            nodes.push_back(fresh);
+        }
+        else
+        {
+            id = free_ids.back();
+            free_ids.pop_back();
+            nodes[id] = fresh;
+        }
+        table[slot] = id;
+        if (++table_used * 2 > table.size())
+        {
+            grow_table();
+        }
+        return id;
+    }
+
+    void hash_life::grow_table()
+    {
+        std::vector<node_id> old(table.size() * 2, NONE);
+        std::swap(table, old);
+        std::size_t const mask = table.size() - 1;
+        for (node_id id : old)
+        {
+            if (id == NONE)
+            {
+                continue;
+            }
+            node const &n = nodes[id];
+            std::size_t slot = node_hash(n.nw, n.ne, n.sw, n.se) & mask;
+            while (table[slot] != NONE)
+            {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = id;
+        }
+    }
+
+    hash_life::node_id hash_life::empty(uint32_t level)
+    {
+        while (empties.size() <= level)
+        {
+            node_id const e = empties.back();
+            empties.push_back(join(e, e, e, e));
+        }
+        return empties[level];
+    }
+
+    // Same cells in a node one level up, surrounded by empty space.
+    hash_life::node_id hash_life::expand(node_id n)
+    {
+        node const c = nodes[n];
+        node_id const e = empty(c.level - 1);
+        return join(join(e, e, e, c.nw),
+                    join(e, e, c.ne, e),
+                    join(e, c.sw, e, e),
+                    join(c.se, e, e, e));
+    }
+
+    // The central half of a node, not advanced in time.
+    hash_life::node_id hash_life::center(node_id n)
+    {
+        node const c = nodes[n];
+        return join(nodes[c.nw].se, nodes[c.ne].sw, nodes[c.sw].ne, nodes[c.se].nw);
+    }
+
+    // A level 2 node (4x4 cells) yields its central 2x2 cells one generation later.
+    hash_life::node_id hash_life::base_successor(node_id n)
+    {
+        node const c = nodes[n];
+        unsigned int bits = 0;
+        auto put = [&](node_id quad, int x, int y)
+        {
+            node const &q = nodes[quad];
+            bits |= (q.nw == ALIVE_CELL ? 1u : 0u) << (y * 4 + x);
+            bits |= (q.ne == ALIVE_CELL ? 1u : 0u) << (y * 4 + x + 1);
+            bits |= (q.sw == ALIVE_CELL ? 1u : 0u) << ((y + 1) * 4 + x);
+            bits |= (q.se == ALIVE_CELL ? 1u : 0u) << ((y + 1) * 4 + x + 1);
+        };
+        put(c.nw, 0, 0);
+        put(c.ne, 2, 0);
+        put(c.sw, 0, 2);
+        put(c.se, 2, 2);
+        auto next = [this, bits](int x, int y)
+        {
+            int num_alive = 0;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (dx != 0 || dy != 0)
+                    {
+                        num_alive += (bits >> ((y + dy) * 4 + x + dx)) & 1;
+                    }
+                }
+            }
+            bool const alive = (bits >> (y * 4 + x)) & 1;
+            return rule_.next(alive, num_alive) ? ALIVE_CELL : DEAD_CELL;
+        };
+        return join(next(1, 1), next(2, 1), next(1, 2), next(2, 2));
+    }
+
+    /**
+     * The central half of a level L node advanced by 2^min(L - 2, step)
+     * generations. Nine overlapping subsquares are stepped (or, below full
+     * speed, just cropped), regrouped into four and stepped once more.
+     */
+    hash_life::node_id hash_life::successor(node_id n)
+    {
+        if (nodes[n].result != NONE)
+        {
+            return nodes[n].result;
+        }
+        node const c = nodes[n];
+        node_id result;
+        if (c.population == 0)
+        {
+            result = empty(c.level - 1);
+        }
+        else if (c.level == 2)
+        {
+            result = base_successor(n);
+        }
+        else
+        {
+            node const nw = nodes[c.nw];
+            node const ne = nodes[c.ne];
+            node const sw = nodes[c.sw];
+            node const se = nodes[c.se];
+            node_id const sub[9] = {
+                c.nw,
+                join(nw.ne, ne.nw, nw.se, ne.sw),
+                c.ne,
+                join(nw.sw, nw.se, sw.nw, sw.ne),
+                join(nw.se, ne.sw, sw.ne, se.nw),
+                join(ne.sw, ne.se, se.nw, se.ne),
+                c.sw,
+                join(sw.ne, se.nw, sw.se, se.sw),
+                c.se};
+            bool const full_speed = step_log2 + 2 >= c.level;
+            node_id r[9];
+            for (int i = 0; i < 9; ++i)
+            {
+                r[i] = full_speed ? successor(sub[i]) : center(sub[i]);
+            }
+            result = join(successor(join(r[0], r[1], r[3], r[4])),
+                          successor(join(r[1], r[2], r[4], r[5])),
+                          successor(join(r[3], r[4], r[6], r[7])),
+                          successor(join(r[4], r[5], r[7], r[8])));
+        }
+        nodes[n].result = result;
+        return result;
+    }
+
+    // True if all live cells lie in the central half of the node.
+    bool hash_life::confined(node_id n) const
+    {
+        node const &c = nodes[n];
+        if (c.level < 2)
+        {
+            return false;
+        }
+        node const &nw = nodes[c.nw];
+        node const &ne = nodes[c.ne];
+        node const &sw = nodes[c.sw];
+        node const &se = nodes[c.se];
+        return nodes[nw.se].population == nw.population &&
+               nodes[ne.sw].population == ne.population &&
+               nodes[sw.ne].population == sw.population &&
+               nodes[se.nw].population == se.population;
+    }
+
+    hash_life::node_id hash_life::with_cell(node_id n, int64_t x, int64_t y, bool alive)
+    {
+        node const c = nodes[n];
+        if (c.level == 0)
+        {
+            return alive ? ALIVE_CELL : DEAD_CELL;
+        }
+        int64_t const half = int64_t{1} << (c.level - 1);
+        if (y < half)
+        {
+            return x < half
+                       ? join(with_cell(c.nw, x, y, alive), c.ne, c.sw, c.se)
+                       : join(c.nw, with_cell(c.ne, x - half, y, alive), c.sw, c.se);
+        }
+        return x < half
+                   ? join(c.nw, c.ne, with_cell(c.sw, x, y - half, alive), c.se)
+                   : join(c.nw, c.ne, c.sw, with_cell(c.se, x - half, y - half, alive));
+    }
+
+    // `n` with cells [x0, x1) of its row y, in node coordinates, set to `alive`.
+    hash_life::node_id hash_life::with_span(node_id n, int64_t x0, int64_t x1, int64_t y, bool alive)
+    {
+        node const c = nodes[n];
+        if (c.level == 0)
+        {
+            return alive ? ALIVE_CELL : DEAD_CELL;
+        }
+        if (!alive && c.population == 0)
+        {
+            return n;
+        }
+        int64_t const half = int64_t{1} << (c.level - 1);
+        bool const south = y >= half;
+        int64_t const row = south ? y - half : y;
+        node_id west = south ? c.sw : c.nw;
+        node_id east = south ? c.se : c.ne;
+        if (x0 < half)
+        {
+            west = with_span(west, x0, std::min(x1, half), row, alive);
+        }
+        if (x1 > half)
+        {
+            east = with_span(east, std::max(x0, half) - half, x1 - half, row, alive);
+        }
+        return south ? join(c.nw, c.ne, west, east) : join(west, east, c.sw, c.se);
+    }
+
+    void hash_life::set_span(int x, int y, int length, bool alive)
+    {
+        if (length <= 0)
+        {
+            return;
+        }
+        int64_t const x1 = int64_t{x} + length;
+        for (;;)
+        {
+            int64_t const half = int64_t{1} << (nodes[root].level - 1);
+            if (x >= -half && x1 <= half && y >= -half && y < half)
+            {
+                root = with_span(root, x + half, x1 + half, y + half, alive);
+                return;
+            }
+            root = expand(root);
+        }
+    }
+
+    // The level 2 node of 4 x 4 cells, row by row from bit 0.
+    hash_life::node_id hash_life::square(unsigned int cells)
+    {
+        if (squares.empty())
+        {
+            squares.assign(std::size_t{1} << 16, NONE);
+        }
+        node_id &n = squares[cells];
+        if (n == NONE)
+        {
+            auto const cell = [cells](int x, int y)
+            {
+                return ((cells >> (y * 4 + x)) & 1) != 0 ? ALIVE_CELL : DEAD_CELL;
+            };
+            auto const quad = [&](int x, int y)
+            {
+                return join(cell(x, y), cell(x + 1, y), cell(x, y + 1), cell(x + 1, y + 1));
+            };
+            n = join(quad(0, 0), quad(2, 0), quad(0, 2), quad(2, 2));
+        }
+        return n;
+    }
+
+    void hash_life::get_rows(int y, int count, int w, uint64_t *words) const
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(w) + 63) / 64;
+        std::fill_n(words, per_row * static_cast<std::size_t>(std::max(count, 0)), 0);
+        for_each_alive(0, y, w, count, [&](int64_t x, int64_t cy)
+                       { words[static_cast<std::size_t>(cy - y) * per_row + static_cast<std::size_t>(x) / 64] |= uint64_t{1} << (x % 64); });
+    }
+
+    void hash_life::set_rows(int y, int count, int w, uint64_t const *words)
+    {
+        if (count <= 0 || w <= 0)
+        {
+            return;
+        }
+        std::size_t const per_row = (static_cast<std::size_t>(w) + 63) / 64;
+        int64_t const y1 = int64_t{y} + count;
+        int64_t half = int64_t{1} << (nodes[root].level - 1);
+        while (w > half || y < -half || y1 > half)
+        {
+            root = expand(root);
+            half = int64_t{1} << (nodes[root].level - 1);
+        }
+        auto const word = [&](int64_t x, int64_t cy)
+        {
+            return words[static_cast<std::size_t>(cy - y) * per_row + static_cast<std::size_t>(x) / 64];
+        };
+        // a node that lies inside the rows, from its squares of 4 x 4 cells up; nodes are aligned to their size
+        auto build = [&](auto &self, uint32_t l, int64_t ox, int64_t oy) -> node_id
+        {
+            if (l == 2)
+            {
+                unsigned int cells = 0;
+                for (int r = 0; r < 4; ++r)
+                {
+                    cells |= static_cast<unsigned int>((word(ox, oy + r) >> (ox % 64)) & 0xf) << (r * 4);
+                }
+                return square(cells);
+            }
+            if (l == 6)
+            {
+                uint64_t any = 0;
+                for (int r = 0; r < 64; ++r)
+                {
+                    any |= word(ox, oy + r);
+                }
+                if (any == 0)
+                {
+                    return empty(l);
+                }
+            }
+            int64_t const h = int64_t{1} << (l - 1);
+            node_id const nw = self(self, l - 1, ox, oy);
+            node_id const ne = self(self, l - 1, ox + h, oy);
+            node_id const sw = self(self, l - 1, ox, oy + h);
+            node_id const se = self(self, l - 1, ox + h, oy + h);
+            return join(nw, ne, sw, se);
+        };
+        // `n` with the rows put in, down to the nodes that lie inside them
+        auto graft = [&](auto &self, node_id n, int64_t ox, int64_t oy) -> node_id
+        {
+            node const c = nodes[n];
+            int64_t const size = int64_t{1} << c.level;
+            if (ox >= w || oy >= y1 || ox + size <= 0 || oy + size <= y)
+            {
+                return n;
+            }
+            if (c.level == 0)
+            {
+                return ((word(ox, oy) >> (ox % 64)) & 1) != 0 ? ALIVE_CELL : DEAD_CELL;
+            }
+            if (c.level >= 2 && ox >= 0 && ox + size <= w && oy >= y && oy + size <= y1)
+            {
+                return build(build, c.level, ox, oy);
+            }
+            int64_t const h = size / 2;
+            node_id const nw = self(self, c.nw, ox, oy);
+            node_id const ne = self(self, c.ne, ox + h, oy);
+            node_id const sw = self(self, c.sw, ox, oy + h);
+            node_id const se = self(self, c.se, ox + h, oy + h);
+            return join(nw, ne, sw, se);
+        };
+        root = graft(graft, root, -half, -half);
+    }
+
+    void hash_life::set(int64_t x, int64_t y, bool alive)
+    {
+        for (;;)
+        {
+            int64_t const half = int64_t{1} << (nodes[root].level - 1);
+            if (x >= -half && x < half && y >= -half && y < half)
+            {
+                root = with_cell(root, x + half, y + half, alive);
+                return;
+            }
+            root = expand(root);
+        }
+    }
+
+    bool hash_life::get(int64_t x, int64_t y) const
+    {
+        node_id n = root;
+        int64_t half = int64_t{1} << (nodes[n].level - 1);
+        if (x < -half || x >= half || y < -half || y >= half)
+        {
+            return false;
+        }
+        x += half;
+        y += half;
+        while (nodes[n].level > 0)
+        {
+            node const &c = nodes[n];
+            if (c.population == 0)
+            {
+                return false;
+            }
+            half = int64_t{1} << (c.level - 1);
+            bool const east = x >= half;
+            bool const south = y >= half;
+            n = south ? (east ? c.se : c.sw) : (east ? c.ne : c.nw);
+            x -= east ? half : 0;
+            y -= south ? half : 0;
+        }
+        return n == ALIVE_CELL;
+    }
+
+    void hash_life::for_each_alive(int64_t x0, int64_t y0, int64_t w, int64_t h,
+                                   std::function<void(int64_t, int64_t)> const &f) const
+    {
+        auto visit = [&](auto &self, node_id n, int64_t ox, int64_t oy) -> void
+        {
+            node const &c = nodes[n];
+            int64_t const size = int64_t{1} << c.level;
+            if (c.population == 0 || ox >= x0 + w || oy >= y0 + h || ox + size <= x0 || oy + size <= y0)
+            {
+                return;
+            }
+            if (c.level == 0)
+            {
+                f(ox, oy);
+                return;
+            }
+            int64_t const half = size / 2;
+            self(self, c.nw, ox, oy);
+            self(self, c.ne, ox + half, oy);
+            self(self, c.sw, ox, oy + half);
+            self(self, c.se, ox + half, oy + half);
+        };
+        int64_t const half = int64_t{1} << (nodes[root].level - 1);
+        visit(visit, root, -half, -half);
+    }
+
+    // The tree is the density pyramid already: nodes as large as a square have its count.
+    void hash_life::get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const
+    {
+        std::fill_n(counts, static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows), 0);
+        if (level > MAX_DENSITY_LEVEL)
+        {
+            return;
+        }
+        int64_t const w = int64_t{columns} << level;
+        int64_t const h = int64_t{rows} << level;
+        auto visit = [&](auto &self, node_id n, int64_t ox, int64_t oy) -> void
+        {
+            node const &c = nodes[n];
+            int64_t const size = int64_t{1} << c.level;
+            if (c.population == 0 || ox >= x + w || oy >= y + h || ox + size <= x || oy + size <= y)
+            {
+                return;
+            }
+            // every node but the root is aligned to its size, so it lies within one square
+            if (static_cast<int>(c.level) <= level && n != root)
+            {
+                counts[static_cast<std::size_t>((oy - y) >> level) * static_cast<std::size_t>(columns) +
+                       static_cast<std::size_t>((ox - x) >> level)] += c.population;
+                return;
+            }
+            int64_t const half = size / 2;
+            self(self, c.nw, ox, oy);
+            self(self, c.ne, ox + half, oy);
+            self(self, c.sw, ox, oy + half);
+            self(self, c.se, ox + half, oy + half);
+        };
+        int64_t const half = int64_t{1} << (nodes[root].level - 1);
+        visit(visit, root, -half, -half);
+    }
+
+    uint64_t hash_life::population() const
+    {
+        return nodes[root].population;
+    }
+
+    void hash_life::set_step(unsigned int log2)
+    {
+        if (log2 == step_log2)
+        {
+            return;
+        }
+        step_log2 = log2;
+        forget_results();
+    }
+
+    void hash_life::set_rule(rules::rule const &r)
+    {
+        if (r == rule_)
+        {
+            return;
+        }
+        rule_ = r;
+        forget_results();
+    }
+
+    void hash_life::forget_results()
+    {
+        for (auto &n : nodes)
+        {
+            n.result = NONE;
+        }
+    }
+
+    void hash_life::populate(double density)
+    {
+        clear();
+        // the window as a packed board, so the cells are those of the other engines
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        std::vector<uint64_t> cells(per_row * static_cast<std::size_t>(height));
+        rng.fill_rows(rng.next_fill(), util::fixed_density(density), width, 0, height, cells.data());
+        set_rows(0, height, width, cells.data());
+    }
+
+    void hash_life::clear()
+    {
+        root = empty(3);
+        generation_ = 0;
+    }
+
+    void hash_life::irritate(int const x, int const y)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                set(x + dx, y + dy, (rng() & 1) != 0);
+            }
+        }
+    }
+
+    void hash_life::iterate()
+    {
+        if (node_count() > max_nodes)
+        {
+            collect_garbage();
+        }
+        // grow until the pattern cannot leave the result square within 2^step generations
+        while (nodes[root].level < step_log2 + 3 || !confined(root))
+        {
+            root = expand(root);
+        }
+        root = successor(expand(root));
+        generation_ += uint64_t{1} << step_log2;
+    }
+
+    /**
+     * Frees every node not reachable from the universe. Memoized results
+     * pointing at freed nodes are forgotten; the others are kept.
+     */
+    void hash_life::collect_garbage()
+    {
+        std::vector<uint8_t> marked(nodes.size(), 0);
+        std::vector<node_id> stack(empties.begin(), empties.end());
+        stack.push_back(root);
+        marked[DEAD_CELL] = marked[ALIVE_CELL] = 1;
+        while (!stack.empty())
+        {
+            node_id const id = stack.back();
+            stack.pop_back();
+            if (marked[id])
+            {
+                continue;
+            }
+            marked[id] = 1;
+            node const &c = nodes[id];
+            stack.push_back(c.nw);
+            stack.push_back(c.ne);
+            stack.push_back(c.sw);
+            stack.push_back(c.se);
+        }
+        free_ids.clear();
+        std::fill(squares.begin(), squares.end(), NONE);
+        std::fill(table.begin(), table.end(), NONE);
+        table_used = 0;
+        std::size_t const mask = table.size() - 1;
+        for (node_id id = ALIVE_CELL + 1; id < nodes.size(); ++id)
+        {
+            node &c = nodes[id];
+            if (!marked[id])
+            {
+                c.result = NONE;
+                free_ids.push_back(id);
+                continue;
+            }
+            if (c.result != NONE && !marked[c.result])
+            {
+                c.result = NONE;
+            }
+            std::size_t slot = node_hash(c.nw, c.ne, c.sw, c.se) & mask;
+            while (table[slot] != NONE)
+            {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = id;
+            ++table_used;
+        }
+        // reuse low slots first so the arena stays compact
+        std::reverse(free_ids.begin(), free_ids.end());
+    }
+
+}
@@ -0,0 +1,135 @@
+#ifndef __HASH_LIFE_HPP__
+#define __HASH_LIFE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "counter-rng.hpp"
+#include "game.hpp"
+#include "rule.hpp"
+#include "util.hpp"
+
+namespace games
+{
+    /**
+     * Game of Life, or any other Life-like rule without B0, on an unbounded
+     * plane using Gosper's HashLife.
+     *
+     * The universe is a quadtree whose nodes are hash-consed, so every
+     * distinct square of cells exists exactly once, and each node memoizes
+     * its own future. One call to iterate() advances 2^step generations,
+     * which for regular patterns costs about as much as a single one.
+     *
+     * Nodes live in an arena with a soft upper bound. When the bound is
+     * exceeded between two steps, all nodes not reachable from the current
+     * universe are collected and their slots reused.
+     *
+     * populate() fills the window [0, width) x [0, height).
+     */
+    class hash_life final : public game
+    {
+    public:
+        static constexpr std::size_t DEFAULT_MAX_NODES = std::size_t{1} << 21;
+
+        hash_life() = delete;
+        hash_life(int width, int height, std::size_t max_nodes = DEFAULT_MAX_NODES);
+
+        void populate(double density) override;
+        void clear() override;
+        void irritate(int x, int y) override;
+        void iterate() override;
+        void seed(unsigned long s) override;
+        void set_span(int x, int y, int length, bool alive) override;
+        void get_rows(int y, int count, int width, uint64_t *words) const override;
+        /// Builds the tree of the rows bottom-up and puts it in place, instead of a descent per run of cells.
+        void set_rows(int y, int count, int width, uint64_t const *words) override;
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override;
+        inline bool get(int x, int y) const override
+        {
+            return get(int64_t{x}, int64_t{y});
+        }
+
+        void set(int64_t x, int64_t y, bool alive);
+        bool get(int64_t x, int64_t y) const;
+
+        /// Calls `f(x, y)` for every live cell inside [x0, x0 + w) x [y0, y0 + h).
+        void for_each_alive(int64_t x0, int64_t y0, int64_t w, int64_t h,
+                            std::function<void(int64_t, int64_t)> const &f) const;
+
+        /// Generations per iterate() are 2^`log2`. Changing it drops the memoized results.
+        void set_step(unsigned int log2);
+        /// Rules with B0 would fill the infinite plane and are not supported. Changing it drops the memoized results.
+        void set_rule(rules::rule const &r);
+        inline rules::rule const &rule() const
+        {
+            return rule_;
+        }
+        inline unsigned int step() const
+        {
+            return step_log2;
+        }
+        inline uint64_t generation() const
+        {
+            return generation_;
+        }
+        uint64_t population() const override;
+        inline std::size_t node_count() const
+        {
+            return nodes.size() - free_ids.size();
+        }
+        inline std::size_t max_node_count() const
+        {
+            return max_nodes;
+        }
+
+    private:
+        using node_id = uint32_t;
+
+        struct node
+        {
+            node_id nw, ne, sw, se;
+            node_id result;
+            uint32_t level;
+            uint64_t population;
+        };
+
+        static constexpr node_id NONE = 0;
+        static constexpr node_id DEAD_CELL = 1;
+        static constexpr node_id ALIVE_CELL = 2;
+
+        node_id join(node_id nw, node_id ne, node_id sw, node_id se);
+        node_id empty(uint32_t level);
+        node_id expand(node_id n);
+        node_id center(node_id n);
+        node_id successor(node_id n);
+        node_id base_successor(node_id n);
+        node_id with_cell(node_id n, int64_t x, int64_t y, bool alive);
+        node_id with_span(node_id n, int64_t x0, int64_t x1, int64_t y, bool alive);
+        node_id square(unsigned int cells);
+        bool confined(node_id n) const;
+        void grow_table();
+        void forget_results();
+        void collect_garbage();
+
+        const int width;
+        const int height;
+        std::size_t max_nodes;
+        std::vector<node> nodes;
+        std::vector<node_id> free_ids;
+        std::vector<node_id> table;
+        std::size_t table_used{0};
+        std::vector<node_id> empties;
+        // level 2 nodes by their 16 cells, row by row from bit 0, NONE if not made yet; forgotten when nodes are freed
+        std::vector<node_id> squares;
+        node_id root{NONE};
+        unsigned int step_log2{0};
+        rules::rule rule_{rules::CONWAY};
+        uint64_t generation_{0};
+        util::counter_rng rng;
+    };
+}
+
+#endif // __HASH_LIFE_HPP__
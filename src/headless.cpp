@@ -0,0 +1,588 @@
+// Runs a simulation without any windowing code, for batch jobs and
+// benchmarks, and reports how long it took.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "census.hpp"
+#include "cycle-detector.hpp"
+#include "engines.hpp"
+#include "history.hpp"
+#include "pattern-io.hpp"
+#include "kernels/life.hpp"
+#include "recorder.hpp"
+#include "rule.hpp"
+#include "snapshot.hpp"
+#include "util.hpp"
+
+namespace
+{
+    void usage(char const *argv0)
+    {
+        std::cerr << "Usage: " << argv0
+                  << " --generations N [--width W] [--height H] [--engine classic|packed|sparse|hashlife|generations|ltl]"
+                     " [--threads N] [--workers N] [--step K] [--kernel NAME] [--rule B3/S23] [--seed S [--density P] | --pattern NAME|FILE | --restore SNAPSHOT]"
+                     " [--output FILE] [--checkpoint FILE [--checkpoint-every N] [--compress]] [--history MB [--keyframe-every N] [--rewind N]]"
+                     " [--detect-cycles [--max-period P] [--stop-on-cycle]] [--census]"
+                     " [--record FILE.y4m|FILE.png|FILE.gif [--record-every N] [--record-fps F] [--record-policy block|drop]]"
+                  << std::endl
+                  << "Patterns: beacon, two-gun, gosper-gun, schick256, cordership, or an RLE, Life 1.06 or .cells file" << std::endl;
+    }
+
+    // Width and height of a pattern in the format game::emplace() takes.
+    std::pair<int, int> pattern_size(std::string const &pattern)
+    {
+        int w = 0;
+        int h = 1;
+        int x = 0;
+        for (char c : pattern)
+        {
+            if (c == '\n')
+            {
+                x = 0;
+                ++h;
+            }
+            else
+            {
+                w = std::max(w, ++x);
+            }
+        }
+        return {w, h};
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    games::settings settings;
+    bool rule_given = false;
+    bool seed_given = false;
+    int width = 1024;
+    int height = 1024;
+    uint64_t generations = 0;
+    std::string pattern_name;
+    std::string output;
+    std::string restore;
+    std::string checkpoint;
+    uint64_t checkpoint_every = 0;
+    bool compress = false;
+    double history_mb = 0;
+    unsigned int keyframe_every = games::history::DEFAULT_KEYFRAME_INTERVAL;
+    uint64_t rewind = 0;
+    bool detect_cycles = false;
+    std::size_t max_period = games::cycle_detector::DEFAULT_MAX_PERIOD;
+    bool stop_on_cycle = false;
+    bool take_census = false;
+    recording::options record;
+    // a batch job wants every frame, however long the disk takes
+    record.when_full = recording::policy::BLOCK;
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((std::strcmp(argv[i], "--width") == 0 || std::strcmp(argv[i], "-w") == 0) && i + 1 < argc)
+        {
+            width = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--height") == 0 || std::strcmp(argv[i], "-h") == 0) && i + 1 < argc)
+        {
+            height = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--generations") == 0 || std::strcmp(argv[i], "-g") == 0) && i + 1 < argc)
+        {
+            generations = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((std::strcmp(argv[i], "--engine") == 0 || std::strcmp(argv[i], "-e") == 0) && i + 1 < argc)
+        {
+            settings.engine = argv[++i];
+        }
+        else if ((std::strcmp(argv[i], "--threads") == 0 || std::strcmp(argv[i], "-t") == 0) && i + 1 < argc)
+        {
+            settings.threads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            settings.workers = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc)
+        {
+            settings.step = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if ((std::strcmp(argv[i], "--rule") == 0 || std::strcmp(argv[i], "-r") == 0) && i + 1 < argc)
+        {
+            // a Life-like or Generations rule, or else a Larger-than-Life one
+            if (!rules::from_name(argv[++i], settings.rule) && !rules::from_name(argv[i], settings.ltl))
+            {
+                std::cerr << "\u001b[31;1mInvalid rule:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            rule_given = true;
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            settings.seed = std::strtoul(argv[++i], nullptr, 10);
+            seed_given = true;
+        }
+        else if (std::strcmp(argv[i], "--density") == 0 && i + 1 < argc)
+        {
+            settings.density = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--pattern") == 0 && i + 1 < argc)
+        {
+            pattern_name = argv[++i];
+        }
+        else if ((std::strcmp(argv[i], "--output") == 0 || std::strcmp(argv[i], "-o") == 0) && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--restore") == 0 && i + 1 < argc)
+        {
+            restore = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+        {
+            checkpoint = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc)
+        {
+            checkpoint_every = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--compress") == 0)
+        {
+            compress = true;
+        }
+        else if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+        {
+            history_mb = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--keyframe-every") == 0 && i + 1 < argc)
+        {
+            keyframe_every = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--rewind") == 0 && i + 1 < argc)
+        {
+            rewind = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--detect-cycles") == 0)
+        {
+            detect_cycles = true;
+        }
+        else if (std::strcmp(argv[i], "--max-period") == 0 && i + 1 < argc)
+        {
+            max_period = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--stop-on-cycle") == 0)
+        {
+            stop_on_cycle = true;
+        }
+        else if (std::strcmp(argv[i], "--census") == 0)
+        {
+            take_census = true;
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            record.path = argv[++i];
+            if (!recording::format_of(record.path, record.fmt))
+            {
+                std::cerr << "\u001b[31;1mUnknown recording format:\u001b[0m " << record.path << " is not .y4m, .png or .gif" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--record-every") == 0 && i + 1 < argc)
+        {
+            record.every = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--record-fps") == 0 && i + 1 < argc)
+        {
+            record.fps = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--record-policy") == 0 && i + 1 < argc)
+        {
+            if (!recording::from_name(argv[++i], record.when_full))
+            {
+                std::cerr << "\u001b[31;1mUnknown recording policy:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            if (!kernels::select(argv[++i]))
+            {
+                std::cerr << "\u001b[31;1mKernel not supported on this CPU:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (width <= 0 || height <= 0 || generations == 0 || (!restore.empty() && !pattern_name.empty()) ||
+        history_mb < 0 || (rewind > 0 && history_mb == 0) || max_period == 0 || (stop_on_cycle && !detect_cycles) ||
+        record.every == 0 || record.fps <= 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    settings.history = static_cast<std::size_t>(history_mb * 1024 * 1024);
+    settings.snapshots = !checkpoint.empty() || !restore.empty();
+
+    // a seed of our own is still printed, so that the run can be repeated
+    if (settings.seed == 0)
+    {
+        settings.seed = util::make_seed();
+    }
+
+    // a snapshot brings its own size, rule, seed and generation
+    snapshots::reader snapshot;
+    uint64_t start = 0;
+    if (!restore.empty())
+    {
+        if (!snapshot.open(restore))
+        {
+            std::cerr << "\u001b[31;1mError reading snapshot:\u001b[0m " << snapshot.error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        snapshots::info const &header = snapshot.header();
+        width = header.width;
+        height = header.height;
+        start = header.generation;
+        if (!rule_given)
+        {
+            settings.rule = header.rule;
+            settings.ltl = header.ltl;
+        }
+        if (!seed_given)
+        {
+            settings.seed = header.seed;
+        }
+    }
+
+    // a pattern file is opened first as it may name the rule
+    std::string const *builtin = pattern_name.empty() ? nullptr : games::find_pattern(pattern_name);
+    std::ifstream pattern_file;
+    std::unique_ptr<patterns::reader> pattern;
+    if (!pattern_name.empty() && builtin == nullptr)
+    {
+        pattern_file.open(pattern_name, std::ios::binary);
+        if (!pattern_file)
+        {
+            std::cerr << "\u001b[31;1mUnknown pattern:\u001b[0m " << pattern_name << std::endl;
+            return EXIT_FAILURE;
+        }
+        pattern = std::make_unique<patterns::reader>(pattern_file);
+        if (!pattern->read_header())
+        {
+            std::cerr << "\u001b[31;1mError reading pattern:\u001b[0m " << pattern->error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (pattern->header().has_rule && !rule_given)
+        {
+            settings.rule = pattern->header().rule;
+        }
+    }
+
+    std::unique_ptr<game> g = games::make_game(settings, width, height);
+    if (!g)
+    {
+        // make_game() reports its own errors starting worker processes
+        std::string const problem = games::check(settings);
+        if (!problem.empty())
+        {
+            std::cerr << "\u001b[31;1mInvalid settings:\u001b[0m " << problem << std::endl;
+        }
+        return EXIT_FAILURE;
+    }
+    if (builtin != nullptr)
+    {
+        auto const [w, h] = pattern_size(*builtin);
+        g->emplace((width - w) / 2, (height - h) / 2, *builtin);
+    }
+    else if (pattern)
+    {
+        // RLE is centered by its size and Life 1.06 around its origin. Plaintext
+        // tells no size and goes to the top left, so --output files load back in place.
+        patterns::info const &header = pattern->header();
+        bool const corner = header.fmt == patterns::format::plaintext;
+        int const x = corner ? 0 : width / 2 - static_cast<int>(header.width / 2);
+        int const y = corner ? 0 : height / 2 - static_cast<int>(header.height / 2);
+        auto const t0 = std::chrono::steady_clock::now();
+        bool ok = false;
+        if (header.fmt == patterns::format::life106)
+        {
+            // cells in any order would write the same bands over and over
+            ok = pattern->read_cells([&](int64_t sx, int64_t sy, int64_t length)
+                                     { g->set_span(x + static_cast<int>(sx), y + static_cast<int>(sy), static_cast<int>(length), true); });
+        }
+        else
+        {
+            patterns::band_writer cells(*g, width, height);
+            ok = pattern->read_cells([&](int64_t sx, int64_t sy, int64_t length)
+                                     { cells(x + sx, y + sy, length); });
+            cells.flush();
+        }
+        if (!ok)
+        {
+            std::cerr << "\u001b[31;1mError reading pattern:\u001b[0m " << pattern->error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "loaded:      " << pattern_name << " in " << std::fixed << std::setprecision(3)
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() << " s" << std::endl;
+    }
+    else if (!restore.empty())
+    {
+        auto const t0 = std::chrono::steady_clock::now();
+        if (!snapshot.restore(*g))
+        {
+            std::cerr << "\u001b[31;1mError reading snapshot:\u001b[0m " << snapshot.error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "restored:    " << restore << " at generation " << start << " in " << std::fixed << std::setprecision(3)
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() << " s" << std::endl;
+    }
+    else
+    {
+        g->populate(settings.density);
+    }
+
+    snapshots::info checkpoint_info;
+    checkpoint_info.width = width;
+    checkpoint_info.height = height;
+    checkpoint_info.rule = settings.rule;
+    checkpoint_info.ltl = settings.ltl;
+    checkpoint_info.seed = settings.seed;
+    checkpoint_info.compressed = compress;
+    uint64_t checkpoints = 0;
+    double checkpoint_seconds = 0;
+    auto const save_checkpoint = [&](uint64_t generation)
+    {
+        auto const t0 = std::chrono::steady_clock::now();
+        checkpoint_info.generation = generation;
+        std::string error;
+        if (!snapshots::save(checkpoint, *g, checkpoint_info, error))
+        {
+            std::cerr << "\u001b[31;1mError writing snapshot:\u001b[0m " << error << std::endl;
+            return false;
+        }
+        ++checkpoints;
+        checkpoint_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    };
+
+    // recording is part of the measured time, so its cost shows in gens/s
+    std::unique_ptr<games::history> past;
+    if (settings.history > 0)
+    {
+        past = std::make_unique<games::history>(width, height, settings.history, keyframe_every);
+        past->record(*g, start);
+    }
+
+    // hashing is part of the measured time as well; engines without a hash
+    // report 0 and are not checked
+    games::cycle_detector cycles(max_period);
+    bool const hashed = detect_cycles && g->hash() != 0;
+    if (hashed)
+    {
+        cycles.add(g->hash(), start);
+    }
+
+    // capturing a frame is part of the measured time, encoding and writing it are not unless the policy blocks
+    std::unique_ptr<recording::recorder> recorder;
+    if (!record.path.empty())
+    {
+        recorder = std::make_unique<recording::recorder>(record, width, height);
+        if (!recorder->error().empty())
+        {
+            std::cerr << "\u001b[31;1mError recording:\u001b[0m " << recorder->error() << std::endl;
+            return EXIT_FAILURE;
+        }
+        recorder->record(*g);
+    }
+
+    uint64_t const per_iteration = games::generations_per_iteration(settings);
+    uint64_t iterations = (generations + per_iteration - 1) / per_iteration;
+    // cells the engine says it computed, 0 if it does not tell
+    uint64_t updated = 0;
+    auto const t0 = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; ++i)
+    {
+        g->iterate();
+        if (std::string const failure = g->failure(); !failure.empty())
+        {
+            std::cerr << "\u001b[31;1mThe engine stopped:\u001b[0m " << failure << std::endl;
+            return EXIT_FAILURE;
+        }
+        updated += g->cells_updated();
+        uint64_t const generation = start + (i + 1) * per_iteration;
+        if (past)
+        {
+            past->record(*g, generation);
+        }
+        if (recorder && (i + 1) % record.every == 0)
+        {
+            recorder->record(*g);
+        }
+        if (hashed && !cycles.found() && cycles.add(g->hash(), generation) && stop_on_cycle)
+        {
+            iterations = i + 1;
+        }
+        if (!checkpoint.empty() && checkpoint_every > 0 && generation / checkpoint_every != (generation - per_iteration) / checkpoint_every &&
+            !save_checkpoint(generation))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    auto const t1 = std::chrono::steady_clock::now();
+    if (recorder)
+    {
+        recorder->finish();
+        if (!recorder->error().empty())
+        {
+            std::cerr << "\u001b[31;1mError recording:\u001b[0m " << recorder->error() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    // time spent writing checkpoints is reported on its own
+    double const seconds = std::chrono::duration<double>(t1 - t0).count() - checkpoint_seconds;
+    uint64_t const done = iterations * per_iteration;
+    if (!checkpoint.empty() && checkpoint_every == 0 && !save_checkpoint(start + done))
+    {
+        return EXIT_FAILURE;
+    }
+    double const cells = updated > 0 ? static_cast<double>(updated) : static_cast<double>(width) * static_cast<double>(height) * static_cast<double>(done);
+
+    // the board, the output and the population below are those of generation `shown`
+    uint64_t shown = start + done;
+    std::string recorded;
+    if (past)
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(1) << static_cast<double>(past->size()) / (1024 * 1024) << " of "
+           << static_cast<double>(past->budget()) / (1024 * 1024) << " MB";
+        if (!past->empty())
+        {
+            ss << ", generations " << past->oldest() << " to " << past->newest();
+        }
+        recorded = ss.str();
+    }
+    double rewind_seconds = 0;
+    if (rewind > 0)
+    {
+        auto const t2 = std::chrono::steady_clock::now();
+        uint64_t const target = rewind > shown ? 0 : shown - rewind;
+        if (!past->seek(*g, target))
+        {
+            std::cerr << "\u001b[31;1mCannot rewind:\u001b[0m generation " << target << " is not in the history";
+            if (!past->empty())
+            {
+                std::cerr << ", it holds " << past->oldest() << " to " << past->newest();
+            }
+            std::cerr << std::endl;
+            return EXIT_FAILURE;
+        }
+        rewind_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t2).count();
+        shown = target;
+    }
+
+    std::ofstream out;
+    if (!output.empty())
+    {
+        out.open(output);
+    }
+    if (!output.empty() && !patterns::write_cells(out, *g, width, height, "generation " + std::to_string(shown)))
+    {
+        std::cerr << "\u001b[31;1mError writing:\u001b[0m " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "engine:      " << settings.engine;
+    if (settings.engine == "packed")
+    {
+        std::cout << " (" << kernels::active().name << ")";
+    }
+    if (settings.workers > 0)
+    {
+        std::cout << " (" << settings.workers << (settings.workers == 1 ? " worker process)" : " worker processes)");
+    }
+    std::cout << std::endl
+              << "seed:        " << settings.seed << std::endl
+              << "rule:        " << (settings.engine == "ltl" ? rules::to_string(settings.ltl) : rules::to_string(settings.rule)) << std::endl
+              << "size:        " << width << "x" << height << std::endl
+              << "generations: " << done << std::endl
+              << std::fixed << std::setprecision(3)
+              << "seconds:     " << seconds << std::endl
+              << std::setprecision(1)
+              << "gens/s:      " << static_cast<double>(done) / seconds << std::endl
+              << std::scientific << std::setprecision(3)
+              << "cells/s:     " << cells / seconds << std::endl
+              << "population:  " << g->population() << std::endl;
+    if (checkpoints > 0)
+    {
+        std::cout << std::fixed << std::setprecision(3)
+                  << "checkpoints: " << checkpoints << " in " << checkpoint_seconds << " s" << std::endl;
+    }
+    if (past)
+    {
+        std::cout << "history:     " << recorded << std::endl;
+    }
+    if (recorder)
+    {
+        std::cout << "recorded:    " << recorder->written() << " frames to " << record.path;
+        if (recorder->dropped() > 0)
+        {
+            std::cout << ", " << recorder->dropped() << " dropped";
+        }
+        std::cout << std::endl;
+    }
+    if (rewind > 0)
+    {
+        std::cout << std::fixed << std::setprecision(3)
+                  << "rewound:     to generation " << shown << " in " << rewind_seconds << " s" << std::endl;
+    }
+    if (detect_cycles)
+    {
+        std::cout << "cycle:       ";
+        if (!hashed)
+        {
+            std::cout << "not supported by " << settings.engine;
+        }
+        else if (cycles.found())
+        {
+            // with --step K only every K-th generation is seen, so the true
+            // period may be a divisor of the one found
+            std::cout << "period " << cycles.period() << " from generation " << cycles.start();
+        }
+        else
+        {
+            std::cout << "none up to period " << max_period * per_iteration;
+        }
+        std::cout << std::endl;
+    }
+    if (take_census)
+    {
+        // of the board that is shown, which wraps around like the packed engine's
+        auto const t3 = std::chrono::steady_clock::now();
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        std::vector<uint64_t> rows(per_row * static_cast<std::size_t>(height));
+        g->get_rows(0, height, width, rows.data());
+        games::census objects(settings.rule, max_period);
+        objects.add(rows.data(), per_row, width, height);
+        double const census_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t3).count();
+        std::cout << std::fixed << std::setprecision(3)
+                  << "census:      " << objects.total() << " objects in " << census_seconds << " s" << std::endl;
+        for (games::census::object const &o : objects.objects())
+        {
+            std::cout << std::setw(12) << o.count << " " << o.code << (o.name.empty() ? "" : " (" + o.name + ")") << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,434 @@
+#include "history.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace games
+{
+    namespace
+    {
+        // blocks are BLOCK_ROWS x BLOCK_WORDS words, one bit of a block mask per word
+        constexpr std::size_t BLOCK_ROWS = 8;
+        constexpr std::size_t BLOCK_WORDS = 8;
+        // rows are read from the game in bands of this many, the rows of a packed engine tile
+        constexpr int BAND_ROWS = 32;
+        constexpr std::size_t BAND_BLOCK_ROWS = BAND_ROWS / BLOCK_ROWS;
+
+        /**
+         * Writes the nonzero words of the `rows` x `columns` words from a[0],
+         * rows `stride` words apart, to `out` and returns which of them were
+         * nonzero. Every word is stored and only the nonzero ones kept, so
+         * `out` needs a word to spare.
+         */
+        inline uint64_t encode_block(uint64_t const *a, std::size_t stride, std::size_t rows, std::size_t columns, uint64_t *&out)
+        {
+            uint64_t mask = 0;
+            for (std::size_t r = 0; r < rows; ++r)
+            {
+                uint64_t const *const row = a + r * stride;
+                for (std::size_t c = 0; c < columns; ++c)
+                {
+                    uint64_t const w = row[c];
+                    uint64_t const nonzero = w != 0;
+                    *out = w;
+                    out += nonzero;
+                    mask |= nonzero << (r * BLOCK_WORDS + c);
+                }
+            }
+            return mask;
+        }
+
+        /**
+         * Like encode_block() for the XOR of `now` and `before`, which then
+         * becomes `now`.
+         */
+        inline uint64_t encode_block_delta(uint64_t const *now, uint64_t *before, std::size_t stride, std::size_t rows, std::size_t columns,
+                                           uint64_t *&out)
+        {
+            uint64_t mask = 0;
+            for (std::size_t r = 0; r < rows; ++r)
+            {
+                uint64_t const *const a = now + r * stride;
+                uint64_t *const b = before + r * stride;
+                for (std::size_t c = 0; c < columns; ++c)
+                {
+                    uint64_t const w = a[c] ^ b[c];
+                    uint64_t const nonzero = w != 0;
+                    b[c] = a[c];
+                    *out = w;
+                    out += nonzero;
+                    mask |= nonzero << (r * BLOCK_WORDS + c);
+                }
+            }
+            return mask;
+        }
+
+        inline std::size_t ceil_div(std::size_t a, std::size_t b)
+        {
+            return (a + b - 1) / b;
+        }
+    }
+
+    history::history(int width, int height, std::size_t budget, unsigned int keyframe_interval)
+        : width(width), height(height)
+        , words_per_row(ceil_div(static_cast<std::size_t>(width), 64))
+        , words(words_per_row * static_cast<std::size_t>(height))
+        , bands(ceil_div(static_cast<std::size_t>(height), BAND_ROWS))
+        , block_columns(ceil_div(words_per_row, BLOCK_WORDS))
+        , band_blocks(BAND_BLOCK_ROWS * block_columns)
+        , blocks(bands * band_blocks)
+        , top_words(ceil_div(blocks, 64))
+        , max_record(words + blocks + top_words)
+        , keyframe_interval(std::max(keyframe_interval, 1u))
+        , ring(budget / sizeof(uint64_t))
+        , previous(words, 0)
+        , band(static_cast<std::size_t>(BAND_ROWS) * words_per_row, 0)
+        , block_masks(blocks, 0)
+        , versions(bands * block_columns, 0)
+        , stale(block_columns, 0)
+        , scratch(max_record + 1)
+    {
+    }
+
+    void history::record(game const &g, uint64_t generation)
+    {
+        bool const delta = !entries.empty();
+        std::size_t const size = encode(g, delta);
+        if (delta && !append(generation, false, size))
+        {
+            // the newest group alone fills the budget and cannot be dropped while its deltas are in use
+            clear();
+        }
+        // a group of sqrt(budget * keyframe) words keeps the most deltas when the oldest group is dropped
+        std::size_t const group_limit = static_cast<std::size_t>(std::sqrt(static_cast<double>(ring.size()) * static_cast<double>(keyframe_size)));
+        if (entries.empty() || generation - last_keyframe >= keyframe_interval || newest_group >= group_limit)
+        {
+            if (!append(generation, true, encode_keyframe()))
+            {
+                // not even one board fits into the budget
+                clear();
+            }
+        }
+    }
+
+    /**
+     * Copies the board of `g` to `previous` band by band and, for a delta,
+     * encodes what changed into `scratch` on the way; the bands and
+     * columns of blocks the game says are unchanged are skipped. Returns
+     * the size of the delta.
+     */
+    std::size_t history::encode(game const &g, bool delta)
+    {
+        uint64_t *out = scratch.data();
+        for (std::size_t b = 0; b < bands; ++b)
+        {
+            int const y = static_cast<int>(b) * BAND_ROWS;
+            int const rows = std::min(BAND_ROWS, height - y);
+            uint64_t *const masks = block_masks.data() + b * band_blocks;
+            bool any = false;
+            for (std::size_t bx = 0; bx < block_columns; ++bx)
+            {
+                int const x = static_cast<int>(bx * BLOCK_WORDS * 64);
+                uint64_t &version = versions[b * block_columns + bx];
+                uint64_t const now = g.area_version(x, y, std::min(static_cast<int>(BLOCK_WORDS * 64), width - x), rows);
+                stale[bx] = !delta || now == 0 || now != version ? 1 : 0;
+                any |= stale[bx] != 0;
+                version = now;
+            }
+            std::fill_n(masks, band_blocks, 0);
+            if (!any)
+            {
+                continue;
+            }
+            uint64_t *const old = previous.data() + static_cast<std::size_t>(y) * words_per_row;
+            g.get_rows(y, rows, width, band.data());
+            if (!delta)
+            {
+                std::memcpy(old, band.data(), static_cast<std::size_t>(rows) * words_per_row * sizeof(uint64_t));
+                continue;
+            }
+            for (std::size_t by = 0; by * BLOCK_ROWS < static_cast<std::size_t>(rows); ++by)
+            {
+                std::size_t const n = std::min(BLOCK_ROWS, static_cast<std::size_t>(rows) - by * BLOCK_ROWS);
+                for (std::size_t bx = 0; bx < block_columns; ++bx)
+                {
+                    if (stale[bx] != 0)
+                    {
+                        std::size_t const i = by * BLOCK_ROWS * words_per_row + bx * BLOCK_WORDS;
+                        masks[by * block_columns + bx] = encode_block_delta(band.data() + i, old + i, words_per_row, n,
+                                                                            std::min(BLOCK_WORDS, words_per_row - bx * BLOCK_WORDS), out);
+                    }
+                }
+            }
+        }
+        return delta ? finish(out) : 0;
+    }
+
+    // Encodes all of `previous` into `scratch` and returns the size.
+    std::size_t history::encode_keyframe()
+    {
+        uint64_t *out = scratch.data();
+        for (std::size_t b = 0; b < bands; ++b)
+        {
+            std::size_t const rows = std::min(static_cast<std::size_t>(BAND_ROWS), static_cast<std::size_t>(height) - b * BAND_ROWS);
+            uint64_t const *const plane = previous.data() + b * BAND_ROWS * words_per_row;
+            uint64_t *const masks = block_masks.data() + b * band_blocks;
+            std::fill_n(masks, band_blocks, 0);
+            for (std::size_t by = 0; by * BLOCK_ROWS < rows; ++by)
+            {
+                for (std::size_t bx = 0; bx < block_columns; ++bx)
+                {
+                    std::size_t const i = by * BLOCK_ROWS * words_per_row + bx * BLOCK_WORDS;
+                    masks[by * block_columns + bx] = encode_block(plane + i, words_per_row, std::min(BLOCK_ROWS, rows - by * BLOCK_ROWS),
+                                                                                std::min(BLOCK_WORDS, words_per_row - bx * BLOCK_WORDS), out);
+                }
+            }
+        }
+        return finish(out);
+    }
+
+    // Appends the block masks to the words encoded in `scratch` up to `out` and returns the size of the record.
+    std::size_t history::finish(uint64_t *out)
+    {
+        for (std::size_t k = 0; k < blocks; ++k)
+        {
+            *out = block_masks[k];
+            out += block_masks[k] != 0 ? 1 : 0;
+        }
+        for (std::size_t t = 0; t < top_words; ++t)
+        {
+            uint64_t top = 0;
+            for (std::size_t k = t * 64; k < std::min(blocks, t * 64 + 64); ++k)
+            {
+                top |= uint64_t{block_masks[k] != 0} << (k % 64);
+            }
+            *out++ = top;
+        }
+        return static_cast<std::size_t>(out - scratch.data());
+    }
+
+    // Copies the record in `scratch` into the ring; false if there is no room without dropping what it needs.
+    bool history::append(uint64_t generation, bool keyframe, std::size_t size)
+    {
+        if (size > ring.size())
+        {
+            return false;
+        }
+        std::size_t const offset = make_room(size, keyframe);
+        if (offset == SIZE_MAX)
+        {
+            return false;
+        }
+        std::memcpy(ring.data() + offset, scratch.data(), size * sizeof(uint64_t));
+        entries.push_back(entry{generation, offset, size, keyframe});
+        used += size;
+        if (keyframe)
+        {
+            ++groups;
+            keyframe_size = size;
+            newest_group = size;
+            last_keyframe = generation;
+        }
+        else
+        {
+            newest_group += size;
+        }
+        return true;
+    }
+
+    /**
+     * Evicts the oldest groups until `size` words fit after the newest
+     * record, and returns where, or SIZE_MAX if that would take the newest
+     * group, which a delta still needs and a keyframe does not.
+     */
+    std::size_t history::make_room(std::size_t size, bool keyframe)
+    {
+        while (!entries.empty())
+        {
+            std::size_t const tail = entries.front().offset;
+            std::size_t const head = entries.back().offset + entries.back().size;
+            // records have at least one word, so the newest starts before the oldest only after wrapping
+            bool const wrapped = entries.back().offset < tail;
+            if (!wrapped && head + size <= ring.size())
+            {
+                return head;
+            }
+            if (!wrapped && size <= tail)
+            {
+                return 0;
+            }
+            if (wrapped && head + size <= tail)
+            {
+                return head;
+            }
+            if (groups <= 1 && !keyframe)
+            {
+                return SIZE_MAX;
+            }
+            evict();
+        }
+        return 0;
+    }
+
+    void history::evict()
+    {
+        // a keyframe goes together with the deltas that lead away from it
+        do
+        {
+            used -= entries.front().size;
+            entries.pop_front();
+        } while (!entries.empty() && !entries.front().keyframe);
+        --groups;
+    }
+
+    // XORs the words of `e` into `plane`.
+    void history::decode(entry const &e, uint64_t *plane) const
+    {
+        uint64_t const *literal = ring.data() + e.offset;
+        uint64_t const *const top = literal + e.size - top_words;
+        std::size_t nonzero_blocks = 0;
+        for (std::size_t t = 0; t < top_words; ++t)
+        {
+            nonzero_blocks += static_cast<std::size_t>(std::popcount(top[t]));
+        }
+        uint64_t const *mask = top - nonzero_blocks;
+        for (std::size_t t = 0; t < top_words; ++t)
+        {
+            for (uint64_t bits = top[t]; bits != 0; bits &= bits - 1)
+            {
+                std::size_t const k = t * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+                std::size_t const row = k / band_blocks * BAND_ROWS + k % band_blocks / block_columns * BLOCK_ROWS;
+                uint64_t *const block = plane + row * words_per_row + k % block_columns * BLOCK_WORDS;
+                for (uint64_t m = *mask++; m != 0; m &= m - 1)
+                {
+                    std::size_t const i = static_cast<std::size_t>(std::countr_zero(m));
+                    block[i / BLOCK_WORDS * words_per_row + i % BLOCK_WORDS] ^= *literal++;
+                }
+            }
+        }
+    }
+
+    // Index of the entry of `generation`, or of the first one after it.
+    std::size_t history::find(uint64_t generation, bool keyframe) const
+    {
+        auto const it = std::lower_bound(entries.begin(), entries.end(), std::make_pair(generation, keyframe),
+                                         [](entry const &e, std::pair<uint64_t, bool> const &key)
+                                         {
+                                             return e.generation < key.first || (e.generation == key.first && e.keyframe < key.second);
+                                         });
+        return static_cast<std::size_t>(it - entries.begin());
+    }
+
+    bool history::seek(game &g, uint64_t generation)
+    {
+        if (entries.empty() || generation < oldest() || generation > newest())
+        {
+            return false;
+        }
+        std::size_t const target = find(generation, false);
+        if (entries[target].generation != generation)
+        {
+            return false;
+        }
+        // the nearest keyframes on either side, if any
+        std::size_t before = target;
+        while (!entries[before].keyframe)
+        {
+            --before;
+        }
+        std::size_t after = target;
+        while (after < entries.size() && !entries[after].keyframe)
+        {
+            ++after;
+        }
+        if (after < entries.size() && entries[after].generation == generation)
+        {
+            before = after;
+        }
+
+        uint64_t const from_current = newest() - generation;
+        uint64_t const from_before = generation - entries[before].generation;
+        uint64_t const from_after = after < entries.size() ? entries[after].generation - generation : UINT64_MAX;
+        if (from_current <= from_before && from_current <= from_after)
+        {
+            for (std::size_t i = entries.size(); i-- > 0 && entries[i].generation > generation;)
+            {
+                if (!entries[i].keyframe)
+                {
+                    decode(entries[i], previous.data());
+                }
+            }
+        }
+        else if (from_before <= from_after)
+        {
+            std::fill(previous.begin(), previous.end(), 0);
+            decode(entries[before], previous.data());
+            for (std::size_t i = before + 1; i < entries.size() && entries[i].generation <= generation; ++i)
+            {
+                if (!entries[i].keyframe)
+                {
+                    decode(entries[i], previous.data());
+                }
+            }
+        }
+        else
+        {
+            std::fill(previous.begin(), previous.end(), 0);
+            decode(entries[after], previous.data());
+            for (std::size_t i = after; i-- > 0 && entries[i].generation > generation;)
+            {
+                if (!entries[i].keyframe)
+                {
+                    decode(entries[i], previous.data());
+                }
+            }
+        }
+        g.set_rows(0, height, width, previous.data());
+        read_versions(g);
+
+        // the generations after this one are about to be replaced
+        while (entries.back().generation > generation)
+        {
+            used -= entries.back().size;
+            groups -= entries.back().keyframe ? 1 : 0;
+            entries.pop_back();
+        }
+        newest_group = 0;
+        for (std::size_t i = entries.size(); i-- > 0;)
+        {
+            newest_group += entries[i].size;
+            if (entries[i].keyframe)
+            {
+                last_keyframe = entries[i].generation;
+                keyframe_size = entries[i].size;
+                break;
+            }
+        }
+        return true;
+    }
+
+    void history::read_versions(game const &g)
+    {
+        for (std::size_t b = 0; b < bands; ++b)
+        {
+            int const y = static_cast<int>(b) * BAND_ROWS;
+            for (std::size_t bx = 0; bx < block_columns; ++bx)
+            {
+                int const x = static_cast<int>(bx * BLOCK_WORDS * 64);
+                versions[b * block_columns + bx] =
+                    g.area_version(x, y, std::min(static_cast<int>(BLOCK_WORDS * 64), width - x), std::min(BAND_ROWS, height - y));
+            }
+        }
+    }
+
+    void history::clear()
+    {
+        entries.clear();
+        used = 0;
+        groups = 0;
+        newest_group = 0;
+    }
+}
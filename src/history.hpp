@@ -0,0 +1,142 @@
+#ifndef __HISTORY_HPP__
+#define __HISTORY_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "game.hpp"
+
+namespace games
+{
+    /**
+     * Bounded rewind buffer of a board's past generations.
+     *
+     * Every recorded generation is stored as the XOR of its bit-packed cells
+     * with the previous generation, sparsely encoded: the nonzero words of
+     * the XOR, then a bitmask of those words for every block of 8 x 8 words
+     * that has any, then a bitmask of those blocks. Encoding is branch free
+     * and decoding visits only the changed words. A keyframe stores the full
+     * board in the same encoding against an empty board; it starts a group
+     * with the deltas after it.
+     *
+     * The board is read a band of rows at a time, so it is compared with
+     * the previous generation while still in cache. Columns of blocks whose
+     * game::area_version() did not move are not compared, and bands where
+     * none moved are not read at all. Records are encoded into a scratch
+     * buffer and copied into one ring of `budget` bytes at their actual
+     * size. When the ring is full, the oldest group is dropped, never the
+     * newest, so memory never exceeds the budget. A new group starts every
+     * `keyframe_interval` generations, or earlier once the newest group
+     * holds the square root of the budget times the keyframe size in
+     * bytes, which keeps the most generations after the oldest is dropped.
+     * Since an XOR delta works in both directions, seek() starts from
+     * whichever of the current board and the keyframes is nearest to the
+     * target and applies deltas forwards or backwards from there.
+     *
+     * Only [0, width) x [0, height) of the board is recorded.
+     */
+    class history
+    {
+    public:
+        static constexpr unsigned int DEFAULT_KEYFRAME_INTERVAL = 256;
+
+        history(int width, int height, std::size_t budget, unsigned int keyframe_interval = DEFAULT_KEYFRAME_INTERVAL);
+
+        /// Records the board of `g` as generation `generation`, which must be larger than the last one.
+        void record(game const &g, uint64_t generation);
+
+        /**
+         * Puts the board of generation `generation` into `g` and forgets all
+         * later generations. Returns false if it is no longer, or was never,
+         * recorded.
+         */
+        bool seek(game &g, uint64_t generation);
+
+        void clear();
+
+        inline bool empty() const
+        {
+            return entries.empty();
+        }
+        /// Oldest generation seek() can go to; only meaningful if !empty().
+        inline uint64_t oldest() const
+        {
+            return entries.front().generation;
+        }
+        /// Last recorded generation; only meaningful if !empty().
+        inline uint64_t newest() const
+        {
+            return entries.back().generation;
+        }
+        /// Bytes of the ring in use.
+        inline std::size_t size() const
+        {
+            return used * sizeof(uint64_t);
+        }
+        inline std::size_t budget() const
+        {
+            return ring.size() * sizeof(uint64_t);
+        }
+        /// Cells of the newest generation in the layout of game::get_rows().
+        inline std::vector<uint64_t> const &cells() const
+        {
+            return previous;
+        }
+
+    private:
+        // offset and size are in words of the ring
+        struct entry
+        {
+            uint64_t generation;
+            std::size_t offset;
+            std::size_t size;
+            bool keyframe;
+        };
+
+        std::size_t encode(game const &g, bool delta);
+        std::size_t encode_keyframe();
+        std::size_t finish(uint64_t *out);
+        bool append(uint64_t generation, bool keyframe, std::size_t size);
+        std::size_t make_room(std::size_t size, bool keyframe);
+        void evict();
+        void decode(entry const &e, uint64_t *plane) const;
+        std::size_t find(uint64_t generation, bool keyframe) const;
+        void read_versions(game const &g);
+
+        const int width;
+        const int height;
+        const std::size_t words_per_row;
+        const std::size_t words;
+        // bands of rows read from the game at a time, columns of blocks across a band and blocks of a band
+        const std::size_t bands;
+        const std::size_t block_columns;
+        const std::size_t band_blocks;
+        const std::size_t blocks;
+        const std::size_t top_words;
+        // the largest record, a board without a single zero word
+        const std::size_t max_record;
+        const unsigned int keyframe_interval;
+        std::vector<uint64_t> ring;
+        std::deque<entry> entries;
+        std::size_t used{0};
+        // keyframes in `entries`, and the words of the newest one and of its group
+        std::size_t groups{0};
+        std::size_t keyframe_size{0};
+        std::size_t newest_group{0};
+        uint64_t last_keyframe{0};
+        // the newest recorded generation
+        std::vector<uint64_t> previous;
+        std::vector<uint64_t> band;
+        std::vector<uint64_t> block_masks;
+        // per band and column of blocks: game::area_version() when it was last read
+        std::vector<uint64_t> versions;
+        // per column of blocks of the band being read: whether it may have changed
+        std::vector<uint8_t> stale;
+        // where records are encoded before they are copied into the ring, with a word to spare
+        std::vector<uint64_t> scratch;
+    };
+}
+
+#endif // __HISTORY_HPP__
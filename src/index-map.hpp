@@ -0,0 +1,155 @@
+#ifndef __INDEX_MAP_HPP__
+#define __INDEX_MAP_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace util
+{
+    /**
+     * Open-addressing hash map from 64-bit keys to 32-bit indexes.
+     *
+     * Keys and values sit next to each other in one flat array probed
+     * linearly, so a lookup usually touches a single cache line. The table
+     * doubles when it gets half full. Erasing shifts the following entries
+     * of the probe sequence back instead of leaving tombstones, so lookups
+     * do not slow down as entries come and go.
+     */
+    class index_map
+    {
+    public:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        explicit index_map(std::size_t capacity = 64)
+        {
+            std::size_t n = 16;
+            while (n < capacity * 2)
+            {
+                n *= 2;
+            }
+            slots.assign(n, slot{0, NONE});
+        }
+
+        inline std::size_t size() const
+        {
+            return used;
+        }
+
+        /// The index stored for `key`, or NONE.
+        inline uint32_t find(uint64_t key) const
+        {
+            for (std::size_t i = home(key);; i = (i + 1) & mask())
+            {
+                slot const &s = slots[i];
+                if (s.value == NONE || s.key == key)
+                {
+                    return s.value;
+                }
+            }
+        }
+
+        /// Stores `value` for `key`, replacing an earlier one.
+        void insert(uint64_t key, uint32_t value)
+        {
+            if ((used + 1) * 2 > slots.size())
+            {
+                grow();
+            }
+            std::size_t i = home(key);
+            for (; slots[i].value != NONE && slots[i].key != key; i = (i + 1) & mask())
+            {
+            }
+            used += slots[i].value == NONE ? 1 : 0;
+            slots[i] = slot{key, value};
+        }
+
+        void erase(uint64_t key)
+        {
+            std::size_t i = home(key);
+            for (; slots[i].key != key; i = (i + 1) & mask())
+            {
+                if (slots[i].value == NONE)
+                {
+                    return;
+                }
+            }
+            if (slots[i].value == NONE)
+            {
+                return;
+            }
+            // move later entries of the probe sequence into the hole unless that passes their home slot
+            for (std::size_t j = (i + 1) & mask(); slots[j].value != NONE; j = (j + 1) & mask())
+            {
+                std::size_t const h = home(slots[j].key);
+                if (((j - h) & mask()) >= ((j - i) & mask()))
+                {
+                    slots[i] = slots[j];
+                    i = j;
+                }
+            }
+            slots[i].value = NONE;
+            --used;
+        }
+
+        void clear()
+        {
+            for (slot &s : slots)
+            {
+                s.value = NONE;
+            }
+            used = 0;
+        }
+
+        /// Calls `f(key, value)` for every entry.
+        template <typename F>
+        void for_each(F &&f) const
+        {
+            for (slot const &s : slots)
+            {
+                if (s.value != NONE)
+                {
+                    f(s.key, s.value);
+                }
+            }
+        }
+
+    private:
+        struct slot
+        {
+            uint64_t key;
+            uint32_t value;
+        };
+
+        inline std::size_t mask() const
+        {
+            return slots.size() - 1;
+        }
+
+        inline std::size_t home(uint64_t key) const
+        {
+            uint64_t h = key * 0x9e3779b97f4a7c15ull;
+            h ^= h >> 32;
+            return static_cast<std::size_t>(h) & mask();
+        }
+
+        void grow()
+        {
+            std::vector<slot> old(slots.size() * 2, slot{0, NONE});
+            old.swap(slots);
+            used = 0;
+            for (slot const &s : old)
+            {
+                if (s.value != NONE)
+                {
+                    insert(s.key, s.value);
+                }
+            }
+        }
+
+        std::vector<slot> slots;
+        std::size_t used{0};
+    };
+}
+
+#endif // __INDEX_MAP_HPP__
@@ -0,0 +1,139 @@
+#include "life.hpp"
+
+#ifdef AUTOMATA_X86_KERNELS
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace kernels
+{
+    namespace
+    {
+#ifdef AUTOMATA_X86_KERNELS
+        struct cpu_features
+        {
+            bool sse2{false};
+            bool avx2{false};
+            bool avx512{false};
+        };
+
+        void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+        {
+#ifdef _MSC_VER
+            int r[4];
+            __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+            for (int i = 0; i < 4; ++i)
+            {
+                regs[i] = static_cast<unsigned int>(r[i]);
+            }
+#else
+            __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+        }
+
+        // XCR0: which register states the OS saves on context switches
+        uint64_t xcr0()
+        {
+#ifdef _MSC_VER
+            return _xgetbv(0);
+#else
+            uint32_t eax, edx;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+        }
+
+        cpu_features detect()
+        {
+            cpu_features f;
+            unsigned int regs[4];
+            cpuid(0, 0, regs);
+            unsigned int const max_leaf = regs[0];
+            if (max_leaf < 1)
+            {
+                return f;
+            }
+            cpuid(1, 0, regs);
+            f.sse2 = (regs[3] & (1u << 26)) != 0;
+            bool const osxsave = (regs[2] & (1u << 27)) != 0;
+            bool const avx = (regs[2] & (1u << 28)) != 0;
+            if (!osxsave || !avx || max_leaf < 7)
+            {
+                return f;
+            }
+            uint64_t const xcr = xcr0();
+            bool const ymm_state = (xcr & 0x06) == 0x06;
+            bool const zmm_state = (xcr & 0xe6) == 0xe6;
+            cpuid(7, 0, regs);
+            f.avx2 = ymm_state && (regs[1] & (1u << 5)) != 0;
+            f.avx512 = zmm_state && (regs[1] & (1u << 16)) != 0;
+            return f;
+        }
+#endif
+
+        std::vector<life_kernel> probe()
+        {
+            std::vector<life_kernel> result{{"scalar", step_scalar, step_wrapped_scalar}};
+#ifdef AUTOMATA_X86_KERNELS
+            cpu_features const f = detect();
+            if (f.sse2)
+            {
+                result.push_back({"sse2", step_sse2, step_wrapped_sse2});
+            }
+            if (f.avx2)
+            {
+                result.push_back({"avx2", step_avx2, step_wrapped_avx2});
+            }
+            if (f.avx512)
+            {
+                result.push_back({"avx512", step_avx512, step_wrapped_avx512});
+            }
+#endif
+            return result;
+        }
+
+        life_kernel const *selected{nullptr};
+    }
+
+    std::vector<life_kernel> const &supported()
+    {
+        static std::vector<life_kernel> const kernels = probe();
+        return kernels;
+    }
+
+    life_kernel const &best()
+    {
+        return supported().back();
+    }
+
+    life_kernel const *find(std::string const &name)
+    {
+        for (auto const &k : supported())
+        {
+            if (name == k.name)
+            {
+                return &k;
+            }
+        }
+        return nullptr;
+    }
+
+    life_kernel const &active()
+    {
+        return selected != nullptr ? *selected : best();
+    }
+
+    bool select(std::string const &name)
+    {
+        life_kernel const *k = find(name);
+        if (k == nullptr)
+        {
+            return false;
+        }
+        selected = k;
+        return true;
+    }
+}
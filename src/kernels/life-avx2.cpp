@@ -0,0 +1,41 @@
+#include <immintrin.h>
+
+#include "life.hpp"
+#include "life-impl.hpp"
+
+namespace
+{
+    struct avx2_traits
+    {
+        using type = __m256i;
+        static constexpr std::size_t lanes = 4;
+
+        static inline type load(uint64_t const *p) { return _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)); }
+        static inline void store(uint64_t *p, type v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+        static inline type and_(type a, type b) { return _mm256_and_si256(a, b); }
+        static inline type or_(type a, type b) { return _mm256_or_si256(a, b); }
+        static inline type xor_(type a, type b) { return _mm256_xor_si256(a, b); }
+        static inline type andnot(type a, type b) { return _mm256_andnot_si256(a, b); }
+        template <int n>
+        static inline type shl(type v) { return _mm256_slli_epi64(v, n); }
+        template <int n>
+        static inline type shr(type v) { return _mm256_srli_epi64(v, n); }
+        static inline type xor3(type a, type b, type c) { return xor_(xor_(a, b), c); }
+        static inline type maj(type a, type b, type c) { return or_(and_(a, b), and_(c, xor_(a, b))); }
+        static inline type zero() { return _mm256_setzero_si256(); }
+        static inline type ones() { return _mm256_set1_epi32(-1); }
+        static inline bool any(type v) { return !_mm256_testz_si256(v, v); }
+    };
+}
+
+void kernels::step_avx2(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                        uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed)
+{
+    step_rule<avx2_traits>(r, above, current, below, out, begin, end, changed);
+}
+
+void kernels::step_wrapped_avx2(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                uint64_t *out, std::size_t count)
+{
+    step_wrapped_rule<avx2_traits>(r, above, current, below, out, count);
+}
@@ -0,0 +1,47 @@
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC's own AVX-512 intrinsics trip -Wmaybe-uninitialized
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+
+#include "life.hpp"
+#include "life-impl.hpp"
+
+namespace
+{
+    struct avx512_traits
+    {
+        using type = __m512i;
+        static constexpr std::size_t lanes = 8;
+
+        static inline type load(uint64_t const *p) { return _mm512_loadu_si512(p); }
+        static inline void store(uint64_t *p, type v) { _mm512_storeu_si512(p, v); }
+        static inline type and_(type a, type b) { return _mm512_and_si512(a, b); }
+        static inline type or_(type a, type b) { return _mm512_or_si512(a, b); }
+        static inline type xor_(type a, type b) { return _mm512_xor_si512(a, b); }
+        static inline type andnot(type a, type b) { return _mm512_andnot_si512(a, b); }
+        template <int n>
+        static inline type shl(type v) { return _mm512_slli_epi64(v, n); }
+        template <int n>
+        static inline type shr(type v) { return _mm512_srli_epi64(v, n); }
+        // full adder digits in one instruction each
+        static inline type xor3(type a, type b, type c) { return _mm512_ternarylogic_epi64(a, b, c, 0x96); }
+        static inline type maj(type a, type b, type c) { return _mm512_ternarylogic_epi64(a, b, c, 0xe8); }
+        static inline type zero() { return _mm512_setzero_si512(); }
+        static inline type ones() { return _mm512_set1_epi32(-1); }
+        static inline bool any(type v) { return _mm512_test_epi64_mask(v, v) != 0; }
+    };
+}
+
+void kernels::step_avx512(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                          uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed)
+{
+    step_rule<avx512_traits>(r, above, current, below, out, begin, end, changed);
+}
+
+void kernels::step_wrapped_avx512(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                  uint64_t *out, std::size_t count)
+{
+    step_wrapped_rule<avx512_traits>(r, above, current, below, out, count);
+}
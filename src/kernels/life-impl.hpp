@@ -0,0 +1,377 @@
+#ifndef __KERNELS_LIFE_IMPL_HPP__
+#define __KERNELS_LIFE_IMPL_HPP__
+
+// Shared body of the Life stepping kernels. Every kernel translation unit
+// includes this file with its own vector traits and compiler flags, so
+// everything in here has internal linkage: an AVX2 instantiation must never
+// be picked by the linker to serve a scalar call site.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "life.hpp"
+#include "../rule.hpp"
+
+namespace kernels
+{
+    namespace
+    {
+        struct scalar_traits
+        {
+            using type = uint64_t;
+            static constexpr std::size_t lanes = 1;
+
+            static inline type load(uint64_t const *p) { return *p; }
+            static inline void store(uint64_t *p, type v) { *p = v; }
+            static inline type and_(type a, type b) { return a & b; }
+            static inline type or_(type a, type b) { return a | b; }
+            static inline type xor_(type a, type b) { return a ^ b; }
+            // ~a & b
+            static inline type andnot(type a, type b) { return ~a & b; }
+            template <int n>
+            static inline type shl(type v) { return v << n; }
+            template <int n>
+            static inline type shr(type v) { return v >> n; }
+            static inline type xor3(type a, type b, type c) { return a ^ b ^ c; }
+            static inline type maj(type a, type b, type c) { return (a & b) | (c & (a ^ b)); }
+            static inline type zero() { return 0; }
+            static inline type ones() { return ~uint64_t{0}; }
+            static inline bool any(type v) { return v != 0; }
+        };
+
+        template <typename V>
+        inline void full_add(typename V::type a, typename V::type b, typename V::type c,
+                             typename V::type &sum, typename V::type &carry)
+        {
+            sum = V::xor3(a, b, c);
+            carry = V::maj(a, b, c);
+        }
+
+        /**
+         * B3/S23 from the eight neighbor words (already shifted into place)
+         * and the current word, 64 cells per lane. Only needs to know
+         * whether the count is 2 or 3, which is cheaper than counting.
+         */
+        struct conway_rule
+        {
+            template <typename V, typename T = typename V::type>
+            inline T apply(T aw, T a, T ae, T cw, T c, T ce, T bw, T b, T be) const
+            {
+                T a0, a1, b0, b1, ones, carry;
+                full_add<V>(aw, a, ae, a0, a1);
+                T const m0 = V::xor_(cw, ce);
+                T const m1 = V::and_(cw, ce);
+                full_add<V>(bw, b, be, b0, b1);
+                full_add<V>(a0, m0, b0, ones, carry);
+                // the count is 2 or 3 iff exactly one of the four twos is set
+                T const p = V::xor_(a1, m1);
+                T const r = V::xor_(b1, carry);
+                T const two_or_three = V::andnot(V::or_(V::and_(a1, m1), V::and_(b1, carry)), V::xor_(p, r));
+                return V::and_(two_or_three, V::or_(ones, c));
+            }
+        };
+
+        // Neighbor count of every cell as bit planes: n = s0 + 2 s1 + 4 s2 + 8 s3.
+        template <typename V>
+        struct count
+        {
+            using T = typename V::type;
+            T s0, s1, s2, s3;
+
+            inline count(T aw, T a, T ae, T cw, T ce, T bw, T b, T be)
+            {
+                T a0, a1, b0, b1, twos, t0, t1;
+                full_add<V>(aw, a, ae, a0, a1);
+                full_add<V>(bw, b, be, b0, b1);
+                full_add<V>(a0, V::xor_(cw, ce), b0, s0, twos);
+                full_add<V>(a1, V::and_(cw, ce), b1, t0, t1);
+                s1 = V::xor_(t0, twos);
+                T const fours = V::and_(t0, twos);
+                s2 = V::xor_(t1, fours);
+                s3 = V::and_(t1, fours);
+            }
+
+            template <int N>
+            inline T equals() const
+            {
+                if constexpr (N == 8)
+                {
+                    return s3;
+                }
+                else
+                {
+                    T all_set = V::ones();
+                    T any_clear = s3;
+                    // the planes of the bits set in N must be set, all others clear
+                    if constexpr ((N & 1) != 0)
+                    {
+                        all_set = V::and_(all_set, s0);
+                    }
+                    else
+                    {
+                        any_clear = V::or_(any_clear, s0);
+                    }
+                    if constexpr ((N & 2) != 0)
+                    {
+                        all_set = V::and_(all_set, s1);
+                    }
+                    else
+                    {
+                        any_clear = V::or_(any_clear, s1);
+                    }
+                    if constexpr ((N & 4) != 0)
+                    {
+                        all_set = V::and_(all_set, s2);
+                    }
+                    else
+                    {
+                        any_clear = V::or_(any_clear, s2);
+                    }
+                    return V::andnot(any_clear, all_set);
+                }
+            }
+
+            // cells with exactly n live neighbors
+            inline T equals(int n) const
+            {
+                switch (n)
+                {
+                case 0:
+                    return equals<0>();
+                case 1:
+                    return equals<1>();
+                case 2:
+                    return equals<2>();
+                case 3:
+                    return equals<3>();
+                case 4:
+                    return equals<4>();
+                case 5:
+                    return equals<5>();
+                case 6:
+                    return equals<6>();
+                case 7:
+                    return equals<7>();
+                default:
+                    return equals<8>();
+                }
+            }
+
+            // cells whose count is in `MASK`, from count N upwards
+            template <uint16_t MASK, int N = 0>
+            inline T in() const
+            {
+                if constexpr (N > 8 || (MASK >> N) == 0)
+                {
+                    return V::zero();
+                }
+                else if constexpr (((MASK >> N) & 1) == 0)
+                {
+                    return in<MASK, N + 1>();
+                }
+                else if constexpr ((MASK >> (N + 1)) == 0)
+                {
+                    return equals<N>();
+                }
+                else
+                {
+                    return V::or_(equals<N>(), in<MASK, N + 1>());
+                }
+            }
+        };
+
+        /**
+         * Any rule known at compile time. Only the counts present in one of
+         * the masks are tested for.
+         */
+        template <uint16_t BIRTH, uint16_t SURVIVAL>
+        struct fixed_rule
+        {
+            template <typename V, typename T = typename V::type>
+            inline T apply(T aw, T a, T ae, T cw, T c, T ce, T bw, T b, T be) const
+            {
+                count<V> const k(aw, a, ae, cw, ce, bw, b, be);
+                return V::or_(V::andnot(c, k.template in<BIRTH>()), V::and_(c, k.template in<SURVIVAL>()));
+            }
+        };
+
+        // Any rule, with the masks read at run time.
+        struct any_rule
+        {
+            rules::rule r;
+
+            template <typename V, typename T = typename V::type>
+            inline T apply(T aw, T a, T ae, T cw, T c, T ce, T bw, T b, T be) const
+            {
+                count<V> const k(aw, a, ae, cw, ce, bw, b, be);
+                T born = V::zero();
+                T kept = V::zero();
+                for (int n = 0; n <= 8; ++n)
+                {
+                    if (r.births(n))
+                    {
+                        born = V::or_(born, k.equals(n));
+                    }
+                    if (r.survives(n))
+                    {
+                        kept = V::or_(kept, k.equals(n));
+                    }
+                }
+                return V::or_(V::andnot(c, born), V::and_(c, kept));
+            }
+        };
+
+        template <typename V>
+        struct life
+        {
+            using T = typename V::type;
+
+            // cell x - 1 moved to position x
+            static inline T west(uint64_t const *r, std::size_t w)
+            {
+                return V::or_(V::template shl<1>(V::load(r + w)), V::template shr<63>(V::load(r + w - 1)));
+            }
+
+            // cell x + 1 moved to position x
+            static inline T east(uint64_t const *r, std::size_t w)
+            {
+                return V::or_(V::template shr<1>(V::load(r + w)), V::template shl<63>(V::load(r + w + 1)));
+            }
+
+            template <typename Rule>
+            static inline T step(Rule const &rule, uint64_t const *above, uint64_t const *current, uint64_t const *below, std::size_t w)
+            {
+                return rule.template apply<V>(west(above, w), V::load(above + w), east(above, w),
+                                           west(current, w), V::load(current + w), east(current, w),
+                                           west(below, w), V::load(below + w), east(below, w));
+            }
+        };
+
+        /**
+         * Steps the interior words [begin, end) of a row. Words begin - 1 and
+         * end must exist, so the caller handles the wrapping edge words.
+         * Sets changed[w / CHUNK_WORDS] for every word w that differs from
+         * `current`.
+         */
+        template <typename V, typename Rule>
+        inline void step_span(Rule const &rule, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                              uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed)
+        {
+            for (std::size_t w = begin; w < end;)
+            {
+                std::size_t const chunk = w / CHUNK_WORDS;
+                std::size_t const chunk_end = end < (chunk + 1) * CHUNK_WORDS ? end : (chunk + 1) * CHUNK_WORDS;
+                typename V::type diff = V::zero();
+                for (; w + V::lanes <= chunk_end; w += V::lanes)
+                {
+                    typename V::type const next = life<V>::step(rule, above, current, below, w);
+                    diff = V::or_(diff, V::xor_(next, V::load(current + w)));
+                    V::store(out + w, next);
+                }
+                uint64_t tail = 0;
+                for (; w < chunk_end; ++w)
+                {
+                    out[w] = life<scalar_traits>::step(rule, above, current, below, w);
+                    tail |= out[w] ^ current[w];
+                }
+                if (V::any(diff) || tail != 0)
+                {
+                    changed[chunk] = 1;
+                }
+            }
+        }
+
+        /**
+         * Board rows of exactly 64 cells that wrap around: the cells west
+         * and east of a word come from the word itself.
+         */
+        template <typename V>
+        struct wrapped_life
+        {
+            using T = typename V::type;
+
+            static inline T west(uint64_t const *r, std::size_t i)
+            {
+                T const v = V::load(r + i);
+                return V::or_(V::template shl<1>(v), V::template shr<63>(v));
+            }
+
+            static inline T east(uint64_t const *r, std::size_t i)
+            {
+                T const v = V::load(r + i);
+                return V::or_(V::template shr<1>(v), V::template shl<63>(v));
+            }
+
+            template <typename Rule>
+            static inline T step(Rule const &rule, uint64_t const *above, uint64_t const *current, uint64_t const *below, std::size_t i)
+            {
+                return rule.template apply<V>(west(above, i), V::load(above + i), east(above, i),
+                                           west(current, i), V::load(current + i), east(current, i),
+                                           west(below, i), V::load(below + i), east(below, i));
+            }
+        };
+
+        // Steps `count` independent wrapped rows, see kernels::wrapped_fn.
+        template <typename V, typename Rule>
+        inline void step_wrapped_span(Rule const &rule, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                      uint64_t *out, std::size_t count)
+        {
+            std::size_t i = 0;
+            for (; i + V::lanes <= count; i += V::lanes)
+            {
+                V::store(out + i, wrapped_life<V>::step(rule, above, current, below, i));
+            }
+            for (; i < count; ++i)
+            {
+                out[i] = wrapped_life<scalar_traits>::step(rule, above, current, below, i);
+            }
+        }
+
+        /**
+         * Calls `f` with the stepping rule for `r`. The rules below get code
+         * of their own, as fast as the hard-coded Conway rule used to be; any
+         * other rule reads its masks at run time.
+         */
+        template <typename F>
+        inline void with_rule(rules::rule const &r, F &&f)
+        {
+            switch (r.id())
+            {
+            case rules::CONWAY.id():
+                return f(conway_rule{});
+#define AUTOMATA_FIXED_RULE(R) \
+    case R.id():               \
+        return f(fixed_rule<R.birth, R.survival>{});
+                AUTOMATA_FIXED_RULE(rules::HIGHLIFE)
+                AUTOMATA_FIXED_RULE(rules::SEEDS)
+                AUTOMATA_FIXED_RULE(rules::DAY_AND_NIGHT)
+                AUTOMATA_FIXED_RULE(rules::LIFE_WITHOUT_DEATH)
+                AUTOMATA_FIXED_RULE(rules::REPLICATOR)
+                AUTOMATA_FIXED_RULE(rules::DIAMOEBA)
+                AUTOMATA_FIXED_RULE(rules::MORLEY)
+                AUTOMATA_FIXED_RULE(rules::TWO_BY_TWO)
+#undef AUTOMATA_FIXED_RULE
+            default:
+                return f(any_rule{r});
+            }
+        }
+
+        template <typename V>
+        inline void step_rule(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                              uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed)
+        {
+            with_rule(r, [&](auto const &rule)
+                      { step_span<V>(rule, above, current, below, out, begin, end, changed); });
+        }
+
+        template <typename V>
+        inline void step_wrapped_rule(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                      uint64_t *out, std::size_t count)
+        {
+            with_rule(r, [&](auto const &rule)
+                      { step_wrapped_span<V>(rule, above, current, below, out, count); });
+        }
+    }
+}
+
+#endif // __KERNELS_LIFE_IMPL_HPP__
@@ -0,0 +1,14 @@
+#include "life.hpp"
+#include "life-impl.hpp"
+
+void kernels::step_scalar(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                          uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed)
+{
+    step_rule<scalar_traits>(r, above, current, below, out, begin, end, changed);
+}
+
+void kernels::step_wrapped_scalar(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                  uint64_t *out, std::size_t count)
+{
+    step_wrapped_rule<scalar_traits>(r, above, current, below, out, count);
+}
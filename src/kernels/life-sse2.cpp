@@ -0,0 +1,41 @@
+#include <emmintrin.h>
+
+#include "life.hpp"
+#include "life-impl.hpp"
+
+namespace
+{
+    struct sse2_traits
+    {
+        using type = __m128i;
+        static constexpr std::size_t lanes = 2;
+
+        static inline type load(uint64_t const *p) { return _mm_loadu_si128(reinterpret_cast<__m128i const *>(p)); }
+        static inline void store(uint64_t *p, type v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+        static inline type and_(type a, type b) { return _mm_and_si128(a, b); }
+        static inline type or_(type a, type b) { return _mm_or_si128(a, b); }
+        static inline type xor_(type a, type b) { return _mm_xor_si128(a, b); }
+        static inline type andnot(type a, type b) { return _mm_andnot_si128(a, b); }
+        template <int n>
+        static inline type shl(type v) { return _mm_slli_epi64(v, n); }
+        template <int n>
+        static inline type shr(type v) { return _mm_srli_epi64(v, n); }
+        static inline type xor3(type a, type b, type c) { return xor_(xor_(a, b), c); }
+        static inline type maj(type a, type b, type c) { return or_(and_(a, b), and_(c, xor_(a, b))); }
+        static inline type zero() { return _mm_setzero_si128(); }
+        static inline type ones() { return _mm_set1_epi32(-1); }
+        static inline bool any(type v) { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xffff; }
+    };
+}
+
+void kernels::step_sse2(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                        uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed)
+{
+    step_rule<sse2_traits>(r, above, current, below, out, begin, end, changed);
+}
+
+void kernels::step_wrapped_sse2(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                uint64_t *out, std::size_t count)
+{
+    step_wrapped_rule<sse2_traits>(r, above, current, below, out, count);
+}
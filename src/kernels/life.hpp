@@ -0,0 +1,68 @@
+#ifndef __KERNELS_LIFE_HPP__
+#define __KERNELS_LIFE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../rule.hpp"
+
+namespace kernels
+{
+    /// Granularity, in words, at which kernels report changes.
+    constexpr std::size_t CHUNK_WORDS = 8;
+
+    /**
+     * Computes the next generation under rule `r` of the interior words
+     * [begin, end) of a bit-packed row from the row itself and its vertical
+     * neighbors, and sets changed[w / CHUNK_WORDS] where word w differs
+     * from `current`.
+     */
+    using span_fn = void (*)(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                             uint64_t *out, std::size_t begin, std::size_t end, uint8_t *changed);
+
+    /**
+     * Computes the next generation under rule `r` of `count` independent
+     * rows of exactly 64 cells that wrap around, one word each: out[i] from
+     * current[i] and its vertical neighbors above[i] and below[i]. Steps
+     * many small boards at once when their rows are interleaved.
+     */
+    using wrapped_fn = void (*)(rules::rule const &r, uint64_t const *above, uint64_t const *current, uint64_t const *below,
+                                uint64_t *out, std::size_t count);
+
+    struct life_kernel
+    {
+        char const *name;
+        span_fn step;
+        wrapped_fn step_wrapped;
+    };
+
+    void step_scalar(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t, std::size_t, uint8_t *);
+    void step_wrapped_scalar(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t);
+#ifdef AUTOMATA_X86_KERNELS
+    void step_sse2(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t, std::size_t, uint8_t *);
+    void step_avx2(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t, std::size_t, uint8_t *);
+    void step_avx512(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t, std::size_t, uint8_t *);
+    void step_wrapped_sse2(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t);
+    void step_wrapped_avx2(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t);
+    void step_wrapped_avx512(rules::rule const &, uint64_t const *, uint64_t const *, uint64_t const *, uint64_t *, std::size_t);
+#endif
+
+    /// All kernels the running CPU can execute, slowest first.
+    std::vector<life_kernel> const &supported();
+
+    /// The fastest kernel the running CPU can execute.
+    life_kernel const &best();
+
+    /// The supported kernel called `name`, or nullptr.
+    life_kernel const *find(std::string const &name);
+
+    /// The kernel new engines start with: best() unless overridden by select().
+    life_kernel const &active();
+
+    /// Makes the kernel called `name` the active one. Returns false if the CPU does not support it.
+    bool select(std::string const &name);
+}
+
+#endif // __KERNELS_LIFE_HPP__
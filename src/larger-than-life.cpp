@@ -0,0 +1,418 @@
+#include "larger-than-life.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+#include "game-of-life.hpp"
+
+namespace games
+{
+    namespace
+    {
+        // Grown to the largest band a thread has stepped and kept, so a generation allocates nothing.
+        struct scratch
+        {
+            std::vector<uint8_t> cells;
+            std::vector<uint16_t> sums;
+            std::vector<uint16_t> diagonal;
+            std::vector<uint16_t> anti_diagonal;
+            std::vector<uint16_t> line;
+            std::vector<uint16_t> counts;
+        };
+
+        scratch &own_scratch()
+        {
+            thread_local scratch s;
+            return s;
+        }
+
+        template <typename T>
+        T *at_least(std::vector<T> &v, std::size_t n)
+        {
+            if (v.size() < n)
+            {
+                v.resize(n);
+            }
+            return v.data();
+        }
+
+        // Row `src` of a torus `width` cells wide, with `pad` cells of wrapped neighbors on either side.
+        void pad_row(uint8_t const *src, int width, int pad, uint8_t *out)
+        {
+            for (int j = 0; j < pad; ++j)
+            {
+                out[j] = src[mod(j - pad, width)];
+                out[pad + width + j] = src[mod(j, width)];
+            }
+            std::copy(src, src + width, out + pad);
+        }
+    }
+
+    larger_than_life::larger_than_life(int width, int height, unsigned int threads)
+        : width(width), height(height)
+        , plane_a(static_cast<std::size_t>(width) * static_cast<std::size_t>(height), 0)
+        , plane_b(static_cast<std::size_t>(width) * static_cast<std::size_t>(height), 0)
+    {
+        set_threads(threads);
+        seed(util::make_seed());
+    }
+
+    void larger_than_life::seed(unsigned long s)
+    {
+        rng.seed(s);
+    }
+
+    void larger_than_life::set_rule(rules::ltl_rule const &r)
+    {
+        rule_ = r;
+    }
+
+    void larger_than_life::set_threads(unsigned int threads)
+    {
+        pool.reset();
+        if (threads != 1)
+        {
+            pool = std::make_unique<util::thread_pool>(threads);
+        }
+    }
+
+    void larger_than_life::populate(double density)
+    {
+        uint32_t const fill = rng.next_fill();
+        uint32_t const p = util::fixed_density(density);
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        std::size_t const bands = (static_cast<std::size_t>(height) + BAND_ROWS - 1) / BAND_ROWS;
+        auto band = [&](std::size_t b)
+        {
+            std::vector<uint64_t> words(per_row);
+            int const y0 = static_cast<int>(b) * BAND_ROWS;
+            for (int y = y0; y < std::min(height, y0 + BAND_ROWS); ++y)
+            {
+                rng.fill_rows(fill, p, width, y, 1, words.data());
+                uint8_t *cells = row(y);
+                for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
+                {
+                    cells[x] = static_cast<uint8_t>((words[x / 64] >> (x % 64)) & 1);
+                }
+            }
+        };
+        if (pool)
+        {
+            pool->parallel_for(bands, band);
+        }
+        else
+        {
+            for (std::size_t b = 0; b < bands; ++b)
+            {
+                band(b);
+            }
+        }
+    }
+
+    void larger_than_life::clear()
+    {
+        std::fill(plane_a.begin(), plane_a.end(), 0);
+    }
+
+    void larger_than_life::irritate(int const x, int const y)
+    {
+        // a neighborhood's worth of noise, or a Moore one for small radii
+        int const r = std::max(1, rule_.radius);
+        for (int dy = -r; dy <= r; ++dy)
+        {
+            for (int dx = -r; dx <= r; ++dx)
+            {
+                set(x + dx, y + dy, (rng() & 1) != 0);
+            }
+        }
+    }
+
+    void larger_than_life::set(int x, int y, bool alive)
+    {
+        row(static_cast<int>(mod(y, height)))[mod(x, width)] = alive ? 1 : 0;
+    }
+
+    void larger_than_life::set_span(int x, int y, int length, bool alive)
+    {
+        length = std::min(length, width);
+        uint8_t *r = row(static_cast<int>(mod(y, height)));
+        int const cx = static_cast<int>(mod(x, width));
+        int const first = std::min(length, width - cx);
+        std::fill_n(r + cx, first, alive ? 1 : 0);
+        std::fill_n(r, length - first, alive ? 1 : 0);
+    }
+
+    bool larger_than_life::get(int x, int y) const
+    {
+        return row(static_cast<int>(mod(y, height)))[mod(x, width)] != 0;
+    }
+
+    void larger_than_life::get_rows(int y, int count, int w, uint64_t *words) const
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::get_rows(y, count, w, words);
+            return;
+        }
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (int r = 0; r < count; ++r)
+        {
+            uint8_t const *cells = row(y + r);
+            uint64_t *out = words + static_cast<std::size_t>(r) * per_row;
+            for (std::size_t word = 0; word < per_row; ++word)
+            {
+                std::size_t const x0 = word * 64;
+                std::size_t const n = std::min<std::size_t>(64, static_cast<std::size_t>(width) - x0);
+                uint64_t bits = 0;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    bits |= uint64_t{cells[x0 + i]} << i;
+                }
+                out[word] = bits;
+            }
+        }
+    }
+
+    void larger_than_life::set_rows(int y, int count, int w, uint64_t const *words)
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::set_rows(y, count, w, words);
+            return;
+        }
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (int r = 0; r < count; ++r)
+        {
+            uint8_t *cells = row(y + r);
+            uint64_t const *in = words + static_cast<std::size_t>(r) * per_row;
+            for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
+            {
+                cells[x] = static_cast<uint8_t>((in[x / 64] >> (x % 64)) & 1);
+            }
+        }
+    }
+
+    void larger_than_life::get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const
+    {
+        count_density(width, height, x, y, level, columns, rows, counts, [this](int cy, int x0, int x1)
+                      {
+                          uint8_t const *cells = row(cy);
+                          return std::accumulate(cells + x0, cells + x1, uint64_t{0}); });
+    }
+
+    uint64_t larger_than_life::population() const
+    {
+        uint64_t n = 0;
+        for (int y = 0; y < height; ++y)
+        {
+            // a row's sum fits in 32 bits
+            n += std::accumulate(row(y), row(y) + width, uint32_t{0});
+        }
+        return n;
+    }
+
+    /**
+     * Squares: `sums` holds, for each of the band's rows and the radius of
+     * rows above and below, the sums of the 2r + 1 cells around each cell
+     * of the row. A running total per column over 2r + 1 of those rows is
+     * the count, moved down a row by adding one row of sums and
+     * subtracting another.
+     */
+    void larger_than_life::count_moore(int y0, int y1, uint16_t *counts) const
+    {
+        scratch &s = own_scratch();
+        int const r = rule_.radius;
+        std::size_t const w = static_cast<std::size_t>(width);
+        std::size_t const padded = w + 2 * static_cast<std::size_t>(r);
+        std::size_t const rows = static_cast<std::size_t>(y1 - y0 + 2 * r);
+        uint8_t *cells = at_least(s.cells, padded);
+        uint16_t *sums = at_least(s.sums, rows * w);
+        uint16_t *column = at_least(s.line, w);
+        uint16_t *prefix = at_least(s.diagonal, padded + 1);
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            pad_row(row(static_cast<int>(mod(y0 - r + static_cast<int>(i), height))), width, r, cells);
+            // prefix sums along the row, so each window is a difference the compiler can vectorize
+            prefix[0] = 0;
+            for (std::size_t j = 0; j < padded; ++j)
+            {
+                prefix[j + 1] = static_cast<uint16_t>(prefix[j] + cells[j]);
+            }
+            uint16_t *out = sums + i * w;
+            uint16_t const *right = prefix + 2 * static_cast<std::size_t>(r) + 1;
+            for (std::size_t x = 0; x < w; ++x)
+            {
+                out[x] = static_cast<uint16_t>(right[x] - prefix[x]);
+            }
+        }
+        std::fill_n(column, w, 0);
+        for (std::size_t i = 0; i <= 2 * static_cast<std::size_t>(r); ++i)
+        {
+            for (std::size_t x = 0; x < w; ++x)
+            {
+                column[x] = static_cast<uint16_t>(column[x] + sums[i * w + x]);
+            }
+        }
+        for (std::size_t i = 0; i < static_cast<std::size_t>(y1 - y0); ++i)
+        {
+            std::copy(column, column + w, counts + i * w);
+            if (i + 1 == static_cast<std::size_t>(y1 - y0))
+            {
+                break;
+            }
+            uint16_t const *enters = sums + (i + 2 * static_cast<std::size_t>(r) + 1) * w;
+            uint16_t const *leaves = sums + i * w;
+            for (std::size_t x = 0; x < w; ++x)
+            {
+                column[x] = static_cast<uint16_t>(column[x] + enters[x] - leaves[x]);
+            }
+        }
+    }
+
+    /**
+     * Diamonds: the scratch grid holds rows y0 - r - 1 to y1 + r - 1 with
+     * r + 1 wrapped columns on either side. `diagonal` sums each cell and
+     * the ones up and to its left, `anti_diagonal` the ones up and to its
+     * right, so any stretch of a diagonal is the difference of two
+     * entries. Moving the diamond around (x, y) down a row gains the
+     * stretches from (x - r, y + 1) to (x, y + r + 1) and from (x + r, y + 1)
+     * to (x + 1, y + r), and loses those from (x, y - r) to (x - r, y) and
+     * from (x + 1, y - r + 1) to (x + r, y). All of the arithmetic is
+     * modulo 2^16, which the counts fit in.
+     */
+    void larger_than_life::count_von_neumann(int y0, int y1, uint16_t *counts) const
+    {
+        scratch &s = own_scratch();
+        int const r = rule_.radius;
+        std::size_t const ur = static_cast<std::size_t>(r);
+        std::size_t const w = static_cast<std::size_t>(width);
+        std::size_t const padded = w + 2 * ur + 2;
+        std::size_t const rows = static_cast<std::size_t>(y1 - y0) + 2 * ur + 1;
+        uint8_t *cells = at_least(s.cells, rows * padded);
+        uint16_t *diagonal = at_least(s.diagonal, rows * padded);
+        uint16_t *anti = at_least(s.anti_diagonal, rows * padded);
+        uint16_t *count = at_least(s.line, std::max(w, padded + 1));
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            uint8_t const *c = cells + i * padded;
+            pad_row(row(static_cast<int>(mod(y0 - r - 1 + static_cast<int>(i), height))), width, r + 1, cells + i * padded);
+            uint16_t *d = diagonal + i * padded;
+            uint16_t *a = anti + i * padded;
+            if (i == 0)
+            {
+                std::copy(c, c + padded, d);
+                std::copy(c, c + padded, a);
+                continue;
+            }
+            uint16_t const *d_up = d - padded;
+            uint16_t const *a_up = a - padded;
+            d[0] = c[0];
+            a[padded - 1] = c[padded - 1];
+            for (std::size_t j = 1; j < padded; ++j)
+            {
+                d[j] = static_cast<uint16_t>(c[j] + d_up[j - 1]);
+            }
+            for (std::size_t j = 0; j + 1 < padded; ++j)
+            {
+                a[j] = static_cast<uint16_t>(c[j] + a_up[j + 1]);
+            }
+        }
+
+        // the first row of the band, a stretch of each row in it from prefix sums along the row
+        uint16_t *prefix = count;
+        uint16_t *first = counts;
+        std::fill_n(first, w, 0);
+        for (int dy = -r; dy <= r; ++dy)
+        {
+            uint8_t const *c = cells + static_cast<std::size_t>(dy + r + 1) * padded;
+            prefix[0] = 0;
+            for (std::size_t j = 0; j < padded; ++j)
+            {
+                prefix[j + 1] = static_cast<uint16_t>(prefix[j] + c[j]);
+            }
+            std::size_t const k = static_cast<std::size_t>(r - std::abs(dy));
+            for (std::size_t x = 0; x < w; ++x)
+            {
+                // column x is at x + r + 1
+                first[x] = static_cast<uint16_t>(first[x] + prefix[x + ur + 1 + k + 1] - prefix[x + ur + 1 - k]);
+            }
+        }
+
+        for (std::size_t i = 0; i + 1 < static_cast<std::size_t>(y1 - y0); ++i)
+        {
+            uint16_t const *above = counts + i * w;
+            uint16_t *below = counts + (i + 1) * w;
+            // row of y in the scratch grid
+            std::size_t const iy = i + ur + 1;
+            uint16_t const *d_top = diagonal + iy * padded;
+            uint16_t const *d_bottom = diagonal + (iy + ur + 1) * padded;
+            uint16_t const *d_gone = diagonal + (iy - ur) * padded;
+            uint16_t const *a_top = anti + iy * padded;
+            uint16_t const *a_bottom = anti + (iy + ur) * padded;
+            uint16_t const *a_gone = anti + (iy - ur - 1) * padded;
+            for (std::size_t x = 0; x < w; ++x)
+            {
+                std::size_t const j = x + ur + 1;
+                unsigned int const gained = d_bottom[j] - d_top[j - ur - 1] + a_bottom[j + 1] - a_top[j + ur + 1];
+                unsigned int const lost = a_top[j - ur] - a_gone[j + 1] + d_top[j + ur] - d_gone[j];
+                below[x] = static_cast<uint16_t>(above[x] + gained - lost);
+            }
+        }
+    }
+
+    void larger_than_life::step_band(std::size_t band)
+    {
+        int const y0 = static_cast<int>(band) * BAND_ROWS;
+        int const y1 = std::min(height, y0 + BAND_ROWS);
+        std::size_t const w = static_cast<std::size_t>(width);
+        uint16_t *counts = at_least(own_scratch().counts, static_cast<std::size_t>(y1 - y0) * w);
+        if (rule_.shape == rules::ltl_rule::VON_NEUMANN)
+        {
+            count_von_neumann(y0, y1, counts);
+        }
+        else
+        {
+            count_moore(y0, y1, counts);
+        }
+        // the ranges clamped to what a count can be, and the middle cell taken back out of it if it does not count
+        auto clamp = [](int n)
+        {
+            return static_cast<uint16_t>(std::clamp(n, 0, 0xffff));
+        };
+        uint16_t const survive_min = clamp(rule_.survive_min + (rule_.middle ? 0 : 1));
+        uint16_t const survive_max = clamp(rule_.survive_max + (rule_.middle ? 0 : 1));
+        uint16_t const birth_min = clamp(rule_.birth_min);
+        uint16_t const birth_max = clamp(rule_.birth_max);
+        for (int y = y0; y < y1; ++y)
+        {
+            uint8_t const *cells = row(y);
+            uint16_t const *n = counts + static_cast<std::size_t>(y - y0) * w;
+            uint8_t *out = plane_b.data() + static_cast<std::size_t>(y) * w;
+            for (std::size_t x = 0; x < w; ++x)
+            {
+                bool const survives = n[x] >= survive_min && n[x] <= survive_max;
+                bool const born = n[x] >= birth_min && n[x] <= birth_max;
+                out[x] = static_cast<uint8_t>(cells[x] != 0 ? survives : born);
+            }
+        }
+    }
+
+    void larger_than_life::iterate()
+    {
+        std::size_t const bands = (static_cast<std::size_t>(height) + BAND_ROWS - 1) / BAND_ROWS;
+        if (pool)
+        {
+            pool->parallel_for(bands, [this](std::size_t b)
+                               { step_band(b); });
+        }
+        else
+        {
+            for (std::size_t b = 0; b < bands; ++b)
+            {
+                step_band(b);
+            }
+        }
+        std::swap(plane_a, plane_b);
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef __LARGER_THAN_LIFE_HPP__
+#define __LARGER_THAN_LIFE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "counter-rng.hpp"
+#include "game.hpp"
+#include "rule.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+
+namespace games
+{
+    /**
+     * Larger-than-Life rules, like Bosco's rule (R5,C0,M1,S34..58,B34..45,NM),
+     * on a torus, one byte per cell.
+     *
+     * Counting the neighborhood of every cell by itself would cost
+     * O(radius^2) per cell. Instead each band of rows copies the rows it
+     * needs, wrapped around, into a padded scratch grid and derives all
+     * counts from running sums over it, at a cost per cell that does not
+     * depend on the radius:
+     *
+     * - Moore squares are separable: windows of 2 radius + 1 cells along
+     *   each row are differences of prefix sums, and a second window slides
+     *   down the columns of those sums, adding the row that enters and
+     *   subtracting the one that leaves.
+     * - Von Neumann diamonds are not, but moving a diamond one row down
+     *   adds two diagonal edges at its bottom and drops two at its top.
+     *   Prefix sums along both diagonals give each edge as a difference of
+     *   two entries. The first row of a band is summed row by row from
+     *   prefix sums along the rows.
+     *
+     * The passes are loops over whole rows that the compiler vectorizes,
+     * and bands are stepped in parallel on a thread pool.
+     */
+    class larger_than_life final : public game
+    {
+    public:
+        /// rows per task of a generation; the scratch grid of a band has 2 radius + 1 more
+        static constexpr int BAND_ROWS = 64;
+
+        larger_than_life() = delete;
+        /// `threads` == 0 uses one thread per hardware thread.
+        larger_than_life(int width, int height, unsigned int threads = 1);
+
+        void populate(double density) override;
+        void clear() override;
+        void irritate(int x, int y) override;
+        void iterate() override;
+        void set_span(int x, int y, int length, bool alive) override;
+        void get_rows(int y, int count, int width, uint64_t *words) const override;
+        void set_rows(int y, int count, int width, uint64_t const *words) override;
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override;
+        uint64_t population() const override;
+        inline uint64_t cells_updated() const override
+        {
+            return static_cast<uint64_t>(width) * static_cast<uint64_t>(height);
+        }
+        bool get(int x, int y) const override;
+        void seed(unsigned long s) override;
+
+        void set(int x, int y, bool alive);
+        void set_rule(rules::ltl_rule const &r);
+        inline rules::ltl_rule const &rule() const
+        {
+            return rule_;
+        }
+
+        void set_threads(unsigned int threads);
+
+    private:
+        inline uint8_t const *row(int y) const
+        {
+            return plane_a.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width);
+        }
+        inline uint8_t *row(int y)
+        {
+            return plane_a.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width);
+        }
+
+        void step_band(std::size_t band);
+        // The counts of rows [y0, y1), each row `width` entries after the one before.
+        void count_moore(int y0, int y1, uint16_t *counts) const;
+        void count_von_neumann(int y0, int y1, uint16_t *counts) const;
+
+        const int width;
+        const int height;
+        rules::ltl_rule rule_{};
+        // 0 or 1 per cell
+        std::vector<uint8_t> plane_a;
+        std::vector<uint8_t> plane_b;
+        std::unique_ptr<util::thread_pool> pool;
+        util::counter_rng rng;
+    };
+}
+
+#endif // __LARGER_THAN_LIFE_HPP__
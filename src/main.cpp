@@ -1,13 +1,192 @@
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
 #include <memory>
+#include <string>
 
 #include "app.hpp"
+#include "kernels/life.hpp"
+#include "rule.hpp"
+#include "packed-life.hpp"
+#include "recorder.hpp"
+#include "util.hpp"
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char *argv[])
+namespace
 {
-    auto a = std::make_unique<app>();
+    void usage(char const *argv0)
+    {
+        std::cerr << "Usage: " << argv0 << " [--engine classic|packed|sparse|hashlife|generations|ltl] [--width W] [--height H] [--threads N] [--workers N] [--step K] [--rate GENS_PER_SEC] [--rule B3/S23] [--seed S] [--density P] [--history MB] [--pattern FILE | --restore SNAPSHOT] [--record FILE.y4m|FILE.png|FILE.gif [--record-every N] [--record-fps F] [--record-policy drop|block]] [--kernel NAME] [--kernel-report]" << std::endl;
+    }
+
+    // Steps a random board with each kernel the CPU supports and prints generations per second.
+    void kernel_report()
+    {
+        constexpr int SIZE = 2048;
+        constexpr auto MIN_DURATION = std::chrono::milliseconds(500);
+        for (auto const &k : kernels::supported())
+        {
+            games::packed_life game(SIZE, SIZE);
+            game.set_kernel(k);
+            game.populate(0.5);
+            long long generations = 0;
+            auto const t0 = std::chrono::steady_clock::now();
+            auto t1 = t0;
+            do
+            {
+                game.iterate();
+                ++generations;
+                t1 = std::chrono::steady_clock::now();
+            } while (t1 - t0 < MIN_DURATION);
+            double const seconds = std::chrono::duration<double>(t1 - t0).count();
+            std::cout << std::left << std::setw(8) << k.name
+                      << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(10) << (static_cast<double>(generations) / seconds) << " gens/s ("
+                      << SIZE << "x" << SIZE << ")" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    games::settings settings;
+    std::string pattern;
+    std::string restore;
+    // 0 = as large as the window
+    int world_width = 0;
+    int world_height = 0;
+    recording::options record;
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((std::strcmp(argv[i], "--engine") == 0 || std::strcmp(argv[i], "-e") == 0) && i + 1 < argc)
+        {
+            settings.engine = argv[++i];
+        }
+        else if ((std::strcmp(argv[i], "--width") == 0 || std::strcmp(argv[i], "-w") == 0) && i + 1 < argc)
+        {
+            world_width = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--height") == 0 || std::strcmp(argv[i], "-h") == 0) && i + 1 < argc)
+        {
+            world_height = std::atoi(argv[++i]);
+        }
+        else if ((std::strcmp(argv[i], "--threads") == 0 || std::strcmp(argv[i], "-t") == 0) && i + 1 < argc)
+        {
+            settings.threads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc)
+        {
+            settings.workers = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc)
+        {
+            settings.step = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+        {
+            settings.rate = std::strtod(argv[++i], nullptr);
+        }
+        else if ((std::strcmp(argv[i], "--rule") == 0 || std::strcmp(argv[i], "-r") == 0) && i + 1 < argc)
+        {
+            // a Life-like or Generations rule, or else a Larger-than-Life one
+            if (!rules::from_name(argv[++i], settings.rule) && !rules::from_name(argv[i], settings.ltl))
+            {
+                std::cerr << "\u001b[31;1mInvalid rule:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            settings.seed = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--density") == 0 && i + 1 < argc)
+        {
+            settings.density = std::strtod(argv[++i], nullptr);
+        }
+        else if (std::strcmp(argv[i], "--history") == 0 && i + 1 < argc)
+        {
+            settings.history = static_cast<std::size_t>(std::strtod(argv[++i], nullptr) * 1024 * 1024);
+        }
+        else if (std::strcmp(argv[i], "--pattern") == 0 && i + 1 < argc)
+        {
+            pattern = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--restore") == 0 && i + 1 < argc)
+        {
+            restore = argv[++i];
+            settings.snapshots = true;
+        }
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            record.path = argv[++i];
+            if (!recording::format_of(record.path, record.fmt))
+            {
+                std::cerr << "\u001b[31;1mUnknown recording format:\u001b[0m " << record.path << " is not .y4m, .png or .gif" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--record-every") == 0 && i + 1 < argc)
+        {
+            record.every = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--record-fps") == 0 && i + 1 < argc)
+        {
+            record.fps = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--record-policy") == 0 && i + 1 < argc)
+        {
+            if (!recording::from_name(argv[++i], record.when_full))
+            {
+                std::cerr << "\u001b[31;1mUnknown recording policy:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            if (!kernels::select(argv[++i]))
+            {
+                std::cerr << "\u001b[31;1mKernel not supported on this CPU:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--kernel-report") == 0)
+        {
+            kernel_report();
+            return EXIT_SUCCESS;
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (record.every == 0 || record.fps <= 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    // known, so that snapshots record it
+    if (settings.seed == 0)
+    {
+        settings.seed = util::make_seed();
+    }
+    auto a = std::make_unique<app>(settings, world_width, world_height);
     if (a->is_ready())
     {
+        if (!pattern.empty())
+        {
+            a->load_pattern(pattern);
+        }
+        if (!restore.empty())
+        {
+            a->restore_snapshot(restore);
+        }
+        a->set_recording(record);
+        if (!record.path.empty())
+        {
+            a->start_recording(record.path);
+        }
         a->loop();
     }
     return EXIT_SUCCESS;
@@ -0,0 +1,229 @@
+#include "mapped-file.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace util
+{
+    mapped_file::~mapped_file()
+    {
+        close();
+    }
+
+    bool mapped_file::fail(std::string const &message)
+    {
+#ifdef _WIN32
+        error_ = message + " (error " + std::to_string(GetLastError()) + ")";
+#else
+        error_ = message + ": " + std::strerror(errno);
+#endif
+        close();
+        return false;
+    }
+
+#ifdef _WIN32
+    bool mapped_file::open(std::string const &path)
+    {
+        close();
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            file = nullptr;
+            return fail("Cannot open " + path);
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            return fail("Cannot map " + path);
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            return fail("Cannot map " + path);
+        }
+        data_ = static_cast<uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data_ == nullptr)
+        {
+            return fail("Cannot map " + path);
+        }
+        size_ = static_cast<std::size_t>(size.QuadPart);
+        return true;
+    }
+
+    bool mapped_file::create(std::string const &path, std::size_t size)
+    {
+        close();
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            file = nullptr;
+            return fail("Cannot create " + path);
+        }
+        uint64_t const size64 = size;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), nullptr);
+        if (mapping == nullptr)
+        {
+            return fail("Cannot map " + path);
+        }
+        data_ = static_cast<uint8_t *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size));
+        if (data_ == nullptr)
+        {
+            return fail("Cannot map " + path);
+        }
+        size_ = size;
+        return true;
+    }
+
+    bool mapped_file::sync()
+    {
+        if (data_ == nullptr)
+        {
+            return true;
+        }
+        if (!FlushViewOfFile(data_, 0) || !FlushFileBuffers(file))
+        {
+            error_ = "Cannot write the mapping back to the disk (error " + std::to_string(GetLastError()) + ")";
+            return false;
+        }
+        return true;
+    }
+
+    bool sync_directory_of(std::string const & /* path */, std::string & /* error */)
+    {
+        // NTFS journals the rename itself
+        return true;
+    }
+
+    void mapped_file::close()
+    {
+        if (data_ != nullptr)
+        {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != nullptr)
+        {
+            CloseHandle(file);
+        }
+        data_ = nullptr;
+        mapping = nullptr;
+        file = nullptr;
+        size_ = 0;
+    }
+#else
+    bool mapped_file::open(std::string const &path)
+    {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return fail("Cannot open " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            return fail("Cannot open " + path);
+        }
+        if (st.st_size == 0)
+        {
+            errno = EINVAL;
+            return fail("Cannot map " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void *p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            return fail("Cannot map " + path);
+        }
+        data_ = static_cast<uint8_t *>(p);
+        // snapshots are read front to back
+        madvise(p, size_, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    bool mapped_file::create(std::string const &path, std::size_t size)
+    {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return fail("Cannot create " + path);
+        }
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            return fail("Cannot resize " + path);
+        }
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            return fail("Cannot map " + path);
+        }
+        data_ = static_cast<uint8_t *>(p);
+        size_ = size;
+        return true;
+    }
+
+    bool mapped_file::sync()
+    {
+        if (data_ == nullptr)
+        {
+            return true;
+        }
+        if (msync(data_, size_, MS_SYNC) != 0 || fsync(fd) != 0)
+        {
+            error_ = std::string("Cannot write the mapping back to the disk: ") + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    bool sync_directory_of(std::string const &path, std::string &error)
+    {
+        std::string::size_type const slash = path.find_last_of('/');
+        std::string const directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int const dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir < 0)
+        {
+            error = "Cannot open " + directory + ": " + std::strerror(errno);
+            return false;
+        }
+        bool const synced = fsync(dir) == 0;
+        if (!synced)
+        {
+            error = "Cannot sync " + directory + ": " + std::strerror(errno);
+        }
+        ::close(dir);
+        return synced;
+    }
+
+    void mapped_file::close()
+    {
+        if (data_ != nullptr)
+        {
+            munmap(data_, size_);
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        fd = -1;
+    }
+#endif
+}
@@ -0,0 +1,72 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace util
+{
+    /**
+     * A whole file mapped into memory, either read-only or created with a
+     * fixed size for writing. Pages are read from or written back to the
+     * file by the operating system as they are touched, so nothing is
+     * copied through a buffer of our own.
+     */
+    class mapped_file
+    {
+    public:
+        mapped_file() = default;
+        mapped_file(mapped_file const &) = delete;
+        mapped_file &operator=(mapped_file const &) = delete;
+        ~mapped_file();
+
+        /// Maps an existing file for reading. Returns false on errors, see error().
+        bool open(std::string const &path);
+        /// Creates or truncates the file at `path` to `size` bytes and maps it for writing.
+        bool create(std::string const &path, std::size_t size);
+        /// Writes the changes of a created file to the disk and waits until they are there. Returns false on errors, see error().
+        bool sync();
+        /// Unmaps the file; changes of a created file are written back by the operating system.
+        void close();
+
+        inline uint8_t *data()
+        {
+            return data_;
+        }
+        inline uint8_t const *data() const
+        {
+            return data_;
+        }
+        inline std::size_t size() const
+        {
+            return size_;
+        }
+        inline std::string const &error() const
+        {
+            return error_;
+        }
+
+    private:
+        bool fail(std::string const &message);
+
+        uint8_t *data_{nullptr};
+        std::size_t size_{0};
+#ifdef _WIN32
+        void *file{nullptr};
+        void *mapping{nullptr};
+#else
+        int fd{-1};
+#endif
+        std::string error_;
+    };
+
+    /**
+     * Waits until the entry of `path` in its directory is on the disk, as
+     * after creating or renaming the file. Returns false with a message in
+     * `error` if it is not; does nothing where directories cannot be synced.
+     */
+    bool sync_directory_of(std::string const &path, std::string &error);
+}
+
+#endif // __MAPPED_FILE_HPP__
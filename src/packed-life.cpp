@@ -0,0 +1,563 @@
+#include "packed-life.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "board-hash.hpp"
+#include "game-of-life.hpp"
+#include "kernels/life-impl.hpp"
+
+namespace games
+{
+    packed_life::packed_life(int width, int height, unsigned int threads)
+        : width(width), height(height)
+        , words_per_row((static_cast<std::size_t>(width) + 63) / 64)
+        , last_word_mask((width % 64) == 0 ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1)
+        , tiles_x((words_per_row + TILE_WORDS - 1) / TILE_WORDS)
+        , tiles_y((static_cast<std::size_t>(height) + TILE_ROWS - 1) / TILE_ROWS)
+        , kernel(&kernels::active())
+    {
+        plane_a.assign(words_per_row * static_cast<std::size_t>(height), 0);
+        plane_b.assign(words_per_row * static_cast<std::size_t>(height), 0);
+        changed.assign(tiles_x * tiles_y, 0);
+        next_changed.assign(tiles_x * tiles_y, 0);
+        active.assign(tiles_x * tiles_y, 0);
+        band_versions.assign(tiles_y, 0);
+        tile_versions.assign(tiles_x * tiles_y, 0);
+        tile_hashes.assign(tiles_x * tiles_y, 0);
+        hash_stale.assign(tiles_x * tiles_y, 1);
+        density_stale.assign(tiles_x * tiles_y, 0);
+        band_hash_delta.assign(tiles_y, 0);
+        work.reserve(tiles_x * tiles_y);
+        stats.total = tiles_x * tiles_y;
+        touch_all();
+        set_threads(threads);
+        seed(util::make_seed());
+    }
+
+    void packed_life::seed(unsigned long s)
+    {
+        rng.seed(s);
+    }
+
+    void packed_life::populate(double density)
+    {
+        uint32_t const fill = rng.next_fill();
+        uint32_t const p = util::fixed_density(density);
+        std::size_t const bands = (static_cast<std::size_t>(height) + TILE_ROWS - 1) / TILE_ROWS;
+        auto band = [&](std::size_t b)
+        {
+            int const y = static_cast<int>(b) * TILE_ROWS;
+            rng.fill_rows(fill, p, width, y, std::min(TILE_ROWS, height - y), row(plane_a, y));
+        };
+        if (pool)
+        {
+            pool->parallel_for(bands, band);
+        }
+        else
+        {
+            for (std::size_t b = 0; b < bands; ++b)
+            {
+                band(b);
+            }
+        }
+        touch_all();
+    }
+
+    void packed_life::clear()
+    {
+        std::fill(plane_a.begin(), plane_a.end(), 0);
+        std::fill(plane_b.begin(), plane_b.end(), 0);
+        touch_all();
+    }
+
+    void packed_life::irritate(int const x, int const y)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                set(x + dx, y + dy, (rng() & 1) != 0);
+            }
+        }
+    }
+
+    void packed_life::set(int x, int y, bool alive)
+    {
+        unsigned int const cx = mod(x, width);
+        unsigned int const cy = mod(y, height);
+        uint64_t &word = row(plane_a, static_cast<int>(cy))[cx / 64];
+        uint64_t const bit = uint64_t{1} << (cx % 64);
+        word = alive ? (word | bit) : (word & ~bit);
+        touch(static_cast<int>(cx), static_cast<int>(cy));
+    }
+
+    void packed_life::set_span(int x, int y, int length, bool alive)
+    {
+        length = std::min(length, width);
+        int const cy = static_cast<int>(mod(y, height));
+        uint64_t *r = row(plane_a, cy);
+        std::size_t begin = mod(x, width);
+        while (length > 0)
+        {
+            std::size_t const end = std::min(begin + static_cast<std::size_t>(length), static_cast<std::size_t>(width));
+            for (std::size_t w = begin / 64; w * 64 < end; ++w)
+            {
+                std::size_t const lo = std::max(begin, w * 64) - w * 64;
+                std::size_t const hi = std::min(end, w * 64 + 64) - w * 64;
+                uint64_t const mask = (hi == 64 ? ~uint64_t{0} : (uint64_t{1} << hi) - 1) & ~((uint64_t{1} << lo) - 1);
+                r[w] = alive ? (r[w] | mask) : (r[w] & ~mask);
+            }
+            for (std::size_t tx = begin / 64 / TILE_WORDS; tx <= (end - 1) / 64 / TILE_WORDS; ++tx)
+            {
+                touch(static_cast<int>(tx * TILE_WORDS * 64), cy);
+            }
+            length -= static_cast<int>(end - begin);
+            begin = 0;
+        }
+    }
+
+    bool packed_life::get(int x, int y) const
+    {
+        unsigned int const cx = mod(x, width);
+        return ((row(plane_a, static_cast<int>(mod(y, height)))[cx / 64] >> (cx % 64)) & 1) != 0;
+    }
+
+    // Marks the tile holding cell (x, y) as modified from outside the simulation.
+    void packed_life::touch(int x, int y)
+    {
+        std::size_t const tile = static_cast<std::size_t>(y / TILE_ROWS) * tiles_x + static_cast<std::size_t>(x) / 64 / TILE_WORDS;
+        changed[tile] = 1;
+        band_versions[static_cast<std::size_t>(y / TILE_ROWS)] = ++version_clock;
+        tile_versions[tile] = version_clock;
+        hash_stale[tile] = 1;
+        mark_density(tile);
+    }
+
+    void packed_life::get_rows(int y, int count, int w, uint64_t *words) const
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::get_rows(y, count, w, words);
+            return;
+        }
+        // the planes are in the same layout
+        std::memcpy(words, row(plane_a, y), static_cast<std::size_t>(count) * words_per_row * sizeof(uint64_t));
+    }
+
+    void packed_life::set_rows(int y, int count, int w, uint64_t const *words)
+    {
+        if (w != width || y < 0 || y + count > height)
+        {
+            game::set_rows(y, count, w, words);
+            return;
+        }
+        std::memcpy(row(plane_a, y), words, static_cast<std::size_t>(count) * words_per_row * sizeof(uint64_t));
+        for (int r = y; r < y + count; ++r)
+        {
+            row(plane_a, r)[words_per_row - 1] &= last_word_mask;
+        }
+        for (int ty = y / TILE_ROWS; count > 0 && ty <= (y + count - 1) / TILE_ROWS; ++ty)
+        {
+            for (std::size_t tx = 0; tx < tiles_x; ++tx)
+            {
+                touch(static_cast<int>(tx * TILE_WORDS * 64), ty * TILE_ROWS);
+            }
+        }
+    }
+
+    uint64_t packed_life::rows_version(int y, int count) const
+    {
+        if (y < 0 || count <= 0 || y + count > height)
+        {
+            return 0;
+        }
+        auto const first = band_versions.begin() + y / TILE_ROWS;
+        auto const last = band_versions.begin() + (y + count - 1) / TILE_ROWS + 1;
+        return *std::max_element(first, last);
+    }
+
+    uint64_t packed_life::area_version(int x, int y, int count_x, int count) const
+    {
+        if (x < 0 || y < 0 || count_x <= 0 || count <= 0 || x + count_x > width || y + count > height)
+        {
+            return 0;
+        }
+        std::size_t const tx0 = static_cast<std::size_t>(x) / 64 / TILE_WORDS;
+        std::size_t const tx1 = static_cast<std::size_t>(x + count_x - 1) / 64 / TILE_WORDS;
+        uint64_t version = 0;
+        for (std::size_t ty = static_cast<std::size_t>(y / TILE_ROWS); ty <= static_cast<std::size_t>((y + count - 1) / TILE_ROWS); ++ty)
+        {
+            auto const first = tile_versions.begin() + static_cast<std::ptrdiff_t>(ty * tiles_x + tx0);
+            version = std::max(version, *std::max_element(first, first + static_cast<std::ptrdiff_t>(tx1 - tx0 + 1)));
+        }
+        return version;
+    }
+
+    static_assert(packed_life::TILE_ROWS == HASH_TILE_ROWS && packed_life::TILE_WORDS == HASH_TILE_WORDS);
+
+    uint64_t packed_life::hash_tile(std::vector<uint64_t> const &plane, std::size_t tx, std::size_t ty) const
+    {
+        int const y0 = static_cast<int>(ty) * TILE_ROWS;
+        std::size_t const w0 = tx * TILE_WORDS;
+        return tile_hash(row(plane, y0) + w0, words_per_row, std::min(TILE_ROWS, height - y0),
+                         std::min(TILE_WORDS, words_per_row - w0), tile_salt(static_cast<int64_t>(tx), static_cast<int64_t>(ty)));
+    }
+
+    uint64_t packed_life::hash() const
+    {
+        hashing = true;
+        for (std::size_t ty = 0; ty < tiles_y; ++ty)
+        {
+            for (std::size_t tx = 0; tx < tiles_x; ++tx)
+            {
+                std::size_t const tile = ty * tiles_x + tx;
+                if (hash_stale[tile])
+                {
+                    uint64_t const h = hash_tile(plane_a, tx, ty);
+                    board_hash ^= tile_hashes[tile] ^ h;
+                    tile_hashes[tile] = h;
+                    hash_stale[tile] = 0;
+                }
+            }
+        }
+        return board_hash ^ EMPTY_BOARD_HASH;
+    }
+
+    void packed_life::mark_density(std::size_t tile)
+    {
+        if (counting && !density_stale[tile])
+        {
+            density_stale[tile] = 1;
+            density_queue.push_back(tile);
+        }
+    }
+
+    // Counts the squares of a tile into the density pyramid.
+    void packed_life::count_tile(std::size_t tile) const
+    {
+        std::size_t const tx = tile % tiles_x;
+        std::size_t const ty = tile / tiles_x;
+        int const y0 = static_cast<int>(ty) * TILE_ROWS;
+        int const y1 = std::min(height, y0 + TILE_ROWS);
+        static_assert(DENSITY_SHIFT == 5, "a word holds two squares across");
+        for (std::size_t i = 0; i < TILE_WORDS; ++i)
+        {
+            std::size_t const w = tx * TILE_WORDS + i;
+            if (w >= words_per_row)
+            {
+                break;
+            }
+            column_count count;
+            for (int y = y0; y < y1; ++y)
+            {
+                count.add(row(plane_a, y)[w]);
+            }
+            uint64_t const q = count.quarters();
+            uint64_t const halves[2] = {(q & 0xffff) + ((q >> 16) & 0xffff), ((q >> 32) & 0xffff) + (q >> 48)};
+            for (std::size_t h = 0; h < 2; ++h)
+            {
+                int64_t const sx = static_cast<int64_t>(w * 2 + h);
+                int64_t const sy = static_cast<int64_t>(ty);
+                if (densities.at(0, sx, sy) != halves[h])
+                {
+                    densities.set(sx, sy, halves[h]);
+                }
+            }
+        }
+    }
+
+    uint64_t packed_life::population() const
+    {
+        constexpr std::size_t BLOCK = 512;
+        uint64_t n = 0;
+        for (std::size_t i = 0; i < plane_a.size(); i += BLOCK)
+        {
+            column_count count;
+            for (std::size_t j = i; j < std::min(plane_a.size(), i + BLOCK); ++j)
+            {
+                count.add(plane_a[j]);
+            }
+            n += count.total();
+        }
+        return n;
+    }
+
+    void packed_life::get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const
+    {
+        std::fill_n(counts, static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows), 0);
+        if (level > MAX_DENSITY_LEVEL)
+        {
+            return;
+        }
+        int64_t const size = int64_t{1} << level;
+        if (level < DENSITY_SHIFT)
+        {
+            // a square lies within one word
+            uint64_t const mask = (uint64_t{1} << size) - 1;
+            for (int r = 0; r < rows; ++r)
+            {
+                int64_t const y0 = y + r * size;
+                if (y0 < 0 || y0 >= height)
+                {
+                    continue;
+                }
+                int const y1 = static_cast<int>(std::min<int64_t>(height, y0 + size));
+                for (int c = 0; c < columns; ++c)
+                {
+                    int64_t const x0 = x + c * size;
+                    if (x0 < 0 || x0 >= width)
+                    {
+                        continue;
+                    }
+                    std::size_t const w = static_cast<std::size_t>(x0 / 64);
+                    int const shift = static_cast<int>(x0 % 64);
+                    uint64_t n = 0;
+                    for (int cy = static_cast<int>(y0); cy < y1; ++cy)
+                    {
+                        n += static_cast<uint64_t>(std::popcount((row(plane_a, cy)[w] >> shift) & mask));
+                    }
+                    counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(c)] = n;
+                }
+            }
+            return;
+        }
+        if (!counting)
+        {
+            counting = true;
+            for (std::size_t tile = 0; tile < tiles_x * tiles_y; ++tile)
+            {
+                density_stale[tile] = 1;
+                density_queue.push_back(tile);
+            }
+        }
+        for (std::size_t tile : density_queue)
+        {
+            count_tile(tile);
+            density_stale[tile] = 0;
+        }
+        density_queue.clear();
+        densities.update();
+        for (int r = 0; r < rows; ++r)
+        {
+            for (int c = 0; c < columns; ++c)
+            {
+                counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(c)] =
+                    densities.at(level - DENSITY_SHIFT, (x >> level) + c, (y >> level) + r);
+            }
+        }
+    }
+
+    void packed_life::touch_all()
+    {
+        std::fill(changed.begin(), changed.end(), 1);
+        std::fill(band_versions.begin(), band_versions.end(), ++version_clock);
+        std::fill(tile_versions.begin(), tile_versions.end(), version_clock);
+        std::fill(hash_stale.begin(), hash_stale.end(), 1);
+        for (std::size_t tile = 0; tile < tiles_x * tiles_y; ++tile)
+        {
+            mark_density(tile);
+        }
+    }
+
+    void packed_life::set_threads(unsigned int threads)
+    {
+        pool.reset();
+        if (threads != 1)
+        {
+            pool = std::make_unique<util::thread_pool>(threads);
+        }
+    }
+
+    void packed_life::set_rule(rules::rule const &r)
+    {
+        rule_ = r;
+        // tiles that were stable under the old rule need not be under the new one
+        touch_all();
+    }
+
+    void packed_life::set_kernel(kernels::life_kernel const &k)
+    {
+        kernel = &k;
+    }
+
+    void packed_life::step_span(uint64_t const *above, uint64_t const *current, uint64_t const *below, uint64_t *out,
+                                std::size_t begin, std::size_t end, uint8_t *changed) const
+    {
+        std::size_t const n = words_per_row;
+        unsigned int const last_bit = static_cast<unsigned int>(width - 1) % 64;
+        // neighbor to the west (x - 1) shifted into position x, wrapping at x = 0
+        auto west = [&](uint64_t const *r, std::size_t w)
+        {
+            uint64_t const carry = w > 0 ? r[w - 1] >> 63 : (r[n - 1] >> last_bit) & 1;
+            return (r[w] << 1) | carry;
+        };
+        // neighbor to the east (x + 1) shifted into position x, wrapping at x = width - 1
+        auto east = [&](uint64_t const *r, std::size_t w)
+        {
+            uint64_t const carry = w + 1 < n ? r[w + 1] << 63 : (r[0] & 1) << last_bit;
+            return (r[w] >> 1) | carry;
+        };
+        auto edge = [&](std::size_t w)
+        {
+            return kernels::any_rule{rule_}.apply<kernels::scalar_traits>(
+                west(above, w), above[w], east(above, w),
+                west(current, w), current[w], east(current, w),
+                west(below, w), below[w], east(below, w));
+        };
+        // the first and last word of a row wrap around, the kernel gets the words in between
+        std::size_t const first = std::max<std::size_t>(begin, 1);
+        std::size_t const last = std::min(end, n - 1);
+        if (begin == 0)
+        {
+            out[0] = edge(0);
+        }
+        if (first < last)
+        {
+            kernel->step(rule_, above, current, below, out, first, last, changed);
+        }
+        if (end == n && n > 1)
+        {
+            out[n - 1] = edge(n - 1);
+        }
+        if (end == n)
+        {
+            out[n - 1] &= last_word_mask;
+            changed[(n - 1) / TILE_WORDS] |= out[n - 1] != current[n - 1];
+        }
+        if (begin == 0)
+        {
+            changed[0] |= out[0] != current[0];
+        }
+    }
+
+    void packed_life::process_band(std::size_t ty)
+    {
+        int const y0 = static_cast<int>(ty) * TILE_ROWS;
+        int const y1 = std::min(height, y0 + TILE_ROWS);
+        uint8_t const *band_active = active.data() + ty * tiles_x;
+        uint8_t *band_changed = next_changed.data() + ty * tiles_x;
+        std::fill(band_changed, band_changed + tiles_x, 0);
+        for (int y = y0; y < y1; ++y)
+        {
+            uint64_t const *above = row(plane_a, y == 0 ? height - 1 : y - 1);
+            uint64_t const *current = row(plane_a, y);
+            uint64_t const *below = row(plane_a, y == height - 1 ? 0 : y + 1);
+            uint64_t *out = row(plane_b, y);
+            for (std::size_t tx = 0; tx < tiles_x;)
+            {
+                if (!band_active[tx])
+                {
+                    ++tx;
+                    continue;
+                }
+                std::size_t run_end = tx + 1;
+                while (run_end < tiles_x && band_active[run_end])
+                {
+                    ++run_end;
+                }
+                step_span(above, current, below, out,
+                          tx * TILE_WORDS, std::min(words_per_row, run_end * TILE_WORDS), band_changed);
+                tx = run_end;
+            }
+        }
+        band_hash_delta[ty] = 0;
+        for (std::size_t tx = 0; tx < tiles_x; ++tx)
+        {
+            if (!band_changed[tx])
+            {
+                continue;
+            }
+            std::size_t const tile = ty * tiles_x + tx;
+            hash_stale[tile] = 1;
+            if (hashing)
+            {
+                // while the tile is still in cache
+                uint64_t const h = hash_tile(plane_b, tx, ty);
+                band_hash_delta[ty] ^= tile_hashes[tile] ^ h;
+                tile_hashes[tile] = h;
+                hash_stale[tile] = 0;
+            }
+        }
+    }
+
+    void packed_life::iterate()
+    {
+        // a tile needs stepping if it or one of its neighbors changed last generation
+        std::fill(active.begin(), active.end(), 0);
+        for (std::size_t ty = 0; ty < tiles_y; ++ty)
+        {
+            for (std::size_t tx = 0; tx < tiles_x; ++tx)
+            {
+                if (!changed[ty * tiles_x + tx])
+                {
+                    continue;
+                }
+                for (std::size_t dy = tiles_y - 1; dy <= tiles_y + 1; ++dy)
+                {
+                    for (std::size_t dx = tiles_x - 1; dx <= tiles_x + 1; ++dx)
+                    {
+                        active[((ty + dy) % tiles_y) * tiles_x + (tx + dx) % tiles_x] = 1;
+                    }
+                }
+            }
+        }
+        work.clear();
+        stats.stepped = 0;
+        for (std::size_t ty = 0; ty < tiles_y; ++ty)
+        {
+            bool busy = false;
+            for (std::size_t tile = ty * tiles_x; tile < (ty + 1) * tiles_x; ++tile)
+            {
+                busy |= active[tile] != 0;
+                stats.stepped += active[tile];
+            }
+            if (busy)
+            {
+                work.push_back(ty);
+            }
+            else
+            {
+                // skipped tiles are unchanged by definition
+                std::fill_n(next_changed.begin() + static_cast<std::ptrdiff_t>(ty * tiles_x), tiles_x, 0);
+            }
+        }
+        if (pool)
+        {
+            pool->parallel_for(work.size(), [this](std::size_t i)
+                               { process_band(work[i]); });
+        }
+        else
+        {
+            for (std::size_t ty : work)
+            {
+                process_band(ty);
+            }
+        }
+        ++version_clock;
+        for (std::size_t ty : work)
+        {
+            board_hash ^= band_hash_delta[ty];
+            auto const band = next_changed.begin() + static_cast<std::ptrdiff_t>(ty * tiles_x);
+            if (std::find(band, band + static_cast<std::ptrdiff_t>(tiles_x), 1) == band + static_cast<std::ptrdiff_t>(tiles_x))
+            {
+                continue;
+            }
+            band_versions[ty] = version_clock;
+            for (std::size_t tx = 0; tx < tiles_x; ++tx)
+            {
+                if (band[static_cast<std::ptrdiff_t>(tx)])
+                {
+                    tile_versions[ty * tiles_x + tx] = version_clock;
+                    if (counting)
+                    {
+                        mark_density(ty * tiles_x + tx);
+                    }
+                }
+            }
+        }
+        std::swap(plane_a, plane_b);
+        std::swap(changed, next_changed);
+    }
+}
@@ -0,0 +1,167 @@
+#ifndef __PACKED_LIFE_HPP__
+#define __PACKED_LIFE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "counter-rng.hpp"
+#include "density-pyramid.hpp"
+#include "game.hpp"
+#include "kernels/life.hpp"
+#include "rule.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+
+namespace games
+{
+    /**
+     * Game of Life, or any other Life-like rule, on a torus with one bit per
+     * cell.
+     *
+     * Every row is stored as `words_per_row` 64-bit words, cell `x` living in
+     * bit `x % 64` of word `x / 64`. Bits past `width` in the last word of a row
+     * are always kept zero. A generation is computed with bit-sliced adders,
+     * 64 cells per word and as many words per instruction as the kernel picked
+     * at startup allows; the result is identical to `game_of_life`.
+     *
+     * The board is cut into tiles of TILE_ROWS rows by TILE_WORDS words. Only
+     * tiles that changed in the previous generation, and their neighbors, are
+     * stepped; all others are known to stay as they are. Runs of adjacent
+     * active tiles are handed to the kernel as one span. With more than one
+     * thread the rows of tiles of a generation are spread over a persistent
+     * thread pool. Each tile only reads the previous generation, so the
+     * result does not depend on the number of threads.
+     */
+    class packed_life final : public game
+    {
+    public:
+        static constexpr int TILE_ROWS = 32;
+        static constexpr std::size_t TILE_WORDS = kernels::CHUNK_WORDS;
+
+        struct tile_stats
+        {
+            std::size_t total{0};
+            /// tiles whose cells were computed
+            std::size_t stepped{0};
+        };
+
+        packed_life() = delete;
+        /// `threads` == 0 uses one thread per hardware thread.
+        packed_life(int width, int height, unsigned int threads = 1);
+
+        void populate(double density) override;
+        void clear() override;
+        void irritate(int x, int y) override;
+        void iterate() override;
+        void set_span(int x, int y, int length, bool alive) override;
+        void get_rows(int y, int count, int width, uint64_t *words) const override;
+        void set_rows(int y, int count, int width, uint64_t const *words) override;
+        uint64_t rows_version(int y, int count) const override;
+        uint64_t area_version(int x, int y, int count_x, int count) const override;
+        uint64_t hash() const override;
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override;
+        uint64_t population() const override;
+        /// the cells of the tiles stepped
+        inline uint64_t cells_updated() const override
+        {
+            return static_cast<uint64_t>(stats.stepped) * TILE_ROWS * TILE_WORDS * 64;
+        }
+        bool get(int x, int y) const override;
+        void seed(unsigned long s) override;
+
+        void set(int x, int y, bool alive);
+
+        void set_threads(unsigned int threads);
+        inline unsigned int threads() const
+        {
+            return pool ? pool->size() : 1;
+        }
+
+        void set_rule(rules::rule const &r);
+        inline rules::rule const &rule() const
+        {
+            return rule_;
+        }
+
+        void set_kernel(kernels::life_kernel const &k);
+        inline kernels::life_kernel const &current_kernel() const
+        {
+            return *kernel;
+        }
+
+        /// Tile counters of the last generation.
+        inline tile_stats const &last_tile_stats() const
+        {
+            return stats;
+        }
+
+    private:
+        // squares of level 0 of the density pyramid are 2^DENSITY_SHIFT cells across
+        static constexpr int DENSITY_SHIFT = 5;
+
+        inline uint64_t *row(std::vector<uint64_t> &plane, int y)
+        {
+            return plane.data() + static_cast<std::size_t>(y) * words_per_row;
+        }
+        inline uint64_t const *row(std::vector<uint64_t> const &plane, int y) const
+        {
+            return plane.data() + static_cast<std::size_t>(y) * words_per_row;
+        }
+        void step_span(uint64_t const *above, uint64_t const *current, uint64_t const *below, uint64_t *out,
+                       std::size_t begin, std::size_t end, uint8_t *changed) const;
+        void process_band(std::size_t ty);
+        void touch(int x, int y);
+        void touch_all();
+        uint64_t hash_tile(std::vector<uint64_t> const &plane, std::size_t tx, std::size_t ty) const;
+        void mark_density(std::size_t tile);
+        void count_tile(std::size_t tile) const;
+
+        const int width;
+        const int height;
+        const std::size_t words_per_row;
+        const uint64_t last_word_mask;
+        const std::size_t tiles_x;
+        const std::size_t tiles_y;
+        kernels::life_kernel const *kernel;
+        rules::rule rule_{rules::CONWAY};
+        std::vector<uint64_t> plane_a;
+        std::vector<uint64_t> plane_b;
+        // per tile: changed in the last generation / in the one being computed
+        std::vector<uint8_t> changed;
+        std::vector<uint8_t> next_changed;
+        // per tile: needs stepping in the generation being computed
+        std::vector<uint8_t> active;
+        // Per tile: tile_hash() when last hashed, and whether the tile changed
+        // since. The first hash() call turns on hashing changed tiles right
+        // after stepping them; until then nothing is hashed.
+        mutable std::vector<uint64_t> tile_hashes;
+        mutable std::vector<uint8_t> hash_stale;
+        // per row of tiles: what stepping it changed in board_hash
+        std::vector<uint64_t> band_hash_delta;
+        mutable uint64_t board_hash{0};
+        mutable bool hashing{false};
+        // Counts of the 32 x 32 squares of the board, and the tiles whose
+        // squares are out of date. The first get_density() call counts the
+        // whole board and turns on queueing tiles as they change; until
+        // then nothing is counted.
+        mutable density_pyramid densities{MAX_DENSITY_LEVEL - DENSITY_SHIFT + 1};
+        mutable std::vector<uint8_t> density_stale;
+        mutable std::vector<std::size_t> density_queue;
+        mutable bool counting{false};
+        // per row of tiles: value of `version_clock` when a cell in it last changed
+        std::vector<uint64_t> band_versions;
+        // per tile: the same
+        std::vector<uint64_t> tile_versions;
+        uint64_t version_clock{0};
+        // rows of tiles with at least one tile to step
+        std::vector<std::size_t> work;
+        tile_stats stats;
+        std::unique_ptr<util::thread_pool> pool;
+        util::counter_rng rng;
+    };
+}
+
+#endif // __PACKED_LIFE_HPP__
@@ -0,0 +1,296 @@
+#include "painter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Trail alphas are 0xff halved, all of the form 2^k - 1, so this one is free for live cells.
+    constexpr uint8_t ALIVE_SHADE = 0xfe;
+    constexpr uint8_t DEAD_SHADE = 0xff;
+
+    // changed rows at most this far apart are uploaded in one go
+    constexpr int JOIN_ROWS = 16;
+
+    inline uint32_t color(uint8_t shade)
+    {
+        return shade == ALIVE_SHADE ? painter::ALIVE_COLOR : (uint32_t{shade} << 24) | (painter::DEAD_COLOR & 0x00ffffff);
+    }
+
+    /**
+     * Colors of 64 cells. The shades are copied first, so the compiler
+     * knows they do not overlap `out`, and with the fixed count it turns
+     * this into SIMD code without a scalar remainder.
+     */
+    inline void color64(uint8_t const *shades, uint32_t *out)
+    {
+        uint8_t block[64];
+        std::memcpy(block, shades, sizeof(block));
+        for (int i = 0; i < 64; ++i)
+        {
+            out[i] = color(block[i]);
+        }
+    }
+
+    // squares this full or fuller are drawn opaque
+    constexpr double FULL_SQUARE = 0.5;
+
+    // Squares with any live cell at all stay visible.
+    inline uint8_t density_shade(uint64_t count, int level)
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        double const share = std::min(1.0, static_cast<double>(count) / std::ldexp(FULL_SQUARE, 2 * level));
+        return static_cast<uint8_t>(0x30 + std::lround(0xcf * std::sqrt(share)));
+    }
+
+    /**
+     * Colors of states 0 to `count` - 1: dead is clear, alive is
+     * ALIVE_COLOR, and the dying states are DEAD_COLOR with an alpha that
+     * falls evenly towards the last one.
+     */
+    std::array<uint32_t, 256> make_palette(int count)
+    {
+        std::array<uint32_t, 256> p{};
+        p[1] = painter::ALIVE_COLOR;
+        for (int k = 2; k < count; ++k)
+        {
+            uint32_t const alpha = static_cast<uint32_t>(0xff * (count - k) / (count - 1));
+            p[static_cast<std::size_t>(k)] = (alpha << 24) | (painter::DEAD_COLOR & 0x00ffffff);
+        }
+        return p;
+    }
+
+    inline void fade(uint64_t alive, uint8_t *shades, int n)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            uint8_t const s = shades[i];
+            shades[i] = ((alive >> i) & 1) != 0 ? ALIVE_SHADE : s == ALIVE_SHADE ? DEAD_SHADE : static_cast<uint8_t>(s >> 1);
+        }
+    }
+
+    constexpr uint64_t BYTES = 0x0101010101010101ull;
+
+    // 0xff in every byte that is 0, 0 in the others
+    inline uint64_t zero_bytes(uint64_t x)
+    {
+        uint64_t const high = ~(((x & (0x7f * BYTES)) + 0x7f * BYTES) | x | (0x7f * BYTES));
+        return (high >> 7) * 0xff;
+    }
+
+    // The same as fade() for 64 cells, eight at a time in the bytes of a word.
+    inline void fade64(uint64_t alive, uint8_t *shades)
+    {
+        for (int i = 0; i < 8; ++i, alive >>= 8)
+        {
+            uint64_t s;
+            std::memcpy(&s, shades + i * 8, sizeof(s));
+            // bit b of the byte of cells becomes byte b
+            uint64_t const live = ~zero_bytes(((alive & 0xff) * BYTES) & 0x8040201008040201ull);
+            uint64_t const died = zero_bytes(s ^ (ALIVE_SHADE * BYTES));
+            uint64_t const dead = (died & (DEAD_SHADE * BYTES)) | (~died & ((s >> 1) & (0x7f * BYTES)));
+            s = (live & (ALIVE_SHADE * BYTES)) | (~live & dead);
+            std::memcpy(shades + i * 8, &s, sizeof(s));
+        }
+    }
+}
+
+painter::painter(int width, int height)
+    : width_(width), height_(height)
+    , words_per_row((static_cast<std::size_t>(width) + 63) / 64)
+    , shown(words_per_row * static_cast<std::size_t>(height), 0)
+    , shades(static_cast<std::size_t>(width) * static_cast<std::size_t>(height), 0)
+    , fading(static_cast<std::size_t>(height), 0)
+    , density_row(static_cast<std::size_t>(width), 0)
+{
+}
+
+std::vector<painter::rows> const &painter::update(std::vector<uint64_t> const &cells, std::vector<uint64_t> const &versions, int band_rows)
+{
+    set_mode(0, 0);
+    // no version is ever this, so every band is compared the first time
+    versions_seen.resize(versions.size(), ~uint64_t{0});
+    for (std::size_t band = 0; band < versions.size(); ++band)
+    {
+        uint64_t const v = versions[band];
+        if (v != 0 && v == versions_seen[band])
+        {
+            continue;
+        }
+        versions_seen[band] = v;
+        int const y0 = static_cast<int>(band) * band_rows;
+        int const y1 = std::min(height_, y0 + band_rows);
+        for (int y = y0; y < y1; ++y)
+        {
+            std::size_t const at = static_cast<std::size_t>(y) * words_per_row;
+            if (std::memcmp(shown.data() + at, cells.data() + at, words_per_row * sizeof(uint64_t)) != 0)
+            {
+                std::memcpy(shown.data() + at, cells.data() + at, words_per_row * sizeof(uint64_t));
+                fading[static_cast<std::size_t>(y)] = FADE_FRAMES + 1;
+            }
+        }
+    }
+
+    return changed_rows();
+}
+
+std::vector<painter::rows> const &painter::update_density(std::vector<uint64_t> const &counts, int new_level)
+{
+    set_mode(new_level, 0);
+    std::vector<uint8_t> &row = density_row;
+    for (int y = 0; y < height_; ++y)
+    {
+        uint64_t const *in = counts.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+        for (std::size_t x = 0; x < row.size(); ++x)
+        {
+            row[x] = density_shade(in[x], level);
+        }
+        uint8_t *s = shades.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+        if (std::memcmp(s, row.data(), row.size()) != 0)
+        {
+            std::memcpy(s, row.data(), row.size());
+            // painted once, nothing fades
+            fading[static_cast<std::size_t>(y)] = 1;
+        }
+    }
+    return changed_rows();
+}
+
+std::vector<painter::rows> const &painter::update_states(std::vector<uint8_t> const &cells, int count)
+{
+    set_mode(0, count);
+    for (int y = 0; y < height_; ++y)
+    {
+        std::size_t const at = static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+        uint8_t *s = shades.data() + at;
+        if (std::memcmp(s, cells.data() + at, static_cast<std::size_t>(width_)) != 0)
+        {
+            std::memcpy(s, cells.data() + at, static_cast<std::size_t>(width_));
+            fading[static_cast<std::size_t>(y)] = 1;
+        }
+    }
+    return changed_rows();
+}
+
+void painter::reset()
+{
+    std::fill(shown.begin(), shown.end(), 0);
+    std::fill(shades.begin(), shades.end(), 0);
+    std::fill(fading.begin(), fading.end(), 0);
+    versions_seen.assign(versions_seen.size(), ~uint64_t{0});
+    repaint = true;
+}
+
+// Switching between cells, states and squares starts over from a blank picture.
+void painter::set_mode(int new_level, int new_states)
+{
+    if (new_level != level || new_states != states)
+    {
+        level = new_level;
+        states = new_states;
+        palette = make_palette(states);
+        reset();
+    }
+}
+
+// Rows still fading, each moved on by one frame; all of them after reset().
+std::vector<painter::rows> const &painter::changed_rows()
+{
+    dirty.clear();
+    for (int y = 0; y < height_; ++y)
+    {
+        uint8_t &left = fading[static_cast<std::size_t>(y)];
+        if (left == 0 && !repaint)
+        {
+            continue;
+        }
+        if (left != 0)
+        {
+            if (level == 0 && states == 0)
+            {
+                fade_row(y);
+            }
+            --left;
+        }
+        if (!dirty.empty() && y - dirty.back().end <= JOIN_ROWS)
+        {
+            dirty.back().end = y + 1;
+        }
+        else
+        {
+            dirty.push_back({y, y + 1});
+        }
+    }
+    repaint = false;
+    return dirty;
+}
+
+// Moves the shades of row y on by one frame.
+void painter::fade_row(int y)
+{
+    uint64_t const *in = shown.data() + static_cast<std::size_t>(y) * words_per_row;
+    uint8_t *s = shades.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+    int x = 0;
+    for (; x + 64 <= width_; x += 64)
+    {
+        fade64(in[x / 64], s + x);
+    }
+    if (x < width_)
+    {
+        fade(in[x / 64], s + x, width_ - x);
+    }
+}
+
+std::array<uint32_t, 256> painter::shade_colors() const
+{
+    if (level == 0 && states > 0)
+    {
+        return palette;
+    }
+    std::array<uint32_t, 256> colors{};
+    for (std::size_t s = 0; s < colors.size(); ++s)
+    {
+        colors[s] = level > 0 ? (uint32_t{static_cast<uint8_t>(s)} << 24) | (ALIVE_COLOR & 0x00ffffff) : color(static_cast<uint8_t>(s));
+    }
+    return colors;
+}
+
+void painter::paint(int begin, int end, void *out, int pitch) const
+{
+    for (int y = begin; level > 0 && y < end; ++y)
+    {
+        uint8_t const *s = shades.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+        uint32_t *p = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(out) + static_cast<std::ptrdiff_t>(y - begin) * pitch);
+        for (int x = 0; x < width_; ++x)
+        {
+            p[x] = (uint32_t{s[x]} << 24) | (ALIVE_COLOR & 0x00ffffff);
+        }
+    }
+    for (int y = begin; level == 0 && states > 0 && y < end; ++y)
+    {
+        uint8_t const *s = shades.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+        uint32_t *p = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(out) + static_cast<std::ptrdiff_t>(y - begin) * pitch);
+        for (int x = 0; x < width_; ++x)
+        {
+            p[x] = palette[s[x]];
+        }
+    }
+    for (int y = begin; level == 0 && states == 0 && y < end; ++y)
+    {
+        uint8_t const *s = shades.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+        uint32_t *p = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(out) + static_cast<std::ptrdiff_t>(y - begin) * pitch);
+        int x = 0;
+        for (; x + 64 <= width_; x += 64)
+        {
+            color64(s + x, p + x);
+        }
+        for (; x < width_; ++x)
+        {
+            p[x] = color(s[x]);
+        }
+    }
+}
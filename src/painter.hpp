@@ -0,0 +1,129 @@
+#ifndef __PAINTER_HPP__
+#define __PAINTER_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Colors the cells of the frames that are shown, apart from stepping them.
+ *
+ * Live cells are ALIVE_COLOR. A cell that dies turns DEAD_COLOR, and the
+ * alpha of its trail is halved with every frame after that until it is
+ * gone. What a cell looks like is kept as one byte, so the colors of any
+ * rows can be written again at any time without reading them back, which
+ * is what a locked streaming texture needs.
+ *
+ * update() takes the cells of the next frame, skips bands of rows whose
+ * game::rows_version() did not move, compares the others with the frame
+ * before, and returns the runs of rows whose colors changed: rows with
+ * cells that changed, and rows with trails still fading. Only those need
+ * to be painted and uploaded.
+ *
+ * Zoomed out, update_density() takes live cell counts per square instead,
+ * and a square is drawn in ALIVE_COLOR with an alpha that grows with the
+ * share of its cells that are alive. Trails are not kept at that scale.
+ *
+ * Cells of a Generations rule come as one state per byte through
+ * update_states() and are painted through a palette of 256 colors:
+ * alive is ALIVE_COLOR, and the dying states are DEAD_COLOR, fading out
+ * towards the last one. The states are the trails, so nothing fades
+ * between frames; a row is painted when its states change.
+ */
+class painter
+{
+public:
+    static constexpr uint32_t ALIVE_COLOR = 0xfff01020;
+    static constexpr uint32_t DEAD_COLOR = 0xffcc8000;
+    /// frames a trail lasts: halving an alpha of 0xff 8 times leaves 0
+    static constexpr int FADE_FRAMES = 8;
+
+    /// Rows [begin, end).
+    struct rows
+    {
+        int begin;
+        int end;
+    };
+
+    painter(int width, int height);
+
+    /**
+     * Takes the cells of the next frame in the layout of game::get_rows()
+     * and, per band of `band_rows` rows, the game::rows_version() they were
+     * read at. Returns the runs of rows whose colors changed, top to
+     * bottom; runs only a few rows apart are joined into one.
+     */
+    std::vector<rows> const &update(std::vector<uint64_t> const &cells, std::vector<uint64_t> const &versions, int band_rows);
+
+    /**
+     * Takes the live cells of squares of 2^`level` x 2^`level` cells, one
+     * per pixel, left to right and top to bottom. Returns the runs of rows
+     * whose colors changed, like update().
+     */
+    std::vector<rows> const &update_density(std::vector<uint64_t> const &counts, int level);
+
+    /**
+     * Takes the state of every cell of the next frame, a byte each in
+     * rows of width(), of a rule with `count` states. Returns the runs of
+     * rows whose colors changed, like update().
+     */
+    std::vector<rows> const &update_states(std::vector<uint8_t> const &cells, int count);
+
+    /// Forgets the frames before, for when the next one shows other cells: no trails, every row painted.
+    void reset();
+
+    /**
+     * Writes the colors of rows [begin, end) to `out` as ARGB8888, each
+     * row `pitch` bytes after the one before.
+     */
+    void paint(int begin, int end, void *out, int pitch) const;
+
+    /// What the cells of row y look like, a byte each, for shade_colors().
+    inline uint8_t const *row_shades(int y) const
+    {
+        return shades.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_);
+    }
+
+    /// The ARGB8888 color paint() writes for each byte of row_shades(), for picture formats with a palette.
+    std::array<uint32_t, 256> shade_colors() const;
+
+    inline int width() const
+    {
+        return width_;
+    }
+    inline int height() const
+    {
+        return height_;
+    }
+
+private:
+    void fade_row(int y);
+    void set_mode(int level, int states);
+    std::vector<rows> const &changed_rows();
+
+    const int width_;
+    const int height_;
+    const std::size_t words_per_row;
+    // the cells of the last frame
+    std::vector<uint64_t> shown;
+    // per band: game::rows_version() of the last frame
+    std::vector<uint64_t> versions_seen;
+    // per cell: ALIVE_SHADE if it is alive, otherwise the alpha of its trail; or its state
+    std::vector<uint8_t> shades;
+    // per row: frames until its trails have faded, counting the current one
+    std::vector<uint8_t> fading;
+    // one row of shades being worked out by update_density()
+    std::vector<uint8_t> density_row;
+    // level of the squares shown, 0 for cells
+    int level{0};
+    // states of the cells from update_states(), 0 for cells from update()
+    int states{0};
+    // per state: its color
+    std::array<uint32_t, 256> palette{};
+    // every row is painted on the next update
+    bool repaint{false};
+    std::vector<rows> dirty;
+};
+
+#endif // __PAINTER_HPP__
@@ -0,0 +1,475 @@
+#include "pattern-io.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+
+namespace patterns
+{
+    namespace
+    {
+        bool starts_with(std::string const &s, char const *prefix)
+        {
+            return s.rfind(prefix, 0) == 0;
+        }
+
+        std::string trim(std::string const &s)
+        {
+            std::size_t const begin = s.find_first_not_of(" \t");
+            if (begin == std::string::npos)
+            {
+                return "";
+            }
+            return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+        }
+
+        bool is_alive(char c)
+        {
+            return c == 'O' || c == 'o' || c == '*';
+        }
+    }
+
+    reader::reader(std::istream &in)
+        : in(in), buffer(CHUNK_SIZE)
+    {
+    }
+
+    int reader::peek()
+    {
+        if (pos == end)
+        {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            end = static_cast<std::size_t>(in.gcount());
+            pos = 0;
+            if (end == 0)
+            {
+                return EOF;
+            }
+        }
+        return static_cast<unsigned char>(buffer[pos]);
+    }
+
+    int reader::get()
+    {
+        int const c = peek();
+        if (c != EOF)
+        {
+            ++pos;
+        }
+        return c;
+    }
+
+    bool reader::next_line(std::string &line)
+    {
+        line.clear();
+        int c = get();
+        if (c == EOF)
+        {
+            return false;
+        }
+        for (; c != EOF && c != '\n'; c = get())
+        {
+            if (c != '\r')
+            {
+                line.push_back(static_cast<char>(c));
+            }
+        }
+        return true;
+    }
+
+    bool reader::fail(std::string const &message)
+    {
+        error_ = message;
+        return false;
+    }
+
+    bool reader::read_header()
+    {
+        std::string line;
+        while (next_line(line))
+        {
+            std::string const t = trim(line);
+            if (t.empty())
+            {
+                if (info_.fmt == format::plaintext)
+                {
+                    // the first, empty row of a plaintext pattern
+                    break;
+                }
+                continue;
+            }
+            if (starts_with(t, "#Life 1.06"))
+            {
+                info_.fmt = format::life106;
+                continue;
+            }
+            if (starts_with(t, "#Life"))
+            {
+                return fail("Unsupported format: " + t);
+            }
+            if (t[0] == '#')
+            {
+                char const tag = t.size() > 1 ? t[1] : ' ';
+                if (tag == 'N')
+                {
+                    info_.name = trim(t.substr(2));
+                }
+                else if (tag == 'r' || (tag == 'R' && info_.fmt == format::life106))
+                {
+                    info_.has_rule = rules::parse(trim(t.substr(2)), info_.rule);
+                    if (!info_.has_rule)
+                    {
+                        return fail("Unsupported rule: " + trim(t.substr(2)));
+                    }
+                }
+                continue;
+            }
+            if (t[0] == '!')
+            {
+                info_.fmt = format::plaintext;
+                if (starts_with(t, "!Name:"))
+                {
+                    info_.name = trim(t.substr(6));
+                }
+                continue;
+            }
+            if (info_.fmt == format::unknown && t[0] == 'x')
+            {
+                info_.fmt = format::rle;
+                return parse_rle_header(t);
+            }
+            if (info_.fmt == format::unknown)
+            {
+                if (t.find_first_not_of(".Oo*") != std::string::npos)
+                {
+                    return fail("Unknown pattern format");
+                }
+                info_.fmt = format::plaintext;
+            }
+            break;
+        }
+        if (!line.empty() || info_.fmt == format::plaintext)
+        {
+            // the line that ended the header already holds cells
+            pending = line;
+            has_pending = true;
+        }
+        if (info_.fmt == format::unknown)
+        {
+            return fail("No pattern found");
+        }
+        return true;
+    }
+
+    // "x = 3, y = 3, rule = B3/S23"
+    bool reader::parse_rle_header(std::string const &line)
+    {
+        std::size_t begin = 0;
+        while (begin < line.size())
+        {
+            std::size_t comma = line.find(',', begin);
+            if (comma == std::string::npos)
+            {
+                comma = line.size();
+            }
+            std::string const item = line.substr(begin, comma - begin);
+            begin = comma + 1;
+            std::size_t const eq = item.find('=');
+            if (eq == std::string::npos)
+            {
+                return fail("Malformed RLE header: " + line);
+            }
+            std::string const key = trim(item.substr(0, eq));
+            std::string value = trim(item.substr(eq + 1));
+            if (key == "x")
+            {
+                info_.width = std::strtoll(value.c_str(), nullptr, 10);
+            }
+            else if (key == "y")
+            {
+                info_.height = std::strtoll(value.c_str(), nullptr, 10);
+            }
+            else if (key == "rule")
+            {
+                // drop a bounded grid suffix such as ":T100,100"
+                value = value.substr(0, value.find(':'));
+                if (!rules::parse(value, info_.rule))
+                {
+                    return fail("Unsupported rule: " + value);
+                }
+                info_.has_rule = true;
+                // the grid suffix may contain commas of its own
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool reader::read_cells(span_sink const &sink)
+    {
+        switch (info_.fmt)
+        {
+        case format::rle:
+            return read_rle(sink);
+        case format::life106:
+            return read_life106(sink);
+        case format::plaintext:
+            return read_plaintext(sink);
+        default:
+            return fail("Header not read");
+        }
+    }
+
+    bool reader::read_rle(span_sink const &sink)
+    {
+        int64_t x = 0;
+        int64_t y = 0;
+        int64_t count = 0;
+        for (int c = get(); c != EOF; c = get())
+        {
+            if (c >= '0' && c <= '9')
+            {
+                count = count * 10 + (c - '0');
+                continue;
+            }
+            if (std::isspace(c))
+            {
+                continue;
+            }
+            int64_t const n = count > 0 ? count : 1;
+            count = 0;
+            if (c == 'b' || c == '.')
+            {
+                x += n;
+            }
+            else if (c == '$')
+            {
+                y += n;
+                x = 0;
+            }
+            else if (c == '!')
+            {
+                return true;
+            }
+            else if (c == '#')
+            {
+                while (c != EOF && c != '\n')
+                {
+                    c = get();
+                }
+            }
+            else if (c >= 'p' && c <= 'y')
+            {
+                // states from 25 up take two letters, "pA" to "yO"
+                int const state = get();
+                if (state < 'A' || state > 'X')
+                {
+                    return fail(std::string("Unexpected state in RLE data: ") + static_cast<char>(c) +
+                                (state == EOF ? std::string() : std::string(1, static_cast<char>(state))));
+                }
+                sink(x, y, n);
+                x += n;
+            }
+            else if (std::isalpha(c))
+            {
+                // 'o', or any state but 0 of a multi-state pattern
+                sink(x, y, n);
+                x += n;
+            }
+            else
+            {
+                return fail(std::string("Unexpected character in RLE data: ") + static_cast<char>(c));
+            }
+        }
+        return true;
+    }
+
+    bool reader::read_life106(span_sink const &sink)
+    {
+        // consecutive cells in a row are merged into one run
+        int64_t run_x = 0;
+        int64_t run_y = 0;
+        int64_t run_length = 0;
+        std::string line;
+        while (has_pending || next_line(line))
+        {
+            if (has_pending)
+            {
+                line.swap(pending);
+                has_pending = false;
+            }
+            char const *p = line.c_str();
+            while (*p == ' ' || *p == '\t')
+            {
+                ++p;
+            }
+            if (*p == '\0' || *p == '#')
+            {
+                continue;
+            }
+            char *after_x = nullptr;
+            char *after_y = nullptr;
+            int64_t const x = std::strtoll(p, &after_x, 10);
+            int64_t const y = std::strtoll(after_x, &after_y, 10);
+            if (after_x == p || after_y == after_x)
+            {
+                return fail("Malformed Life 1.06 line: " + line);
+            }
+            if (run_length > 0 && y == run_y && x == run_x + run_length)
+            {
+                ++run_length;
+                continue;
+            }
+            if (run_length > 0)
+            {
+                sink(run_x, run_y, run_length);
+            }
+            run_x = x;
+            run_y = y;
+            run_length = 1;
+        }
+        if (run_length > 0)
+        {
+            sink(run_x, run_y, run_length);
+        }
+        return true;
+    }
+
+    void reader::plaintext_row(std::string const &line, int64_t y, span_sink const &sink) const
+    {
+        std::size_t x = 0;
+        while (x < line.size())
+        {
+            if (!is_alive(line[x]))
+            {
+                ++x;
+                continue;
+            }
+            std::size_t run = x + 1;
+            while (run < line.size() && is_alive(line[run]))
+            {
+                ++run;
+            }
+            sink(static_cast<int64_t>(x), y, static_cast<int64_t>(run - x));
+            x = run;
+        }
+    }
+
+    bool reader::read_plaintext(span_sink const &sink)
+    {
+        int64_t y = 0;
+        std::string line;
+        while (has_pending || next_line(line))
+        {
+            if (has_pending)
+            {
+                line.swap(pending);
+                has_pending = false;
+            }
+            if (!line.empty() && line[0] == '!')
+            {
+                continue;
+            }
+            plaintext_row(line, y++, sink);
+        }
+        return true;
+    }
+
+    band_writer::band_writer(game &g, int width, int height)
+        : g(g), width(width), height(height), per_row((static_cast<std::size_t>(width) + 63) / 64),
+          words(per_row * BAND_ROWS)
+    {
+    }
+
+    void band_writer::operator()(int64_t x, int64_t y, int64_t length)
+    {
+        if (x < 0 || y < 0 || x + length > width || y >= height)
+        {
+            outside.push_back({x, y, length});
+            return;
+        }
+        int const band = static_cast<int>(y - y % BAND_ROWS);
+        if (band != band_y)
+        {
+            write_band();
+            band_y = band;
+            g.get_rows(band_y, std::min(BAND_ROWS, height - band_y), width, words.data());
+        }
+        uint64_t *row = words.data() + static_cast<std::size_t>(y - band_y) * per_row;
+        for (std::size_t begin = static_cast<std::size_t>(x), end = static_cast<std::size_t>(x + length); begin < end;)
+        {
+            std::size_t const w = begin / 64;
+            std::size_t const hi = std::min(end - w * 64, std::size_t{64});
+            uint64_t const mask = (hi == 64 ? ~uint64_t{0} : (uint64_t{1} << hi) - 1) & ~((uint64_t{1} << (begin % 64)) - 1);
+            row[w] |= mask;
+            begin = w * 64 + hi;
+        }
+    }
+
+    void band_writer::write_band()
+    {
+        if (band_y >= 0)
+        {
+            g.set_rows(band_y, std::min(BAND_ROWS, height - band_y), width, words.data());
+            band_y = -1;
+        }
+    }
+
+    void band_writer::flush()
+    {
+        write_band();
+        for (span const &s : outside)
+        {
+            g.set_span(static_cast<int>(s.x), static_cast<int>(s.y), static_cast<int>(std::min<int64_t>(s.length, INT32_MAX)), true);
+        }
+        outside.clear();
+    }
+
+    bool load(std::string const &path, game &g, int width, int height, int x, int y, info &header, std::string &error)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            error = "Cannot open " + path;
+            return false;
+        }
+        reader r(in);
+        band_writer cells(g, width, height);
+        bool ok = r.read_header();
+        if (ok && r.header().fmt == format::life106)
+        {
+            // cells in any order would write the same bands over and over
+            ok = r.read_cells([&](int64_t sx, int64_t sy, int64_t length)
+                              { g.set_span(x + static_cast<int>(sx), y + static_cast<int>(sy),
+                                           static_cast<int>(std::min<int64_t>(length, INT32_MAX)), true); });
+        }
+        else if (ok)
+        {
+            ok = r.read_cells([&](int64_t sx, int64_t sy, int64_t length)
+                              { cells(x + sx, y + sy, length); });
+            cells.flush();
+        }
+        header = r.header();
+        error = r.error();
+        return ok;
+    }
+
+    bool write_cells(std::ostream &out, game const &g, int width, int height, std::string const &name)
+    {
+        out << "!Name: " << name << '\n';
+        std::string line;
+        for (int y = 0; y < height; ++y)
+        {
+            line.clear();
+            for (int x = 0; x < width; ++x)
+            {
+                line.push_back(g.get(x, y) ? 'O' : '.');
+            }
+            // trailing dead cells are implied
+            line.erase(line.find_last_not_of('.') + 1);
+            out << line << '\n';
+        }
+        return static_cast<bool>(out);
+    }
+}
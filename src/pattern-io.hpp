@@ -0,0 +1,141 @@
+#ifndef __PATTERN_IO_HPP__
+#define __PATTERN_IO_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "game.hpp"
+#include "rule.hpp"
+
+namespace patterns
+{
+    enum class format
+    {
+        unknown,
+        rle,
+        life106,
+        plaintext,
+    };
+
+    /// What the header of a pattern file says about it.
+    struct info
+    {
+        format fmt{format::unknown};
+        std::string name;
+        /// bounding box from the RLE header, 0 if the format has none
+        int64_t width{0};
+        int64_t height{0};
+        bool has_rule{false};
+        rules::rule rule{rules::CONWAY};
+    };
+
+    /// Receives runs of `length` live cells starting at (x, y), left to right and top to bottom.
+    using span_sink = std::function<void(int64_t x, int64_t y, int64_t length)>;
+
+    /**
+     * Streaming parser for RLE, Life 1.06 and plaintext (.cells) patterns.
+     *
+     * The input is read in fixed-size chunks, so only one chunk is held in
+     * memory no matter how large the file is. Live cells are reported as
+     * horizontal runs rather than one by one. Life 1.06 cells are relative
+     * to the pattern's origin and may be negative; the other formats start
+     * at (0, 0).
+     */
+    class reader
+    {
+    public:
+        explicit reader(std::istream &in);
+
+        /// Reads up to the first cell and detects the format. Returns false on errors, see error().
+        bool read_header();
+        inline info const &header() const
+        {
+            return info_;
+        }
+
+        /// Reads all cells. Returns false on errors, see error().
+        bool read_cells(span_sink const &sink);
+
+        inline std::string const &error() const
+        {
+            return error_;
+        }
+
+    private:
+        static constexpr std::size_t CHUNK_SIZE = std::size_t{1} << 16;
+
+        int get();
+        int peek();
+        bool next_line(std::string &line);
+        bool fail(std::string const &message);
+        bool parse_rle_header(std::string const &line);
+        bool read_rle(span_sink const &sink);
+        bool read_life106(span_sink const &sink);
+        bool read_plaintext(span_sink const &sink);
+        void plaintext_row(std::string const &line, int64_t y, span_sink const &sink) const;
+
+        std::istream &in;
+        std::vector<char> buffer;
+        std::size_t pos{0};
+        std::size_t end{0};
+        info info_;
+        // the first line that already belongs to the cells, if the header ended on one
+        std::string pending;
+        bool has_pending{false};
+        std::string error_;
+    };
+
+    /**
+     * Sets the runs of live cells of a pattern in row order on a board of
+     * `width` x `height` cells. The runs of each band of BAND_ROWS rows are
+     * gathered and written with one get_rows() and set_rows(), which engines
+     * that build their cells in bulk do far faster than run by run. Runs
+     * that leave the board are kept until flush() and then go to
+     * set_span(), so they wrap around as before without a band writing
+     * over them. Call flush() after the last run.
+     */
+    class band_writer
+    {
+    public:
+        band_writer(game &g, int width, int height);
+
+        void operator()(int64_t x, int64_t y, int64_t length);
+        void flush();
+
+    private:
+        static constexpr int BAND_ROWS = 64;
+
+        struct span
+        {
+            int64_t x, y, length;
+        };
+
+        void write_band();
+
+        game &g;
+        int const width;
+        int const height;
+        std::size_t const per_row;
+        std::vector<uint64_t> words;
+        // first row of the band in `words`, or -1 if none
+        int band_y{-1};
+        std::vector<span> outside;
+    };
+
+    /**
+     * Loads the pattern file at `path` into `g`, a board of `width` x
+     * `height` cells, with its origin at (x, y). Fills `header` with what
+     * the file says about itself.
+     */
+    bool load(std::string const &path, game &g, int width, int height, int x, int y, info &header, std::string &error);
+
+    /// Writes [0, width) x [0, height) of `g` in plaintext (.cells) format.
+    bool write_cells(std::ostream &out, game const &g, int width, int height, std::string const &name);
+}
+
+#endif // __PATTERN_IO_HPP__
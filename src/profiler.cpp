@@ -0,0 +1,271 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace profiling
+{
+    namespace
+    {
+        // bit of an event's id telling counters from phases
+        constexpr uint64_t COUNTER_BIT = 0x100;
+
+        struct slot
+        {
+            std::atomic<uint64_t> time{0};
+            // the end of a phase, the value of a counter
+            std::atomic<uint64_t> value{0};
+            std::atomic<uint64_t> id{0};
+        };
+
+        /**
+         * The newest events of one thread. Only its thread writes, and
+         * publishes each event by moving `head` on; readers take the newer
+         * half of the ring only, which the writer would need thousands of
+         * events to reach while they read it.
+         */
+        struct ring
+        {
+            static constexpr std::size_t SIZE = std::size_t{1} << 14;
+            static constexpr std::size_t READABLE = SIZE / 2;
+
+            std::array<slot, SIZE> slots;
+            std::atomic<uint64_t> head{0};
+            uint32_t thread{0};
+            // guarded by the registry's mutex
+            std::string name;
+
+            inline void push(uint64_t time, uint64_t value, uint64_t id)
+            {
+                uint64_t const h = head.load(std::memory_order_relaxed);
+                slot &s = slots[h % SIZE];
+                s.time.store(time, std::memory_order_relaxed);
+                s.value.store(value, std::memory_order_relaxed);
+                s.id.store(id, std::memory_order_relaxed);
+                head.store(h + 1, std::memory_order_release);
+            }
+
+            /// Calls `f(time, value, id)` for the readable events, oldest first.
+            template <typename F>
+            void for_each(F &&f) const
+            {
+                uint64_t const h = head.load(std::memory_order_acquire);
+                for (uint64_t i = h > READABLE ? h - READABLE : 0; i < h; ++i)
+                {
+                    slot const &s = slots[i % SIZE];
+                    f(s.time.load(std::memory_order_relaxed), s.value.load(std::memory_order_relaxed),
+                      s.id.load(std::memory_order_relaxed));
+                }
+            }
+        };
+
+        // Rings of all threads that recorded something; rings outlive their threads.
+        struct registry
+        {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<ring>> rings;
+        };
+
+        registry &threads()
+        {
+            static registry r;
+            return r;
+        }
+
+        ring &own()
+        {
+            thread_local std::shared_ptr<ring> const mine = []
+            {
+                auto r = std::make_shared<ring>();
+                registry &all = threads();
+                std::lock_guard<std::mutex> lock(all.mutex);
+                r->thread = static_cast<uint32_t>(all.rings.size());
+                all.rings.push_back(r);
+                return r;
+            }();
+            return *mine;
+        }
+
+        template <typename F>
+        void for_each_ring(F &&f)
+        {
+            registry &all = threads();
+            std::lock_guard<std::mutex> lock(all.mutex);
+            for (std::shared_ptr<ring> const &r : all.rings)
+            {
+                f(*r);
+            }
+        }
+
+        // now() and the steady clock when the program started, to calibrate against
+        struct start
+        {
+            uint64_t ticks{now()};
+            std::chrono::steady_clock::time_point time{std::chrono::steady_clock::now()};
+        };
+        start const started;
+
+        double percentile(std::vector<uint64_t> &sorted, double p)
+        {
+            std::size_t const i = std::min(sorted.size() - 1, static_cast<std::size_t>(p * static_cast<double>(sorted.size())));
+            return static_cast<double>(sorted[i]);
+        }
+    }
+
+    char const *name(phase p)
+    {
+        static constexpr char const *NAMES[PHASES] = {"step", "read", "color", "upload", "present", "events", "capture", "encode"};
+        return p < PHASES ? NAMES[p] : "?";
+    }
+
+    char const *name(counter c)
+    {
+        static constexpr char const *NAMES[COUNTERS] = {"population", "cell updates", "dropped frames"};
+        return c < COUNTERS ? NAMES[c] : "?";
+    }
+
+    double ticks_per_second()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        static double const rate = []
+        {
+            // long enough for the steady clock's resolution not to matter
+            auto const enough = started.time + std::chrono::milliseconds(20);
+            std::this_thread::sleep_until(enough);
+            auto const time = std::chrono::steady_clock::now();
+            uint64_t const ticks = now();
+            return static_cast<double>(ticks - started.ticks) / std::chrono::duration<double>(time - started.time).count();
+        }();
+        return rate;
+#else
+        return 1e9;
+#endif
+    }
+
+    void record(phase p, uint64_t begin, uint64_t end)
+    {
+        own().push(begin, end, p);
+    }
+
+    void record(counter c, uint64_t value)
+    {
+        own().push(now(), value, COUNTER_BIT | c);
+    }
+
+    void name_thread(std::string const &name)
+    {
+        ring &r = own();
+        std::lock_guard<std::mutex> lock(threads().mutex);
+        r.name = name;
+    }
+
+    void summarize(double seconds, summary &out, std::vector<uint64_t> &scratch)
+    {
+        double const tps = ticks_per_second();
+        uint64_t const t = now();
+        uint64_t const window = static_cast<uint64_t>(seconds * tps);
+        uint64_t const since = t > window ? t - window : 0;
+        out = summary{};
+        std::array<uint64_t, COUNTERS> latest{};
+        for (int p = 0; p < PHASES; ++p)
+        {
+            scratch.clear();
+            for_each_ring([&](ring const &r)
+                          { r.for_each([&](uint64_t time, uint64_t value, uint64_t id)
+                                       {
+                                           if ((id & COUNTER_BIT) != 0)
+                                           {
+                                               // counters only need one pass
+                                               std::size_t const c = static_cast<std::size_t>(id & 0xff);
+                                               if (p == 0 && c < COUNTERS && time >= latest[c])
+                                               {
+                                                   latest[c] = time;
+                                                   out.counters[c] = value;
+                                               }
+                                           }
+                                           else if (id == static_cast<uint64_t>(p) && value >= since && value >= time)
+                                           {
+                                               scratch.push_back(value - time);
+                                           } }); });
+            percentiles &result = out.phases[static_cast<std::size_t>(p)];
+            result.count = scratch.size();
+            if (scratch.empty())
+            {
+                continue;
+            }
+            std::sort(scratch.begin(), scratch.end());
+            double const ms = 1000 / tps;
+            result.p50 = percentile(scratch, 0.5) * ms;
+            result.p90 = percentile(scratch, 0.9) * ms;
+            result.p99 = percentile(scratch, 0.99) * ms;
+            result.max = static_cast<double>(scratch.back()) * ms;
+        }
+    }
+
+    bool write_trace(std::string const &path, std::string &error)
+    {
+        struct event
+        {
+            uint64_t time;
+            uint64_t value;
+            uint64_t id;
+            uint32_t thread;
+        };
+        std::vector<event> events;
+        std::vector<std::pair<uint32_t, std::string>> names;
+        for_each_ring([&](ring const &r)
+                      {
+                          names.emplace_back(r.thread, r.name);
+                          r.for_each([&](uint64_t time, uint64_t value, uint64_t id)
+                                     { events.push_back({time, value, id, r.thread}); }); });
+        std::sort(events.begin(), events.end(), [](event const &a, event const &b)
+                  { return a.time < b.time; });
+
+        std::ofstream out(path);
+        if (!out)
+        {
+            error = "cannot open " + path;
+            return false;
+        }
+        // microseconds from the first event
+        double const us = 1e6 / ticks_per_second();
+        uint64_t const origin = events.empty() ? 0 : events.front().time;
+        out << std::fixed << std::setprecision(3) << "{\"traceEvents\": [\n";
+        bool first = true;
+        for (auto const &[thread, name] : names)
+        {
+            out << (first ? "" : ",\n") << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread
+                << ", \"args\": {\"name\": \"" << (name.empty() ? "thread " + std::to_string(thread) : name) << "\"}}";
+            first = false;
+        }
+        for (event const &e : events)
+        {
+            double const ts = static_cast<double>(e.time - origin) * us;
+            out << (first ? "" : ",\n");
+            first = false;
+            if ((e.id & COUNTER_BIT) != 0)
+            {
+                out << "  {\"name\": \"" << name(static_cast<counter>(e.id & 0xff)) << "\", \"ph\": \"C\", \"pid\": 1, \"tid\": " << e.thread
+                    << ", \"ts\": " << ts << ", \"args\": {\"value\": " << e.value << "}}";
+            }
+            else
+            {
+                out << "  {\"name\": \"" << name(static_cast<phase>(e.id)) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << e.thread
+                    << ", \"ts\": " << ts << ", \"dur\": " << static_cast<double>(e.value - e.time) * us << "}";
+            }
+        }
+        out << "\n]}\n";
+        if (!out)
+        {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/**
+ * Timers for the phases of a frame, cheap enough to stay on in release
+ * builds.
+ *
+ * A scope reads the time stamp counter when it starts and ends, and
+ * appends the pair to a ring of events owned by its thread: no locks, no
+ * allocations, a few dozen cycles. Counters such as the population are
+ * appended to the same ring. Any thread can read the recent events of
+ * all threads, to summarize() them for a display or to write them as a
+ * Chrome trace that chrome://tracing or Perfetto open.
+ */
+namespace profiling
+{
+    enum phase : uint8_t
+    {
+        /// game::iterate()
+        STEP,
+        /// copying the cells of a generation into a frame
+        READ,
+        /// coloring a frame
+        COLOR,
+        /// writing colors into the texture
+        UPLOAD,
+        /// drawing and presenting, including the wait for vsync
+        PRESENT,
+        /// handling input events
+        EVENTS,
+        /// copying the cells of a generation for the recorder
+        CAPTURE,
+        /// coloring, encoding and writing a recorded frame
+        ENCODE,
+        PHASES
+    };
+
+    enum counter : uint8_t
+    {
+        /// live cells
+        POPULATION,
+        /// cells the last generation computed
+        CELL_UPDATES,
+        /// frames the recorder dropped so far, as the disk fell behind
+        DROPPED_FRAMES,
+        COUNTERS
+    };
+
+    char const *name(phase p);
+    char const *name(counter c);
+
+    /// Time stamp counter ticks, or nanoseconds where there is none.
+    inline uint64_t now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+#endif
+    }
+
+    /// Ticks of now() per second, measured against the steady clock the first time.
+    double ticks_per_second();
+
+    void record(phase p, uint64_t begin, uint64_t end);
+    void record(counter c, uint64_t value);
+
+    /// Names the calling thread in traces.
+    void name_thread(std::string const &name);
+
+    /// Times the rest of the enclosing block as phase `p`.
+    class scope
+    {
+    public:
+        explicit scope(phase p)
+            : what(p), begin(now())
+        {
+        }
+        ~scope()
+        {
+            record(what, begin, now());
+        }
+
+        scope(scope const &) = delete;
+        scope &operator=(scope const &) = delete;
+
+    private:
+        phase what;
+        uint64_t begin;
+    };
+
+    struct percentiles
+    {
+        /// events in the window
+        std::size_t count{0};
+        /// durations in milliseconds
+        double p50{0};
+        double p90{0};
+        double p99{0};
+        double max{0};
+    };
+
+    struct summary
+    {
+        std::array<percentiles, PHASES> phases{};
+        /// latest value per counter, 0 if none was recorded
+        std::array<uint64_t, COUNTERS> counters{};
+    };
+
+    /**
+     * Percentiles of the phases that ended in the last `seconds`, over all
+     * threads. The events are copied into `scratch`, which keeps its
+     * capacity between calls.
+     */
+    void summarize(double seconds, summary &out, std::vector<uint64_t> &scratch);
+
+    /// Writes the events of all threads still in their rings as a Chrome trace.
+    bool write_trace(std::string const &path, std::string &error);
+}
+
+#endif // __PROFILER_HPP__
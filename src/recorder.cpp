@@ -0,0 +1,1099 @@
+#include "recorder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <queue>
+
+#include "profiler.hpp"
+
+namespace recording
+{
+    /**
+     * Writes frames of `width` x `height` palette indices, row after row,
+     * with the colors of the palette as 0x00rrggbb.
+     */
+    class encoder
+    {
+    public:
+        virtual ~encoder() = default;
+
+        virtual bool write(uint8_t const *pixels, std::array<uint32_t, 256> const &rgb) = 0;
+        /// Completes the file after the last frame.
+        virtual bool finish()
+        {
+            return true;
+        }
+
+        /// why the file could not be opened, or the last write() or finish() failed
+        std::string error;
+    };
+}
+
+namespace
+{
+    using recording::encoder;
+
+    // rows a band of the painter compares at once
+    constexpr int BAND_ROWS = 32;
+
+    // Bits into bytes, the lowest bit first, as deflate and GIF pack them.
+    class bit_writer
+    {
+    public:
+        explicit bit_writer(std::vector<uint8_t> &out)
+            : out(out)
+        {
+        }
+
+        inline void put(uint32_t value, int bits)
+        {
+            acc |= uint64_t{value} << count;
+            count += bits;
+            while (count >= 8)
+            {
+                out.push_back(static_cast<uint8_t>(acc));
+                acc >>= 8;
+                count -= 8;
+            }
+        }
+
+        void flush()
+        {
+            if (count > 0)
+            {
+                out.push_back(static_cast<uint8_t>(acc));
+            }
+            acc = 0;
+            count = 0;
+        }
+
+    private:
+        std::vector<uint8_t> &out;
+        uint64_t acc{0};
+        int count{0};
+    };
+
+    inline void put_be32(std::vector<uint8_t> &out, uint32_t v)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            out.push_back(static_cast<uint8_t>(v >> shift));
+        }
+    }
+
+    constexpr std::array<uint16_t, 29> LENGTH_BASE = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                                      35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    constexpr std::array<uint8_t, 29> LENGTH_EXTRA = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                                      3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    constexpr std::array<uint16_t, 30> DISTANCE_BASE = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                                        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    constexpr std::array<uint8_t, 30> DISTANCE_EXTRA = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                                        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+    /**
+     * Lengths of a Huffman code for symbols of frequencies `freq`, none
+     * longer than `limit` bits; 0 for the symbols that do not occur. Too
+     * long codes are shortened by halving the frequencies until they fit.
+     */
+    void code_lengths(std::vector<uint32_t> freq, int limit, std::vector<uint8_t> &lengths)
+    {
+        lengths.assign(freq.size(), 0);
+        for (;;)
+        {
+            // leaves first, then the inner nodes in the order they are made
+            std::vector<int> parent;
+            std::vector<std::size_t> symbols;
+            using node = std::pair<uint64_t, int>;
+            std::priority_queue<node, std::vector<node>, std::greater<node>> lightest;
+            for (std::size_t i = 0; i < freq.size(); ++i)
+            {
+                if (freq[i] > 0)
+                {
+                    lightest.push({freq[i], static_cast<int>(symbols.size())});
+                    symbols.push_back(i);
+                    parent.push_back(-1);
+                }
+            }
+            while (lightest.size() > 1)
+            {
+                node const a = lightest.top();
+                lightest.pop();
+                node const b = lightest.top();
+                lightest.pop();
+                int const inner = static_cast<int>(parent.size());
+                parent.push_back(-1);
+                parent[static_cast<std::size_t>(a.second)] = inner;
+                parent[static_cast<std::size_t>(b.second)] = inner;
+                lightest.push({a.first + b.first, inner});
+            }
+            int longest = 0;
+            for (std::size_t leaf = 0; leaf < symbols.size(); ++leaf)
+            {
+                int depth = 0;
+                for (int n = parent[leaf]; n >= 0; n = parent[static_cast<std::size_t>(n)])
+                {
+                    ++depth;
+                }
+                lengths[symbols[leaf]] = static_cast<uint8_t>(std::max(depth, 1));
+                longest = std::max(longest, depth);
+            }
+            if (longest <= limit)
+            {
+                return;
+            }
+            for (uint32_t &f : freq)
+            {
+                f = f == 0 ? 0 : std::max<uint32_t>(1, f / 2);
+            }
+        }
+    }
+
+    // Canonical codes for `lengths`, reversed to go in from their highest bit.
+    void canonical_codes(std::vector<uint8_t> const &lengths, std::vector<uint16_t> &codes)
+    {
+        std::array<uint32_t, 16> count{};
+        for (uint8_t l : lengths)
+        {
+            ++count[l];
+        }
+        count[0] = 0;
+        std::array<uint32_t, 16> next{};
+        for (std::size_t bits = 1; bits < next.size(); ++bits)
+        {
+            next[bits] = (next[bits - 1] + count[bits - 1]) << 1;
+        }
+        codes.assign(lengths.size(), 0);
+        for (std::size_t i = 0; i < lengths.size(); ++i)
+        {
+            if (lengths[i] == 0)
+            {
+                continue;
+            }
+            uint32_t const code = next[lengths[i]]++;
+            uint32_t reversed = 0;
+            for (int b = 0; b < lengths[i]; ++b)
+            {
+                reversed = (reversed << 1) | ((code >> b) & 1);
+            }
+            codes[i] = static_cast<uint16_t>(reversed);
+        }
+    }
+
+    /**
+     * zlib streams of one deflate block each, with Huffman codes built for
+     * that block. Frames use a handful of shades, so the codes are short.
+     */
+    class deflater
+    {
+    public:
+        /// Appends the zlib stream of `n` bytes of rows `stride` bytes long to `out`.
+        void compress(uint8_t const *data, std::size_t n, std::size_t stride, std::vector<uint8_t> &out)
+        {
+            find_matches(data, n, stride);
+            // 32K window, fastest compression
+            out.push_back(0x78);
+            out.push_back(0x01);
+            bit_writer bits(out);
+            write_block(bits);
+            bits.flush();
+            uint32_t a = 1;
+            uint32_t b = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                a = (a + data[i]) % 65521;
+                b = (b + a) % 65521;
+            }
+            put_be32(out, (b << 16) | a);
+        }
+
+    private:
+        static constexpr std::size_t WINDOW = 32768;
+        static constexpr std::size_t MIN_MATCH = 8;
+        static constexpr std::size_t MAX_MATCH = 258;
+        static constexpr uint32_t END = 256;
+
+        // a literal byte if `distance` is 0, else a match of `value` bytes `distance` back
+        struct token
+        {
+            uint16_t value;
+            uint16_t distance;
+        };
+
+        static inline std::size_t length_code(std::size_t length)
+        {
+            return static_cast<std::size_t>(std::upper_bound(LENGTH_BASE.begin(), LENGTH_BASE.end(), length) - LENGTH_BASE.begin()) - 1;
+        }
+        static inline std::size_t distance_code(std::size_t distance)
+        {
+            return static_cast<std::size_t>(std::upper_bound(DISTANCE_BASE.begin(), DISTANCE_BASE.end(), distance) - DISTANCE_BASE.begin()) - 1;
+        }
+
+        /**
+         * Tokens for `data`, rows of `stride` bytes, and their frequencies.
+         * A match is looked for in two places only, the byte before and the
+         * row above, which is where runs of dead cells and still lifes
+         * repeat; short matches cost more bits than the literals they
+         * replace in busy frames and are not taken.
+         */
+        void find_matches(uint8_t const *data, std::size_t n, std::size_t stride)
+        {
+            tokens.clear();
+            literal_freq.assign(286, 0);
+            distance_freq.assign(30, 0);
+            std::array<std::size_t, 2> const candidates = {1, stride};
+            for (std::size_t i = 0; i < n;)
+            {
+                std::size_t const limit = std::min(MAX_MATCH, n - i);
+                std::size_t best = 0;
+                std::size_t distance = 0;
+                for (std::size_t back : candidates)
+                {
+                    if (back > i || back > WINDOW)
+                    {
+                        continue;
+                    }
+                    std::size_t length = 0;
+                    while (length < limit && data[i - back + length] == data[i + length])
+                    {
+                        ++length;
+                    }
+                    if (length > best)
+                    {
+                        best = length;
+                        distance = back;
+                    }
+                }
+                if (best < MIN_MATCH)
+                {
+                    tokens.push_back({data[i], 0});
+                    ++literal_freq[data[i]];
+                    ++i;
+                    continue;
+                }
+                tokens.push_back({static_cast<uint16_t>(best), static_cast<uint16_t>(distance)});
+                ++literal_freq[257 + length_code(best)];
+                ++distance_freq[distance_code(distance)];
+                i += best;
+            }
+            ++literal_freq[END];
+        }
+
+        void write_block(bit_writer &bits)
+        {
+            // a code of a single symbol is incomplete, which decoders may refuse
+            for (std::vector<uint32_t> *freq : {&literal_freq, &distance_freq})
+            {
+                std::size_t used = freq->size() - static_cast<std::size_t>(std::count(freq->begin(), freq->end(), 0u));
+                for (std::size_t i = 0; used < 2; ++i)
+                {
+                    if ((*freq)[i] == 0)
+                    {
+                        (*freq)[i] = 1;
+                        ++used;
+                    }
+                }
+            }
+            code_lengths(literal_freq, 15, literal_lengths);
+            code_lengths(distance_freq, 15, distance_lengths);
+            canonical_codes(literal_lengths, literal_codes);
+            canonical_codes(distance_lengths, distance_codes);
+            std::size_t literals = literal_lengths.size();
+            while (literal_lengths[literals - 1] == 0)
+            {
+                --literals;
+            }
+            std::size_t distances = distance_lengths.size();
+            while (distance_lengths[distances - 1] == 0)
+            {
+                --distances;
+            }
+
+            // both sets of lengths, run length coded with symbols 16 to 18
+            std::vector<uint8_t> all(literal_lengths.begin(), literal_lengths.begin() + static_cast<std::ptrdiff_t>(literals));
+            all.insert(all.end(), distance_lengths.begin(), distance_lengths.begin() + static_cast<std::ptrdiff_t>(distances));
+            std::vector<std::pair<uint8_t, uint8_t>> runs;
+            std::vector<uint32_t> length_freq(19, 0);
+            for (std::size_t i = 0; i < all.size();)
+            {
+                uint8_t const l = all[i];
+                std::size_t run = 1;
+                while (i + run < all.size() && all[i + run] == l)
+                {
+                    ++run;
+                }
+                i += run;
+                if (l != 0)
+                {
+                    runs.push_back({l, 0});
+                    --run;
+                    for (; run >= 3; run -= std::min<std::size_t>(run, 6))
+                    {
+                        runs.push_back({16, static_cast<uint8_t>(std::min<std::size_t>(run, 6) - 3)});
+                    }
+                }
+                for (; l == 0 && run >= 11; run -= std::min<std::size_t>(run, 138))
+                {
+                    runs.push_back({18, static_cast<uint8_t>(std::min<std::size_t>(run, 138) - 11)});
+                }
+                for (; l == 0 && run >= 3; run -= std::min<std::size_t>(run, 10))
+                {
+                    runs.push_back({17, static_cast<uint8_t>(std::min<std::size_t>(run, 10) - 3)});
+                }
+                for (; run > 0; --run)
+                {
+                    runs.push_back({l, 0});
+                }
+            }
+            for (auto const &[symbol, extra] : runs)
+            {
+                ++length_freq[symbol];
+            }
+            std::vector<uint8_t> length_lengths;
+            std::vector<uint16_t> length_codes;
+            code_lengths(length_freq, 7, length_lengths);
+            canonical_codes(length_lengths, length_codes);
+            static constexpr std::array<uint8_t, 19> ORDER = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            std::size_t sent = ORDER.size();
+            while (sent > 4 && length_lengths[ORDER[sent - 1]] == 0)
+            {
+                --sent;
+            }
+
+            // the last block, dynamic codes
+            bits.put(1, 1);
+            bits.put(2, 2);
+            bits.put(static_cast<uint32_t>(literals - 257), 5);
+            bits.put(static_cast<uint32_t>(distances - 1), 5);
+            bits.put(static_cast<uint32_t>(sent - 4), 4);
+            for (std::size_t i = 0; i < sent; ++i)
+            {
+                bits.put(length_lengths[ORDER[i]], 3);
+            }
+            static constexpr std::array<int, 3> RUN_EXTRA = {2, 3, 7};
+            for (auto const &[symbol, extra] : runs)
+            {
+                bits.put(length_codes[symbol], length_lengths[symbol]);
+                if (symbol >= 16)
+                {
+                    bits.put(extra, RUN_EXTRA[symbol - 16u]);
+                }
+            }
+
+            for (token const &t : tokens)
+            {
+                if (t.distance == 0)
+                {
+                    bits.put(literal_codes[t.value], literal_lengths[t.value]);
+                    continue;
+                }
+                std::size_t const l = length_code(t.value);
+                bits.put(literal_codes[257 + l], literal_lengths[257 + l]);
+                bits.put(static_cast<uint32_t>(t.value - LENGTH_BASE[l]), LENGTH_EXTRA[l]);
+                std::size_t const d = distance_code(t.distance);
+                bits.put(distance_codes[d], distance_lengths[d]);
+                bits.put(static_cast<uint32_t>(t.distance - DISTANCE_BASE[d]), DISTANCE_EXTRA[d]);
+            }
+            bits.put(literal_codes[END], literal_lengths[END]);
+        }
+
+        std::vector<token> tokens;
+        std::vector<uint32_t> literal_freq;
+        std::vector<uint32_t> distance_freq;
+        std::vector<uint8_t> literal_lengths;
+        std::vector<uint8_t> distance_lengths;
+        std::vector<uint16_t> literal_codes;
+        std::vector<uint16_t> distance_codes;
+    };
+
+    std::array<uint32_t, 256> make_crc_table()
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) != 0 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    uint32_t crc32(uint8_t const *data, std::size_t n)
+    {
+        static std::array<uint32_t, 256> const table = make_crc_table();
+        uint32_t c = 0xffffffff;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            c = table[(c ^ data[i]) & 0xff] ^ (c >> 8);
+        }
+        return c ^ 0xffffffff;
+    }
+
+    inline void put_le16(std::vector<uint8_t> &out, int v)
+    {
+        out.push_back(static_cast<uint8_t>(v));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    // Writes all of `bytes` to a file opened for writing, false if it fails.
+    bool write_file(std::ofstream &file, std::vector<uint8_t> const &bytes)
+    {
+        file.write(reinterpret_cast<char const *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return static_cast<bool>(file);
+    }
+
+    /**
+     * YUV4MPEG2: a text header, then every frame as full planes of Y, Cb
+     * and Cr, one byte per pixel each (4:4:4), in the limited range of
+     * BT.601.
+     */
+    class y4m_encoder final : public encoder
+    {
+    public:
+        y4m_encoder(std::string const &path, int width, int height, int fps)
+            : width(width), height(height), file(path, std::ios::binary)
+        {
+            if (!file)
+            {
+                error = "cannot open " + path;
+                return;
+            }
+            file << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C444\n";
+        }
+
+        bool write(uint8_t const *pixels, std::array<uint32_t, 256> const &rgb) override
+        {
+            std::array<std::array<uint8_t, 256>, 3> planes{};
+            for (std::size_t i = 0; i < rgb.size(); ++i)
+            {
+                int const r = static_cast<int>((rgb[i] >> 16) & 0xff);
+                int const g = static_cast<int>((rgb[i] >> 8) & 0xff);
+                int const b = static_cast<int>(rgb[i] & 0xff);
+                planes[0][i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+                planes[1][i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                planes[2][i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+            std::size_t const size = static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+            bytes.resize(6 + 3 * size);
+            std::memcpy(bytes.data(), "FRAME\n", 6);
+            for (std::size_t p = 0; p < planes.size(); ++p)
+            {
+                uint8_t *plane = bytes.data() + 6 + p * size;
+                for (std::size_t i = 0; i < size; ++i)
+                {
+                    plane[i] = planes[p][pixels[i]];
+                }
+            }
+            if (!write_file(file, bytes))
+            {
+                error = "cannot write a frame";
+                return false;
+            }
+            return true;
+        }
+
+        bool finish() override
+        {
+            file.close();
+            return static_cast<bool>(file);
+        }
+
+    private:
+        const int width;
+        const int height;
+        std::ofstream file;
+        std::vector<uint8_t> bytes;
+    };
+
+    /// A PNG file per frame, 8 bits of palette index per pixel.
+    class png_encoder final : public encoder
+    {
+    public:
+        png_encoder(std::string const &path, int width, int height)
+            : width(width), height(height)
+        {
+            std::size_t const slash = path.find_last_of('/');
+            std::size_t const dot = path.find_last_of('.');
+            bool const has_extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+            stem = has_extension ? path.substr(0, dot) : path;
+            extension = has_extension ? path.substr(dot) : ".png";
+            // the first file tells whether the directory can be written at all
+            std::ofstream probe(name(0), std::ios::binary);
+            if (!probe)
+            {
+                error = "cannot open " + name(0);
+                return;
+            }
+            probe.close();
+            std::remove(name(0).c_str());
+        }
+
+        bool write(uint8_t const *pixels, std::array<uint32_t, 256> const &rgb) override
+        {
+            // rows with a filter byte of 0 in front
+            std::size_t const stride = static_cast<std::size_t>(width) + 1;
+            filtered.resize(stride * static_cast<std::size_t>(height));
+            for (std::size_t y = 0; y < static_cast<std::size_t>(height); ++y)
+            {
+                filtered[y * stride] = 0;
+                std::memcpy(filtered.data() + y * stride + 1, pixels + y * (stride - 1), stride - 1);
+            }
+            bytes.assign({0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'});
+            std::vector<uint8_t> &chunk = scratch;
+            chunk.clear();
+            put_be32(chunk, static_cast<uint32_t>(width));
+            put_be32(chunk, static_cast<uint32_t>(height));
+            // 8 bits, palette, deflate, no filter choice, not interlaced
+            chunk.insert(chunk.end(), {8, 3, 0, 0, 0});
+            put_chunk("IHDR", chunk);
+            chunk.clear();
+            for (uint32_t c : rgb)
+            {
+                chunk.insert(chunk.end(), {static_cast<uint8_t>(c >> 16), static_cast<uint8_t>(c >> 8), static_cast<uint8_t>(c)});
+            }
+            put_chunk("PLTE", chunk);
+            chunk.clear();
+            zlib.compress(filtered.data(), filtered.size(), stride, chunk);
+            put_chunk("IDAT", chunk);
+            chunk.clear();
+            put_chunk("IEND", chunk);
+            std::string const path = name(frames++);
+            std::ofstream file(path, std::ios::binary);
+            if (!file || !write_file(file, bytes))
+            {
+                error = "cannot write " + path;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        std::string name(uint64_t frame) const
+        {
+            char number[32];
+            std::snprintf(number, sizeof(number), "-%06llu", static_cast<unsigned long long>(frame));
+            return stem + number + extension;
+        }
+
+        void put_chunk(char const (&type)[5], std::vector<uint8_t> const &data)
+        {
+            put_be32(bytes, static_cast<uint32_t>(data.size()));
+            std::size_t const start = bytes.size();
+            bytes.insert(bytes.end(), type, type + 4);
+            bytes.insert(bytes.end(), data.begin(), data.end());
+            put_be32(bytes, crc32(bytes.data() + start, bytes.size() - start));
+        }
+
+        const int width;
+        const int height;
+        std::string stem;
+        std::string extension;
+        uint64_t frames{0};
+        std::vector<uint8_t> filtered;
+        deflater zlib;
+        std::vector<uint8_t> scratch;
+        std::vector<uint8_t> bytes;
+    };
+
+    /**
+     * An animated GIF that loops. Each frame has a palette of its own and
+     * covers only the rectangle of pixels that changed since the frame
+     * before, which stay on screen; its pixels are LZW coded.
+     */
+    class gif_encoder final : public encoder
+    {
+    public:
+        gif_encoder(std::string const &path, int width, int height, int fps)
+            : width(width), height(height), delay(std::max(2, static_cast<int>(std::lround(100.0 / std::max(fps, 1)))))
+            , file(path, std::ios::binary)
+            , previous(static_cast<std::size_t>(width) * static_cast<std::size_t>(height))
+        {
+            if (width > 0xffff || height > 0xffff)
+            {
+                error = "GIF frames are at most 65535 pixels wide and high";
+                return;
+            }
+            if (!file)
+            {
+                error = "cannot open " + path;
+                return;
+            }
+            bytes.assign({'G', 'I', 'F', '8', '9', 'a'});
+            put_le16(bytes, width);
+            put_le16(bytes, height);
+            // no global palette, background 0, square pixels
+            bytes.insert(bytes.end(), {0, 0, 0});
+            // loop forever
+            bytes.insert(bytes.end(), {0x21, 0xff, 11, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 3, 1, 0, 0, 0});
+            if (!write_file(file, bytes))
+            {
+                error = "cannot write " + path;
+            }
+        }
+
+        bool write(uint8_t const *pixels, std::array<uint32_t, 256> const &rgb) override
+        {
+            std::size_t const w = static_cast<std::size_t>(width);
+            std::size_t const h = static_cast<std::size_t>(height);
+            // the rectangle that changed; all of it when the colors did
+            std::size_t x0 = 0;
+            std::size_t y0 = 0;
+            std::size_t x1 = w;
+            std::size_t y1 = h;
+            if (frames > 0 && rgb == palette)
+            {
+                x0 = w;
+                y0 = h;
+                x1 = 0;
+                y1 = 0;
+                for (std::size_t y = 0; y < h; ++y)
+                {
+                    uint8_t const *now = pixels + y * w;
+                    uint8_t const *before = previous.data() + y * w;
+                    if (std::memcmp(now, before, w) == 0)
+                    {
+                        continue;
+                    }
+                    std::size_t left = 0;
+                    while (now[left] == before[left])
+                    {
+                        ++left;
+                    }
+                    std::size_t right = w;
+                    while (now[right - 1] == before[right - 1])
+                    {
+                        --right;
+                    }
+                    x0 = std::min(x0, left);
+                    x1 = std::max(x1, right);
+                    y0 = std::min(y0, y);
+                    y1 = y + 1;
+                }
+                if (x1 == 0)
+                {
+                    // nothing changed, but the frame still takes its time
+                    x0 = 0;
+                    y0 = 0;
+                    x1 = 1;
+                    y1 = 1;
+                }
+            }
+            std::memcpy(previous.data(), pixels, w * h);
+            palette = rgb;
+            ++frames;
+
+            bytes.clear();
+            // leave the frame in place, delay in hundredths of a second
+            bytes.insert(bytes.end(), {0x21, 0xf9, 4, 0x04});
+            put_le16(bytes, delay);
+            bytes.insert(bytes.end(), {0, 0});
+            bytes.push_back(0x2c);
+            put_le16(bytes, static_cast<int>(x0));
+            put_le16(bytes, static_cast<int>(y0));
+            put_le16(bytes, static_cast<int>(x1 - x0));
+            put_le16(bytes, static_cast<int>(y1 - y0));
+            // a local palette of 256 colors
+            bytes.push_back(0x87);
+            for (uint32_t c : rgb)
+            {
+                bytes.insert(bytes.end(), {static_cast<uint8_t>(c >> 16), static_cast<uint8_t>(c >> 8), static_cast<uint8_t>(c)});
+            }
+            bytes.push_back(8);
+            codes.clear();
+            lzw(pixels, x0, y0, x1, y1);
+            // in blocks of up to 255 bytes, then an empty one
+            for (std::size_t i = 0; i < codes.size(); i += 255)
+            {
+                std::size_t const n = std::min<std::size_t>(255, codes.size() - i);
+                bytes.push_back(static_cast<uint8_t>(n));
+                bytes.insert(bytes.end(), codes.begin() + static_cast<std::ptrdiff_t>(i), codes.begin() + static_cast<std::ptrdiff_t>(i + n));
+            }
+            bytes.push_back(0);
+            if (!write_file(file, bytes))
+            {
+                error = "cannot write a frame";
+                return false;
+            }
+            return true;
+        }
+
+        bool finish() override
+        {
+            file.put(0x3b);
+            file.close();
+            return static_cast<bool>(file);
+        }
+
+    private:
+        static constexpr uint32_t CLEAR = 256;
+        static constexpr uint32_t END = 257;
+        static constexpr uint32_t MAX_CODES = 4096;
+        static constexpr int TABLE_BITS = 13;
+
+        /**
+         * LZW codes of the pixels in [x0, x1) x [y0, y1), 8 bits per
+         * symbol. Strings are found in a hash table from (code of the
+         * string, next pixel) to the code of the longer string; the table
+         * starts over when all 4096 codes are taken.
+         */
+        void lzw(uint8_t const *pixels, std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1)
+        {
+            keys.assign(std::size_t{1} << TABLE_BITS, -1);
+            values.resize(keys.size());
+            bit_writer bits(codes);
+            int size = 9;
+            uint32_t next = END + 1;
+            bits.put(CLEAR, size);
+            std::size_t const w = static_cast<std::size_t>(width);
+            uint32_t prefix = pixels[y0 * w + x0];
+            bool first = true;
+            for (std::size_t y = y0; y < y1; ++y)
+            {
+                for (std::size_t x = x0; x < x1; ++x)
+                {
+                    if (first)
+                    {
+                        first = false;
+                        continue;
+                    }
+                    uint32_t const k = pixels[y * w + x];
+                    int32_t const key = static_cast<int32_t>((prefix << 8) | k);
+                    std::size_t slot = (static_cast<uint32_t>(key) * 2654435761u) >> (32 - TABLE_BITS);
+                    while (keys[slot] != -1 && keys[slot] != key)
+                    {
+                        slot = (slot + 1) & (keys.size() - 1);
+                    }
+                    if (keys[slot] == key)
+                    {
+                        prefix = values[slot];
+                        continue;
+                    }
+                    bits.put(prefix, size);
+                    // the decoder reads the next code one bit wider from here on
+                    if (next >= (uint32_t{1} << size) && size < 12)
+                    {
+                        ++size;
+                    }
+                    if (next < MAX_CODES)
+                    {
+                        keys[slot] = key;
+                        values[slot] = static_cast<uint16_t>(next++);
+                    }
+                    else
+                    {
+                        bits.put(CLEAR, size);
+                        keys.assign(keys.size(), -1);
+                        size = 9;
+                        next = END + 1;
+                    }
+                    prefix = k;
+                }
+            }
+            bits.put(prefix, size);
+            if (next >= (uint32_t{1} << size) && size < 12)
+            {
+                ++size;
+            }
+            bits.put(END, size);
+            bits.flush();
+        }
+
+        const int width;
+        const int height;
+        const int delay;
+        std::ofstream file;
+        uint64_t frames{0};
+        std::vector<uint8_t> previous;
+        std::array<uint32_t, 256> palette{};
+        std::vector<int32_t> keys;
+        std::vector<uint16_t> values;
+        std::vector<uint8_t> codes;
+        std::vector<uint8_t> bytes;
+    };
+}
+
+namespace recording
+{
+    bool format_of(std::string const &path, format &f)
+    {
+        std::size_t const dot = path.find_last_of('.');
+        std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        if (extension == "y4m")
+        {
+            f = format::Y4M;
+        }
+        else if (extension == "png")
+        {
+            f = format::PNG;
+        }
+        else if (extension == "gif")
+        {
+            f = format::GIF;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    bool from_name(std::string_view name, policy &p)
+    {
+        if (name == "drop")
+        {
+            p = policy::DROP;
+        }
+        else if (name == "block")
+        {
+            p = policy::BLOCK;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    recorder::recorder(options const &o, int width, int height)
+        : options_(o), width(width), height(height)
+        , pool(std::max<std::size_t>(o.buffers, 1))
+        , versions(static_cast<std::size_t>((height + BAND_ROWS - 1) / BAND_ROWS), 0)
+        , colors(width, height)
+        , pixels(static_cast<std::size_t>(width) * static_cast<std::size_t>(height))
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+        for (frame &f : pool)
+        {
+            f.cells.resize(per_row * static_cast<std::size_t>(height));
+            spare.push_back(&f);
+        }
+        switch (o.fmt)
+        {
+        case format::Y4M:
+            out = std::make_unique<y4m_encoder>(o.path, width, height, o.fps);
+            break;
+        case format::PNG:
+            out = std::make_unique<png_encoder>(o.path, width, height);
+            break;
+        case format::GIF:
+            out = std::make_unique<gif_encoder>(o.path, width, height, o.fps);
+            break;
+        }
+        if (!out->error.empty())
+        {
+            failed = true;
+            error_ = out->error;
+            return;
+        }
+        writer = std::thread(&recorder::run, this);
+    }
+
+    recorder::~recorder()
+    {
+        finish();
+    }
+
+    bool recorder::record(::game const &g)
+    {
+        profiling::scope timer(profiling::CAPTURE);
+        frame *f = acquire();
+        if (f == nullptr)
+        {
+            return false;
+        }
+        f->level = 0;
+        f->counted = false;
+        f->state_count = g.states();
+        g.get_rows(0, height, width, f->cells.data());
+        if (f->state_count > 2)
+        {
+            f->states.resize(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+            g.get_states(0, height, width, f->states.data());
+        }
+        submit(f);
+        return true;
+    }
+
+    bool recorder::record(::game const &g, int64_t x, int64_t y, int level)
+    {
+        profiling::scope timer(profiling::CAPTURE);
+        frame *f = acquire();
+        if (f == nullptr)
+        {
+            return false;
+        }
+        f->level = level;
+        f->counted = level == 0;
+        f->state_count = 2;
+        f->counts.resize(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+        g.get_density(x, y, level, width, height, f->counts.data());
+        submit(f);
+        return true;
+    }
+
+    void recorder::finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        queued.notify_all();
+        freed.notify_all();
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+    }
+
+    std::string recorder::error() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error_;
+    }
+
+    // A free buffer, or none when the frame is to be dropped.
+    recorder::frame *recorder::acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (spare.empty() && !closing && !failed && options_.when_full == policy::DROP)
+        {
+            uint64_t const dropped = dropped_.fetch_add(1, std::memory_order_relaxed) + 1;
+            lock.unlock();
+            profiling::record(profiling::DROPPED_FRAMES, dropped);
+            return nullptr;
+        }
+        freed.wait(lock, [this]
+                   { return !spare.empty() || closing || failed; });
+        if (closing || failed)
+        {
+            return nullptr;
+        }
+        frame *f = spare.back();
+        spare.pop_back();
+        return f;
+    }
+
+    void recorder::submit(frame *f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            waiting.push_back(f);
+        }
+        queued.notify_one();
+    }
+
+    // The writer thread: frames in the order they were recorded, until finish() and the queue is empty.
+    void recorder::run()
+    {
+        profiling::name_thread("recorder");
+        for (;;)
+        {
+            frame *f;
+            bool skip;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                queued.wait(lock, [this]
+                            { return closing || !waiting.empty(); });
+                if (waiting.empty())
+                {
+                    break;
+                }
+                f = waiting.front();
+                waiting.pop_front();
+                skip = failed;
+            }
+            if (!skip)
+            {
+                write(*f);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                spare.push_back(f);
+            }
+            freed.notify_one();
+        }
+        if (!out->finish())
+        {
+            fail("cannot complete " + options_.path);
+        }
+    }
+
+    void recorder::write(frame const &f)
+    {
+        profiling::scope timer(profiling::ENCODE);
+        if (f.level > 0)
+        {
+            colors.update_density(f.counts, f.level);
+        }
+        else if (f.counted)
+        {
+            std::size_t const per_row = (static_cast<std::size_t>(width) + 63) / 64;
+            packed.assign(per_row * static_cast<std::size_t>(height), 0);
+            for (std::size_t y = 0; y < static_cast<std::size_t>(height); ++y)
+            {
+                for (std::size_t x = 0; x < static_cast<std::size_t>(width); ++x)
+                {
+                    packed[y * per_row + x / 64] |= f.counts[y * static_cast<std::size_t>(width) + x] << (x % 64);
+                }
+            }
+            colors.update(packed, versions, BAND_ROWS);
+        }
+        else if (f.state_count > 2)
+        {
+            colors.update_states(f.states, f.state_count);
+        }
+        else
+        {
+            colors.update(f.cells, versions, BAND_ROWS);
+        }
+        for (int y = 0; y < height; ++y)
+        {
+            std::memcpy(pixels.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width), colors.row_shades(y),
+                        static_cast<std::size_t>(width));
+        }
+        // over a black background, as in the window
+        std::array<uint32_t, 256> rgb = colors.shade_colors();
+        for (uint32_t &c : rgb)
+        {
+            uint32_t const alpha = c >> 24;
+            uint32_t blended = 0;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                blended |= ((((c >> shift) & 0xff) * alpha + 127) / 255) << shift;
+            }
+            c = blended;
+        }
+        if (out->write(pixels.data(), rgb))
+        {
+            written_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            fail(out->error);
+        }
+    }
+
+    // Stops taking frames; those queued are still taken off the queue, but not written.
+    void recorder::fail(std::string const &message)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failed)
+            {
+                error_ = message;
+            }
+            failed = true;
+        }
+        freed.notify_all();
+    }
+}
@@ -0,0 +1,171 @@
+#ifndef __RECORDER_HPP__
+#define __RECORDER_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "game.hpp"
+#include "painter.hpp"
+
+namespace recording
+{
+    enum class format
+    {
+        /// one raw YUV4MPEG2 video file, which ffmpeg and most players read
+        Y4M,
+        /// a numbered PNG file per frame
+        PNG,
+        /// one animated GIF file
+        GIF,
+    };
+
+    /// What record() does when every buffer still waits to be written.
+    enum class policy
+    {
+        /// skips the frame and counts it, so the caller never waits
+        DROP,
+        /// waits for a buffer, so the caller slows down to what the disk takes
+        BLOCK,
+    };
+
+    /// The format the extension of `path` names (.y4m, .png, .gif); false for any other.
+    bool format_of(std::string const &path, format &f);
+    bool from_name(std::string_view name, policy &p);
+
+    /// Writes frames of palette indices in one format, see recorder.cpp.
+    class encoder;
+
+    struct options
+    {
+        /// the video file; for PNG, frames go to its name with -000000, -000001, ... before the extension
+        std::string path;
+        format fmt{format::Y4M};
+        policy when_full{policy::DROP};
+        /// a frame every this many iterate() calls
+        uint64_t every{1};
+        /// frames per second of the video
+        int fps{30};
+        /// frames that may wait for the writer at once
+        std::size_t buffers{8};
+    };
+
+    /**
+     * Streams frames of a game to a video or picture files, with the
+     * colors and trails of the window, without slowing down the thread
+     * that steps the game.
+     *
+     * record() only copies the cells into one of a fixed set of buffers
+     * and queues it; a writer thread of its own colors the frames with a
+     * painter, encodes and writes them, and hands the buffers back. Nothing
+     * is allocated per frame. When the disk falls behind and every buffer
+     * is queued, the policy decides: DROP skips the frame and counts it,
+     * BLOCK makes record() wait for the writer.
+     *
+     * Frames are a pixel per cell, or per square of cells zoomed out, on
+     * black. GIF and PNG use the painter's shades as palette indices; GIF
+     * frames after the first hold only the rectangle that changed.
+     */
+    class recorder
+    {
+    public:
+        /// Records frames of `width` x `height` pixels. A file that cannot be opened shows in error().
+        recorder(options const &o, int width, int height);
+        /// finish()es.
+        ~recorder();
+
+        recorder(recorder const &) = delete;
+        recorder &operator=(recorder const &) = delete;
+
+        /**
+         * Queues the whole board of `g`, which must be as large as the
+         * frames. Returns false if the frame was dropped, or the recorder
+         * is finished or failed.
+         */
+        bool record(::game const &g);
+
+        /// Queues squares of 2^`level` cells from cell (x, y), as game::get_density() counts them.
+        bool record(::game const &g, int64_t x, int64_t y, int level);
+
+        /// Writes the frames still queued, completes the file and stops the writer. Later frames are dropped.
+        void finish();
+
+        inline options const &settings() const
+        {
+            return options_;
+        }
+
+        /// Frames written so far.
+        inline uint64_t written() const
+        {
+            return written_.load(std::memory_order_relaxed);
+        }
+
+        /// Frames skipped because no buffer was free.
+        inline uint64_t dropped() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+        /// The first error writing, after which nothing more is written; empty if there was none.
+        std::string error() const;
+
+    private:
+        struct frame
+        {
+            /// 0 for cells, more for squares of 2^level cells
+            int level{0};
+            /// at level 0: the cells are in `counts` as 0 or 1 per cell, from game::get_density()
+            bool counted{false};
+            int state_count{2};
+            /// at level 0: the layout of game::get_rows()
+            std::vector<uint64_t> cells;
+            /// at level 0 with more than two states: game::get_states()
+            std::vector<uint8_t> states;
+            /// above level 0, or counted: live cells per square
+            std::vector<uint64_t> counts;
+        };
+
+        frame *acquire();
+        void submit(frame *f);
+        void run();
+        void write(frame const &f);
+        void fail(std::string const &message);
+
+        const options options_;
+        const int width;
+        const int height;
+        std::vector<frame> pool;
+        // rows_version() is not known for the frames, so every band is compared
+        std::vector<uint64_t> versions;
+
+        // touched on the writer thread only
+        painter colors;
+        std::unique_ptr<encoder> out;
+        // counted frames packed like game::get_rows()
+        std::vector<uint64_t> packed;
+        std::vector<uint8_t> pixels;
+
+        mutable std::mutex mutex;
+        std::condition_variable queued;
+        std::condition_variable freed;
+        std::vector<frame *> spare;
+        std::deque<frame *> waiting;
+        bool closing{false};
+        bool failed{false};
+        std::string error_;
+        std::atomic<uint64_t> written_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::thread writer;
+    };
+}
+
+#endif // __RECORDER_HPP__
@@ -0,0 +1,389 @@
+#ifndef __RULE_HPP__
+#define __RULE_HPP__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace rules
+{
+    /**
+     * An outer-totalistic rule on the Moore neighborhood ("Life-like").
+     * Bit n of `birth` is set if a dead cell with n live neighbors comes
+     * alive, bit n of `survival` if a live cell with n live neighbors stays
+     * alive.
+     *
+     * With more than two `states` it is a Generations rule: a live cell
+     * that does not survive is dying for `states` - 2 generations, one
+     * state further each, before it is dead. Dying cells do not count as
+     * live neighbors and cannot be born.
+     */
+    struct rule
+    {
+        uint16_t birth;
+        uint16_t survival;
+        uint8_t states{2};
+
+        constexpr bool operator==(rule const &other) const = default;
+
+        /// Packs both masks into one value, e.g. for switch statements.
+        constexpr uint32_t id() const
+        {
+            return (uint32_t{birth} << 9) | survival;
+        }
+
+        constexpr bool births(int n) const
+        {
+            return ((birth >> n) & 1) != 0;
+        }
+        constexpr bool survives(int n) const
+        {
+            return ((survival >> n) & 1) != 0;
+        }
+        constexpr bool next(bool alive, int n) const
+        {
+            return alive ? survives(n) : births(n);
+        }
+    };
+
+    constexpr rule CONWAY{1 << 3, (1 << 2) | (1 << 3)};
+
+    namespace detail
+    {
+        // 2 to 255, optionally after a 'C'
+        constexpr bool states(std::string_view s, uint8_t &states)
+        {
+            if (!s.empty() && (s[0] == 'C' || s[0] == 'c'))
+            {
+                s.remove_prefix(1);
+            }
+            unsigned int n = 0;
+            for (char c : s)
+            {
+                if (c < '0' || c > '9' || n > 255)
+                {
+                    return false;
+                }
+                n = n * 10 + static_cast<unsigned int>(c - '0');
+            }
+            states = static_cast<uint8_t>(n);
+            return !s.empty() && n >= 2 && n <= 255;
+        }
+
+        constexpr bool digits(std::string_view s, uint16_t &mask)
+        {
+            for (char c : s)
+            {
+                if (c < '0' || c > '8')
+                {
+                    return false;
+                }
+                mask = static_cast<uint16_t>(mask | (1 << (c - '0')));
+            }
+            return true;
+        }
+    }
+
+    /**
+     * Parses "B36/S23" (letters in any case, either half first) or the
+     * older "23/36" survival/birth notation, and Generations rules with the
+     * number of states as a third part: "B2/S/C3" or "/2/3". Returns false
+     * for anything else.
+     */
+    constexpr bool parse(std::string_view s, rule &r)
+    {
+        std::size_t const slash = s.find('/');
+        if (slash == std::string_view::npos)
+        {
+            return false;
+        }
+        std::string_view first = s.substr(0, slash);
+        std::string_view second = s.substr(slash + 1);
+        r = rule{0, 0};
+        std::size_t const third = second.find('/');
+        if (third != std::string_view::npos)
+        {
+            if (!detail::states(second.substr(third + 1), r.states))
+            {
+                return false;
+            }
+            second = second.substr(0, third);
+        }
+        auto tagged = [](std::string_view part, char tag)
+        {
+            return !part.empty() && (part[0] == tag || part[0] == tag - 'A' + 'a');
+        };
+        if (tagged(first, 'S') && tagged(second, 'B'))
+        {
+            std::string_view const t = first;
+            first = second;
+            second = t;
+        }
+        if (tagged(first, 'B') && tagged(second, 'S'))
+        {
+            return detail::digits(first.substr(1), r.birth) && detail::digits(second.substr(1), r.survival);
+        }
+        return detail::digits(first, r.survival) && detail::digits(second, r.birth);
+    }
+
+    constexpr rule parse(std::string_view s)
+    {
+        rule r{0, 0};
+        return parse(s, r) ? r : rule{0, 0};
+    }
+
+    constexpr rule HIGHLIFE = parse("B36/S23");
+    constexpr rule SEEDS = parse("B2/S");
+    constexpr rule DAY_AND_NIGHT = parse("B3678/S34678");
+    constexpr rule LIFE_WITHOUT_DEATH = parse("B3/S012345678");
+    constexpr rule REPLICATOR = parse("B1357/S1357");
+    constexpr rule DIAMOEBA = parse("B35678/S5678");
+    constexpr rule MORLEY = parse("B368/S245");
+    constexpr rule TWO_BY_TWO = parse("B36/S125");
+    constexpr rule BRIANS_BRAIN = parse("/2/3");
+    constexpr rule STAR_WARS = parse("345/2/4");
+
+    static_assert(parse("B3/S23") == CONWAY && parse("23/3") == CONWAY && parse("s23/b3") == CONWAY);
+    static_assert(parse("B2/S/C3") == BRIANS_BRAIN && BRIANS_BRAIN.states == 3 && parse("B3/S23/2") == CONWAY);
+
+    /// "B3/S23" notation of `r`, "B2/S/C3" for Generations rules.
+    inline std::string to_string(rule const &r)
+    {
+        std::string s = "B";
+        for (int n = 0; n <= 8; ++n)
+        {
+            if (r.births(n))
+            {
+                s += static_cast<char>('0' + n);
+            }
+        }
+        s += "/S";
+        for (int n = 0; n <= 8; ++n)
+        {
+            if (r.survives(n))
+            {
+                s += static_cast<char>('0' + n);
+            }
+        }
+        if (r.states > 2)
+        {
+            s += "/C" + std::to_string(r.states);
+        }
+        return s;
+    }
+
+    /// A rulestring or one of the names conway, highlife, seeds, daynight, lwod, replicator, diamoeba, morley, 2x2, brain, starwars.
+    inline bool from_name(std::string const &name, rule &r)
+    {
+        struct named
+        {
+            char const *name;
+            rule r;
+        };
+        static constexpr named known[] = {
+            {"conway", CONWAY},
+            {"highlife", HIGHLIFE},
+            {"seeds", SEEDS},
+            {"daynight", DAY_AND_NIGHT},
+            {"lwod", LIFE_WITHOUT_DEATH},
+            {"replicator", REPLICATOR},
+            {"diamoeba", DIAMOEBA},
+            {"morley", MORLEY},
+            {"2x2", TWO_BY_TWO},
+            {"brain", BRIANS_BRAIN},
+            {"starwars", STAR_WARS},
+        };
+        for (named const &k : known)
+        {
+            if (name == k.name)
+            {
+                r = k.r;
+                return true;
+            }
+        }
+        return parse(name, r);
+    }
+
+    /**
+     * A Larger-than-Life rule: a cell counts the live cells within
+     * `radius` of it, itself too if `middle` is set, and is alive next
+     * generation if the count is in [survive_min, survive_max] for a live
+     * cell or in [birth_min, birth_max] for a dead one. Within the radius
+     * means a square of (2 radius + 1)^2 cells for the Moore neighborhood
+     * and a diamond of cells at most `radius` steps away for von Neumann.
+     */
+    struct ltl_rule
+    {
+        enum neighborhood : uint8_t
+        {
+            MOORE,
+            VON_NEUMANN,
+        };
+
+        /// neighborhoods up to this radius; their counts fit in 16 bits
+        static constexpr int MAX_RADIUS = 100;
+
+        int radius{1};
+        bool middle{false};
+        int survive_min{2};
+        int survive_max{3};
+        int birth_min{3};
+        int birth_max{3};
+        neighborhood shape{MOORE};
+
+        constexpr bool operator==(ltl_rule const &other) const = default;
+
+        constexpr bool next(bool alive, int n) const
+        {
+            return alive ? n >= survive_min && n <= survive_max : n >= birth_min && n <= birth_max;
+        }
+    };
+
+    namespace detail
+    {
+        constexpr bool number(std::string_view s, int &n)
+        {
+            n = 0;
+            for (char c : s)
+            {
+                if (c < '0' || c > '9' || n > 100'000)
+                {
+                    return false;
+                }
+                n = n * 10 + (c - '0');
+            }
+            return !s.empty();
+        }
+
+        // "34..58"
+        constexpr bool range(std::string_view s, int &low, int &high)
+        {
+            std::size_t const dots = s.find("..");
+            if (dots == std::string_view::npos)
+            {
+                return number(s, low) && number(s, high);
+            }
+            return number(s.substr(0, dots), low) && number(s.substr(dots + 2), high);
+        }
+    }
+
+    /**
+     * Parses the "R5,C0,M1,S34..58,B34..45,NM" notation Golly uses:
+     * radius, states (0 or 2, as Generations variants are not supported),
+     * whether the middle cell counts, the survival and birth ranges, and
+     * the neighborhood, M for Moore or N for von Neumann. Returns false
+     * for anything else.
+     */
+    constexpr bool parse(std::string_view s, ltl_rule &r)
+    {
+        r = ltl_rule{};
+        // every part but the states is required, once
+        unsigned int seen = 0;
+        while (!s.empty())
+        {
+            std::size_t const comma = s.find(',');
+            std::string_view const part = s.substr(0, comma);
+            s = comma == std::string_view::npos ? std::string_view{} : s.substr(comma + 1);
+            if (part.empty())
+            {
+                return false;
+            }
+            std::string_view const value = part.substr(1);
+            int states = 0;
+            int middle = 0;
+            bool ok = false;
+            unsigned int bit = 0;
+            switch (part[0])
+            {
+            case 'R':
+            case 'r':
+                ok = detail::number(value, r.radius) && r.radius >= 1 && r.radius <= ltl_rule::MAX_RADIUS;
+                bit = 1;
+                break;
+            case 'C':
+            case 'c':
+                ok = detail::number(value, states) && (states == 0 || states == 2);
+                bit = 2;
+                break;
+            case 'M':
+            case 'm':
+                ok = detail::number(value, middle) && middle <= 1;
+                r.middle = middle == 1;
+                bit = 4;
+                break;
+            case 'S':
+            case 's':
+                ok = detail::range(value, r.survive_min, r.survive_max);
+                bit = 8;
+                break;
+            case 'B':
+            case 'b':
+                ok = detail::range(value, r.birth_min, r.birth_max);
+                bit = 16;
+                break;
+            case 'N':
+            case 'n':
+                ok = value == "M" || value == "m" || value == "N" || value == "n";
+                r.shape = value == "N" || value == "n" ? ltl_rule::VON_NEUMANN : ltl_rule::MOORE;
+                bit = 32;
+                break;
+            default:
+                return false;
+            }
+            if (!ok || (seen & bit) != 0)
+            {
+                return false;
+            }
+            seen |= bit;
+        }
+        return (seen | 2) == 63;
+    }
+
+    constexpr ltl_rule parse_ltl(std::string_view s)
+    {
+        ltl_rule r{};
+        return parse(s, r) ? r : ltl_rule{};
+    }
+
+    constexpr ltl_rule BOSCO = parse_ltl("R5,C0,M1,S34..58,B34..45,NM");
+    constexpr ltl_rule MAJORITY = parse_ltl("R4,C0,M1,S41..81,B41..81,NM");
+    constexpr ltl_rule WAFFLE = parse_ltl("R7,C0,M1,S100..200,B75..170,NM");
+
+    static_assert(parse_ltl("R1,C0,M0,S2..3,B3..3,NM") == ltl_rule{} && BOSCO.radius == 5 && BOSCO.middle);
+    static_assert(parse_ltl("R2,M0,S1..2,B2,NN").shape == ltl_rule::VON_NEUMANN && parse_ltl("R2,M0,S1..2,B2").radius == 1);
+
+    /// "R5,C0,M1,S34..58,B34..45,NM" notation of `r`.
+    inline std::string to_string(ltl_rule const &r)
+    {
+        return "R" + std::to_string(r.radius) + ",C0,M" + (r.middle ? "1" : "0") +
+               ",S" + std::to_string(r.survive_min) + ".." + std::to_string(r.survive_max) +
+               ",B" + std::to_string(r.birth_min) + ".." + std::to_string(r.birth_max) +
+               ",N" + (r.shape == ltl_rule::VON_NEUMANN ? "N" : "M");
+    }
+
+    /// A Larger-than-Life rulestring or one of the names bosco, majority, waffle.
+    inline bool from_name(std::string const &name, ltl_rule &r)
+    {
+        struct named
+        {
+            char const *name;
+            ltl_rule r;
+        };
+        static constexpr named known[] = {
+            {"bosco", BOSCO},
+            {"majority", MAJORITY},
+            {"waffle", WAFFLE},
+        };
+        for (named const &k : known)
+        {
+            if (name == k.name)
+            {
+                r = k.r;
+                return true;
+            }
+        }
+        return parse(name, r);
+    }
+}
+
+#endif // __RULE_HPP__
@@ -0,0 +1,273 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "profiler.hpp"
+
+simulation::simulation(games::settings const &settings, int width, int height, int view_width, int view_height)
+    : width_(width), height_(height), view_width_(view_width), view_height_(view_height)
+    , frames(frame{view{},
+                   std::vector<uint64_t>((static_cast<std::size_t>(view_width) + 63) / 64 * static_cast<std::size_t>(view_height), 0),
+                   std::vector<uint64_t>(static_cast<std::size_t>((view_height + BAND_ROWS - 1) / BAND_ROWS), 0),
+                   std::vector<uint64_t>(static_cast<std::size_t>(view_width) * static_cast<std::size_t>(view_height), 0),
+                   2, {}})
+    , rate(settings.rate)
+{
+    game = games::make_game(settings, width, height);
+    if (settings.history > 0)
+    {
+        history = std::make_unique<games::history>(width, height, settings.history);
+    }
+}
+
+simulation::~simulation()
+{
+    stop();
+}
+
+void simulation::start()
+{
+    if (!thread.joinable())
+    {
+        stopping = false;
+        thread = std::thread(&simulation::run, this);
+    }
+}
+
+void simulation::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+void simulation::post(command c)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        commands.push_back(std::move(c));
+    }
+    wake.notify_one();
+}
+
+void simulation::set_paused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused_ = paused;
+    }
+    wake.notify_one();
+}
+
+void simulation::set_rate(double generations_per_second)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        rate = generations_per_second;
+    }
+    wake.notify_one();
+}
+
+void simulation::rewind(uint64_t iterations)
+{
+    post([this, iterations](::game &g)
+         {
+             if (!history || history->empty())
+             {
+                 return;
+             }
+             uint64_t const now = iterations_.load(std::memory_order_relaxed);
+             uint64_t const target = std::max(now > iterations ? now - iterations : 0, history->oldest());
+             if (history->seek(g, target))
+             {
+                 iterations_.store(target, std::memory_order_relaxed);
+                 // shown even while paused
+                 read_frame(frames.back());
+                 frames.publish();
+             } });
+}
+
+void simulation::set_view(view v)
+{
+    post([this, v](::game &)
+         {
+             view_ = v;
+             read_frame(frames.back());
+             frames.publish(); });
+}
+
+void simulation::set_recorder(std::shared_ptr<recording::recorder> r)
+{
+    post([this, r](::game &)
+         { recorder = r; });
+}
+
+void simulation::run()
+{
+    using clock = std::chrono::steady_clock;
+    profiling::name_thread("simulation");
+    auto next = clock::now();
+    std::vector<command> pending;
+    // the engine can no longer step, see game::failure()
+    bool failed = false;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // the next generation is due unless paused, failed or ahead of the target rate
+            auto const due = [&]
+            {
+                return !paused_ && !failed && (rate <= 0 || clock::now() >= next);
+            };
+            auto const ready = [&]
+            {
+                return stopping || !commands.empty() || due();
+            };
+            if (paused_ || failed)
+            {
+                wake.wait(lock, ready);
+            }
+            else
+            {
+                wake.wait_until(lock, next, ready);
+            }
+            if (stopping)
+            {
+                return;
+            }
+            pending.swap(commands);
+        }
+        for (command &c : pending)
+        {
+            c(*game);
+        }
+        pending.clear();
+
+        double const r = rate;
+        auto const now = clock::now();
+        if (paused_ || failed || (r > 0 && now < next))
+        {
+            continue;
+        }
+        if (history && history->empty())
+        {
+            history->record(*game, iterations_.load(std::memory_order_relaxed));
+        }
+        {
+            profiling::scope timer(profiling::STEP);
+            game->iterate();
+        }
+        if (std::string const failure = game->failure(); !failure.empty())
+        {
+            // the board stays at the last generation completed, for viewing and saving
+            std::cerr << "\u001b[31;1mThe engine stopped:\u001b[0m " << failure << std::endl;
+            failed = true;
+            continue;
+        }
+        profiling::record(profiling::CELL_UPDATES, game->cells_updated());
+        uint64_t const done = iterations_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (history)
+        {
+            history->record(*game, done);
+        }
+        publish_frame();
+        if (recorder && done % recorder->settings().every == 0)
+        {
+            record_frame();
+        }
+        if (r > 0)
+        {
+            // falling behind does not turn into a burst of catch-up generations
+            next = std::max(next + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / r)), now);
+        }
+    }
+}
+
+void simulation::publish_frame()
+{
+    // a frame still waiting to be shown would only be replaced unseen
+    if (!frames.consumed())
+    {
+        return;
+    }
+    read_frame(frames.back());
+    frames.publish();
+    if (tracking_population.load(std::memory_order_relaxed))
+    {
+        profiling::record(profiling::POPULATION, game->population());
+    }
+}
+
+// Hands the view to the recorder, which copies it and returns.
+void simulation::record_frame()
+{
+    if (view_ == view{} && width_ == view_width_ && height_ == view_height_)
+    {
+        recorder->record(*game);
+    }
+    else
+    {
+        recorder->record(*game, view_.x, view_.y, view_.level);
+    }
+}
+
+/**
+ * Brings `f` up to date with the game and the view. When the view is the
+ * whole world, only bands that changed since `f` was filled are read.
+ */
+void simulation::read_frame(frame &f)
+{
+    profiling::scope timer(profiling::READ);
+    if (f.shown != view_)
+    {
+        // the versions were of other cells
+        std::fill(f.versions.begin(), f.versions.end(), 0);
+        f.shown = view_;
+    }
+    std::size_t const per_row = (static_cast<std::size_t>(view_width_) + 63) / 64;
+    f.state_count = game->states();
+    if (view_ != view{} || width_ != view_width_ || height_ != view_height_)
+    {
+        game->get_density(view_.x, view_.y, view_.level, view_width_, view_height_, f.counts.data());
+        if (view_.level > 0)
+        {
+            return;
+        }
+        // one cell per square, packed like get_rows() does
+        std::fill(f.cells.begin(), f.cells.end(), 0);
+        for (std::size_t y = 0; y < static_cast<std::size_t>(view_height_); ++y)
+        {
+            for (std::size_t x = 0; x < static_cast<std::size_t>(view_width_); ++x)
+            {
+                f.cells[y * per_row + x / 64] |= f.counts[y * static_cast<std::size_t>(view_width_) + x] << (x % 64);
+            }
+        }
+        return;
+    }
+    for (int y = 0; y < height_; y += BAND_ROWS)
+    {
+        int const rows = std::min(BAND_ROWS, height_ - y);
+        uint64_t &seen = f.versions[static_cast<std::size_t>(y / BAND_ROWS)];
+        uint64_t const now = game->rows_version(y, rows);
+        if (now != 0 && now == seen)
+        {
+            continue;
+        }
+        game->get_rows(y, rows, width_, f.cells.data() + static_cast<std::size_t>(y) * per_row);
+        if (f.state_count > 2)
+        {
+            // only games with more than two states need it
+            f.states.resize(static_cast<std::size_t>(width_) * static_cast<std::size_t>(height_));
+            game->get_states(y, rows, width_, f.states.data() + static_cast<std::size_t>(y) * static_cast<std::size_t>(width_));
+        }
+        seen = now;
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef __SIMULATION_HPP__
+#define __SIMULATION_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "engines.hpp"
+#include "game.hpp"
+#include "history.hpp"
+#include "recorder.hpp"
+#include "triple-buffer.hpp"
+
+/**
+ * Runs a game on its own thread, independent of the display.
+ *
+ * The cells are copied out of the game into a frame and published
+ * through a triple buffer only when the previous frame has been picked
+ * up, so generations nobody will see cost nothing beyond stepping them.
+ * Coloring is left to the display. A frame reads only the bands of rows
+ * whose game::rows_version() moved since that frame was last filled.
+ * Edits from the UI are queued with post() and applied between two
+ * generations. With a history budget in the settings, every generation is
+ * recorded so that rewind() can go back to it.
+ *
+ * The world may be larger than the frames. A frame shows the part of it
+ * under the view: one cell per pixel at level 0, and zoomed out, the
+ * number of live cells in each square of 2^level x 2^level cells from
+ * game::get_density(), so reading a frame costs the same for any size of
+ * world.
+ *
+ * A recorder given to set_recorder() gets the view of every generation
+ * its settings ask for, whether or not the display picks it up.
+ */
+class simulation
+{
+public:
+    /// rows per band of a frame
+    static constexpr int BAND_ROWS = 32;
+
+    /// The part of the world a frame shows: squares of 2^level cells from cell (x, y), a multiple of 2^level.
+    struct view
+    {
+        int64_t x{0};
+        int64_t y{0};
+        int level{0};
+
+        bool operator==(view const &) const = default;
+    };
+
+    struct frame
+    {
+        view shown;
+        /// at level 0: cells in the layout of game::get_rows()
+        std::vector<uint64_t> cells;
+        /// at level 0: per band of BAND_ROWS rows, game::rows_version() when its cells were read, 0 if unknown
+        std::vector<uint64_t> versions;
+        /// above level 0: live cells per square, in rows of view_width()
+        std::vector<uint64_t> counts;
+        /// game::states() when the cells were read
+        int state_count{2};
+        /// at level 0 with more than two states: game::get_states() of every cell, in rows of view_width()
+        std::vector<uint8_t> states;
+    };
+    using command = std::function<void(::game &)>;
+
+    /// A world of `width` x `height` cells seen through frames of `view_width` x `view_height`.
+    simulation(games::settings const &settings, int width, int height, int view_width, int view_height);
+    ~simulation();
+
+    simulation(simulation const &) = delete;
+    simulation &operator=(simulation const &) = delete;
+
+    /// False if the settings named an unknown engine.
+    inline bool is_ready() const
+    {
+        return game != nullptr;
+    }
+
+    void start();
+    void stop();
+
+    /// Runs `c` on the simulation thread before the next generation.
+    void post(command c);
+
+    void set_paused(bool paused);
+    inline bool paused() const
+    {
+        return paused_.load(std::memory_order_relaxed);
+    }
+
+    /// Target generations per second, 0 runs as fast as possible.
+    void set_rate(double generations_per_second);
+
+    /**
+     * Goes back `iterations` iterate() calls, or as far as the history
+     * reaches, before the next generation. Later generations are forgotten.
+     */
+    void rewind(uint64_t iterations);
+
+    /// Shows `v` from the next frame on, which is published even while paused.
+    void set_view(view v);
+
+    /// Streams the view to `r` from the next generation on; nullptr stops.
+    void set_recorder(std::shared_ptr<recording::recorder> r);
+
+    /// Records the population as a profiling counter with every frame published; counting it costs a pass over the board.
+    inline void track_population(bool on)
+    {
+        tracking_population.store(on, std::memory_order_relaxed);
+    }
+
+    /// Number of iterate() calls so far, less those rewound.
+    inline uint64_t iterations() const
+    {
+        return iterations_.load(std::memory_order_relaxed);
+    }
+
+    /// Makes the newest published frame available through latest_frame(). Returns false if none arrived.
+    inline bool update_frame()
+    {
+        return frames.update();
+    }
+    inline frame const &latest_frame() const
+    {
+        return frames.front();
+    }
+
+    inline int width() const
+    {
+        return width_;
+    }
+    inline int height() const
+    {
+        return height_;
+    }
+    inline int view_width() const
+    {
+        return view_width_;
+    }
+    inline int view_height() const
+    {
+        return view_height_;
+    }
+
+private:
+    void run();
+    void publish_frame();
+    void read_frame(frame &f);
+    void record_frame();
+
+    const int width_;
+    const int height_;
+    const int view_width_;
+    const int view_height_;
+    // touched on the simulation thread only
+    view view_;
+    std::unique_ptr<::game> game;
+    std::unique_ptr<games::history> history;
+    util::triple_buffer<frame> frames;
+    // touched on the simulation thread only
+    std::shared_ptr<recording::recorder> recorder;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<command> commands;
+    bool stopping{false};
+    std::atomic<bool> paused_{false};
+    std::atomic<double> rate{0};
+    std::atomic<uint64_t> iterations_{0};
+    std::atomic<bool> tracking_population{false};
+};
+
+#endif // __SIMULATION_HPP__
@@ -0,0 +1,367 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+namespace snapshots
+{
+    namespace
+    {
+        constexpr char MAGIC[8] = {'L', 'I', 'F', 'E', 'S', 'N', 'A', 'P'};
+        constexpr uint32_t VERSION = 2;
+        constexpr uint32_t FLAG_COMPRESSED = 1;
+        constexpr uint8_t LTL_MIDDLE = 1;
+        constexpr uint8_t LTL_VON_NEUMANN = 2;
+
+        struct file_header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t flags;
+            uint32_t width;
+            uint32_t height;
+            uint16_t birth;
+            uint16_t survival;
+            // states of a Generations rule, 0 for two
+            uint32_t states;
+            uint64_t generation;
+            uint64_t seed;
+            uint64_t data_offset;
+            uint64_t data_size;
+            // since version 2: the rule of the ltl engine; neighbor counts fit in 16 bits up to MAX_RADIUS
+            uint8_t ltl_radius;
+            uint8_t ltl_flags;
+            uint16_t ltl_survive_min;
+            uint16_t ltl_survive_max;
+            uint16_t ltl_birth_min;
+            uint16_t ltl_birth_max;
+            uint8_t reserved[6];
+        };
+        static_assert(sizeof(file_header) == 80);
+        // the header of version 1 ends before the Larger-than-Life rule
+        constexpr std::size_t V1_HEADER_SIZE = 64;
+        // planes and header are written as they are in memory
+        static_assert(std::endian::native == std::endian::little);
+
+        constexpr uint64_t DATA_OFFSET = sizeof(file_header);
+
+        std::size_t words_per_row(int width)
+        {
+            return (static_cast<std::size_t>(width) + 63) / 64;
+        }
+
+        // Tiling of a board; the last row and column of tiles may be cut short.
+        struct tiling
+        {
+            std::size_t per_row;
+            std::size_t tiles_x;
+            std::size_t tiles_y;
+            int height;
+
+            tiling(int width, int height)
+                : per_row(words_per_row(width))
+                , tiles_x((per_row + TILE_WORDS - 1) / TILE_WORDS)
+                , tiles_y((static_cast<std::size_t>(height) + TILE_ROWS - 1) / TILE_ROWS)
+                , height(height)
+            {
+            }
+
+            std::size_t count() const
+            {
+                return tiles_x * tiles_y;
+            }
+            int rows(std::size_t ty) const
+            {
+                return std::min(TILE_ROWS, height - static_cast<int>(ty) * TILE_ROWS);
+            }
+            std::size_t words(std::size_t tx) const
+            {
+                return std::min(TILE_WORDS, per_row - tx * TILE_WORDS);
+            }
+        };
+
+        // Bytes tile `tx` of a band takes in a compressed snapshot, 0 if it is empty.
+        uint64_t encoded_size(tiling const &t, uint64_t const *band, int rows, std::size_t tx)
+        {
+            uint64_t nonzero = 0;
+            for (int r = 0; r < rows; ++r)
+            {
+                uint64_t const *w = band + static_cast<std::size_t>(r) * t.per_row + tx * TILE_WORDS;
+                for (std::size_t i = 0; i < t.words(tx); ++i)
+                {
+                    nonzero += w[i] != 0 ? 1 : 0;
+                }
+            }
+            if (nonzero == 0)
+            {
+                return 0;
+            }
+            // keep the tiles 8-byte aligned
+            return (static_cast<uint64_t>(rows) + nonzero * sizeof(uint64_t) + 7) & ~uint64_t{7};
+        }
+
+        void encode(tiling const &t, uint64_t const *band, int rows, std::size_t tx, uint8_t *out)
+        {
+            uint8_t *words = out + rows;
+            for (int r = 0; r < rows; ++r)
+            {
+                uint64_t const *w = band + static_cast<std::size_t>(r) * t.per_row + tx * TILE_WORDS;
+                uint8_t mask = 0;
+                for (std::size_t i = 0; i < t.words(tx); ++i)
+                {
+                    if (w[i] != 0)
+                    {
+                        mask = static_cast<uint8_t>(mask | (1 << i));
+                        std::memcpy(words, &w[i], sizeof(uint64_t));
+                        words += sizeof(uint64_t);
+                    }
+                }
+                out[r] = mask;
+            }
+        }
+    }
+
+    bool save(std::string const &path, game const &g, info const &header, std::string &error)
+    {
+        tiling const t(header.width, header.height);
+        std::size_t const plane_words = t.per_row * static_cast<std::size_t>(header.height);
+        std::vector<uint64_t> band;
+        std::vector<uint64_t> offsets;
+        uint64_t data_size = plane_words * sizeof(uint64_t);
+        if (header.compressed)
+        {
+            // the size of every tile is needed up front to size the file
+            band.resize(static_cast<std::size_t>(TILE_ROWS) * t.per_row);
+            offsets.resize(t.count() + 1);
+            offsets[0] = offsets.size() * sizeof(uint64_t);
+            for (std::size_t ty = 0; ty < t.tiles_y; ++ty)
+            {
+                g.get_rows(static_cast<int>(ty) * TILE_ROWS, t.rows(ty), header.width, band.data());
+                for (std::size_t tx = 0; tx < t.tiles_x; ++tx)
+                {
+                    std::size_t const i = ty * t.tiles_x + tx;
+                    offsets[i + 1] = offsets[i] + encoded_size(t, band.data(), t.rows(ty), tx);
+                }
+            }
+            data_size = offsets.back();
+        }
+
+        std::string const tmp = path + ".tmp";
+        util::mapped_file file;
+        if (!file.create(tmp, DATA_OFFSET + data_size))
+        {
+            error = file.error();
+            return false;
+        }
+        file_header h{};
+        std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        h.flags = header.compressed ? FLAG_COMPRESSED : 0;
+        h.width = static_cast<uint32_t>(header.width);
+        h.height = static_cast<uint32_t>(header.height);
+        h.birth = header.rule.birth;
+        h.survival = header.rule.survival;
+        h.states = header.rule.states > 2 ? header.rule.states : 0;
+        h.generation = header.generation;
+        h.seed = header.seed;
+        h.data_offset = DATA_OFFSET;
+        h.data_size = data_size;
+        h.ltl_radius = static_cast<uint8_t>(header.ltl.radius);
+        h.ltl_flags = static_cast<uint8_t>((header.ltl.middle ? LTL_MIDDLE : 0) | (header.ltl.shape == rules::ltl_rule::VON_NEUMANN ? LTL_VON_NEUMANN : 0));
+        h.ltl_survive_min = static_cast<uint16_t>(header.ltl.survive_min);
+        h.ltl_survive_max = static_cast<uint16_t>(header.ltl.survive_max);
+        h.ltl_birth_min = static_cast<uint16_t>(header.ltl.birth_min);
+        h.ltl_birth_max = static_cast<uint16_t>(header.ltl.birth_max);
+        std::memcpy(file.data(), &h, sizeof(h));
+
+        uint8_t *const data = file.data() + DATA_OFFSET;
+        if (!header.compressed)
+        {
+            g.get_rows(0, header.height, header.width, reinterpret_cast<uint64_t *>(data));
+        }
+        else
+        {
+            std::memcpy(data, offsets.data(), offsets.size() * sizeof(uint64_t));
+            for (std::size_t ty = 0; ty < t.tiles_y; ++ty)
+            {
+                g.get_rows(static_cast<int>(ty) * TILE_ROWS, t.rows(ty), header.width, band.data());
+                for (std::size_t tx = 0; tx < t.tiles_x; ++tx)
+                {
+                    std::size_t const i = ty * t.tiles_x + tx;
+                    if (offsets[i + 1] != offsets[i])
+                    {
+                        encode(t, band.data(), t.rows(ty), tx, data + offsets[i]);
+                    }
+                }
+            }
+        }
+        // the data must be on the disk before the rename is, or a power loss could leave the new name on an empty file
+        if (!file.sync())
+        {
+            error = tmp + ": " + file.error();
+            return false;
+        }
+        file.close();
+
+        std::error_code ec;
+        std::filesystem::rename(tmp, path, ec);
+        if (ec)
+        {
+            error = "Cannot rename " + tmp + ": " + ec.message();
+            return false;
+        }
+        return util::sync_directory_of(path, error);
+    }
+
+    bool reader::fail(std::string const &message)
+    {
+        error_ = message;
+        file.close();
+        return false;
+    }
+
+    bool reader::open(std::string const &path)
+    {
+        if (!file.open(path))
+        {
+            error_ = file.error();
+            return false;
+        }
+        file_header h{};
+        if (file.size() < V1_HEADER_SIZE)
+        {
+            return fail("Not a snapshot: " + path);
+        }
+        std::memcpy(&h, file.data(), V1_HEADER_SIZE);
+        if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            return fail("Not a snapshot: " + path);
+        }
+        if (h.version != 1 && h.version != VERSION)
+        {
+            return fail("Unsupported snapshot version " + std::to_string(h.version) + ": " + path);
+        }
+        rules::ltl_rule ltl{};
+        if (h.version >= 2)
+        {
+            if (file.size() < sizeof(h))
+            {
+                return fail("Corrupt snapshot: " + path);
+            }
+            std::memcpy(&h, file.data(), sizeof(h));
+            if (h.ltl_radius < 1 || h.ltl_radius > rules::ltl_rule::MAX_RADIUS || (h.ltl_flags & ~(LTL_MIDDLE | LTL_VON_NEUMANN)) != 0)
+            {
+                return fail("Corrupt snapshot: " + path);
+            }
+            ltl.radius = h.ltl_radius;
+            ltl.middle = (h.ltl_flags & LTL_MIDDLE) != 0;
+            ltl.shape = (h.ltl_flags & LTL_VON_NEUMANN) != 0 ? rules::ltl_rule::VON_NEUMANN : rules::ltl_rule::MOORE;
+            ltl.survive_min = h.ltl_survive_min;
+            ltl.survive_max = h.ltl_survive_max;
+            ltl.birth_min = h.ltl_birth_min;
+            ltl.birth_max = h.ltl_birth_max;
+        }
+        if (h.width == 0 || h.height == 0 || h.width > INT32_MAX || h.height > INT32_MAX ||
+            h.data_offset % sizeof(uint64_t) != 0 || h.data_offset > file.size() || h.data_size > file.size() - h.data_offset)
+        {
+            return fail("Corrupt snapshot: " + path);
+        }
+        info_.width = static_cast<int>(h.width);
+        info_.height = static_cast<int>(h.height);
+        info_.rule = rules::rule{h.birth, h.survival, static_cast<uint8_t>(h.states > 2 && h.states < 256 ? h.states : 2)};
+        info_.ltl = ltl;
+        info_.generation = h.generation;
+        info_.seed = static_cast<unsigned long>(h.seed);
+        info_.compressed = (h.flags & FLAG_COMPRESSED) != 0;
+        data_offset = h.data_offset;
+        data_size = h.data_size;
+        uint64_t const plane_bytes = words_per_row(info_.width) * h.height * sizeof(uint64_t);
+        if (!info_.compressed && data_size != plane_bytes)
+        {
+            return fail("Corrupt snapshot: " + path);
+        }
+        return true;
+    }
+
+    bool reader::restore(game &g)
+    {
+        if (file.data() == nullptr)
+        {
+            return fail("No snapshot open");
+        }
+        if (info_.compressed)
+        {
+            return restore_tiles(g);
+        }
+        // straight from the page cache into the engine
+        g.set_rows(0, info_.height, info_.width, reinterpret_cast<uint64_t const *>(file.data() + data_offset));
+        return true;
+    }
+
+    bool reader::restore_tiles(game &g)
+    {
+        tiling const t(info_.width, info_.height);
+        uint8_t const *const data = file.data() + data_offset;
+        uint64_t const index_size = (t.count() + 1) * sizeof(uint64_t);
+        if (index_size > data_size)
+        {
+            return fail("Corrupt snapshot index");
+        }
+        uint64_t const *const offsets = reinterpret_cast<uint64_t const *>(data);
+        if (offsets[0] != index_size || offsets[t.count()] > data_size)
+        {
+            return fail("Corrupt snapshot index");
+        }
+
+        std::vector<uint64_t> band(static_cast<std::size_t>(TILE_ROWS) * t.per_row);
+        for (std::size_t ty = 0; ty < t.tiles_y; ++ty)
+        {
+            int const rows = t.rows(ty);
+            std::fill(band.begin(), band.end(), 0);
+            for (std::size_t tx = 0; tx < t.tiles_x; ++tx)
+            {
+                std::size_t const i = ty * t.tiles_x + tx;
+                if (offsets[i + 1] < offsets[i])
+                {
+                    return fail("Corrupt snapshot index");
+                }
+                uint64_t const size = offsets[i + 1] - offsets[i];
+                if (size == 0)
+                {
+                    continue;
+                }
+                uint8_t const *const masks = data + offsets[i];
+                if (size < static_cast<uint64_t>(rows))
+                {
+                    return fail("Corrupt snapshot tile");
+                }
+                uint64_t words = 0;
+                bool valid = true;
+                for (int r = 0; r < rows; ++r)
+                {
+                    words += static_cast<uint64_t>(std::popcount(masks[r]));
+                    valid &= (masks[r] >> t.words(tx)) == 0;
+                }
+                if (!valid || rows + words * sizeof(uint64_t) > size)
+                {
+                    return fail("Corrupt snapshot tile");
+                }
+                uint8_t const *in = masks + rows;
+                for (int r = 0; r < rows; ++r)
+                {
+                    uint64_t *w = band.data() + static_cast<std::size_t>(r) * t.per_row + tx * TILE_WORDS;
+                    for (unsigned int mask = masks[r]; mask != 0; mask &= mask - 1)
+                    {
+                        std::memcpy(&w[std::countr_zero(mask)], in, sizeof(uint64_t));
+                        in += sizeof(uint64_t);
+                    }
+                }
+            }
+            g.set_rows(static_cast<int>(ty) * TILE_ROWS, rows, info_.width, band.data());
+        }
+        return true;
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef __SNAPSHOT_HPP__
+#define __SNAPSHOT_HPP__
+
+#include <cstdint>
+#include <string>
+
+#include "game.hpp"
+#include "mapped-file.hpp"
+#include "rule.hpp"
+
+namespace snapshots
+{
+    /**
+     * Binary checkpoints of a board.
+     *
+     * An 80 byte little-endian header (magic "LIFESNAP", version, flags,
+     * width, height, rule, generation, seed, offset and size of the data,
+     * then the Larger-than-Life rule) is followed by the cells as one
+     * bit-packed plane: (width + 63) / 64 words per row, cell x in bit
+     * x % 64 of word x / 64, the layout the packed engine keeps in memory.
+     * Saving and restoring such a plane is a single copy between the engine
+     * and the mapped file.
+     *
+     * Compressed snapshots cut the plane into tiles of TILE_ROWS rows by
+     * TILE_WORDS words. An index of tile offsets is followed by the tiles;
+     * an empty tile takes no space, any other one a byte per row telling
+     * which of its words are nonzero, followed by those words.
+     *
+     * Version 1 snapshots, whose header stops before the Larger-than-Life
+     * rule, are still read, with the default one.
+     */
+    constexpr int TILE_ROWS = 32;
+    constexpr std::size_t TILE_WORDS = 8;
+
+    struct info
+    {
+        int width{0};
+        int height{0};
+        rules::rule rule{rules::CONWAY};
+        /// rule of the ltl engine
+        rules::ltl_rule ltl{};
+        uint64_t generation{0};
+        unsigned long seed{0};
+        bool compressed{false};
+    };
+
+    /**
+     * Writes [0, width) x [0, height) of `g` as described by `header`. The
+     * file is written next to `path` and renamed over it when complete, so
+     * an interrupted checkpoint never destroys the previous one.
+     */
+    bool save(std::string const &path, game const &g, info const &header, std::string &error);
+
+    /// Maps a snapshot file; its header is checked when opened, the cells are read by restore().
+    class reader
+    {
+    public:
+        /// Returns false on errors, see error().
+        bool open(std::string const &path);
+        inline info const &header() const
+        {
+            return info_;
+        }
+
+        /// Writes the cells into `g`, which must be at least header().width x header().height.
+        bool restore(game &g);
+
+        inline std::string const &error() const
+        {
+            return error_;
+        }
+
+    private:
+        bool fail(std::string const &message);
+        bool restore_tiles(game &g);
+
+        util::mapped_file file;
+        info info_;
+        uint64_t data_offset{0};
+        uint64_t data_size{0};
+        std::string error_;
+    };
+}
+
+#endif // __SNAPSHOT_HPP__
@@ -0,0 +1,256 @@
+#include "soup-farm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "board-hash.hpp"
+#include "counter-rng.hpp"
+#include "kernels/life.hpp"
+#include "thread-pool.hpp"
+
+namespace games
+{
+    namespace
+    {
+        constexpr std::size_t ROWS = static_cast<std::size_t>(soup_farm::SIZE);
+
+        // a board is hashed as the packed engine's two tiles of a SIZE x SIZE board
+        static_assert(soup_farm::SIZE == 2 * HASH_TILE_ROWS, "a board must be two hash tiles high");
+
+        /**
+         * Boards stepped together by one thread, with their rows interleaved:
+         * row y of lane l is at [y * lanes + l].
+         */
+        class batch
+        {
+        public:
+            batch(soup_farm::settings const &s, std::size_t lanes, std::atomic<uint64_t> &next)
+                : s(s), next(next), kernel(&kernels::active()), lanes(lanes)
+                , plane_a(ROWS * lanes, 0), plane_b(ROWS * lanes, 0), states(lanes, state(s.max_period))
+                , top_salt(tile_salt(0, 0)), bottom_salt(tile_salt(0, 1))
+            {
+            }
+
+            uint64_t run(std::function<void(soup_result const &)> const &report, std::mutex &reporting)
+            {
+                uint64_t generations = 0;
+                for (std::size_t l = 0; l < lanes; ++l)
+                {
+                    start(l);
+                }
+                while (active > 0)
+                {
+                    step();
+                    for (std::size_t l = 0; l < lanes; ++l)
+                    {
+                        state &st = states[l];
+                        if (!st.active)
+                        {
+                            continue;
+                        }
+                        ++st.generation;
+                        if (st.cycles.add(hash(l), st.generation) || st.generation >= s.max_generations)
+                        {
+                            generations += st.generation;
+                            soup_result const r = result(l);
+                            if (s.census)
+                            {
+                                objects.add(plane_a.data() + l, lanes, soup_farm::SIZE, soup_farm::SIZE);
+                            }
+                            {
+                                std::lock_guard<std::mutex> lock(reporting);
+                                report(r);
+                            }
+                            start(l);
+                        }
+                    }
+                    if (exhausted && active > 0 && active <= lanes / 2)
+                    {
+                        compact();
+                    }
+                }
+                return generations;
+            }
+
+        private:
+            struct state
+            {
+                explicit state(std::size_t max_period)
+                    : cycles(max_period)
+                {
+                }
+
+                uint64_t index{0};
+                uint32_t seed{0};
+                uint64_t generation{0};
+                cycle_detector cycles;
+                bool active{false};
+            };
+
+            // Puts the next soup into lane `l`, or retires the lane if there is none.
+            void start(std::size_t l)
+            {
+                state &st = states[l];
+                uint64_t const index = exhausted ? s.soups : next.fetch_add(1, std::memory_order_relaxed);
+                if (index >= s.soups)
+                {
+                    exhausted = true;
+                    active -= st.active ? 1 : 0;
+                    st.active = false;
+                    for (std::size_t y = 0; y < ROWS; ++y)
+                    {
+                        plane_a[y * lanes + l] = 0;
+                    }
+                    return;
+                }
+                active += st.active ? 0 : 1;
+                st.active = true;
+                st.index = index;
+                st.seed = soup_farm::soup_seed(s.seed, index);
+                st.generation = 0;
+                // the same cells as packed_life::seed() and a first populate(0.5) make
+                for (std::size_t y = 0; y < ROWS; ++y)
+                {
+                    plane_a[y * lanes + l] = util::random_cells(st.seed, 0, y, util::HALF_DENSITY);
+                }
+                st.cycles.clear();
+                st.cycles.add(hash(l), 0);
+            }
+
+            void step()
+            {
+                for (std::size_t y = 0; y < ROWS; ++y)
+                {
+                    uint64_t const *above = plane_a.data() + (y + ROWS - 1) % ROWS * lanes;
+                    uint64_t const *below = plane_a.data() + (y + 1) % ROWS * lanes;
+                    kernel->step_wrapped(s.rule, above, plane_a.data() + y * lanes, below, plane_b.data() + y * lanes, lanes);
+                }
+                std::swap(plane_a, plane_b);
+            }
+
+            // The hash packed_life::hash() has for the board in lane `l`.
+            uint64_t hash(std::size_t l) const
+            {
+                uint64_t const *cells = plane_a.data() + l;
+                return EMPTY_BOARD_HASH ^ tile_hash(cells, lanes, HASH_TILE_ROWS, 1, top_salt) ^
+                       tile_hash(cells + static_cast<std::size_t>(HASH_TILE_ROWS) * lanes, lanes, HASH_TILE_ROWS, 1, bottom_salt);
+            }
+
+            soup_result result(std::size_t l) const
+            {
+                state const &st = states[l];
+                soup_result r{st.index, st.seed, st.generation, 0, 0, 0, 0, 0, 0};
+                if (st.cycles.found())
+                {
+                    r.generation = st.cycles.start();
+                    r.period = st.cycles.period();
+                }
+                int x0 = soup_farm::SIZE;
+                int x1 = -1;
+                int y0 = soup_farm::SIZE;
+                int y1 = -1;
+                for (std::size_t y = 0; y < ROWS; ++y)
+                {
+                    uint64_t const w = plane_a[y * lanes + l];
+                    if (w == 0)
+                    {
+                        continue;
+                    }
+                    r.population += static_cast<uint64_t>(std::popcount(w));
+                    x0 = std::min(x0, std::countr_zero(w));
+                    x1 = std::max(x1, 63 - std::countl_zero(w));
+                    y0 = std::min(y0, static_cast<int>(y));
+                    y1 = static_cast<int>(y);
+                }
+                if (r.population > 0)
+                {
+                    r.x = x0;
+                    r.y = y0;
+                    r.width = x1 - x0 + 1;
+                    r.height = y1 - y0 + 1;
+                }
+                return r;
+            }
+
+            /**
+             * Once no new soups come in, moves the remaining boards into
+             * fewer lanes, so the last long-lived soups are not stepped
+             * together with a batch full of empty ones.
+             */
+            void compact()
+            {
+                std::size_t const fewer = std::max<std::size_t>(active, 1);
+                std::vector<uint64_t> packed(ROWS * fewer, 0);
+                std::vector<state> kept;
+                kept.reserve(fewer);
+                for (std::size_t l = 0; l < lanes; ++l)
+                {
+                    if (!states[l].active)
+                    {
+                        continue;
+                    }
+                    for (std::size_t y = 0; y < ROWS; ++y)
+                    {
+                        packed[y * fewer + kept.size()] = plane_a[y * lanes + l];
+                    }
+                    kept.push_back(std::move(states[l]));
+                }
+                lanes = fewer;
+                plane_a = std::move(packed);
+                plane_b.assign(ROWS * lanes, 0);
+                kept.resize(lanes, state(s.max_period));
+                states = std::move(kept);
+            }
+
+            soup_farm::settings const &s;
+            std::atomic<uint64_t> &next;
+            kernels::life_kernel const *kernel;
+            std::size_t lanes;
+            std::vector<uint64_t> plane_a;
+            std::vector<uint64_t> plane_b;
+            std::vector<state> states;
+            uint64_t const top_salt;
+            uint64_t const bottom_salt;
+            std::size_t active{0};
+            bool exhausted{false};
+
+        public:
+            // objects on the boards finished so far, with soup_farm::settings::census
+            games::census objects{s.rule, s.max_period};
+        };
+    }
+
+    soup_farm::soup_farm(settings const &s)
+        : s(s), objects_(s.rule, s.max_period)
+    {
+    }
+
+    uint32_t soup_farm::soup_seed(uint64_t seed, uint64_t index)
+    {
+        uint32_t const result = static_cast<uint32_t>(mix64(mix64(seed) + index * 0x9e3779b97f4a7c15ull) >> 32);
+        // 0 stands for a random seed in games::settings
+        return result != 0 ? result : 1;
+    }
+
+    uint64_t soup_farm::run(std::function<void(soup_result const &)> const &report)
+    {
+        util::thread_pool pool(s.threads);
+        // no more lanes than it takes to give every thread a share of the soups
+        std::size_t const share = static_cast<std::size_t>((s.soups + pool.size() - 1) / pool.size());
+        std::size_t const lanes = std::clamp<std::size_t>(share, 1, std::max<std::size_t>(s.lanes, 1));
+        std::atomic<uint64_t> next{0};
+        std::atomic<uint64_t> generations{0};
+        std::mutex reporting;
+        pool.parallel_for(pool.size(), [&](std::size_t)
+                          {
+                              batch b(s, lanes, next);
+                              generations += b.run(report, reporting);
+                              std::lock_guard<std::mutex> lock(reporting);
+                              objects_.merge(b.objects); });
+        return generations;
+    }
+}
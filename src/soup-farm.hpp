@@ -0,0 +1,95 @@
+#ifndef __SOUP_FARM_HPP__
+#define __SOUP_FARM_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "census.hpp"
+#include "cycle-detector.hpp"
+#include "rule.hpp"
+
+namespace games
+{
+    /// What became of one soup.
+    struct soup_result
+    {
+        /// number of the soup in the search, from 0
+        uint64_t index;
+        /// seed its cells were drawn with, see soup_farm::soup_seed()
+        uint32_t seed;
+        /// generation the board settled in, or the last one run if it did not
+        uint64_t generation;
+        /// period it settled into, 1 for still lifes and empty boards, 0 if it did not settle
+        uint64_t period;
+        uint64_t population;
+        /// bounding box of the live cells, 0 x 0 for an empty board
+        int x, y, width, height;
+    };
+
+    /**
+     * Runs many random soups on small boards at once, for scanning them for
+     * what they settle into.
+     *
+     * Every board is SIZE x SIZE cells and wraps around, so each of its rows
+     * is a single word. The rows of `lanes` boards are interleaved, row y
+     * of board b at [y * lanes + b], and every row of all of them is stepped
+     * by one call of the active kernel's step_wrapped(), which puts several
+     * boards into each SIMD register. Each worker thread runs such a batch.
+     * After every generation each board's hash goes into a cycle_detector of
+     * its own; a board that settled, or ran `max_generations`, is reported
+     * and its lane gets the next soup.
+     *
+     * Soup i is filled from soup_seed(seed, i) exactly like
+     * packed_life::populate(0.5) fills a board after seed(), so any soup can be
+     * replayed on its own with the packed engine on a SIZE x SIZE board.
+     * The results do not depend on the number of threads or lanes, only
+     * the order they are reported in does. With settings::census, every
+     * thread also takes a census of each board it finishes.
+     */
+    class soup_farm
+    {
+    public:
+        static constexpr int SIZE = 64;
+
+        struct settings
+        {
+            rules::rule rule{rules::CONWAY};
+            /// seed of the whole search; soups get their own from it
+            uint64_t seed{1};
+            uint64_t soups{1000};
+            uint64_t max_generations{10'000};
+            std::size_t max_period{cycle_detector::DEFAULT_MAX_PERIOD};
+            /// worker threads, 0 = one per hardware thread
+            unsigned int threads{0};
+            /// boards stepped together by each thread
+            std::size_t lanes{256};
+            /// count the objects of every finished board in objects()
+            bool census{false};
+        };
+
+        explicit soup_farm(settings const &s);
+
+        /**
+         * Runs all soups and calls `report` with each one as soon as it is
+         * done, from one thread at a time. Returns the number of
+         * generations run, summed over all soups.
+         */
+        uint64_t run(std::function<void(soup_result const &)> const &report);
+
+        /// Seed of soup `index` of the search with seed `seed`; never 0.
+        static uint32_t soup_seed(uint64_t seed, uint64_t index);
+
+        /// Objects on the final boards of all soups run, with settings::census.
+        inline games::census const &objects() const
+        {
+            return objects_;
+        }
+
+    private:
+        settings const s;
+        games::census objects_;
+    };
+}
+
+#endif // __SOUP_FARM_HPP__
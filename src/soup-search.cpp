@@ -0,0 +1,172 @@
+// Scans random soups on small wrapping boards for what they settle into,
+// many boards at once, and streams a line per soup as soon as it is done.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "kernels/life.hpp"
+#include "rule.hpp"
+#include "soup-farm.hpp"
+
+namespace
+{
+    void usage(char const *argv0)
+    {
+        std::cerr << "Usage: " << argv0
+                  << " [--soups N] [--seed S] [--generations N] [--max-period P] [--rule B3/S23] [--threads N] [--lanes N]"
+                     " [--kernel NAME] [--format csv|json] [--output FILE] [--census]"
+                  << std::endl;
+    }
+
+    void write_csv(std::ostream &out, games::soup_result const &r)
+    {
+        out << r.index << "," << r.seed << "," << r.generation << "," << r.period << "," << r.population << ","
+            << r.x << "," << r.y << "," << r.width << "," << r.height << "\n";
+    }
+
+    void write_json(std::ostream &out, games::soup_result const &r)
+    {
+        out << "{\"index\": " << r.index << ", \"seed\": " << r.seed << ", \"generation\": " << r.generation
+            << ", \"period\": " << r.period << ", \"population\": " << r.population << ", \"x\": " << r.x << ", \"y\": " << r.y
+            << ", \"width\": " << r.width << ", \"height\": " << r.height << "}\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    games::soup_farm::settings settings;
+    std::string format{"csv"};
+    std::string output;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--soups") == 0 && i + 1 < argc)
+        {
+            settings.soups = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            settings.seed = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((std::strcmp(argv[i], "--generations") == 0 || std::strcmp(argv[i], "-g") == 0) && i + 1 < argc)
+        {
+            settings.max_generations = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--max-period") == 0 && i + 1 < argc)
+        {
+            settings.max_period = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if ((std::strcmp(argv[i], "--rule") == 0 || std::strcmp(argv[i], "-r") == 0) && i + 1 < argc)
+        {
+            if (!rules::from_name(argv[++i], settings.rule))
+            {
+                std::cerr << "\u001b[31;1mInvalid rule:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if ((std::strcmp(argv[i], "--threads") == 0 || std::strcmp(argv[i], "-t") == 0) && i + 1 < argc)
+        {
+            settings.threads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--lanes") == 0 && i + 1 < argc)
+        {
+            settings.lanes = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--kernel") == 0 && i + 1 < argc)
+        {
+            if (!kernels::select(argv[++i]))
+            {
+                std::cerr << "\u001b[31;1mKernel not supported on this CPU:\u001b[0m " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (std::strcmp(argv[i], "--census") == 0)
+        {
+            settings.census = true;
+        }
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            format = argv[++i];
+        }
+        else if ((std::strcmp(argv[i], "--output") == 0 || std::strcmp(argv[i], "-o") == 0) && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if ((format != "csv" && format != "json") || settings.soups == 0 || settings.max_generations == 0 || settings.max_period == 0 ||
+        settings.lanes == 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::ofstream file;
+    if (!output.empty())
+    {
+        file.open(output);
+        if (!file)
+        {
+            std::cerr << "\u001b[31;1mError writing:\u001b[0m " << output << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream &out = output.empty() ? std::cout : file;
+    bool const csv = format == "csv";
+    if (csv)
+    {
+        out << "index,seed,generation,period,population,x,y,width,height\n";
+    }
+
+    uint64_t settled = 0;
+    auto const t0 = std::chrono::steady_clock::now();
+    games::soup_farm farm(settings);
+    uint64_t const generations = farm.run([&](games::soup_result const &r)
+                                          {
+                                              settled += r.period != 0 ? 1 : 0;
+                                              if (csv)
+                                              {
+                                                  write_csv(out, r);
+                                              }
+                                              else
+                                              {
+                                                  write_json(out, r);
+                                              } });
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    out.flush();
+    if (!out)
+    {
+        std::cerr << "\u001b[31;1mError writing:\u001b[0m " << (output.empty() ? "stdout" : output) << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the results own stdout, so the summary goes to stderr
+    std::cerr << "kernel:      " << kernels::active().name << std::endl
+              << "rule:        " << rules::to_string(settings.rule) << std::endl
+              << "soups:       " << settings.soups << ", " << settled << " settled within " << settings.max_generations
+              << " generations" << std::endl
+              << std::fixed << std::setprecision(3)
+              << "seconds:     " << seconds << std::endl
+              << std::setprecision(1)
+              << "soups/s:     " << static_cast<double>(settings.soups) / seconds << std::endl
+              << std::scientific << std::setprecision(3)
+              << "gens/s:      " << static_cast<double>(generations) / seconds << std::endl;
+    if (settings.census)
+    {
+        std::cerr << "objects:     " << farm.objects().total() << std::endl;
+        for (games::census::object const &o : farm.objects().objects())
+        {
+            std::cerr << std::setw(12) << o.count << " " << o.code << (o.name.empty() ? "" : " (" + o.name + ")") << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
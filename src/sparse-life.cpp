@@ -0,0 +1,598 @@
+#include "sparse-life.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include "board-hash.hpp"
+
+namespace games
+{
+    namespace
+    {
+        struct direction
+        {
+            int dx;
+            int dy;
+        };
+        // bit d of chunk::edges refers to DIRECTIONS[d]
+        constexpr direction DIRECTIONS[8] = {{0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}};
+        enum : uint8_t
+        {
+            NORTH = 1 << 0,
+            NORTH_EAST = 1 << 1,
+            EAST = 1 << 2,
+            SOUTH_EAST = 1 << 3,
+            SOUTH = 1 << 4,
+            SOUTH_WEST = 1 << 5,
+            WEST = 1 << 6,
+            NORTH_WEST = 1 << 7,
+        };
+
+        // chunk coordinates of a cell; the shifts round towards negative infinity
+        constexpr int CHUNK_X_SHIFT = std::countr_zero(static_cast<unsigned int>(sparse_life::CHUNK_WIDTH));
+        constexpr int CHUNK_Y_SHIFT = std::countr_zero(static_cast<unsigned int>(sparse_life::CHUNK_ROWS));
+        static_assert((1 << CHUNK_X_SHIFT) == sparse_life::CHUNK_WIDTH && (1 << CHUNK_Y_SHIFT) == sparse_life::CHUNK_ROWS);
+    }
+
+    sparse_life::sparse_life(int width, int height, unsigned int threads)
+        : width(width), height(height), kernel(&kernels::active())
+    {
+        set_threads(threads);
+        seed(util::make_seed());
+    }
+
+    void sparse_life::seed(unsigned long s)
+    {
+        rng.seed(s);
+    }
+
+    void sparse_life::set_threads(unsigned int threads)
+    {
+        pool.reset();
+        if (threads != 1)
+        {
+            pool = std::make_unique<util::thread_pool>(threads);
+        }
+    }
+
+    void sparse_life::set_rule(rules::rule const &r)
+    {
+        rule_ = r;
+        // chunks that were stable under the old rule need not be under the new one
+        std::vector<uint32_t> all;
+        map.for_each([&all](uint64_t, uint32_t i)
+                     { all.push_back(i); });
+        for (uint32_t i : all)
+        {
+            touch(i);
+        }
+    }
+
+    uint32_t sparse_life::get_or_create(int64_t cx, int64_t cy)
+    {
+        uint32_t i = map.find(key(cx, cy));
+        if (i != util::index_map::NONE)
+        {
+            return i;
+        }
+        if (free_ids.empty())
+        {
+            i = static_cast<uint32_t>(chunks.size());
+            chunks.emplace_back();
+        }
+        else
+        {
+            i = free_ids.back();
+            free_ids.pop_back();
+        }
+        // value-initialized, so all cells are dead
+        chunks[i] = std::make_unique<chunk>();
+        chunks[i]->cx = static_cast<int32_t>(cx);
+        chunks[i]->cy = static_cast<int32_t>(cy);
+        map.insert(key(cx, cy), i);
+        return i;
+    }
+
+    void sparse_life::release(uint32_t i)
+    {
+        // released chunks are empty and hash to 0
+        board_hash ^= chunks[i]->hash;
+        for (std::size_t s = 0; counting && s < CHUNK_SQUARES; ++s)
+        {
+            int64_t const sx = int64_t{chunks[i]->cx} * static_cast<int64_t>(CHUNK_SQUARES) + static_cast<int64_t>(s);
+            if (densities.at(0, sx, chunks[i]->cy) != 0)
+            {
+                densities.set(sx, chunks[i]->cy, 0);
+            }
+        }
+        map.erase(key(chunks[i]->cx, chunks[i]->cy));
+        chunks[i].reset();
+        free_ids.push_back(i);
+    }
+
+    void sparse_life::schedule(uint32_t i)
+    {
+        chunk &c = *chunks[i];
+        if (!c.scheduled)
+        {
+            c.scheduled = true;
+            active.push_back(i);
+        }
+    }
+
+    void sparse_life::touch(uint32_t i)
+    {
+        schedule(i);
+        chunks[i]->hash_stale = true;
+        mark_density(i);
+        int64_t const cx = chunks[i]->cx;
+        int64_t const cy = chunks[i]->cy;
+        for (direction const &d : DIRECTIONS)
+        {
+            schedule(get_or_create(cx + d.dx, cy + d.dy));
+        }
+    }
+
+    void sparse_life::fill_halo(chunk &c) const
+    {
+        int const p = c.current;
+        auto neighbor = [&](int d)
+        {
+            return find(int64_t{c.cx} + DIRECTIONS[d].dx, int64_t{c.cy} + DIRECTIONS[d].dy);
+        };
+        chunk const *const west = neighbor(6);
+        chunk const *const east = neighbor(2);
+        for (int y = 0; y < CHUNK_ROWS; ++y)
+        {
+            uint64_t *r = c.row(p, y);
+            r[-1] = west ? west->row(west->current, y)[CHUNK_WORDS - 1] : 0;
+            r[CHUNK_WORDS] = east ? east->row(east->current, y)[0] : 0;
+        }
+        // the halo rows take a word from the diagonal neighbors at either end
+        auto halo_row = [&](uint64_t *r, chunk const *w, chunk const *n, chunk const *e, int y)
+        {
+            r[-1] = w ? w->row(w->current, y)[CHUNK_WORDS - 1] : 0;
+            for (std::size_t i = 0; i < CHUNK_WORDS; ++i)
+            {
+                r[i] = n ? n->row(n->current, y)[i] : 0;
+            }
+            r[CHUNK_WORDS] = e ? e->row(e->current, y)[0] : 0;
+        };
+        halo_row(c.row(p, -1), neighbor(7), neighbor(0), neighbor(1), CHUNK_ROWS - 1);
+        halo_row(c.row(p, CHUNK_ROWS), neighbor(5), neighbor(4), neighbor(3), 0);
+    }
+
+    void sparse_life::step_chunk(chunk &c) const
+    {
+        fill_halo(c);
+        int const p = c.current;
+        uint8_t changed = 0;
+        for (int y = 0; y < CHUNK_ROWS; ++y)
+        {
+            kernel->step(rule_, c.row(p, y - 1), c.row(p, y), c.row(p, y + 1), c.row(1 - p, y), 0, CHUNK_WORDS, &changed);
+        }
+        c.changed = changed;
+        if (changed && hashing)
+        {
+            // while the chunk is still in cache
+            c.next_hash = tile_hash(c.row(1 - p, 0), STRIDE, CHUNK_ROWS, CHUNK_WORDS, tile_salt(c.cx, c.cy));
+        }
+    }
+
+    uint8_t sparse_life::border(chunk const &c)
+    {
+        // cells that were or are alive on the border may make or have made a neighbor change
+        auto both = [&c](int y, std::size_t w)
+        {
+            return c.row(0, y)[w] | c.row(1, y)[w];
+        };
+        uint64_t top = 0;
+        uint64_t bottom = 0;
+        for (std::size_t w = 0; w < CHUNK_WORDS; ++w)
+        {
+            top |= both(0, w);
+            bottom |= both(CHUNK_ROWS - 1, w);
+        }
+        uint64_t left = 0;
+        uint64_t right = 0;
+        for (int y = 0; y < CHUNK_ROWS; ++y)
+        {
+            left |= both(y, 0);
+            right |= both(y, CHUNK_WORDS - 1);
+        }
+        unsigned int edges = 0;
+        edges |= top != 0 ? NORTH : 0;
+        edges |= bottom != 0 ? SOUTH : 0;
+        edges |= (left & 1) != 0 ? WEST : 0;
+        edges |= (right >> 63) != 0 ? EAST : 0;
+        edges |= (both(0, 0) & 1) != 0 ? NORTH_WEST : 0;
+        edges |= (both(0, CHUNK_WORDS - 1) >> 63) != 0 ? NORTH_EAST : 0;
+        edges |= (both(CHUNK_ROWS - 1, 0) & 1) != 0 ? SOUTH_WEST : 0;
+        edges |= (both(CHUNK_ROWS - 1, CHUNK_WORDS - 1) >> 63) != 0 ? SOUTH_EAST : 0;
+        return static_cast<uint8_t>(edges);
+    }
+
+    bool sparse_life::is_empty(chunk const &c)
+    {
+        uint64_t any = 0;
+        for (int y = 0; y < CHUNK_ROWS; ++y)
+        {
+            uint64_t const *r = c.row(c.current, y);
+            for (std::size_t w = 0; w < CHUNK_WORDS; ++w)
+            {
+                any |= r[w];
+            }
+        }
+        return any == 0;
+    }
+
+    void sparse_life::iterate()
+    {
+        stepping.swap(active);
+        active.clear();
+        last_active = stepping.size();
+
+        // every chunk only writes its own halo and next plane, so they can be stepped in any order
+        if (pool)
+        {
+            pool->parallel_for(stepping.size(), [this](std::size_t i)
+                               { step_chunk(*chunks[stepping[i]]); });
+        }
+        else
+        {
+            for (uint32_t i : stepping)
+            {
+                step_chunk(*chunks[i]);
+            }
+        }
+
+        for (uint32_t i : stepping)
+        {
+            chunk &c = *chunks[i];
+            c.scheduled = false;
+            if (c.changed)
+            {
+                c.edges = border(c);
+                c.current ^= 1;
+                c.hash_stale = !hashing;
+                if (hashing)
+                {
+                    board_hash ^= c.hash ^ c.next_hash;
+                    c.hash = c.next_hash;
+                }
+                mark_density(i);
+            }
+        }
+        // a changed chunk is stepped again, together with the neighbors its border reaches
+        for (uint32_t i : stepping)
+        {
+            chunk &c = *chunks[i];
+            if (!c.changed)
+            {
+                continue;
+            }
+            schedule(i);
+            for (int d = 0; d < 8; ++d)
+            {
+                if ((c.edges >> d) & 1)
+                {
+                    schedule(get_or_create(int64_t{c.cx} + DIRECTIONS[d].dx, int64_t{c.cy} + DIRECTIONS[d].dy));
+                }
+            }
+        }
+        // empty chunks that stay empty are implied by their absence
+        for (uint32_t i : stepping)
+        {
+            chunk const &c = *chunks[i];
+            if (!c.changed && !c.scheduled && is_empty(c))
+            {
+                release(i);
+            }
+        }
+        ++generation_;
+    }
+
+    void sparse_life::set(int64_t x, int64_t y, bool alive)
+    {
+        int64_t const cx = x >> CHUNK_X_SHIFT;
+        int64_t const cy = y >> CHUNK_Y_SHIFT;
+        if (!alive && find(cx, cy) == nullptr)
+        {
+            return;
+        }
+        uint32_t const i = get_or_create(cx, cy);
+        chunk &c = *chunks[i];
+        std::size_t const lx = static_cast<std::size_t>(x & (CHUNK_WIDTH - 1));
+        uint64_t &word = c.row(c.current, static_cast<int>(y & (CHUNK_ROWS - 1)))[lx / 64];
+        uint64_t const bit = uint64_t{1} << (lx % 64);
+        word = alive ? (word | bit) : (word & ~bit);
+        touch(i);
+    }
+
+    bool sparse_life::get(int64_t x, int64_t y) const
+    {
+        chunk const *c = find(x >> CHUNK_X_SHIFT, y >> CHUNK_Y_SHIFT);
+        if (c == nullptr)
+        {
+            return false;
+        }
+        std::size_t const lx = static_cast<std::size_t>(x & (CHUNK_WIDTH - 1));
+        return ((c->row(c->current, static_cast<int>(y & (CHUNK_ROWS - 1)))[lx / 64] >> (lx % 64)) & 1) != 0;
+    }
+
+    void sparse_life::set_span(int x, int y, int length, bool alive)
+    {
+        int64_t const cy = int64_t{y} >> CHUNK_Y_SHIFT;
+        int const ly = y & (CHUNK_ROWS - 1);
+        int64_t cx = int64_t{x} >> CHUNK_X_SHIFT;
+        std::size_t begin = static_cast<std::size_t>(x & (CHUNK_WIDTH - 1));
+        for (int64_t left = length; left > 0; ++cx, begin = 0)
+        {
+            std::size_t const end = std::min(begin + static_cast<std::size_t>(left), static_cast<std::size_t>(CHUNK_WIDTH));
+            left -= static_cast<int64_t>(end - begin);
+            if (!alive && find(cx, cy) == nullptr)
+            {
+                continue;
+            }
+            uint32_t const i = get_or_create(cx, cy);
+            chunk &c = *chunks[i];
+            uint64_t *r = c.row(c.current, ly);
+            for (std::size_t w = begin / 64; w * 64 < end; ++w)
+            {
+                std::size_t const lo = std::max(begin, w * 64) - w * 64;
+                std::size_t const hi = std::min(end, w * 64 + 64) - w * 64;
+                uint64_t const mask = (hi == 64 ? ~uint64_t{0} : (uint64_t{1} << hi) - 1) & ~((uint64_t{1} << lo) - 1);
+                r[w] = alive ? (r[w] | mask) : (r[w] & ~mask);
+            }
+            touch(i);
+        }
+    }
+
+    // Rows start at column 0, so the words of a row line up with those of the chunks.
+    void sparse_life::get_rows(int y, int count, int w, uint64_t *words) const
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(w) + 63) / 64;
+        for (int row = 0; row < count; ++row)
+        {
+            int64_t const cy = int64_t{y + row} >> CHUNK_Y_SHIFT;
+            int const ly = (y + row) & (CHUNK_ROWS - 1);
+            uint64_t *out = words + static_cast<std::size_t>(row) * per_row;
+            for (std::size_t begin = 0; begin < per_row; begin += CHUNK_WORDS)
+            {
+                std::size_t const end = std::min(begin + CHUNK_WORDS, per_row);
+                chunk const *c = find(static_cast<int64_t>(begin / CHUNK_WORDS), cy);
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    out[i] = c == nullptr ? 0 : c->row(c->current, ly)[i - begin];
+                }
+            }
+            if (w % 64 != 0)
+            {
+                out[per_row - 1] &= (uint64_t{1} << (w % 64)) - 1;
+            }
+        }
+    }
+
+    void sparse_life::set_rows(int y, int count, int w, uint64_t const *words)
+    {
+        std::size_t const per_row = (static_cast<std::size_t>(w) + 63) / 64;
+        uint64_t const last = w % 64 == 0 ? ~uint64_t{0} : (uint64_t{1} << (w % 64)) - 1;
+        for (int row = 0; row < count; ++row)
+        {
+            int64_t const cy = int64_t{y + row} >> CHUNK_Y_SHIFT;
+            int const ly = (y + row) & (CHUNK_ROWS - 1);
+            uint64_t const *in = words + static_cast<std::size_t>(row) * per_row;
+            for (std::size_t begin = 0; begin < per_row; begin += CHUNK_WORDS)
+            {
+                std::size_t const end = std::min(begin + CHUNK_WORDS, per_row);
+                int64_t const cx = static_cast<int64_t>(begin / CHUNK_WORDS);
+                uint64_t any = 0;
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    any |= in[i] & (i == per_row - 1 ? last : ~uint64_t{0});
+                }
+                if (any == 0 && find(cx, cy) == nullptr)
+                {
+                    continue;
+                }
+                uint32_t const i = get_or_create(cx, cy);
+                chunk &c = *chunks[i];
+                uint64_t *r = c.row(c.current, ly);
+                for (std::size_t j = begin; j < end; ++j)
+                {
+                    uint64_t const mask = j == per_row - 1 ? last : ~uint64_t{0};
+                    r[j - begin] = (r[j - begin] & ~mask) | (in[j] & mask);
+                }
+                touch(i);
+            }
+        }
+    }
+
+    void sparse_life::populate(double density)
+    {
+        clear();
+        uint32_t const fill = rng.next_fill();
+        uint32_t const p = util::fixed_density(density);
+        // words are numbered as in a packed board of the window
+        uint64_t const per_row = (static_cast<uint64_t>(width) + 63) / 64;
+        for (int y0 = 0; y0 < height; y0 += CHUNK_ROWS)
+        {
+            for (int x0 = 0; x0 < width; x0 += CHUNK_WIDTH)
+            {
+                uint32_t const i = get_or_create(x0 >> CHUNK_X_SHIFT, y0 >> CHUNK_Y_SHIFT);
+                chunk &c = *chunks[i];
+                for (int y = 0; y < std::min(CHUNK_ROWS, height - y0); ++y)
+                {
+                    uint64_t *r = c.row(c.current, y);
+                    for (std::size_t w = 0; w < CHUNK_WORDS && x0 + static_cast<int>(w) * 64 < width; ++w)
+                    {
+                        int const left = width - x0 - static_cast<int>(w) * 64;
+                        uint64_t const mask = left >= 64 ? ~uint64_t{0} : (uint64_t{1} << left) - 1;
+                        uint64_t const index = static_cast<uint64_t>(y0 + y) * per_row + static_cast<uint64_t>(x0 / 64) + w;
+                        r[w] = util::random_cells(rng.key(), fill, index, p) & mask;
+                    }
+                }
+                touch(i);
+            }
+        }
+    }
+
+    void sparse_life::clear()
+    {
+        board_hash = 0;
+        densities.clear();
+        density_queue.clear();
+        chunks.clear();
+        free_ids.clear();
+        map.clear();
+        active.clear();
+        generation_ = 0;
+    }
+
+    void sparse_life::irritate(int const x, int const y)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                set(x + dx, y + dy, (rng() & 1) != 0);
+            }
+        }
+    }
+
+    uint64_t sparse_life::hash() const
+    {
+        hashing = true;
+        map.for_each([this](uint64_t, uint32_t i)
+                     {
+                         chunk &c = *chunks[i];
+                         if (c.hash_stale)
+                         {
+                             uint64_t const h = tile_hash(c.row(c.current, 0), STRIDE, CHUNK_ROWS, CHUNK_WORDS, tile_salt(c.cx, c.cy));
+                             board_hash ^= c.hash ^ h;
+                             c.hash = h;
+                             c.hash_stale = false;
+                         } });
+        return board_hash ^ EMPTY_BOARD_HASH;
+    }
+
+    void sparse_life::mark_density(uint32_t i)
+    {
+        chunk &c = *chunks[i];
+        if (counting && !c.density_stale)
+        {
+            c.density_stale = true;
+            density_queue.push_back(i);
+        }
+    }
+
+    // Counts the squares of a chunk, one column of words each, into the density pyramid.
+    void sparse_life::count_chunk(chunk const &c) const
+    {
+        static_assert(CHUNK_SQUARES == CHUNK_WORDS && CHUNK_ROWS == 1 << DENSITY_SHIFT);
+        for (std::size_t s = 0; s < CHUNK_SQUARES; ++s)
+        {
+            column_count count;
+            for (int y = 0; y < CHUNK_ROWS; ++y)
+            {
+                count.add(c.row(c.current, y)[s]);
+            }
+            uint64_t const n = count.total();
+            int64_t const sx = int64_t{c.cx} * static_cast<int64_t>(CHUNK_SQUARES) + static_cast<int64_t>(s);
+            if (densities.at(0, sx, c.cy) != n)
+            {
+                densities.set(sx, c.cy, n);
+            }
+        }
+    }
+
+    void sparse_life::get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const
+    {
+        std::fill_n(counts, static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows), 0);
+        if (level > MAX_DENSITY_LEVEL)
+        {
+            return;
+        }
+        int64_t const size = int64_t{1} << level;
+        if (level < DENSITY_SHIFT)
+        {
+            // a square lies within one word of one chunk
+            uint64_t const mask = (uint64_t{1} << size) - 1;
+            for (int r = 0; r < rows; ++r)
+            {
+                int64_t const y0 = y + r * size;
+                chunk const *c = nullptr;
+                int64_t cx = 0;
+                for (int col = 0; col < columns; ++col)
+                {
+                    int64_t const x0 = x + col * size;
+                    if (c == nullptr || (x0 >> CHUNK_X_SHIFT) != cx)
+                    {
+                        cx = x0 >> CHUNK_X_SHIFT;
+                        c = find(cx, y0 >> CHUNK_Y_SHIFT);
+                    }
+                    if (c == nullptr)
+                    {
+                        continue;
+                    }
+                    std::size_t const w = static_cast<std::size_t>((x0 & (CHUNK_WIDTH - 1)) / 64);
+                    int const shift = static_cast<int>(x0 & 63);
+                    int const ly = static_cast<int>(y0 & (CHUNK_ROWS - 1));
+                    uint64_t n = 0;
+                    for (int cy = ly; cy < ly + size; ++cy)
+                    {
+                        n += static_cast<uint64_t>(std::popcount((c->row(c->current, cy)[w] >> shift) & mask));
+                    }
+                    counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(col)] = n;
+                }
+            }
+            return;
+        }
+        if (!counting)
+        {
+            counting = true;
+            map.for_each([this](uint64_t, uint32_t i)
+                         {
+                             chunks[i]->density_stale = true;
+                             density_queue.push_back(i); });
+        }
+        for (uint32_t i : density_queue)
+        {
+            // released chunks took their squares with them, and their slot may have been reused since
+            chunk *c = chunks[i].get();
+            if (c != nullptr && c->density_stale)
+            {
+                count_chunk(*c);
+                c->density_stale = false;
+            }
+        }
+        density_queue.clear();
+        densities.update();
+        for (int r = 0; r < rows; ++r)
+        {
+            for (int col = 0; col < columns; ++col)
+            {
+                counts[static_cast<std::size_t>(r) * static_cast<std::size_t>(columns) + static_cast<std::size_t>(col)] =
+                    densities.at(level - DENSITY_SHIFT, (x >> level) + col, (y >> level) + r);
+            }
+        }
+    }
+
+    uint64_t sparse_life::population() const
+    {
+        uint64_t n = 0;
+        map.for_each([&](uint64_t, uint32_t i)
+                     {
+                         chunk const &c = *chunks[i];
+                         for (int y = 0; y < CHUNK_ROWS; ++y)
+                         {
+                             uint64_t const *r = c.row(c.current, y);
+                             for (std::size_t w = 0; w < CHUNK_WORDS; ++w)
+                             {
+                                 n += static_cast<uint64_t>(std::popcount(r[w]));
+                             }
+                         } });
+        return n;
+    }
+
+}
@@ -0,0 +1,179 @@
+#ifndef __SPARSE_LIFE_HPP__
+#define __SPARSE_LIFE_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "counter-rng.hpp"
+#include "density-pyramid.hpp"
+#include "game.hpp"
+#include "index-map.hpp"
+#include "kernels/life.hpp"
+#include "rule.hpp"
+#include "thread-pool.hpp"
+#include "util.hpp"
+
+namespace games
+{
+    /**
+     * Game of Life, or any other Life-like rule without B0, on an unbounded
+     * plane stored as chunks of CHUNK_ROWS rows by CHUNK_WORDS 64-bit words.
+     *
+     * Chunks live in an open-addressing hash map keyed by their chunk
+     * coordinates. A chunk exists only where there are live cells or
+     * activity next to them: it is created when a changing neighbor has
+     * live cells on the shared border and freed once it is empty and
+     * stable. Only chunks that changed in the previous generation, and the
+     * neighbors they touch, are stepped, so memory and time follow the live
+     * population rather than its bounding box.
+     *
+     * Every chunk row carries a halo word on either side, and every chunk a
+     * halo row above and below, filled from the neighbors before a step.
+     * That lets the SIMD kernels of the packed engine step a chunk without
+     * any edge cases.
+     *
+     * populate() fills the window [0, width) x [0, height).
+     */
+    class sparse_life final : public game
+    {
+    public:
+        static constexpr int CHUNK_ROWS = 64;
+        static constexpr std::size_t CHUNK_WORDS = kernels::CHUNK_WORDS;
+        static constexpr int CHUNK_WIDTH = static_cast<int>(CHUNK_WORDS) * 64;
+
+        sparse_life() = delete;
+        /// `threads` == 0 uses one thread per hardware thread.
+        sparse_life(int width, int height, unsigned int threads = 1);
+
+        void populate(double density) override;
+        void clear() override;
+        void irritate(int x, int y) override;
+        void iterate() override;
+        void seed(unsigned long s) override;
+        void set_span(int x, int y, int length, bool alive) override;
+        void get_rows(int y, int count, int width, uint64_t *words) const override;
+        void set_rows(int y, int count, int width, uint64_t const *words) override;
+        uint64_t hash() const override;
+        void get_density(int64_t x, int64_t y, int level, int columns, int rows, uint64_t *counts) const override;
+        inline bool get(int x, int y) const override
+        {
+            return get(int64_t{x}, int64_t{y});
+        }
+
+        void set(int64_t x, int64_t y, bool alive);
+        bool get(int64_t x, int64_t y) const;
+
+        void set_threads(unsigned int threads);
+        /// Rules with B0 would fill the infinite plane and are not supported.
+        void set_rule(rules::rule const &r);
+        inline rules::rule const &rule() const
+        {
+            return rule_;
+        }
+        inline uint64_t generation() const
+        {
+            return generation_;
+        }
+        uint64_t population() const override;
+        /// the cells of the chunks stepped
+        inline uint64_t cells_updated() const override
+        {
+            return static_cast<uint64_t>(last_active) * CHUNK_WIDTH * CHUNK_ROWS;
+        }
+        inline std::size_t chunk_count() const
+        {
+            return map.size();
+        }
+        /// Chunks stepped in the last generation.
+        inline std::size_t last_active_count() const
+        {
+            return last_active;
+        }
+
+    private:
+        static constexpr std::size_t STRIDE = CHUNK_WORDS + 2;
+        static constexpr std::size_t PLANE_WORDS = (CHUNK_ROWS + 2) * STRIDE;
+        // squares of level 0 of the density pyramid are 2^DENSITY_SHIFT cells across, a chunk is a row of them
+        static constexpr int DENSITY_SHIFT = 6;
+        static constexpr std::size_t CHUNK_SQUARES = CHUNK_WIDTH >> DENSITY_SHIFT;
+
+        struct chunk
+        {
+            int32_t cx;
+            int32_t cy;
+            // two planes with halos, `current` is the one holding the cells
+            uint64_t planes[2][PLANE_WORDS];
+            uint8_t current;
+            uint8_t changed;
+            // directions in which live cells touch the border, see DIRECTIONS
+            uint8_t edges;
+            bool scheduled;
+            // tile_hash() of the cells as counted in board_hash, the one of
+            // the cells just stepped, and whether the cells changed since
+            bool hash_stale;
+            uint64_t hash;
+            uint64_t next_hash;
+            // the counts of its squares in the density pyramid are out of date
+            bool density_stale;
+
+            // word 0 of row y, -1 <= y <= CHUNK_ROWS
+            inline uint64_t *row(int plane, int y)
+            {
+                return planes[plane] + static_cast<std::size_t>(y + 1) * STRIDE + 1;
+            }
+            inline uint64_t const *row(int plane, int y) const
+            {
+                return planes[plane] + static_cast<std::size_t>(y + 1) * STRIDE + 1;
+            }
+        };
+
+        static inline uint64_t key(int64_t cx, int64_t cy)
+        {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+        }
+        inline chunk const *find(int64_t cx, int64_t cy) const
+        {
+            uint32_t const i = map.find(key(cx, cy));
+            return i == util::index_map::NONE ? nullptr : chunks[i].get();
+        }
+        uint32_t get_or_create(int64_t cx, int64_t cy);
+        void release(uint32_t i);
+        void schedule(uint32_t i);
+        void touch(uint32_t i);
+        void fill_halo(chunk &c) const;
+        void step_chunk(chunk &c) const;
+        static uint8_t border(chunk const &c);
+        static bool is_empty(chunk const &c);
+        void mark_density(uint32_t i);
+        void count_chunk(chunk const &c) const;
+
+        const int width;
+        const int height;
+        kernels::life_kernel const *kernel;
+        rules::rule rule_{rules::CONWAY};
+        std::vector<std::unique_ptr<chunk>> chunks;
+        std::vector<uint32_t> free_ids;
+        util::index_map map;
+        // chunks to step in the next generation
+        std::vector<uint32_t> active;
+        std::vector<uint32_t> stepping;
+        std::size_t last_active{0};
+        uint64_t generation_{0};
+        // Chunks are hashed lazily by hash(), which also turns on hashing
+        // changed chunks right after stepping them.
+        mutable uint64_t board_hash{0};
+        mutable bool hashing{false};
+        // Counts of the 64 x 64 squares of the plane, and the chunks whose
+        // squares are out of date. The first get_density() call counts all
+        // chunks and turns on queueing them as they change.
+        mutable density_pyramid densities{MAX_DENSITY_LEVEL - DENSITY_SHIFT + 1};
+        mutable std::vector<uint32_t> density_queue;
+        mutable bool counting{false};
+        std::unique_ptr<util::thread_pool> pool;
+        util::counter_rng rng;
+    };
+}
+
+#endif // __SPARSE_LIFE_HPP__
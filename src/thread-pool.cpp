@@ -0,0 +1,105 @@
+#include "thread-pool.hpp"
+
+#include <algorithm>
+
+namespace util
+{
+    thread_pool::thread_pool(unsigned int threads)
+        : shares(threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+        workers.reserve(shares.size() - 1);
+        for (unsigned int id = 1; id < shares.size(); ++id)
+        {
+            workers.emplace_back(&thread_pool::worker, this, id);
+        }
+    }
+
+    thread_pool::~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto &t : workers)
+        {
+            t.join();
+        }
+    }
+
+    void thread_pool::parallel_for(std::size_t count, std::function<void(std::size_t)> const &task)
+    {
+        std::size_t const n = shares.size();
+        if (n == 1 || count <= 1)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                task(i);
+            }
+            return;
+        }
+        for (std::size_t id = 0; id < n; ++id)
+        {
+            shares[id].next.store(count * id / n, std::memory_order_relaxed);
+            shares[id].end = count * (id + 1) / n;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &task;
+            busy = static_cast<unsigned int>(workers.size());
+            ++round;
+        }
+        start_cv.notify_all();
+        drain(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this]
+                     { return busy == 0; });
+        current = nullptr;
+    }
+
+    void thread_pool::worker(unsigned int id)
+    {
+        unsigned long long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_cv.wait(lock, [&]
+                              { return stopping || round != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = round;
+            }
+            drain(id);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--busy != 0)
+                {
+                    continue;
+                }
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    // Works off the own share first, then steals from the others in turn.
+    void thread_pool::drain(unsigned int id)
+    {
+        std::size_t const n = shares.size();
+        for (std::size_t k = 0; k < n; ++k)
+        {
+            share &s = shares[(id + k) % n];
+            for (;;)
+            {
+                std::size_t const i = s.next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= s.end)
+                {
+                    break;
+                }
+                (*current)(i);
+            }
+        }
+    }
+}
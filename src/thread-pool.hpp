@@ -0,0 +1,62 @@
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util
+{
+    /**
+     * Persistent pool of worker threads for data-parallel loops.
+     *
+     * parallel_for() hands every worker (the calling thread counts as one) a
+     * contiguous share of the index range. A worker that runs out of its own
+     * share steals indexes from the others, so uneven tasks still balance.
+     * The call returns once all indexes are done, which makes it the single
+     * barrier of a generation.
+     */
+    class thread_pool
+    {
+    public:
+        /// `threads` includes the calling thread; 0 means one per hardware thread.
+        explicit thread_pool(unsigned int threads = 0);
+        ~thread_pool();
+
+        thread_pool(thread_pool const &) = delete;
+        thread_pool &operator=(thread_pool const &) = delete;
+
+        inline unsigned int size() const
+        {
+            return static_cast<unsigned int>(shares.size());
+        }
+
+        void parallel_for(std::size_t count, std::function<void(std::size_t)> const &task);
+
+    private:
+        struct alignas(64) share
+        {
+            std::atomic<std::size_t> next{0};
+            std::size_t end{0};
+        };
+
+        void worker(unsigned int id);
+        void drain(unsigned int id);
+
+        std::vector<share> shares;
+        std::vector<std::thread> workers;
+        std::function<void(std::size_t)> const *current{nullptr};
+        std::mutex mutex;
+        std::condition_variable start_cv;
+        std::condition_variable done_cv;
+        unsigned long long round{0};
+        unsigned int busy{0};
+        bool stopping{false};
+    };
+}
+
+#endif // __THREAD_POOL_HPP__
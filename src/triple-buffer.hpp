@@ -0,0 +1,80 @@
+#ifndef __TRIPLE_BUFFER_HPP__
+#define __TRIPLE_BUFFER_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace util
+{
+    /**
+     * Lock-free hand-off of values from one producer thread to one consumer
+     * thread.
+     *
+     * The producer fills back() and publish()es it; the consumer calls
+     * update() and reads front(). The third slot sits in between, so neither
+     * side ever waits for the other and the consumer always sees the newest
+     * published value. A value published while the previous one is still
+     * unread replaces it.
+     */
+    template <typename T>
+    class triple_buffer
+    {
+    public:
+        triple_buffer() = default;
+        explicit triple_buffer(T const &initial)
+            : slots{initial, initial, initial}
+        {
+        }
+
+        triple_buffer(triple_buffer const &) = delete;
+        triple_buffer &operator=(triple_buffer const &) = delete;
+
+        /// The slot the producer writes to.
+        inline T &back()
+        {
+            return slots[back_];
+        }
+
+        /// Hands back() to the consumer and gives the producer a free slot.
+        inline void publish()
+        {
+            back_ = middle.exchange(static_cast<uint8_t>(back_ | FRESH), std::memory_order_acq_rel) & INDEX;
+        }
+
+        /// True once the consumer has taken the last published value.
+        inline bool consumed() const
+        {
+            return (middle.load(std::memory_order_acquire) & FRESH) == 0;
+        }
+
+        /// Makes the newest published value the front. Returns false if there was none.
+        inline bool update()
+        {
+            if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+            {
+                return false;
+            }
+            front_ = middle.exchange(front_, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        /// The slot the consumer reads from.
+        inline T const &front() const
+        {
+            return slots[front_];
+        }
+
+    private:
+        static constexpr uint8_t INDEX = 3;
+        static constexpr uint8_t FRESH = 4;
+
+        std::array<T, 3> slots{};
+        uint8_t back_{0};
+        // slot index, plus FRESH while it holds a value the consumer has not taken
+        std::atomic<uint8_t> middle{1};
+        uint8_t front_{2};
+    };
+}
+
+#endif // __TRIPLE_BUFFER_HPP__
@@ -1,9 +1,13 @@
 #ifndef __UI_CONTEXT_HPP__
 #define __UI_CONTEXT_HPP__
 
+#include <memory>
+
 #include <SDL.h>
 #include <SDL_ttf.h>
 
+#include "glyph_atlas.hpp"
+
 namespace ui
 {
     class context
@@ -31,6 +35,15 @@ namespace ui
         {
             return renderer_;
         }
+        /// The glyphs of font(), built on first use and shared by every element drawing text.
+        inline glyph_atlas &atlas()
+        {
+            if (!atlas_)
+            {
+                atlas_ = std::make_unique<glyph_atlas>(renderer_, font_);
+            }
+            return *atlas_;
+        }
         inline SDL_Color foreground_color() const
         {
             return foreground_color_;
@@ -50,6 +63,7 @@ namespace ui
         SDL_Color foreground_color_{255, 255, 255, 255};
         SDL_Color background_color_{10, 10, 10, 200};
         SDL_Color highlight_color_{191, 255, 0, 255};
+        std::unique_ptr<glyph_atlas> atlas_;
     };
 }
 
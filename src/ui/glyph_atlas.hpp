@@ -0,0 +1,162 @@
+#ifndef __UI_GLYPH_ATLAS_HPP__
+#define __UI_GLYPH_ATLAS_HPP__
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+namespace ui
+{
+    /**
+     * The printable ASCII glyphs of a font, rasterized once into a single
+     * texture.
+     *
+     * Text is laid out as one quad per glyph that samples the texture, and
+     * a whole string is drawn with one SDL_RenderGeometry() call. Glyphs
+     * are rendered white, so the vertex color tints them. Characters the
+     * atlas does not hold are drawn as '?'.
+     */
+    class glyph_atlas
+    {
+    public:
+        static constexpr char FIRST = ' ';
+        static constexpr char LAST = '~';
+        /// width of the texture; glyphs are packed into rows of it
+        static constexpr int WIDTH = 512;
+
+        glyph_atlas(SDL_Renderer *renderer, TTF_Font *font)
+            : height(TTF_FontHeight(font))
+        {
+            std::array<SDL_Surface *, LAST - FIRST + 1> rendered{};
+            int x = 0;
+            int y = 0;
+            int row_height = 0;
+            for (char c = FIRST; c <= LAST; ++c)
+            {
+                glyph &g = glyphs[static_cast<std::size_t>(c - FIRST)];
+                TTF_GlyphMetrics(font, static_cast<Uint16>(c), nullptr, nullptr, nullptr, nullptr, &g.advance);
+                SDL_Surface *s = TTF_RenderGlyph_Blended(font, static_cast<Uint16>(c), SDL_Color{255, 255, 255, 255});
+                rendered[static_cast<std::size_t>(c - FIRST)] = s;
+                if (s == nullptr)
+                {
+                    continue;
+                }
+                if (x + s->w > WIDTH)
+                {
+                    x = 0;
+                    y += row_height + 1;
+                    row_height = 0;
+                }
+                // a glyph surface is a line high, with the glyph where it is relative to the pen
+                g.source = {x, y, s->w, s->h};
+                x += s->w + 1;
+                row_height = std::max(row_height, s->h);
+            }
+            SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, y + row_height, 32, SDL_PIXELFORMAT_RGBA32);
+            for (std::size_t i = 0; i < rendered.size(); ++i)
+            {
+                if (rendered[i] == nullptr)
+                {
+                    continue;
+                }
+                if (sheet != nullptr)
+                {
+                    SDL_SetSurfaceBlendMode(rendered[i], SDL_BLENDMODE_NONE);
+                    SDL_BlitSurface(rendered[i], nullptr, sheet, &glyphs[i].source);
+                }
+                SDL_FreeSurface(rendered[i]);
+            }
+            if (sheet == nullptr)
+            {
+                return;
+            }
+            texture = SDL_CreateTextureFromSurface(renderer, sheet);
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+            sheet_width = static_cast<float>(sheet->w);
+            sheet_height = static_cast<float>(sheet->h);
+            SDL_FreeSurface(sheet);
+        }
+
+        ~glyph_atlas()
+        {
+            SDL_DestroyTexture(texture);
+        }
+
+        glyph_atlas(glyph_atlas const &) = delete;
+        glyph_atlas &operator=(glyph_atlas const &) = delete;
+
+        inline SDL_Texture *sheet() const
+        {
+            return texture;
+        }
+
+        /**
+         * Replaces `vertices` with the quads of `text`, its top left corner
+         * at (x, y), 4 vertices per character. Returns the size of the text.
+         * Keeps the capacity of `vertices`, so laying out text no longer
+         * than before allocates nothing.
+         */
+        SDL_Point layout(std::string const &text, int x, int y, SDL_Color color, std::vector<SDL_Vertex> &vertices) const
+        {
+            vertices.clear();
+            int pen = x;
+            for (char c : text)
+            {
+                glyph const &g = glyphs[static_cast<std::size_t>((c >= FIRST && c <= LAST ? c : '?') - FIRST)];
+                float const left = static_cast<float>(pen);
+                float const top = static_cast<float>(y);
+                float const right = left + static_cast<float>(g.source.w);
+                float const bottom = top + static_cast<float>(g.source.h);
+                float const u0 = static_cast<float>(g.source.x) / sheet_width;
+                float const v0 = static_cast<float>(g.source.y) / sheet_height;
+                float const u1 = static_cast<float>(g.source.x + g.source.w) / sheet_width;
+                float const v1 = static_cast<float>(g.source.y + g.source.h) / sheet_height;
+                vertices.push_back({{left, top}, color, {u0, v0}});
+                vertices.push_back({{right, top}, color, {u1, v0}});
+                vertices.push_back({{right, bottom}, color, {u1, v1}});
+                vertices.push_back({{left, bottom}, color, {u0, v1}});
+                pen += g.advance;
+            }
+            return {pen - x, height};
+        }
+
+        /// Draws quads from layout() in one call.
+        void draw(SDL_Renderer *renderer, std::vector<SDL_Vertex> const &vertices)
+        {
+            std::size_t const quads = vertices.size() / 4;
+            // the two triangles of every quad; grows only for the longest text so far
+            for (std::size_t q = indices.size() / 6; q < quads; ++q)
+            {
+                int const v = static_cast<int>(q * 4);
+                indices.insert(indices.end(), {v, v + 1, v + 2, v, v + 2, v + 3});
+            }
+            if (quads > 0 && texture != nullptr)
+            {
+                SDL_RenderGeometry(renderer, texture, vertices.data(), static_cast<int>(vertices.size()),
+                                   indices.data(), static_cast<int>(quads * 6));
+            }
+        }
+
+    private:
+        struct glyph
+        {
+            // where the glyph is in the texture
+            SDL_Rect source{0, 0, 0, 0};
+            // pen movement to the next glyph
+            int advance{0};
+        };
+
+        int height;
+        std::array<glyph, LAST - FIRST + 1> glyphs{};
+        SDL_Texture *texture{nullptr};
+        float sheet_width{1};
+        float sheet_height{1};
+        std::vector<int> indices;
+    };
+}
+
+#endif // __UI_GLYPH_ATLAS_HPP__
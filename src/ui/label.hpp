@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <SDL.h>
 
@@ -10,6 +11,11 @@
 
 namespace ui
 {
+    /**
+     * A line of text drawn from the context's glyph atlas. The quads of
+     * the text are kept and laid out again only when the text, position
+     * or color changes, so drawing an unchanged label allocates nothing.
+     */
     class label : public ui_element
     {
     public:
@@ -33,24 +39,32 @@ namespace ui
         }
         void render()
         {
-            SDL_Surface *text_surface = TTF_RenderText_Solid(ctx()->font(), text_.c_str(), color_);
-            pos_.w = text_surface->w;
-            pos_.h = text_surface->h;
-            SDL_Texture *font_texture = SDL_CreateTextureFromSurface(ctx()->renderer(), text_surface);
-            SDL_RenderCopy(ctx()->renderer(), font_texture, nullptr, &pos_);
-            SDL_DestroyTexture(font_texture);
-            SDL_FreeSurface(text_surface);
+            glyph_atlas &atlas = ctx()->atlas();
+            if (stale)
+            {
+                SDL_Point const size = atlas.layout(text_, pos_.x, pos_.y, color_, vertices);
+                pos_.w = size.x;
+                pos_.h = size.y;
+                stale = false;
+            }
+            atlas.draw(ctx()->renderer(), vertices);
         }
         void set_pos(SDL_Rect pos)
         {
+            stale = stale || pos.x != pos_.x || pos.y != pos_.y;
             pos_ = pos;
         }
         void set_text(std::string const &text)
         {
-            text_ = text;
+            if (text != text_)
+            {
+                text_ = text;
+                stale = true;
+            }
         }
         void set_color(SDL_Color color)
         {
+            stale = stale || color.r != color_.r || color.g != color_.g || color.b != color_.b || color.a != color_.a;
             color_ = color;
         }
         std::string const &text() const
@@ -62,6 +76,9 @@ namespace ui
         SDL_Rect pos_{0, 0, 0, 0};
         SDL_Color color_{255, 255, 255, 200};
         std::string text_;
+        // the quads of text_, laid out again when `stale`
+        std::vector<SDL_Vertex> vertices;
+        bool stale{true};
     };
 
 }
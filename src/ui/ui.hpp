@@ -1,6 +1,7 @@
 #ifndef __UI_HPP__
 #define __UI_HPP__
 
+#include "glyph_atlas.hpp"
 #include "context.hpp"
 #include "ui_element.hpp"
 #include "label.hpp"